@@ -27,7 +27,7 @@ esac
 
 cd ./jemalloc-5.3.0 && \
     bash autogen.sh && \
-    CC=/usr/bin/gcc CXX=/usr/bin/g++ ./configure --prefix=/usr/local CXXFLAGS=-fPIC CFLAGS=-fPIC && \
+    CC=/usr/bin/gcc CXX=/usr/bin/g++ ./configure --prefix=/usr/local --enable-prof CXXFLAGS=-fPIC CFLAGS=-fPIC && \
     make -j && \
     make install && \
     make clean && \
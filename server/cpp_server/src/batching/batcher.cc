@@ -9,15 +9,32 @@
 
 #include <boost/asio/post.hpp>
 #include <boost/thread/future.hpp>
+#include <butil/time.h>
 
 #include "config/global_config.h"
 #include "logger/logger.h"
+#include "monitor/trace.h"
 
 namespace netease::grps {
+DynamicBatcher::~DynamicBatcher() {
+  // Batcher of an unloaded model(e.g. replaced by hot reload) may not be stopped explicitly.
+  if (schedule_thread_.joinable()) {
+    Stop();
+  }
+  if (worker_tp_) {
+    worker_tp_->join();
+  }
+}
+
 void DynamicBatcher::Init(
   std::string name, int max_batch_size, int batch_timeout_us, Converter* converter, ModelInferer* inferer) {
   Batcher::Init(name, max_batch_size, batch_timeout_us, converter, inferer);
   worker_tp_ = std::make_unique<boost::asio::thread_pool>(GlobalConfig::Instance().server_config().max_concurrency);
+  batch_metrics_.resize(max_batch_size + 1);
+  batch_metrics_once_ = std::make_unique<std::once_flag[]>(max_batch_size + 1);
+  if (inferer && inferer->SupportProfiler()) {
+    profile_counter_ = InferProfiler::Instance().Register(name_);
+  }
   LOG4(INFO, "DynamicBatcher(" << name << ") init, max_batch_size: " << max_batch_size
                                << ", batch_timeout_us: " << batch_timeout_us);
 }
@@ -59,10 +76,14 @@ void DynamicBatcher::Start() {
         std::vector<const ::grps::protos::v1::GrpsMessage*> inputs;
         std::vector<::grps::protos::v1::GrpsMessage*> outputs;
         std::vector<GrpsContext*> ctxs;
+        auto& metrics = BatchMetrics(tasks.size());
+        auto begin = butil::gettimeofday_us();
         for (const auto& task : tasks) {
+          StageMetrics::Observe(metrics.queue_wait, begin - task.enqueue_us);
           inputs.emplace_back(task.input);
           outputs.emplace_back(task.output);
           ctxs.emplace_back(task.ctx == nullptr ? task.ctx_sp.get() : task.ctx);
+          Trace::Record(ctxs.back()->trace(), "batch_queue", task.enqueue_us, begin, name_);
         }
         BatchInferProcess(inputs, outputs, ctxs);
       });
@@ -85,7 +106,7 @@ void DynamicBatcher::Infer(const ::grps::protos::v1::GrpsMessage& input,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "DynamicBatcher(" << name_ << ") infer, input: " << input.DebugString());
 #endif
-  Task task = {&input, &output, &ctx, nullptr};
+  Task task = {&input, &output, &ctx, nullptr, butil::gettimeofday_us()};
   boost::promise<void> promise;
   task.ctx->set_batcher_promise(&promise);
   auto future = promise.get_future();
@@ -103,7 +124,7 @@ void DynamicBatcher::Infer(const ::grps::protos::v1::GrpsMessage& input,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "DynamicBatcher(" << name_ << ") infer, input: " << input.DebugString());
 #endif
-  Task task = {&input, &output, nullptr, ctx_sp};
+  Task task = {&input, &output, nullptr, ctx_sp, butil::gettimeofday_us()};
   boost::promise<void> promise;
   task.ctx_sp->set_batcher_promise(&promise);
   auto future = promise.get_future();
@@ -115,6 +136,25 @@ void DynamicBatcher::Infer(const ::grps::protos::v1::GrpsMessage& input,
   future.wait();
 }
 
+StageMetrics& DynamicBatcher::BatchMetrics(size_t batch_size) {
+  std::call_once(batch_metrics_once_[batch_size], [this, batch_size] {
+    batch_metrics_[batch_size] = std::make_unique<StageMetrics>(
+      "model=" + name_ + ",batch=" + std::to_string(batch_size), converter_ != nullptr, true);
+  });
+  return *batch_metrics_[batch_size];
+}
+
+// Record span of one batch stage into traces of sampled requests in the batch.
+static void TraceBatch(const std::vector<GrpsContext*>& ctxs,
+                       const char* stage,
+                       int64_t begin_us,
+                       int64_t end_us,
+                       const std::string& name) {
+  for (const auto& ctx : ctxs) {
+    Trace::Record(ctx->trace(), stage, begin_us, end_us, name);
+  }
+}
+
 static bool AllErr(const std::vector<GrpsContext*>& ctxs) {
   bool all_err = true;
   for (const auto& ctx : ctxs) {
@@ -144,7 +184,12 @@ void DynamicBatcher::BatchInferProcess(std::vector<const ::grps::protos::v1::Grp
         goto NOTIFY;
       }
       auto preprocess_end = butil::gettimeofday_us();
-      inferer_->BatchInfer(input_tensors, output_tensors, ctxs);
+      auto profiler_path = InferProfiler::Acquire(profile_counter_.get(), name_);
+      if (profiler_path.empty()) {
+        inferer_->BatchInfer(input_tensors, output_tensors, ctxs);
+      } else {
+        inferer_->BatchInferWithProfiler(profiler_path, input_tensors, output_tensors, ctxs);
+      }
       if (AllErr(ctxs)) {
         goto NOTIFY;
       }
@@ -154,18 +199,36 @@ void DynamicBatcher::BatchInferProcess(std::vector<const ::grps::protos::v1::Grp
         goto NOTIFY;
       }
       auto postprocess_end = butil::gettimeofday_us();
+      auto& metrics = BatchMetrics(inputs.size());
+      StageMetrics::Observe(metrics.preprocess, preprocess_end - begin);
+      StageMetrics::Observe(metrics.infer, infer_end - preprocess_end);
+      StageMetrics::Observe(metrics.postprocess, postprocess_end - infer_end);
+      TraceBatch(ctxs, "batch_preprocess", begin, preprocess_end, name_);
+      TraceBatch(ctxs, "batch_infer", preprocess_end, infer_end, name_);
+      TraceBatch(ctxs, "batch_postprocess", infer_end, postprocess_end, name_);
+#ifdef GRPS_DEBUG
       LOG4(INFO, "DynamicBatcher(" << name_ << "), batch_size: " << inputs.size() << ", preprocess latency: "
                                    << preprocess_end - begin << "us, infer latency: " << infer_end - preprocess_end
                                    << "us, postprocess latency: " << postprocess_end - infer_end << "us");
+#endif
     } else {
       auto begin = butil::gettimeofday_us();
-      inferer_->BatchInfer(inputs, outputs, ctxs);
+      auto profiler_path = InferProfiler::Acquire(profile_counter_.get(), name_);
+      if (profiler_path.empty()) {
+        inferer_->BatchInfer(inputs, outputs, ctxs);
+      } else {
+        inferer_->BatchInferWithProfiler(profiler_path, inputs, outputs, ctxs);
+      }
       if (AllErr(ctxs)) {
         goto NOTIFY;
       }
       auto infer_end = butil::gettimeofday_us();
+      StageMetrics::Observe(BatchMetrics(inputs.size()).infer, infer_end - begin);
+      TraceBatch(ctxs, "batch_infer", begin, infer_end, name_);
+#ifdef GRPS_DEBUG
       LOG4(INFO, "DynamicBatcher(" << name_ << "), batch_size: " << inputs.size()
                                    << ", infer latency: " << infer_end - begin << "us");
+#endif
     }
 
   NOTIFY:
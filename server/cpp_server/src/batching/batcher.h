@@ -10,13 +10,17 @@
 #include <boost/asio/thread_pool.hpp>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 #include "context/context.h"
 #include "converter/converter.h"
 #include "grps.pb.h"
+#include "model_infer/infer_profiler.h"
 #include "model_infer/inferer.h"
+#include "monitor/stage_metrics.h"
 
 namespace netease::grps {
 class Batcher {
@@ -40,6 +44,7 @@ public:
     ::grps::protos::v1::GrpsMessage* output;
     GrpsContext* ctx;
     std::shared_ptr<GrpsContext> ctx_sp;
+    int64_t enqueue_us; // Time of entering queue.
   };
 
   Batcher() = default;
@@ -95,7 +100,7 @@ protected:
 class DynamicBatcher : public Batcher {
 public:
   DynamicBatcher() = default;
-  ~DynamicBatcher() override = default;
+  ~DynamicBatcher() override;
 
   void Init(
     std::string name, int max_batch_size, int batch_timeout_us, Converter* converter, ModelInferer* inferer) override;
@@ -133,10 +138,16 @@ private:
                          std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
                          std::vector<netease::grps::GrpsContext*>& ctxs);
 
+  // Stage metrics of batch size, registered on the first batch of the size.
+  StageMetrics& BatchMetrics(size_t batch_size);
+
   std::deque<Task> task_queue_;
   std::mutex queue_mutex_;
   std::condition_variable queue_cv_;
   std::thread schedule_thread_;
   std::unique_ptr<boost::asio::thread_pool> worker_tp_;
+  std::vector<std::unique_ptr<StageMetrics>> batch_metrics_; // Index is batch size.
+  std::unique_ptr<std::once_flag[]> batch_metrics_once_;
+  std::shared_ptr<InferProfiler::Counter> profile_counter_; // Null if profiler not supported.
 };
 } // namespace netease::grps
\ No newline at end of file
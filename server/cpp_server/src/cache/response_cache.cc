@@ -0,0 +1,220 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/03
+ * Brief  Per-model response cache.
+ */
+
+#include "response_cache.h"
+
+#include <butil/third_party/murmurhash3/murmurhash3.h>
+#include <butil/time.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include "config/global_config.h"
+#include "constant.h"
+#include "logger/logger.h"
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+static constexpr uint32_t kKeySeed = 0x67727073; // "grps"
+
+ResponseCache::ResponseCache(std::string model_name,
+                             Policy policy,
+                             size_t max_bytes,
+                             int64_t ttl_ms,
+                             int shard_num)
+    : model_name_(std::move(model_name)), policy_(policy), ttl_us_(ttl_ms * 1000) {
+  if (max_bytes == 0) {
+    throw ResponseCacheException("max_bytes of cache should be greater than 0, model: " + model_name_);
+  }
+  if (shard_num <= 0) {
+    throw ResponseCacheException("shard_num of cache should be greater than 0, model: " + model_name_);
+  }
+  if (ttl_ms < 0) {
+    throw ResponseCacheException("ttl_ms of cache should not be negative, model: " + model_name_);
+  }
+
+  shard_max_bytes_ = max_bytes / shard_num;
+  shards_.reserve(shard_num);
+  for (int i = 0; i < shard_num; ++i) {
+    auto shard = std::make_unique<Shard>();
+    if (policy_ == Policy::kTinyLfu) {
+      // Assume about 1KB per response to size the sketch.
+      shard->sketch = std::make_unique<FrequencySketch>(std::max<size_t>(shard_max_bytes_ / 1024, 64));
+    }
+    shards_.emplace_back(std::move(shard));
+  }
+
+  hit_rate_metric_ = MONITOR_REGISTER(std::string(CACHE_HIT_RATE) + "{model=" + model_name_ + "}", AggType::kAvg);
+  size_metric_ = MONITOR_REGISTER(std::string(CACHE_SIZE) + "{model=" + model_name_ + "}", AggType::kMax);
+  eviction_metric_ =
+    MONITOR_REGISTER(std::string(CACHE_EVICTION_COUNT) + "{model=" + model_name_ + "}", AggType::kInc);
+}
+
+bool ResponseCache::Cacheable(GrpsContext& ctx) {
+  if (ctx.IfStreaming()) {
+    return false;
+  }
+  // Customized http request has empty request message and its response is written by user through http controller.
+  const auto& server_config = GlobalConfig::Instance().server_config();
+  if (ctx.http_controller() != nullptr && server_config._is_set.customized_predict_http &&
+      server_config.interface.customized_predict_http.customized_body) {
+    return false;
+  }
+  return true;
+}
+
+ResponseCache::Key ResponseCache::MakeKey(const std::string& model_name, const ::grps::protos::v1::GrpsMessage& input) {
+  // Deterministic serialization makes map fields (gmap) stable between equal requests.
+  std::string serialized;
+  {
+    ::google::protobuf::io::StringOutputStream string_stream(&serialized);
+    ::google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    input.SerializeToCodedStream(&coded_stream);
+  }
+
+  butil::MurmurHash3_x64_128_Context hash_ctx{};
+  butil::MurmurHash3_x64_128_Init(&hash_ctx, kKeySeed);
+  butil::MurmurHash3_x64_128_Update(&hash_ctx, model_name.data(), int(model_name.size()));
+  butil::MurmurHash3_x64_128_Update(&hash_ctx, serialized.data(), int(serialized.size()));
+  uint64_t out[2];
+  butil::MurmurHash3_x64_128_Final(out, &hash_ctx);
+  return {out[0], out[1]};
+}
+
+bool ResponseCache::Lookup(const Key& key, ::grps::protos::v1::GrpsMessage& output) {
+  auto& shard = GetShard(key);
+  std::shared_ptr<const ::grps::protos::v1::GrpsMessage> value;
+  bool expired = false;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (shard.sketch) {
+      shard.sketch->Increment(key);
+    }
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end()) {
+      if (iter->second->expire_us != 0 && iter->second->expire_us < butil::gettimeofday_us()) {
+        Erase(shard, iter->second);
+        expired = true;
+      } else {
+        shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+        value = iter->second->value;
+      }
+    }
+  }
+
+  if (expired) {
+    MONITOR_INC(eviction_metric_, 1);
+  }
+  if (!value) {
+    MONITOR_AVG(hit_rate_metric_, 0);
+    return false;
+  }
+
+  // Copy outside the lock, value will not be modified after inserted.
+  output.CopyFrom(*value);
+  MONITOR_AVG(hit_rate_metric_, 100);
+  return true;
+}
+
+void ResponseCache::Insert(const Key& key, const ::grps::protos::v1::GrpsMessage& output) {
+  auto value = std::make_shared<::grps::protos::v1::GrpsMessage>(output);
+  size_t bytes = value->SpaceUsedLong() + sizeof(Entry);
+  if (bytes > shard_max_bytes_) {
+    return;
+  }
+  int64_t expire_us = ttl_us_ == 0 ? 0 : butil::gettimeofday_us() + ttl_us_;
+
+  auto& shard = GetShard(key);
+  int evicted = 0;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end()) {
+      // Inserted by other request with the same input.
+      Erase(shard, iter->second);
+    }
+
+    if (shard.sketch && shard.bytes + bytes > shard_max_bytes_ && !shard.lru.empty() &&
+        shard.sketch->Estimate(key) <= shard.sketch->Estimate(shard.lru.back().key)) {
+      // Tinylfu admission: candidate is not more frequent than the victim, reject it.
+      return;
+    }
+
+    while (shard.bytes + bytes > shard_max_bytes_ && !shard.lru.empty()) {
+      Erase(shard, std::prev(shard.lru.end()));
+      ++evicted;
+    }
+
+    shard.lru.push_front({key, std::move(value), bytes, expire_us});
+    shard.index.emplace(key, shard.lru.begin());
+    shard.bytes += bytes;
+  }
+
+  if (evicted > 0) {
+    MONITOR_INC(eviction_metric_, float(evicted));
+  }
+  MONITOR_MAX(size_metric_, float(this->bytes()) / MIB);
+}
+
+size_t ResponseCache::bytes() const {
+  size_t total = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mtx);
+    total += shard->bytes;
+  }
+  return total;
+}
+
+void ResponseCache::Erase(Shard& shard, std::list<Entry>::iterator iter) {
+  shard.bytes -= iter->bytes;
+  shard.index.erase(iter->key);
+  shard.lru.erase(iter);
+}
+
+ResponseCache::FrequencySketch::FrequencySketch(size_t width) {
+  size_t size = 1;
+  while (size < width) {
+    size <<= 1;
+  }
+  table_.resize(size * kDepth, 0);
+  mask_ = size - 1;
+  sample_size_ = size * 10;
+}
+
+size_t ResponseCache::FrequencySketch::Index(const Key& key, int row) const {
+  uint64_t hash = key.h1 + uint64_t(row) * key.h2;
+  return size_t(row) * (mask_ + 1) + (hash & mask_);
+}
+
+void ResponseCache::FrequencySketch::Increment(const Key& key) {
+  for (int row = 0; row < kDepth; ++row) {
+    auto& counter = table_[Index(key, row)];
+    if (counter < kMaxCount) {
+      ++counter;
+    }
+  }
+  if (++additions_ >= sample_size_) {
+    Reset();
+  }
+}
+
+uint8_t ResponseCache::FrequencySketch::Estimate(const Key& key) const {
+  uint8_t freq = kMaxCount;
+  for (int row = 0; row < kDepth; ++row) {
+    freq = std::min(freq, table_[Index(key, row)]);
+  }
+  return freq;
+}
+
+void ResponseCache::FrequencySketch::Reset() {
+  // Aging: halve all counters so that old popularity fades out.
+  for (auto& counter : table_) {
+    counter >>= 1;
+  }
+  additions_ /= 2;
+}
+} // namespace netease::grps
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/03
+ * Brief  Per-model response cache. Responses are keyed by the hash of the serialized request message and the model
+ *        (name-version), stored in a sharded lru cache bounded by bytes and expired by ttl. An optional tinylfu
+ *        admission policy keeps one-hit wonders from flushing hot entries.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "context/context.h"
+#include "grps.pb.h"
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+class ResponseCache {
+public:
+  class ResponseCacheException : public std::exception {
+  public:
+    explicit ResponseCacheException(std::string message) : message_(std::move(message)) {}
+    ~ResponseCacheException() override = default;
+    [[nodiscard]] const char* what() const noexcept override {
+      static std::string err_message;
+      err_message = "[ResponseCacheException] " + message_;
+      return err_message.c_str();
+    }
+
+  private:
+    std::string message_;
+  };
+
+  enum class Policy { kLru = 0, kTinyLfu = 1 };
+
+  // 128 bits hash of request message and model.
+  struct Key {
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    bool operator==(const Key& other) const { return h1 == other.h1 && h2 == other.h2; }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const { return key.h1; }
+  };
+
+  /**
+   * @brief Response cache constructor.
+   * @param model_name: Model name with `name-version` format, mixed into the key and used as metrics label.
+   * @param policy: Cache policy.
+   * @param max_bytes: Maximum bytes of cached responses.
+   * @param ttl_ms: Time to live of one cached response, 0 means never expire.
+   * @param shard_num: Shard number, each shard has its own lock and 1/shard_num of max_bytes.
+   */
+  ResponseCache(std::string model_name, Policy policy, size_t max_bytes, int64_t ttl_ms, int shard_num);
+  ~ResponseCache() = default;
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+  ResponseCache(ResponseCache&&) = delete;
+  ResponseCache& operator=(ResponseCache&&) = delete;
+
+  /**
+   * @brief If the request of ctx can be served by cache. Streaming requests and customized http requests (whose
+   * response is written by user through http controller) are never cached.
+   */
+  static bool Cacheable(GrpsContext& ctx);
+
+  /**
+   * @brief Compute cache key of input.
+   */
+  [[nodiscard]] Key MakeKey(const ::grps::protos::v1::GrpsMessage& input) const { return MakeKey(model_name_, input); }
+
+  /**
+   * @brief Compute key of input, hash of model name and deterministic serialized input.
+   */
+  static Key MakeKey(const std::string& model_name, const ::grps::protos::v1::GrpsMessage& input);
+
+  /**
+   * @brief Lookup cached response.
+   * @param key: Key made by MakeKey.
+   * @param output: Cached response will be copied to output when hit.
+   * @return If hit.
+   */
+  bool Lookup(const Key& key, ::grps::protos::v1::GrpsMessage& output);
+
+  /**
+   * @brief Insert response into cache. May be rejected by admission policy.
+   */
+  void Insert(const Key& key, const ::grps::protos::v1::GrpsMessage& output);
+
+  [[nodiscard]] const std::string& model_name() const { return model_name_; }
+  [[nodiscard]] size_t bytes() const;
+
+private:
+  struct Entry {
+    Key key;
+    std::shared_ptr<const ::grps::protos::v1::GrpsMessage> value;
+    size_t bytes;
+    int64_t expire_us; // 0 means never expire.
+  };
+
+  // Count-min sketch with 4 rows used by tinylfu admission to estimate access frequency.
+  class FrequencySketch {
+  public:
+    explicit FrequencySketch(size_t width);
+    void Increment(const Key& key);
+    [[nodiscard]] uint8_t Estimate(const Key& key) const;
+
+  private:
+    static constexpr int kDepth = 4;
+    static constexpr uint8_t kMaxCount = 15;
+    std::vector<uint8_t> table_;
+    size_t mask_;
+    size_t additions_ = 0;
+    size_t sample_size_;
+    [[nodiscard]] size_t Index(const Key& key, int row) const;
+    void Reset();
+  };
+
+  struct Shard {
+    std::mutex mtx;
+    std::list<Entry> lru; // Front is the most recently used.
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    size_t bytes = 0;
+    std::unique_ptr<FrequencySketch> sketch;
+  };
+
+  std::string model_name_;
+  Policy policy_;
+  size_t shard_max_bytes_;
+  int64_t ttl_us_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Metrics handles.
+  MetricsAgg* hit_rate_metric_;
+  MetricsAgg* size_metric_;
+  MetricsAgg* eviction_metric_;
+
+  Shard& GetShard(const Key& key) { return *shards_[key.h2 % shards_.size()]; }
+  // Remove entry from shard, shard lock should be held.
+  static void Erase(Shard& shard, std::list<Entry>::iterator iter);
+};
+} // namespace netease::grps
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/05
+ * Brief  Single flight, coalesce identical in-flight requests of one model.
+ */
+
+#include "single_flight.h"
+
+#include <chrono>
+
+#include "constant.h"
+#include "logger/logger.h"
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+SingleFlight::Leader::~Leader() {
+  if (std::uncaught_exceptions() > uncaught_exceptions_) {
+    single_flight_->Publish(key_, call_, nullptr, "Coalesced request failed, leader request throws exception.");
+  } else if (ctx_.has_err()) {
+    auto err_msg = ctx_.err_msg();
+    single_flight_->Publish(key_, call_, nullptr, err_msg.empty() ? "Coalesced request failed." : err_msg);
+  } else {
+    single_flight_->Publish(key_, call_, &output_, "");
+  }
+}
+
+SingleFlight::SingleFlight(std::string model_name, int64_t wait_timeout_ms)
+    : model_name_(std::move(model_name)), wait_timeout_ms_(wait_timeout_ms) {
+  coalesced_metric_ = MONITOR_REGISTER(std::string(COALESCED_COUNT) + "{model=" + model_name_ + "}", AggType::kInc);
+  coalesced_timeout_metric_ =
+    MONITOR_REGISTER(std::string(COALESCED_TIMEOUT_COUNT) + "{model=" + model_name_ + "}", AggType::kInc);
+}
+
+bool SingleFlight::Join(const Key& key,
+                        ::grps::protos::v1::GrpsMessage& output,
+                        GrpsContext& ctx,
+                        std::unique_ptr<Leader>& leader) {
+  std::shared_ptr<Call> call;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto iter = calls_.find(key);
+    if (iter == calls_.end()) {
+      call = std::make_shared<Call>();
+      calls_.emplace(key, call);
+      leader = std::make_unique<Leader>(this, key, call, output, ctx);
+      return false;
+    }
+    call = iter->second;
+    ++call->followers;
+  }
+
+  MONITOR_INC(coalesced_metric_, 1);
+  std::unique_lock<std::mutex> lock(call->mtx);
+  if (!call->cv.wait_for(lock, std::chrono::milliseconds(wait_timeout_ms_), [&call] { return call->done; })) {
+    // Leader may be stuck, do not pin current request on it.
+    lock.unlock();
+    MONITOR_INC(coalesced_timeout_metric_, 1);
+    LOG4(WARN, "Wait for coalesced request timeout, run independently, model: "
+                 << model_name_ << ", timeout_ms: " << wait_timeout_ms_);
+    return false;
+  }
+  if (!call->err_msg.empty()) {
+    ctx.set_err_msg(call->err_msg);
+    return true;
+  }
+  output.CopyFrom(*call->output);
+  return true;
+}
+
+void SingleFlight::Publish(const Key& key,
+                           const std::shared_ptr<Call>& call,
+                           const ::grps::protos::v1::GrpsMessage* output,
+                           const std::string& err_msg) {
+  int followers;
+  {
+    // Remove call first, so that later requests will start a new call instead of joining a finished one.
+    std::lock_guard<std::mutex> lock(mtx_);
+    calls_.erase(key);
+    followers = call->followers;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(call->mtx);
+    if (output != nullptr) {
+      // Only copy the result when someone is waiting for it.
+      if (followers > 0) {
+        call->output = std::make_shared<::grps::protos::v1::GrpsMessage>(*output);
+      }
+    } else {
+      call->err_msg = err_msg;
+    }
+    call->done = true;
+  }
+  call->cv.notify_all();
+}
+} // namespace netease::grps
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/05
+ * Brief  Single flight, coalesce identical in-flight requests of one model. The first request (leader) runs the
+ *        inference, and the followers with the same input wait for and share its result. Followers waiting longer than
+ *        the timeout (e.g. leader is stuck) give up and run the inference independently.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "cache/response_cache.h"
+#include "context/context.h"
+#include "grps.pb.h"
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+class SingleFlight {
+public:
+  using Key = ResponseCache::Key;
+
+  static constexpr int64_t kDefaultWaitTimeoutMs = 1000;
+
+  // Result of one in-flight call shared by leader and followers.
+  struct Call {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+    int followers = 0; // Protected by SingleFlight::mtx_.
+    std::shared_ptr<const ::grps::protos::v1::GrpsMessage> output;
+    std::string err_msg; // Not empty if leader failed.
+  };
+
+  // Leader guard. Publish the result of leader (output or error of ctx) to followers when destroyed, so that
+  // followers will always be notified even if leader returns early or throws.
+  class Leader {
+  public:
+    Leader(SingleFlight* single_flight,
+           const Key& key,
+           std::shared_ptr<Call> call,
+           const ::grps::protos::v1::GrpsMessage& output,
+           GrpsContext& ctx)
+        : single_flight_(single_flight)
+        , key_(key)
+        , call_(std::move(call))
+        , output_(output)
+        , ctx_(ctx)
+        , uncaught_exceptions_(std::uncaught_exceptions()) {}
+    ~Leader();
+    Leader(const Leader&) = delete;
+    Leader& operator=(const Leader&) = delete;
+
+  private:
+    SingleFlight* single_flight_;
+    Key key_;
+    std::shared_ptr<Call> call_;
+    const ::grps::protos::v1::GrpsMessage& output_;
+    GrpsContext& ctx_;
+    int uncaught_exceptions_;
+  };
+
+  /**
+   * @brief Single flight constructor.
+   * @param model_name: Model name with `name-version` format, used as metrics label.
+   * @param wait_timeout_ms: Max time followers wait for the in-flight call.
+   */
+  explicit SingleFlight(std::string model_name, int64_t wait_timeout_ms = kDefaultWaitTimeoutMs);
+  ~SingleFlight() = default;
+  SingleFlight(const SingleFlight&) = delete;
+  SingleFlight& operator=(const SingleFlight&) = delete;
+  SingleFlight(SingleFlight&&) = delete;
+  SingleFlight& operator=(SingleFlight&&) = delete;
+
+  /**
+   * @brief Join an identical in-flight call, or lead a new one.
+   * @param key: Key of input, made by ResponseCache::MakeKey.
+   * @param output: Result of in-flight call will be copied to output when joined.
+   * @param ctx: Context of current request, error of in-flight call will be set to ctx when joined.
+   * @param leader: Set to a leader guard when current request leads a new call, keep nullptr when waiting for the
+   * in-flight call timed out.
+   * @return True if current request is served by an in-flight call, false if current request should run the inference
+   * itself.
+   */
+  bool Join(const Key& key,
+            ::grps::protos::v1::GrpsMessage& output,
+            GrpsContext& ctx,
+            std::unique_ptr<Leader>& leader);
+
+  [[nodiscard]] const std::string& model_name() const { return model_name_; }
+
+private:
+  std::string model_name_;
+  int64_t wait_timeout_ms_;
+  std::unordered_map<Key, std::shared_ptr<Call>, ResponseCache::KeyHash> calls_;
+  std::mutex mtx_;
+
+  // Metrics handles.
+  MetricsAgg* coalesced_metric_;
+  MetricsAgg* coalesced_timeout_metric_;
+
+  void Publish(const Key& key,
+               const std::shared_ptr<Call>& call,
+               const ::grps::protos::v1::GrpsMessage* output,
+               const std::string& err_msg);
+};
+} // namespace netease::grps
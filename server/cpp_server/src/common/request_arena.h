@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/10
+ * Brief  Protobuf arena for messages built on predict path. Initial blocks of arenas are reused from a thread local
+ *        pool, so a request arena usually needs no heap allocation unless its messages outgrow the initial block.
+ */
+
+#pragma once
+
+#include <google/protobuf/arena.h>
+
+#include <memory>
+#include <vector>
+
+namespace netease::grps {
+class RequestArena {
+public:
+  // Initial block size of arena, big enough for most requests with several small tensors.
+  static constexpr size_t kInitialBlockSize = 64 * 1024;
+  // Maximum count of cached initial blocks per thread.
+  static constexpr size_t kMaxCachedBlocks = 4;
+
+  RequestArena() : block_holder_(), arena_(Options(block_holder_.block.get())) {}
+  ~RequestArena() = default;
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+  RequestArena(RequestArena&&) = delete;
+  RequestArena& operator=(RequestArena&&) = delete;
+
+  // Create message owned by arena. Message will be destroyed with arena, never delete it.
+  template <typename T>
+  T* CreateMessage() {
+    return ::google::protobuf::Arena::CreateMessage<T>(&arena_);
+  }
+
+  ::google::protobuf::Arena* arena() { return &arena_; }
+
+private:
+  // Hold initial block and give it back to thread local pool after arena destroyed.
+  struct BlockHolder {
+    std::unique_ptr<char[]> block;
+    BlockHolder() {
+      auto& pool = Pool();
+      if (pool.empty()) {
+        block.reset(new char[kInitialBlockSize]);
+      } else {
+        block = std::move(pool.back());
+        pool.pop_back();
+      }
+    }
+    ~BlockHolder() {
+      auto& pool = Pool();
+      if (pool.size() < kMaxCachedBlocks) {
+        pool.emplace_back(std::move(block));
+      }
+    }
+  };
+
+  static std::vector<std::unique_ptr<char[]>>& Pool() {
+    static thread_local std::vector<std::unique_ptr<char[]>> pool;
+    return pool;
+  }
+
+  static ::google::protobuf::ArenaOptions Options(char* initial_block) {
+    ::google::protobuf::ArenaOptions options;
+    options.initial_block = initial_block;
+    options.initial_block_size = kInitialBlockSize;
+    return options;
+  }
+
+  // Declared before arena_, so that it is destroyed after arena_.
+  BlockHolder block_holder_;
+  ::google::protobuf::Arena arena_;
+};
+} // namespace netease::grps
@@ -7,6 +7,8 @@
 
 #include "global_config.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <regex>
 
@@ -21,7 +23,7 @@
 namespace netease::grps {
 bool GlobalConfig::Load(const std::string& server_conf_path, const std::string& inference_conf_path) {
   try {
-    return LoadServerConf(server_conf_path) && LoadInferenceConf(inference_conf_path);
+    return LoadServerConf(server_conf_path) && LoadInferenceConf(inference_conf_path, inference_config_);
   } catch (const std::exception& e) {
     std::cerr << "[server.yml] Failed to load config file: " << e.what() << std::endl;
     return false;
@@ -140,11 +142,105 @@ bool GlobalConfig::LoadServerConf(const std::string& conf_path) {
   }
   server_config_._is_set.log = true;
 
+  auto hot_reload_conf = server_conf["hot_reload"];
+  if (hot_reload_conf && !hot_reload_conf.IsNull() && hot_reload_conf.IsMap()) {
+    YAML_TRY_EXTRACT(hot_reload_conf, watch, bool, server_config_.hot_reload.watch);
+    if (hot_reload_conf["watch_interval_s"]) {
+      YAML_TRY_EXTRACT(hot_reload_conf, watch_interval_s, int, server_config_.hot_reload.watch_interval_s);
+    }
+    if (server_config_.hot_reload.watch_interval_s < 1) {
+      std::cerr << "[server.yml] hot_reload watch_interval_s must be positive." << std::endl;
+      return false;
+    }
+    server_config_._is_set.hot_reload = true;
+  }
+
+  auto lazy_load_conf = server_conf["lazy_load"];
+  if (lazy_load_conf && !lazy_load_conf.IsNull() && lazy_load_conf.IsMap()) {
+    YAML_TRY_EXTRACT(lazy_load_conf, memory_budget_mib, int64_t, server_config_.lazy_load.memory_budget_mib);
+    server_config_._is_set.lazy_load = true;
+  }
+
+  auto monitor_history_conf = server_conf["monitor_history"];
+  if (monitor_history_conf && !monitor_history_conf.IsNull() && monitor_history_conf.IsMap()) {
+    YAML_TRY_EXTRACT(monitor_history_conf, enable, bool, server_config_.monitor_history.enable);
+    if (monitor_history_conf["max_metrics"]) {
+      YAML_TRY_EXTRACT(monitor_history_conf, max_metrics, int, server_config_.monitor_history.max_metrics);
+    }
+    if (monitor_history_conf["max_cdf_metrics"]) {
+      YAML_TRY_EXTRACT(monitor_history_conf, max_cdf_metrics, int, server_config_.monitor_history.max_cdf_metrics);
+    }
+    if (server_config_.monitor_history.max_metrics < 0 || server_config_.monitor_history.max_cdf_metrics < 0) {
+      std::cerr << "[server.yml] monitor_history max_metrics and max_cdf_metrics must not be negative." << std::endl;
+      return false;
+    }
+    server_config_._is_set.monitor_history = true;
+  }
+
+  auto trace_conf = server_conf["trace"];
+  if (trace_conf && !trace_conf.IsNull() && trace_conf.IsMap()) {
+    YAML_TRY_EXTRACT(trace_conf, sample_rate, double, server_config_.trace.sample_rate);
+    if (trace_conf["max_traces"]) {
+      YAML_TRY_EXTRACT(trace_conf, max_traces, int, server_config_.trace.max_traces);
+    }
+    if (server_config_.trace.sample_rate < 0 || server_config_.trace.sample_rate > 1 ||
+        server_config_.trace.max_traces < 1) {
+      std::cerr << "[server.yml] trace sample_rate must be in [0, 1] and max_traces must be positive." << std::endl;
+      return false;
+    }
+    server_config_._is_set.trace = true;
+  }
+
+  auto debug_server_conf = server_conf["debug_server"];
+  if (debug_server_conf && !debug_server_conf.IsNull() && debug_server_conf.IsMap()) {
+    if (debug_server_conf["host"]) {
+      YAML_TRY_EXTRACT(debug_server_conf, host, std::string, server_config_.debug_server.host);
+    }
+    YAML_TRY_EXTRACT(debug_server_conf, port, int, server_config_.debug_server.port);
+    if (debug_server_conf["auth_token"]) {
+      YAML_TRY_EXTRACT(debug_server_conf, auth_token, std::string, server_config_.debug_server.auth_token);
+    }
+    // Token in environment takes precedence, so that it need not be kept in conf file.
+    const char* env_token = getenv("GRPS_DEBUG_AUTH_TOKEN");
+    if (env_token != nullptr && env_token[0] != '\0') {
+      server_config_.debug_server.auth_token = env_token;
+    }
+    if (server_config_.debug_server.port <= 0 || server_config_.debug_server.port > 65535) {
+      std::cerr << "[server.yml] debug_server port must be in [1, 65535]." << std::endl;
+      return false;
+    }
+    if (server_config_.debug_server.auth_token.empty()) {
+      std::cerr << "[server.yml] debug_server auth_token(or env GRPS_DEBUG_AUTH_TOKEN) must not be empty." << std::endl;
+      return false;
+    }
+    server_config_._is_set.debug_server = true;
+  }
+
+  auto request_recorder_conf = server_conf["request_recorder"];
+  if (request_recorder_conf && !request_recorder_conf.IsNull() && request_recorder_conf.IsMap()) {
+    YAML_TRY_EXTRACT(request_recorder_conf, sample_rate, double, server_config_.request_recorder.sample_rate);
+    if (request_recorder_conf["max_file_size_mib"]) {
+      YAML_TRY_EXTRACT(request_recorder_conf, max_file_size_mib, int,
+                       server_config_.request_recorder.max_file_size_mib);
+    }
+    if (request_recorder_conf["max_files"]) {
+      YAML_TRY_EXTRACT(request_recorder_conf, max_files, int, server_config_.request_recorder.max_files);
+    }
+    if (server_config_.request_recorder.sample_rate < 0 || server_config_.request_recorder.sample_rate > 1 ||
+        server_config_.request_recorder.max_file_size_mib < 1 || server_config_.request_recorder.max_files < 1) {
+      std::cerr << "[server.yml] request_recorder sample_rate must be in [0, 1], max_file_size_mib and max_files must "
+                   "be positive."
+                << std::endl;
+      return false;
+    }
+    server_config_._is_set.request_recorder = true;
+  }
+
   // std::cout << "Server config: \n" << server_config_.ToString() << std::endl;
   return true;
 }
 
-bool GlobalConfig::LoadInferenceConf(const std::string& conf_path) {
+bool GlobalConfig::LoadInferenceConf(const std::string& conf_path, InferenceConfig& inference_config) {
   YAML::Node inference_conf = YAML::LoadFile(conf_path);
   if (!inference_conf || inference_conf.IsNull() || !inference_conf.IsMap()) {
     std::cerr << "[inference.yml] Failed to load inference config file: " << conf_path << std::endl;
@@ -184,23 +280,164 @@ bool GlobalConfig::LoadInferenceConf(const std::string& conf_path) {
     } else {
       model_config.batching.type = "none";
     }
-    if (inference_config_.models.find(model_config.name + "-" + model_config.version) !=
-        inference_config_.models.end()) {
+    auto cache_conf = model_conf["cache"];
+    if (cache_conf && !cache_conf.IsNull() && cache_conf.IsMap()) {
+      YAML_TRY_EXTRACT(cache_conf, type, std::string, model_config.cache.type);
+      if (model_config.cache.type != "none") {
+        YAML_TRY_EXTRACT(cache_conf, max_bytes, int64_t, model_config.cache.max_bytes);
+        if (cache_conf["ttl_ms"]) {
+          YAML_TRY_EXTRACT(cache_conf, ttl_ms, int64_t, model_config.cache.ttl_ms);
+        }
+        if (cache_conf["shard_num"]) {
+          YAML_TRY_EXTRACT(cache_conf, shard_num, int, model_config.cache.shard_num);
+        }
+      }
+    } else {
+      model_config.cache.type = "none";
+    }
+    if (model_conf["coalescing"]) {
+      YAML_TRY_EXTRACT(model_conf, coalescing, bool, model_config.coalescing);
+    }
+    if (model_conf["coalescing_timeout_ms"]) {
+      YAML_TRY_EXTRACT(model_conf, coalescing_timeout_ms, int64_t, model_config.coalescing_timeout_ms);
+      if (model_config.coalescing_timeout_ms <= 0) {
+        std::cerr << "[inference.yml] Model " << model_config.name << " coalescing_timeout_ms must be positive."
+                  << std::endl;
+        return false;
+      }
+    }
+    if (model_conf["load_policy"]) {
+      YAML_TRY_EXTRACT(model_conf, load_policy, std::string, model_config.load_policy);
+      if (model_config.load_policy != "eager" && model_config.load_policy != "lazy") {
+        std::cerr << "[inference.yml] Model " << model_config.name << " load_policy must be eager or lazy."
+                  << std::endl;
+        return false;
+      }
+    }
+    if (model_conf["memory_mib"]) {
+      YAML_TRY_EXTRACT(model_conf, memory_mib, int64_t, model_config.memory_mib);
+    }
+    if (model_conf["instances"]) {
+      YAML_TRY_EXTRACT(model_conf, instances, int, model_config.instances);
+      if (model_config.instances <= 0) {
+        std::cerr << "[inference.yml] Model " << model_config.name << " instances must be greater than 0." << std::endl;
+        return false;
+      }
+    }
+    if (model_conf["instance_dispatch"]) {
+      YAML_TRY_EXTRACT(model_conf, instance_dispatch, std::string, model_config.instance_dispatch);
+      if (model_config.instance_dispatch != "round_robin" && model_config.instance_dispatch != "least_loaded") {
+        std::cerr << "[inference.yml] Model " << model_config.name
+                  << " instance_dispatch must be round_robin or least_loaded." << std::endl;
+        return false;
+      }
+    }
+    if (model_conf["instance_cpus"] && !model_conf["instance_cpus"].IsNull()) {
+      YAML_TRY_EXTRACT(model_conf, instance_cpus, std::vector<std::string>, model_config.instance_cpus);
+      if (!model_config.instance_cpus.empty() && int(model_config.instance_cpus.size()) != model_config.instances) {
+        std::cerr << "[inference.yml] Model " << model_config.name
+                  << " instance_cpus size must be equal to instances." << std::endl;
+        return false;
+      }
+    }
+    auto warmup_conf = model_conf["warmup"];
+    if (warmup_conf && !warmup_conf.IsNull() && warmup_conf.IsMap()) {
+      auto& warmup_config = model_config.warmup;
+      if (warmup_conf["iterations"]) {
+        YAML_TRY_EXTRACT(warmup_conf, iterations, int, warmup_config.iterations);
+      }
+      if (warmup_conf["batch_sizes"]) {
+        YAML_TRY_EXTRACT(warmup_conf, batch_sizes, std::vector<int>, warmup_config.batch_sizes);
+      }
+      if (warmup_conf["samples"] && !warmup_conf["samples"].IsNull()) {
+        YAML_TRY_EXTRACT(warmup_conf, samples, std::vector<std::string>, warmup_config.samples);
+      }
+      auto synthetic_conf = warmup_conf["synthetic"];
+      if (synthetic_conf && !synthetic_conf.IsNull()) {
+        if (!synthetic_conf.IsSequence()) {
+          std::cerr << "[inference.yml] Model " << model_config.name << " warmup synthetic conf is invalid."
+                    << std::endl;
+          return false;
+        }
+        for (const auto& tensor_conf : synthetic_conf) {
+          InferenceConfig::ModelConfig::WarmupConfig::TensorConfig tensor_config;
+          YAML_TRY_EXTRACT(tensor_conf, name, std::string, tensor_config.name);
+          YAML_TRY_EXTRACT(tensor_conf, dtype, std::string, tensor_config.dtype);
+          YAML_TRY_EXTRACT(tensor_conf, shape, std::vector<int>, tensor_config.shape);
+          warmup_config.synthetic.emplace_back(std::move(tensor_config));
+        }
+      }
+      if (warmup_config.iterations < 1 || warmup_config.batch_sizes.empty() ||
+          std::any_of(warmup_config.batch_sizes.begin(), warmup_config.batch_sizes.end(),
+                      [](int batch_size) { return batch_size < 1; })) {
+        std::cerr << "[inference.yml] Model " << model_config.name
+                  << " warmup iterations and batch_sizes must be positive." << std::endl;
+        return false;
+      }
+    }
+    if (inference_config.models.find(model_config.name + "-" + model_config.version) != inference_config.models.end()) {
       std::cerr << "[inference.yml] Model " << model_config.name << "-" << model_config.version
                 << " has already existed." << std::endl;
       return false;
     }
-    inference_config_.models.emplace(model_config.name + "-" + model_config.version, std::move(model_config));
+    inference_config.models.emplace(model_config.name + "-" + model_config.version, std::move(model_config));
+  }
+  inference_config._is_set.models = true;
+
+  auto routing_conf = inference_conf["routing"];
+  if (routing_conf && !routing_conf.IsNull()) {
+    if (!routing_conf.IsSequence()) {
+      std::cerr << "[inference.yml] Routing conf is invalid." << std::endl;
+      return false;
+    }
+    for (const auto& route_conf : routing_conf) {
+      if (!route_conf || route_conf.IsNull() || !route_conf.IsMap()) {
+        std::cerr << "[inference.yml] Route conf is invalid." << std::endl;
+        return false;
+      }
+      InferenceConfig::RouteConfig route_config;
+      YAML_TRY_EXTRACT(route_conf, model, std::string, route_config.model);
+      auto versions_conf = route_conf["versions"];
+      if (!versions_conf || versions_conf.IsNull() || !versions_conf.IsSequence() || versions_conf.size() == 0) {
+        std::cerr << "[inference.yml] Route " << route_config.model << " versions conf is invalid." << std::endl;
+        return false;
+      }
+      for (const auto& version_conf : versions_conf) {
+        InferenceConfig::RouteConfig::VersionConfig version_config;
+        YAML_TRY_EXTRACT(version_conf, version, std::string, version_config.version);
+        YAML_TRY_EXTRACT(version_conf, weight, int, version_config.weight);
+        if (version_config.weight < 0) {
+          std::cerr << "[inference.yml] Route " << route_config.model << " weight must not be negative." << std::endl;
+          return false;
+        }
+        route_config.versions.emplace_back(std::move(version_config));
+      }
+      auto shadow_conf = route_conf["shadow"];
+      if (shadow_conf && !shadow_conf.IsNull() && shadow_conf.IsMap()) {
+        YAML_TRY_EXTRACT(shadow_conf, version, std::string, route_config.shadow.version);
+        YAML_TRY_EXTRACT(shadow_conf, ratio, float, route_config.shadow.ratio);
+        if (route_config.shadow.ratio < 0 || route_config.shadow.ratio > 1) {
+          std::cerr << "[inference.yml] Route " << route_config.model << " shadow ratio must be in [0, 1]."
+                    << std::endl;
+          return false;
+        }
+      }
+      if (inference_config.routes.find(route_config.model) != inference_config.routes.end()) {
+        std::cerr << "[inference.yml] Route " << route_config.model << " has already existed." << std::endl;
+        return false;
+      }
+      inference_config.routes.emplace(route_config.model, std::move(route_config));
+    }
+    inference_config._is_set.routes = true;
   }
-  inference_config_._is_set.models = true;
 
   auto dag_conf = inference_conf["dag"];
   if (!dag_conf || dag_conf.IsNull() || !dag_conf.IsMap()) {
     std::cerr << "[inference.yml] Dag conf is invalid." << std::endl;
     return false;
   }
-  YAML_TRY_EXTRACT(dag_conf, type, std::string, inference_config_.dag.type);
-  YAML_TRY_EXTRACT(dag_conf, name, std::string, inference_config_.dag.name);
+  YAML_TRY_EXTRACT(dag_conf, type, std::string, inference_config.dag.type);
+  YAML_TRY_EXTRACT(dag_conf, name, std::string, inference_config.dag.name);
   auto nodes_conf = dag_conf["nodes"];
   if (!nodes_conf || nodes_conf.IsNull() || !nodes_conf.IsSequence()) {
     std::cerr << "[inference.yml] Nodes conf is invalid." << std::endl;
@@ -214,12 +451,165 @@ bool GlobalConfig::LoadInferenceConf(const std::string& conf_path) {
     InferenceConfig::NodeConfig node_config;
     YAML_TRY_EXTRACT(node, name, std::string, node_config.name);
     YAML_TRY_EXTRACT(node, type, std::string, node_config.type);
-    YAML_TRY_EXTRACT(node, model, std::string, node_config.model);
-    inference_config_.dag.nodes.emplace_back(std::move(node_config));
+    if (node_config.type == "model") {
+      YAML_TRY_EXTRACT(node, model, std::string, node_config.model);
+    }
+    auto split_conf = node["split"];
+    if (split_conf && !split_conf.IsNull() && split_conf.IsMap()) {
+      if (split_conf["type"]) {
+        YAML_TRY_EXTRACT(split_conf, type, std::string, node_config.split.type);
+      }
+      if (split_conf["chunk_size"]) {
+        YAML_TRY_EXTRACT(split_conf, chunk_size, int, node_config.split.chunk_size);
+      }
+    }
+    if (node_config.type == "splitter") {
+      if (node_config.split.type != "tensor" && node_config.split.type != "text") {
+        std::cerr << "[inference.yml] Node " << node_config.name << " split type must be tensor or text." << std::endl;
+        return false;
+      }
+      if (node_config.split.chunk_size <= 0) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " chunk_size must be greater than 0." << std::endl;
+        return false;
+      }
+    }
+    auto merge_conf = node["merge"];
+    if (merge_conf && !merge_conf.IsNull() && merge_conf.IsMap()) {
+      if (merge_conf["reduce"]) {
+        YAML_TRY_EXTRACT(merge_conf, reduce, std::string, node_config.merge.reduce);
+      }
+      if (merge_conf["k"]) {
+        YAML_TRY_EXTRACT(merge_conf, k, int, node_config.merge.k);
+      }
+      if (merge_conf["score_tensor"]) {
+        YAML_TRY_EXTRACT(merge_conf, score_tensor, std::string, node_config.merge.score_tensor);
+      }
+    }
+    if (node_config.type == "merger") {
+      const auto& reduce = node_config.merge.reduce;
+      if (reduce != "concat" && reduce != "mean" && reduce != "topk") {
+        std::cerr << "[inference.yml] Node " << node_config.name << " reduce must be concat, mean or topk."
+                  << std::endl;
+        return false;
+      }
+      if (reduce == "topk" && node_config.merge.k <= 0) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " k must be greater than 0." << std::endl;
+        return false;
+      }
+    }
+    auto condition_conf = node["condition"];
+    if (node_config.type == "condition") {
+      if (!condition_conf || condition_conf.IsNull() || !condition_conf.IsMap()) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition conf is invalid." << std::endl;
+        return false;
+      }
+      auto& condition = node_config.condition;
+      if (condition_conf["source"]) {
+        YAML_TRY_EXTRACT(condition_conf, source, std::string, condition.source);
+      }
+      YAML_TRY_EXTRACT(condition_conf, key, std::string, condition.key);
+      if (condition_conf["op"]) {
+        YAML_TRY_EXTRACT(condition_conf, op, std::string, condition.op);
+      }
+      YAML_TRY_EXTRACT(condition_conf, value, double, condition.value);
+      if (condition_conf["action"]) {
+        YAML_TRY_EXTRACT(condition_conf, action, std::string, condition.action);
+      }
+      if (condition_conf["target"]) {
+        YAML_TRY_EXTRACT(condition_conf, target, std::string, condition.target);
+      }
+      if (condition_conf["forward"]) {
+        YAML_TRY_EXTRACT(condition_conf, forward, std::string, condition.forward);
+      }
+      if (condition.source != "gmap" && condition.source != "tensor_max") {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition source must be gmap or tensor_max."
+                  << std::endl;
+        return false;
+      }
+      static const std::vector<std::string> ops = {">", ">=", "<", "<=", "==", "!="};
+      if (std::find(ops.begin(), ops.end(), condition.op) == ops.end()) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition op must be >, >=, <, <=, == or !="
+                  << std::endl;
+        return false;
+      }
+      if (condition.action != "exit" && condition.action != "goto") {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition action must be exit or goto."
+                  << std::endl;
+        return false;
+      }
+      if (condition.action == "goto" && condition.target.empty()) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition target should be set for goto."
+                  << std::endl;
+        return false;
+      }
+      if (condition.forward != "output" && condition.forward != "request") {
+        std::cerr << "[inference.yml] Node " << node_config.name << " condition forward must be output or request."
+                  << std::endl;
+        return false;
+      }
+    }
+    auto ensemble_conf = node["ensemble"];
+    if (node_config.type == "ensemble") {
+      if (!ensemble_conf || ensemble_conf.IsNull() || !ensemble_conf.IsMap()) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " ensemble conf is invalid." << std::endl;
+        return false;
+      }
+      auto& ensemble = node_config.ensemble;
+      auto members_conf = ensemble_conf["members"];
+      if (!members_conf || members_conf.IsNull() || !members_conf.IsSequence() || members_conf.size() == 0) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " ensemble members conf is invalid." << std::endl;
+        return false;
+      }
+      for (const auto& member_conf : members_conf) {
+        InferenceConfig::NodeConfig::EnsembleMemberConfig member;
+        YAML_TRY_EXTRACT(member_conf, model, std::string, member.model);
+        if (member_conf["weight"]) {
+          YAML_TRY_EXTRACT(member_conf, weight, double, member.weight);
+        }
+        if (member.weight < 0) {
+          std::cerr << "[inference.yml] Node " << node_config.name << " ensemble weight must not be negative."
+                    << std::endl;
+          return false;
+        }
+        ensemble.members.emplace_back(std::move(member));
+      }
+      if (ensemble_conf["reduce"]) {
+        YAML_TRY_EXTRACT(ensemble_conf, reduce, std::string, ensemble.reduce);
+      }
+      if (ensemble_conf["timeout_ms"]) {
+        YAML_TRY_EXTRACT(ensemble_conf, timeout_ms, int64_t, ensemble.timeout_ms);
+      }
+      if (ensemble_conf["min_members"]) {
+        YAML_TRY_EXTRACT(ensemble_conf, min_members, int, ensemble.min_members);
+      }
+      const auto& reduce = ensemble.reduce;
+      if (reduce != "mean" && reduce != "weighted_sum" && reduce != "vote" && reduce != "concat") {
+        std::cerr << "[inference.yml] Node " << node_config.name
+                  << " ensemble reduce must be mean, weighted_sum, vote or concat." << std::endl;
+        return false;
+      }
+      if (ensemble.timeout_ms < 0) {
+        std::cerr << "[inference.yml] Node " << node_config.name << " ensemble timeout_ms must not be negative."
+                  << std::endl;
+        return false;
+      }
+      if (ensemble.min_members <= 0 || ensemble.min_members > int(ensemble.members.size())) {
+        std::cerr << "[inference.yml] Node " << node_config.name
+                  << " ensemble min_members must be in [1, number of members]." << std::endl;
+        return false;
+      }
+    }
+    if (node["tensor_handoff"]) {
+      YAML_TRY_EXTRACT(node, tensor_handoff, bool, node_config.tensor_handoff);
+    }
+    if (node["inputs"] && !node["inputs"].IsNull()) {
+      YAML_TRY_EXTRACT(node, inputs, std::vector<std::string>, node_config.inputs);
+    }
+    inference_config.dag.nodes.emplace_back(std::move(node_config));
   }
-  inference_config_._is_set.dag = true;
+  inference_config._is_set.dag = true;
 
-  // std::cout << "Inference config: \n" << inference_config_.ToString() << std::endl;
+  // std::cout << "Inference config: \n" << inference_config.ToString() << std::endl;
   return true;
 }
 } // namespace netease::grps
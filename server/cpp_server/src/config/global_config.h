@@ -50,6 +50,38 @@ public:
       int log_backup_count{};
     } log;
 
+    struct {
+      bool watch = false;        // Watch inference.yml and model files, reload models when changed.
+      int watch_interval_s = 10; // Interval(s) of checking changes.
+    } hot_reload;
+
+    struct {
+      int64_t memory_budget_mib = 0; // Memory budget of lazy loaded models, 0 means no limit.
+    } lazy_load;
+
+    struct {
+      bool enable = false;      // Keep trend and cdf windows of metrics in a memory-mapped file under log dir.
+      int max_metrics = 1024;   // Max number of trend(avg, max, min, inc) metrics kept in history.
+      int max_cdf_metrics = 64; // Max number of cdf metrics kept in history.
+    } monitor_history;
+
+    struct {
+      double sample_rate = 0; // Ratio of requests to be traced, 0 means disabled.
+      int max_traces = 1000;  // Max number of latest traces kept in memory.
+    } trace;
+
+    struct {
+      std::string host = "127.0.0.1"; // Host of debug listener, loopback by default.
+      int port = 0;                   // Port of debug listener, separated from interface ports.
+      std::string auth_token;         // Requests must carry `Authorization: Bearer <auth_token>` header.
+    } debug_server;
+
+    struct {
+      double sample_rate = 0;      // Ratio of predict requests to be recorded, 0 means disabled.
+      int max_file_size_mib = 256; // Max size of one record file.
+      int max_files = 4;           // Max number of record files, the oldest one is removed when rotated.
+    } request_recorder;
+
     struct {
       bool interface = false;
       bool customized_predict_http = false;
@@ -57,6 +89,12 @@ public:
       bool max_concurrency = false;
       bool gpu = false;
       bool log = false;
+      bool hot_reload = false;
+      bool lazy_load = false;
+      bool monitor_history = false;
+      bool trace = false;
+      bool debug_server = false;
+      bool request_recorder = false;
     } _is_set{};
 
     [[nodiscard]] std::string ToString() const {
@@ -84,6 +122,26 @@ public:
       if (_is_set.log) {
         ss << "log: " << log.log_dir << " " << log.log_backup_count << std::endl;
       }
+      if (_is_set.hot_reload) {
+        ss << "hot_reload: " << hot_reload.watch << " " << hot_reload.watch_interval_s << std::endl;
+      }
+      if (_is_set.lazy_load) {
+        ss << "lazy_load: " << lazy_load.memory_budget_mib << std::endl;
+      }
+      if (_is_set.monitor_history) {
+        ss << "monitor_history: " << monitor_history.enable << " " << monitor_history.max_metrics << " "
+           << monitor_history.max_cdf_metrics << std::endl;
+      }
+      if (_is_set.trace) {
+        ss << "trace: " << trace.sample_rate << " " << trace.max_traces << std::endl;
+      }
+      if (_is_set.debug_server) {
+        ss << "debug_server: " << debug_server.host << " " << debug_server.port << std::endl;
+      }
+      if (_is_set.request_recorder) {
+        ss << "request_recorder: " << request_recorder.sample_rate << " " << request_recorder.max_file_size_mib << " "
+           << request_recorder.max_files << std::endl;
+      }
       return ss.str();
     }
   };
@@ -108,13 +166,83 @@ public:
         int max_batch_size{};
         int batch_timeout_us{};
       } batching;
+      struct CacheConfig {
+        std::string type; // `none`, `lru` or `tinylfu`.
+        int64_t max_bytes{};
+        int64_t ttl_ms{};
+        int shard_num = 16;
+      } cache;
+      bool coalescing = false;                       // Coalesce identical in-flight requests.
+      int64_t coalescing_timeout_ms = 1000;          // Max time identical requests wait for the in-flight one.
+      std::string load_policy = "eager";             // `eager` or `lazy`(load on first request).
+      int64_t memory_mib = 0;                        // Memory of lazy model, required with lazy budget.
+      int instances = 1;                             // Replicas of inferer.
+      std::string instance_dispatch = "round_robin"; // `round_robin` or `least_loaded`.
+      std::vector<std::string> instance_cpus;        // Cpu list(such as `0-15,32`) pinned by each replica.
+      struct WarmupConfig {
+        int iterations = 1;
+        std::vector<int> batch_sizes = {1};
+        std::vector<std::string> samples; // Sample request files with json format.
+        struct TensorConfig {
+          std::string name;
+          std::string dtype;
+          std::vector<int> shape;
+        };
+        std::vector<TensorConfig> synthetic; // Synthetic gtensors input used when no samples.
+        [[nodiscard]] bool enabled() const { return !samples.empty() || !synthetic.empty(); }
+      } warmup;
     };
     std::unordered_map<std::string, ModelConfig> models;
 
+    // Weighted traffic splitting between versions of the same model.
+    struct RouteConfig {
+      std::string model; // Model name without version.
+      struct VersionConfig {
+        std::string version;
+        int weight{};
+      };
+      std::vector<VersionConfig> versions;
+      struct {
+        std::string version; // Empty means no shadow.
+        float ratio{};       // Ratio of requests mirrored to shadow version, in [0, 1].
+      } shadow;
+    };
+    std::unordered_map<std::string, RouteConfig> routes;
+
     struct NodeConfig {
       std::string name;
       std::string type;
       std::string model;
+      std::vector<std::string> inputs; // Upstream nodes of graph dag, empty means input of dag.
+      bool tensor_handoff = false;     // Take output tensors of previous model node of sequential dag directly.
+      struct {
+        std::string type = "tensor"; // `tensor`(first dimension of gtensors) or `text`(str_data).
+        int chunk_size = 1;          // Rows of tensor or bytes of text in one sub-request.
+      } split;                       // Splitter node.
+      struct {
+        std::string reduce = "concat"; // `concat`, `mean` or `topk`.
+        int k = 1;                     // Rows kept by topk.
+        std::string score_tensor;      // Tensor used as score by topk, empty means the first tensor.
+      } merge;                         // Merger node.
+      struct {
+        std::string source = "gmap"; // `gmap`(numeric value of key) or `tensor_max`(max value of tensor named key).
+        std::string key;
+        std::string op = ">="; // `>`, `>=`, `<`, `<=`, `==` or `!=`.
+        double value{};
+        std::string action = "exit"; // When predicate is true, `exit`: end dag, `goto`: jump to target node.
+        std::string target;           // Target node of goto.
+        std::string forward = "output"; // Message forwarded to next node, `output` of previous node or `request`.
+      } condition;                      // Condition node.
+      struct EnsembleMemberConfig {
+        std::string model; // Model(name-version format) or model name declared in routing.
+        double weight = 1; // Weight of weighted_sum and vote.
+      };
+      struct {
+        std::vector<EnsembleMemberConfig> members;
+        std::string reduce = "mean"; // `mean`, `weighted_sum`, `vote` or `concat`.
+        int64_t timeout_ms = 0;      // Timeout of each member, 0 means no timeout.
+        int min_members = 1;         // Minimum succeeded members of a degraded result.
+      } ensemble;                    // Ensemble node.
     };
 
     struct {
@@ -125,6 +253,7 @@ public:
 
     struct {
       bool models = false;
+      bool routes = false;
       bool dag = false;
     } _is_set{};
 
@@ -138,13 +267,33 @@ public:
              << model_config.inferer_name << " " << model_config.inferer_path << " " << model_config.inferer_args
              << model_config.converter_name << " " << model_config.converter_path << " " << model_config.converter_args
              << " " << model_config.batching.type << " " << model_config.batching.max_batch_size << " "
-             << model_config.batching.batch_timeout_us << std::endl;
+             << model_config.batching.batch_timeout_us << " " << model_config.cache.type << " "
+             << model_config.cache.max_bytes << " " << model_config.cache.ttl_ms << " "
+             << model_config.cache.shard_num << " " << model_config.coalescing << " "
+             << model_config.coalescing_timeout_ms << " " << model_config.load_policy << " "
+             << model_config.memory_mib << " " << model_config.instances << " " << model_config.instance_dispatch << " "
+             << model_config.instance_cpus.size() << " " << model_config.warmup.iterations
+             << " " << model_config.warmup.samples.size() << " " << model_config.warmup.synthetic.size() << std::endl;
+        }
+      }
+      if (_is_set.routes) {
+        ss << "routing: " << std::endl;
+        for (const auto& [model, route] : routes) {
+          ss << "  " << model << ":";
+          for (const auto& version : route.versions) {
+            ss << " " << version.version << "(" << version.weight << ")";
+          }
+          ss << " shadow: " << route.shadow.version << "(" << route.shadow.ratio << ")" << std::endl;
         }
       }
       if (_is_set.dag) {
         ss << "dag: " << dag.type << " " << dag.name << std::endl;
         for (const auto& node : dag.nodes) {
-          ss << "  " << node.name << ": " << node.type << " " << node.model << std::endl;
+          ss << "  " << node.name << ": " << node.type << " " << node.model;
+          for (const auto& input : node.inputs) {
+            ss << " <- " << input;
+          }
+          ss << std::endl;
         }
       }
       return ss.str();
@@ -168,6 +317,7 @@ public:
   GlobalConfig& operator=(GlobalConfig&&) = delete;
 
   [[nodiscard]] const ServerConfig& server_config() const { return server_config_; }
+  // Inference config loaded at startup. Models may be hot reloaded later, see Executor::Reload.
   [[nodiscard]] const InferenceConfig& inference_config() const { return inference_config_; }
   [[nodiscard]] const MPIConfig& mpi() const { return mpi_; }
   void set_mpi(const MPIConfig& mpi) { mpi_ = mpi; }
@@ -175,6 +325,14 @@ public:
   bool Load(const std::string& server_conf_path = "./conf/server.yml",
             const std::string& inference_conf_path = "./conf/inference.yml");
 
+  /**
+   * @brief Parse inference config file.
+   * @param conf_path: Inference config file path.
+   * @param inference_config: Parsed inference config.
+   * @return If success.
+   */
+  static bool LoadInferenceConf(const std::string& conf_path, InferenceConfig& inference_config);
+
 private:
   GlobalConfig() = default;
 
@@ -183,8 +341,6 @@ private:
   MPIConfig mpi_{};
 
   bool LoadServerConf(const std::string& conf_path);
-
-  bool LoadInferenceConf(const std::string& conf_path);
 }; // class GlobalConfig
 
 } // namespace netease::grps
\ No newline at end of file
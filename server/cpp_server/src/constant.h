@@ -30,3 +30,21 @@
 #define GPU_OOM_COUNT "*gpu_oom_count"
 #define CPU_USAGE_AVG "*cpu_usage(%)"
 #define MEM_USAGE_AVG "*mem_usage(%)"
+#define CACHE_HIT_RATE "*cache_hit_rate(%)"
+#define CACHE_SIZE "*cache_size(MiB)"
+#define CACHE_EVICTION_COUNT "*cache_eviction_count"
+#define COALESCED_COUNT "*coalesced_count"
+#define COALESCED_TIMEOUT_COUNT "*coalesced_timeout_count"
+#define MODEL_LATENCY_AVG "*model_latency_avg(ms)"
+#define MODEL_LATENCY_MAX "*model_latency_max(ms)"
+#define MODEL_FAIL_RATE "*model_fail_rate(%)"
+#define SHADOW_DROP_COUNT "*shadow_drop_count"
+#define ENSEMBLE_DROP_COUNT "*ensemble_drop_count"
+#define MODEL_LOAD_TIME "*model_load_time(ms)"
+#define LAZY_MODEL_MEMORY "*lazy_model_memory(MiB)"
+#define CONDITION_HIT_RATE "*condition_hit_rate(%)"
+#define STAGE_QUEUE_WAIT_AVG "*queue_wait_avg(ms)"
+#define STAGE_PREPROCESS_AVG "*preprocess_avg(ms)"
+#define STAGE_INFER_AVG "*infer_avg(ms)"
+#define STAGE_POSTPROCESS_AVG "*postprocess_avg(ms)"
+#define SERIALIZATION_AVG "*serialization_avg(ms)"
@@ -7,13 +7,108 @@
 
 #include "context.h"
 
+#include <butil/time.h>
+
 #include "common/pb_utils.h"
 #include "converter/converter.h"
 #include "logger/logger.h"
 #include "model_infer/inferer.h"
 #include "model_infer/tensor_wrapper.h"
+#include "monitor/trace.h"
 
 namespace netease::grps {
+// Maximum count of contexts cached in the pool of one thread.
+static constexpr size_t kMaxPooledContexts = 64;
+
+// Http streaming writer close callback.
+class HttpStreamingWriterCloseClosure : public google::protobuf::Closure {
+public:
+  explicit HttpStreamingWriterCloseClosure(std::shared_ptr<std::atomic<bool>> closed) : closed_(std::move(closed)) {}
+  void Run() override {
+    *closed_ = true;
+    delete this;
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> closed_;
+};
+
+static std::vector<std::unique_ptr<GrpsContext>>& ContextPool() {
+  static thread_local std::vector<std::unique_ptr<GrpsContext>> pool;
+  return pool;
+}
+
+std::shared_ptr<GrpsContext> GrpsContext::Acquire(
+  const ::grps::protos::v1::GrpsMessage* request,
+  ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer,
+  butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer,
+  brpc::Controller* http_controller,
+  brpc::Controller* brpc_controller,
+  grpc::ServerContext* grpc_server_ctx) {
+  GrpsContext* ctx;
+  auto& pool = ContextPool();
+  if (pool.empty()) {
+    ctx = new GrpsContext(request, rpc_stream_writer, http_stream_writer, http_controller, brpc_controller,
+                          grpc_server_ctx);
+  } else {
+    ctx = pool.back().release();
+    pool.pop_back();
+    ctx->Reset(request, rpc_stream_writer, http_stream_writer, http_controller, brpc_controller, grpc_server_ctx);
+  }
+  // Requests sampled by tracer in current thread record spans of their stages.
+  ctx->trace_ = Tracer::Current();
+
+  return {ctx, [](GrpsContext* ctx) {
+            ctx->Reset();
+            auto& pool = ContextPool();
+            if (pool.size() < kMaxPooledContexts) {
+              pool.emplace_back(ctx);
+            } else {
+              delete ctx;
+            }
+          }};
+}
+
+std::shared_ptr<GrpsContext> GrpsContext::AcquireChild(const GrpsContext& parent,
+                                                       const ::grps::protos::v1::GrpsMessage* request) {
+  auto ctx = Acquire(request, nullptr, nullptr, parent.http_controller_, parent.brpc_controller_,
+                     parent.grpc_server_ctx_);
+  // Thread local trace of current thread belongs to other requests or is nullptr.
+  ctx->trace_ = parent.trace_;
+  return ctx;
+}
+
+void GrpsContext::Reset(const ::grps::protos::v1::GrpsMessage* request,
+                        ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer,
+                        butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer,
+                        brpc::Controller* http_controller,
+                        brpc::Controller* brpc_controller,
+                        grpc::ServerContext* grpc_server_ctx) {
+  request_ = request;
+  converter_ = nullptr;
+  model_inferer_ = nullptr;
+  trace_ = nullptr;
+  has_err_ = false;
+  err_msg_.clear();
+  promise_notified_ = false;
+  batcher_promise_ = nullptr;
+  batch_size_ = 0;
+  http_controller_ = http_controller;
+  brpc_controller_ = brpc_controller;
+  grpc_server_ctx_ = grpc_server_ctx;
+  DestroyUserData();
+
+  rpc_stream_writer_ = rpc_stream_writer;
+  http_stream_writer_ = http_stream_writer;
+  http_stream_done_guard_ = nullptr;
+  streaming_end_ = false;
+  http_streaming_writer_close_.reset();
+  if (http_stream_writer_ != nullptr) {
+    http_streaming_writer_close_ = std::make_shared<std::atomic<bool>>(false);
+    http_stream_writer_->get()->NotifyOnStopped(new HttpStreamingWriterCloseClosure(http_streaming_writer_close_));
+  }
+}
+
 void GrpsContext::StreamingRespond(const ::grps::protos::v1::GrpsMessage& message, bool final) {
   std::lock_guard<std::mutex> lock(streaming_mutex_);
   if (streaming_end_) {
@@ -23,6 +118,7 @@ void GrpsContext::StreamingRespond(const ::grps::protos::v1::GrpsMessage& messag
   if (rpc_stream_writer_ == nullptr && http_stream_writer_ == nullptr) {
     return;
   }
+  int64_t begin_us = trace_ != nullptr ? butil::gettimeofday_us() : 0;
 
   if (!message.has_status() || message.status().status() != ::grps::protos::v1::Status::FAILURE) {
     // Add success status.
@@ -71,6 +167,7 @@ void GrpsContext::StreamingRespond(const ::grps::protos::v1::GrpsMessage& messag
       }
     }
   }
+  Trace::Record(trace_, "streaming_respond", begin_us, trace_ != nullptr ? butil::gettimeofday_us() : 0);
 
   if (final) {
     streaming_end_ = true;
@@ -118,19 +215,17 @@ void GrpsContext::CustomizedHttpStreamingRespond(const void* data, size_t size,
 }
 
 void GrpsContext::BatcherPromiseNotify() {
-  boost::call_once(
-    [this]() {
-      if (batcher_promise_ == nullptr) {
-        return;
-      }
-      batcher_promise_->set_value();
-    },
-    promise_notified_flag_);
+  if (batcher_promise_ == nullptr) {
+    return;
+  }
+  if (!promise_notified_.exchange(true)) {
+    batcher_promise_->set_value();
+  }
 }
 
 bool GrpsContext::IfDisconnected() {
   if (http_stream_writer_ != nullptr) {
-    return http_streaming_writer_close_;
+    return *http_streaming_writer_close_;
   } else if (http_controller_ != nullptr) {
     return http_controller_->IsCanceled();
   } else if (brpc_controller_ != nullptr) {
@@ -45,7 +45,9 @@
 
 #include <boost/thread.hpp>
 #include <boost/thread/future.hpp>
+#include <atomic>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
@@ -56,49 +58,80 @@ namespace netease::grps {
 class Converter;
 class ModelInferer;
 class TensorWrapper;
+class Trace;
 
-class GrpsContext {
+// Context of one request. Hot fields are kept at the front, and the object is aligned to cache line to avoid false
+// sharing between contexts handled by different threads. Use GrpsContext::Acquire to get a context recycled by a thread
+// local pool instead of constructing a new one for every request.
+class alignas(64) GrpsContext {
 public:
   explicit GrpsContext(const ::grps::protos::v1::GrpsMessage* request = nullptr,
                        ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer = nullptr,
                        butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer = nullptr,
                        brpc::Controller* http_controller = nullptr,
                        brpc::Controller* brpc_controller = nullptr,
-                       grpc::ServerContext* grpc_server_ctx = nullptr)
-      : request_(request)
-      , rpc_stream_writer_(rpc_stream_writer)
-      , http_stream_writer_(http_stream_writer)
-      , http_controller_(http_controller)
-      , brpc_controller_(brpc_controller)
-      , grpc_server_ctx_(grpc_server_ctx) {
-    if (http_stream_writer_ != nullptr) {
-      auto* http_stream_writer_close = google::protobuf::NewCallback(this, &GrpsContext::HttpStreamingWriterCloseCb);
-      http_stream_writer_->get()->NotifyOnStopped(http_stream_writer_close);
-    }
+                       grpc::ServerContext* grpc_server_ctx = nullptr) {
+    Reset(request, rpc_stream_writer, http_stream_writer, http_controller, brpc_controller, grpc_server_ctx);
   }
 
-  ~GrpsContext() {
-    std::lock_guard<std::mutex> lock(user_data_mutex_);
-    if (user_data_ != nullptr) {
-      user_data_deleter_(user_data_);
-    }
-  }
+  ~GrpsContext() { DestroyUserData(); }
+
+  GrpsContext(const GrpsContext&) = delete;
+  GrpsContext& operator=(const GrpsContext&) = delete;
+  GrpsContext(GrpsContext&&) = delete;
+  GrpsContext& operator=(GrpsContext&&) = delete;
+
+  // [Only call by grps framework] Get a context from thread local pool. The context will be cleared and given back to
+  // the pool of the releasing thread when the last shared ptr is released.
+  static std::shared_ptr<GrpsContext> Acquire(
+    const ::grps::protos::v1::GrpsMessage* request = nullptr,
+    ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer = nullptr,
+    butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer = nullptr,
+    brpc::Controller* http_controller = nullptr,
+    brpc::Controller* brpc_controller = nullptr,
+    grpc::ServerContext* grpc_server_ctx = nullptr);
+
+  // [Only call by grps framework] Get a context for a sub-request(such as split part or dag branch) processed on
+  // another thread within parent request. Trace and controllers of parent are shared, controllers should only be read
+  // since sub-requests run concurrently. Streaming writers and user data are not shared. Sub-requests that may outlive
+  // parent request(such as shadow request) should use Acquire and keep trace alive by themselves instead.
+  static std::shared_ptr<GrpsContext> AcquireChild(const GrpsContext& parent,
+                                                   const ::grps::protos::v1::GrpsMessage* request);
 
   // ---------------------------- User data function. ----------------------------
 
-  // Set user data. T should be copyable and movable.
+  // Set user data. T should be copyable and movable. Small user data (not bigger than kInlineUserDataSize bytes) is
+  // stored inline in context without heap allocation. Bigger user data is constructed and the previous one is destroyed
+  // outside the lock.
   // Multi-thread safe.
   template <typename T,
             typename = std::enable_if_t<std::is_copy_constructible<std::decay_t<T>>::value &&
                                         std::is_move_constructible<std::decay_t<T>>::value>>
   void SetUserData(T&& data) {
-    std::lock_guard<std::mutex> lock(user_data_mutex_);
     using TDecayType = typename std::decay<T>::type;
-    if (user_data_ != nullptr) {
-      delete reinterpret_cast<TDecayType*>(user_data_);
+    if constexpr (sizeof(TDecayType) <= kInlineUserDataSize && alignof(TDecayType) <= alignof(std::max_align_t)) {
+      std::lock_guard<std::mutex> lock(user_data_mutex_);
+      DestroyUserData();
+      user_data_ = new (user_data_buf_) TDecayType(std::forward<T>(data));
+      user_data_deleter_ = [](void* data) { reinterpret_cast<TDecayType*>(data)->~TDecayType(); };
+    } else {
+      void* new_data = new TDecayType(std::forward<T>(data));
+      void* old_data = nullptr;
+      void (*old_deleter)(void*) = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(user_data_mutex_);
+        if (user_data_ == user_data_buf_) { // Inline data should be destroyed before the buffer is reused.
+          DestroyUserData();
+        }
+        old_data = user_data_;
+        old_deleter = user_data_deleter_;
+        user_data_ = new_data;
+        user_data_deleter_ = [](void* data) { delete reinterpret_cast<TDecayType*>(data); };
+      }
+      if (old_data != nullptr) {
+        old_deleter(old_data);
+      }
     }
-    user_data_ = new TDecayType(std::forward<T>(data));
-    user_data_deleter_ = [](void* data) { delete reinterpret_cast<TDecayType*>(data); };
   }
 
   // Get user data. T should be copyable and movable.
@@ -153,8 +186,8 @@ public:
   // Multi-thread safe.
   void set_err_msg(const std::string& err_msg) {
     std::lock_guard<std::mutex> lock(err_msg_mutex_);
-    has_err_ = true;
     err_msg_ = err_msg;
+    has_err_ = true;
   }
 
   // Get err_msg.
@@ -198,7 +231,10 @@ public:
   // ---------------------------- Batching function. ----------------------------
 
   // [Only call by grps framework] Set batcher promise.
-  void set_batcher_promise(boost::promise<void>* batcher_promise) { batcher_promise_ = batcher_promise; }
+  void set_batcher_promise(boost::promise<void>* batcher_promise) {
+    batcher_promise_ = batcher_promise;
+    promise_notified_ = false;
+  }
 
   // [Only call by grps framework] Get batcher promise.
   [[nodiscard]] boost::promise<void>* batcher_promise() const { return batcher_promise_; }
@@ -207,6 +243,11 @@ public:
   // Multi-thread safe.
   void BatcherPromiseNotify();
 
+  // Batch size (count of rows in dim 0) of current request in batching process mode. Set by batch converter in
+  // `BatchPreProcess` and used in `BatchPostProcess` to split the batched output.
+  void set_batch_size(int64_t batch_size) { batch_size_ = batch_size; }
+  [[nodiscard]] int64_t batch_size() const { return batch_size_; }
+
   // ---------------------------- Other function. ----------------------------
 
   // Get request from client.
@@ -230,8 +271,19 @@ public:
   // Get brpc controller. Only used when using brpc interface. Otherwise, is nullptr.
   [[nodiscard]] brpc::Controller* brpc_controller() const { return brpc_controller_; }
 
-  // [Only call by grps framework] Http streaming writer close callback.
-  void HttpStreamingWriterCloseCb() { http_streaming_writer_close_ = true; }
+  // [Only call by grps framework] Set trace of current request.
+  void set_trace(Trace* trace) { trace_ = trace; }
+
+  // Trace of current request, nullptr if current request is not sampled by tracer.
+  [[nodiscard]] Trace* trace() const { return trace_; }
+
+  // [Only call by grps framework] Clear context and reset with new request. Used to recycle context.
+  void Reset(const ::grps::protos::v1::GrpsMessage* request = nullptr,
+             ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer = nullptr,
+             butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer = nullptr,
+             brpc::Controller* http_controller = nullptr,
+             brpc::Controller* brpc_controller = nullptr,
+             grpc::ServerContext* grpc_server_ctx = nullptr);
 
   // If connection with client is broken.
   [[nodiscard]] bool IfDisconnected();
@@ -242,41 +294,62 @@ public:
   }
 
 private:
+  static constexpr size_t kInlineUserDataSize = 32;
+
+  // ---- Hot fields, used by every request. ----
   // request.
-  const ::grps::protos::v1::GrpsMessage* request_;
+  const ::grps::protos::v1::GrpsMessage* request_ = nullptr;
 
-  // streaming writer.
-  ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer_;
-  butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer_;
-  brpc::ClosureGuard* http_stream_done_guard_ = nullptr;
-  bool streaming_end_ = false;
-  std::mutex streaming_mutex_;
-  std::atomic<bool> http_streaming_writer_close_ = false;
+  Converter* converter_ = nullptr;
+  ModelInferer* model_inferer_ = nullptr;
+  Trace* trace_ = nullptr;
+
+  // err msg.
+  std::atomic<bool> has_err_ = false;
+  std::mutex err_msg_mutex_;
+
+  // Used to notify batcher that current request is finished.
+  std::atomic<bool> promise_notified_ = false;
+  boost::promise<void>* batcher_promise_ = nullptr;
+
+  // batching slots.
+  int64_t batch_size_ = 0;
 
   // http controller, Only used when using http interface. Otherwise, is nullptr.
-  brpc::Controller* http_controller_;
+  brpc::Controller* http_controller_ = nullptr;
 
   // brpc controller, Only used when using brpc interface. Otherwise, is nullptr.
-  brpc::Controller* brpc_controller_;
+  brpc::Controller* brpc_controller_ = nullptr;
 
   // grpc server context. Only used when using grpc interface. Otherwise, is nullptr.
-  grpc::ServerContext* grpc_server_ctx_;
+  grpc::ServerContext* grpc_server_ctx_ = nullptr;
 
-  // user data.
+  // user data, stored inline in user_data_buf_ if small enough.
   void* user_data_ = nullptr;
-  std::function<void(void*)> user_data_deleter_;
+  void (*user_data_deleter_)(void*) = nullptr;
   std::mutex user_data_mutex_;
+  alignas(std::max_align_t) unsigned char user_data_buf_[kInlineUserDataSize]{};
 
-  // err msg.
-  std::atomic<bool> has_err_ = false;
   std::string err_msg_;
-  std::mutex err_msg_mutex_;
 
-  // Used to notify batcher that current request is finished.
-  boost::promise<void>* batcher_promise_ = nullptr;
-  boost::once_flag promise_notified_flag_ = BOOST_ONCE_INIT;
+  // ---- Cold fields, only used by streaming request. ----
+  // streaming writer.
+  ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* rpc_stream_writer_ = nullptr;
+  butil::intrusive_ptr<brpc::ProgressiveAttachment>* http_stream_writer_ = nullptr;
+  brpc::ClosureGuard* http_stream_done_guard_ = nullptr;
+  bool streaming_end_ = false;
+  std::mutex streaming_mutex_;
+  // Set by http streaming writer close callback, which may be called after the request finished, so it is shared with
+  // the callback instead of pointing to this context.
+  std::shared_ptr<std::atomic<bool>> http_streaming_writer_close_;
 
-  Converter* converter_ = nullptr;
-  ModelInferer* model_inferer_ = nullptr;
+  // Destroy user data, user_data_mutex_ should be held or no other thread is using the context.
+  void DestroyUserData() {
+    if (user_data_ != nullptr) {
+      user_data_deleter_(user_data_);
+      user_data_ = nullptr;
+      user_data_deleter_ = nullptr;
+    }
+  }
 };
 } // namespace netease::grps
\ No newline at end of file
@@ -299,7 +299,7 @@ void TfTensorConverter::PostProcess(const std::vector<std::pair<std::string, Ten
 #endif
   for (const auto& [name, tensor_wrapper] : input) {
     auto& tensor = *tensor_wrapper.tf_tensor;
-    ::grps::protos::v1::GenericTensor g_tensor;
+    auto& g_tensor = *output.mutable_gtensors()->add_tensors();
 
     // Set name.
     g_tensor.set_name(name);
@@ -312,7 +312,6 @@ void TfTensorConverter::PostProcess(const std::vector<std::pair<std::string, Ten
 
     // Set data.
     TfTensor2GTensor(tensor, name, g_tensor, tensor.NumElements(), 0);
-    *output.mutable_gtensors()->add_tensors() = std::move(g_tensor);
   }
 
 #if TF_TENSOR_CONVERTER_DEBUG
@@ -440,7 +439,7 @@ void TfTensorConverter::BatchPreProcess(std::vector<const ::grps::protos::v1::Gr
       offsets[j] += tensor_size;
     }
 
-    ctxs[i]->SetUserData<long long>(g_tensors.tensors(0).shape(0));
+    ctxs[i]->set_batch_size(g_tensors.tensors(0).shape(0));
   }
 
 #if TF_TENSOR_CONVERTER_DEBUG
@@ -468,13 +467,13 @@ void TfTensorConverter::BatchPostProcess(const std::vector<std::pair<std::string
 
   std::vector<size_t> offsets(input.size(), 0);
   for (size_t i = 0; i < ctxs.size(); i++) {
-    auto batch_size = ctxs[i]->GetUserData<long long>();
+    auto batch_size = ctxs[i]->batch_size();
     for (size_t j = 0; j < input.size(); j++) {
       auto& [name, tensor_wrapper] = input[j];
       auto& tensor = *tensor_wrapper.tf_tensor;
       auto tensor_size = tensor.NumElements() / tensor.dim_size(0) * batch_size;
 
-      ::grps::protos::v1::GenericTensor g_tensor;
+      auto& g_tensor = *outputs[i]->mutable_gtensors()->add_tensors();
       // Set name.
       g_tensor.set_name(name);
       // Set shape.
@@ -484,7 +483,6 @@ void TfTensorConverter::BatchPostProcess(const std::vector<std::pair<std::string
       }
       // Set data.
       TfTensor2GTensor(tensor, name, g_tensor, tensor_size, offsets[j]);
-      *outputs[i]->mutable_gtensors()->add_tensors() = std::move(g_tensor);
 
       offsets[j] += tensor_size;
     }
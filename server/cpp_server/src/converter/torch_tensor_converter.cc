@@ -273,7 +273,7 @@ void TorchTensorConverter::PostProcess(const std::vector<std::pair<std::string,
 
   auto* g_tensors = output.mutable_gtensors();
   for (const auto& [name, val] : input) {
-    ::grps::protos::v1::GenericTensor g_tensor;
+    auto& g_tensor = *g_tensors->add_tensors();
     auto& tensor = *val.torch_tensor;
     // Set name.
     g_tensor.set_name(name);
@@ -283,7 +283,6 @@ void TorchTensorConverter::PostProcess(const std::vector<std::pair<std::string,
     }
     // Set data.
     TorchTensor2GTensor(val.torch_tensor->to(torch::kCPU), name, g_tensor, tensor.numel(), 0);
-    *g_tensors->add_tensors() = std::move(g_tensor);
   }
 
 #if TORCH_TENSOR_CONVERTER_DEBUG
@@ -413,7 +412,7 @@ void TorchTensorConverter::BatchPreProcess(std::vector<const ::grps::protos::v1:
       offsets[j] += tensor_size;
     }
 
-    ctxs[i]->SetUserData<long long>(g_tensors.tensors(0).shape(0));
+    ctxs[i]->set_batch_size(g_tensors.tensors(0).shape(0));
   }
 
 #if TORCH_TENSOR_CONVERTER_DEBUG
@@ -446,13 +445,13 @@ void TorchTensorConverter::BatchPostProcess(const std::vector<std::pair<std::str
 
   std::vector<size_t> offsets(input.size(), 0);
   for (size_t i = 0; i < ctxs.size(); i++) {
-    auto batch_size = ctxs[i]->GetUserData<long long>();
+    auto batch_size = ctxs[i]->batch_size();
     for (size_t j = 0; j < input.size(); j++) {
       auto& [name, tensor_wrapper] = input[j];
       auto& tensor = *tensor_wrapper.torch_tensor;
       auto tensor_size = tensor.numel() / tensor.size(0) * batch_size;
 
-      ::grps::protos::v1::GenericTensor g_tensor;
+      auto& g_tensor = *outputs[i]->mutable_gtensors()->add_tensors();
       // Set name.
       g_tensor.set_name(name);
       // Set shape.
@@ -462,7 +461,6 @@ void TorchTensorConverter::BatchPostProcess(const std::vector<std::pair<std::str
       }
       // Set data.
       TorchTensor2GTensor(tensor, name, g_tensor, tensor_size, offsets[j]);
-      *outputs[i]->mutable_gtensors()->add_tensors() = std::move(g_tensor);
 
       offsets[j] += tensor_size;
     }
@@ -230,7 +230,7 @@ void TrtTensorConverter::PostProcess(const std::vector<std::pair<std::string, Te
 #endif
   for (const auto& [name, tensor_wrapper] : input) {
     auto& tensor = *tensor_wrapper.trt_host_binding;
-    ::grps::protos::v1::GenericTensor g_tensor;
+    auto& g_tensor = *output.mutable_gtensors()->add_tensors();
 
     // Set name.
     g_tensor.set_name(name);
@@ -243,7 +243,6 @@ void TrtTensorConverter::PostProcess(const std::vector<std::pair<std::string, Te
 
     // Set data.
     TrtTensor2GTensor(tensor, name, g_tensor, tensor.volume(), 0);
-    *output.mutable_gtensors()->add_tensors() = std::move(g_tensor);
   }
 
 #if TRT_TENSOR_CONVERTER_DEBUG
@@ -378,7 +377,7 @@ void TrtTensorConverter::BatchPreProcess(std::vector<const ::grps::protos::v1::G
       offsets[j] += tensor_size;
     }
 
-    ctxs[i]->SetUserData<long long>(g_tensors.tensors(0).shape(0));
+    ctxs[i]->set_batch_size(g_tensors.tensors(0).shape(0));
   }
 
 #if TRT_TENSOR_CONVERTER_DEBUG
@@ -406,13 +405,13 @@ void TrtTensorConverter::BatchPostProcess(const std::vector<std::pair<std::strin
 
   std::vector<size_t> offsets(input.size(), 0);
   for (size_t i = 0; i < ctxs.size(); i++) {
-    auto batch_size = ctxs[i]->GetUserData<long long>();
+    auto batch_size = ctxs[i]->batch_size();
     for (size_t j = 0; j < input.size(); j++) {
       auto& [name, tensor_wrapper] = input[j];
       auto& tensor = *tensor_wrapper.trt_host_binding;
       auto tensor_size = tensor.volume() / tensor.dims().d[0] * batch_size;
 
-      ::grps::protos::v1::GenericTensor g_tensor;
+      auto& g_tensor = *outputs[i]->mutable_gtensors()->add_tensors();
       // Set name.
       g_tensor.set_name(name);
       // Set shape.
@@ -422,7 +421,6 @@ void TrtTensorConverter::BatchPostProcess(const std::vector<std::pair<std::strin
       }
       // Set data.
       TrtTensor2GTensor(tensor, name, g_tensor, tensor_size, offsets[j]);
-      *outputs[i]->mutable_gtensors()->add_tensors() = std::move(g_tensor);
 
       offsets[j] += tensor_size;
     }
@@ -7,29 +7,168 @@
 
 #include "dag/dag.h"
 
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <queue>
+
 #include "logger/logger.h"
 
 namespace netease::grps {
+// Pool running branches of all graph dags, created once and shared by dags rebuilt by hot reload. Tasks never wait for
+// each other, so that it never deadlocks. max_concurrency 0 means no limit of server, and one thread is used then.
+static boost::asio::thread_pool& BranchPool() {
+  static boost::asio::thread_pool pool(std::max(GlobalConfig::Instance().server_config().max_concurrency, 1));
+  return pool;
+}
+
+std::shared_ptr<Node> InferDag::BuildModelNode(
+  const std::string& name,
+  const std::string& model_name,
+  const std::unordered_map<std::string, Model>& models,
+  const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) {
+  auto named_node = named_nodes.find(model_name);
+  if (named_node != named_nodes.end()) {
+    return named_node->second;
+  }
+  auto model = models.find(model_name);
+  if (model == models.end()) {
+    LOG4(ERROR, "Model not found: " << model_name);
+    throw InferDagException("Model not found: " + model_name);
+  }
+  return std::make_shared<ModelNode>(name, model_name, model->second.inferer_, model->second.converter_,
+                                     model->second.batcher_, model->second.cache_, model->second.single_flight_);
+}
+
+std::shared_ptr<Node> InferDag::BuildNode(const GlobalConfig::InferenceConfig::NodeConfig& node_config,
+                                          const std::unordered_map<std::string, Model>& models,
+                                          const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) {
+  if (node_config.type == "model") {
+    return BuildModelNode(node_config.name, node_config.model, models, named_nodes);
+  } else if (node_config.type == "splitter") {
+    auto type = node_config.split.type == "text" ? SplitterNode::Type::kText : SplitterNode::Type::kTensor;
+    return std::make_shared<SplitterNode>(node_config.name, type, node_config.split.chunk_size);
+  } else if (node_config.type == "merger") {
+    auto reduce = MergerNode::Reduce::kConcat;
+    if (node_config.merge.reduce == "mean") {
+      reduce = MergerNode::Reduce::kMean;
+    } else if (node_config.merge.reduce == "topk") {
+      reduce = MergerNode::Reduce::kTopK;
+    }
+    return std::make_shared<MergerNode>(node_config.name, reduce, node_config.merge.k, node_config.merge.score_tensor);
+  } else if (node_config.type == "condition") {
+    const auto& condition = node_config.condition;
+    auto source =
+      condition.source == "tensor_max" ? ConditionNode::Source::kTensorMax : ConditionNode::Source::kGmap;
+    static const std::unordered_map<std::string, ConditionNode::Op> ops = {
+      {">", ConditionNode::Op::kGt},  {">=", ConditionNode::Op::kGe}, {"<", ConditionNode::Op::kLt},
+      {"<=", ConditionNode::Op::kLe}, {"==", ConditionNode::Op::kEq}, {"!=", ConditionNode::Op::kNe}};
+    auto action = condition.action == "goto" ? ConditionNode::Action::kGoto : ConditionNode::Action::kExit;
+    auto forward =
+      condition.forward == "request" ? ConditionNode::Forward::kRequest : ConditionNode::Forward::kOutput;
+    return std::make_shared<ConditionNode>(node_config.name, source, condition.key, ops.at(condition.op),
+                                           condition.value, action, condition.target, forward);
+  } else if (node_config.type == "ensemble") {
+    const auto& ensemble = node_config.ensemble;
+    std::vector<EnsembleNode::Member> members;
+    for (const auto& member : ensemble.members) {
+      members.push_back({member.model, BuildModelNode(member.model, member.model, models, named_nodes), member.weight});
+    }
+    static const std::unordered_map<std::string, EnsembleNode::Reduce> reduces = {
+      {"mean", EnsembleNode::Reduce::kMean},
+      {"weighted_sum", EnsembleNode::Reduce::kWeightedSum},
+      {"vote", EnsembleNode::Reduce::kVote},
+      {"concat", EnsembleNode::Reduce::kConcat}};
+    return std::make_shared<EnsembleNode>(node_config.name, std::move(members), reduces.at(ensemble.reduce),
+                                          ensemble.timeout_ms, ensemble.min_members);
+  } else {
+    LOG4(ERROR, "Unknown node type: " << node_config.type);
+    throw InferDagException("Unknown node type: " + node_config.type);
+  }
+}
+
 void SequentialDag::BuildDag(const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& node_configs,
-                             const std::unordered_map<std::string, Model>& models) {
+                             const std::unordered_map<std::string, Model>& models,
+                             const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) {
   LOG4(INFO, "Build sequential dag: " << name_);
+  bool splitting = false;
   for (const auto& node : node_configs) {
-    if (node.type == "model") {
-      auto model = models.find(node.model);
-      if (model == models.end()) {
-        LOG4(ERROR, "Model not found: " << node.model);
-        throw InferDagException("Model not found: " + node.model);
+    sequence_.emplace_back(BuildNode(node, models, named_nodes));
+    if (node.type == "splitter") {
+      if (splitting) {
+        LOG4(ERROR, "Nested splitter node: " << node.name);
+        throw InferDagException("Nested splitter node: " + node.name);
       }
-      sequence_.emplace_back(std::make_shared<ModelNode>(node.name, model->second.inferer_, model->second.converter_,
-                                                         model->second.batcher_));
+      stages_.emplace_back(Stage::kSplit);
+      splitting = true;
+    } else if (node.type == "merger") {
+      if (!splitting) {
+        LOG4(ERROR, "Merger node: " << node.name << " does not follow a splitter node.");
+        throw InferDagException("Merger node: " + node.name + " does not follow a splitter node.");
+      }
+      stages_.emplace_back(Stage::kMerge);
+      splitting = false;
+    } else if (node.type == "condition") {
+      if (splitting) {
+        LOG4(ERROR, "Condition node: " << node.name << " between splitter and merger node.");
+        throw InferDagException("Condition node: " + node.name + " between splitter and merger node.");
+      }
+      stages_.emplace_back(Stage::kCondition);
     } else {
-      LOG4(ERROR, "Unknown node type: " << node.type);
-      throw InferDagException("Unknown node type: " + node.type);
+      stages_.emplace_back(splitting ? Stage::kParts : Stage::kSingle);
     }
   }
+  if (splitting) {
+    LOG4(ERROR, "Splitter node is not followed by a merger node.");
+    throw InferDagException("Splitter node is not followed by a merger node.");
+  }
+
+  handoffs_.resize(sequence_.size());
+  for (size_t i = 0; i < node_configs.size(); ++i) {
+    if (!node_configs[i].tensor_handoff) {
+      continue;
+    }
+    auto supported = [this](size_t idx) {
+      auto model_node = std::dynamic_pointer_cast<ModelNode>(sequence_[idx]);
+      return stages_[idx] == Stage::kSingle && model_node && model_node->SupportTensorHandoff();
+    };
+    if (i == 0 || !supported(i - 1) || !supported(i)) {
+      LOG4(ERROR, "Node: " << node_configs[i].name << " and its previous node do not support tensor hand-off.");
+      throw InferDagException("Node: " + node_configs[i].name +
+                              " and its previous node do not support tensor hand-off. Both should be model nodes "
+                              "with converter, and without batching, cache, coalescing, routing and lazy loading.");
+    }
+    handoffs_[i - 1].tensor_output = true;
+    handoffs_[i].tensor_input = true;
+  }
+
+  // Goto target of condition node should be a later node outside splitter and merger, and not take tensors handed off.
+  gotos_.assign(sequence_.size(), 0);
+  for (size_t i = 0; i < node_configs.size(); ++i) {
+    if (stages_[i] != Stage::kCondition || node_configs[i].condition.action != "goto") {
+      continue;
+    }
+    const auto& target = node_configs[i].condition.target;
+    size_t j = i + 1;
+    while (j < node_configs.size() && node_configs[j].name != target) {
+      ++j;
+    }
+    if (j == node_configs.size() || (stages_[j] != Stage::kSingle && stages_[j] != Stage::kSplit &&
+                                     stages_[j] != Stage::kCondition) ||
+        handoffs_[j].tensor_input) {
+      LOG4(ERROR, "Goto target: " << target << " of condition node: " << node_configs[i].name << " is invalid.");
+      throw InferDagException("Goto target: " + target + " of condition node: " + node_configs[i].name +
+                              " is invalid, it should be a later node outside splitter and merger, and without "
+                              "tensor hand-off.");
+    }
+    gotos_[i] = j;
+  }
+
   std::stringstream ss;
-  for (const auto& node : sequence_) {
-    ss << node->name() << " -> ";
+  for (size_t i = 0; i < sequence_.size(); ++i) {
+    ss << sequence_[i]->name() << (stages_[i] == Stage::kParts ? "(parallel)" : "")
+       << (gotos_[i] != 0 ? "(goto " + sequence_[gotos_[i]]->name() + ")" : "")
+       << (handoffs_[i].tensor_output ? " => " : " -> ");
   }
   LOG4(INFO, "Build sequential dag successfully, sequence is: " << ss.str());
 }
@@ -40,15 +179,51 @@ void SequentialDag::Infer(const ::grps::protos::v1::GrpsMessage& input,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "Infer sequential dag: " << name_);
 #endif
-  for (int i = 0; i < sequence_.size(); ++i) {
-    if (i == 0) {
-      sequence_[i]->Process(input, output, ctx);
-    } else {
-      sequence_[i]->Process(output, output, ctx);
+  std::vector<::grps::protos::v1::GrpsMessage> parts;
+  ModelNode::Tensors tensors;
+  const ::grps::protos::v1::GrpsMessage* node_input = &input;
+  for (size_t i = 0; i < sequence_.size(); ++i) {
+    switch (stages_[i]) {
+      case Stage::kSingle:
+        if (handoffs_[i].tensor_input || handoffs_[i].tensor_output) {
+          RunHandoff(i, *node_input, output, tensors, ctx);
+        } else {
+          sequence_[i]->Process(*node_input, output, ctx);
+        }
+        break;
+      case Stage::kSplit:
+        static_cast<SplitterNode&>(*sequence_[i]).Split(*node_input, parts, ctx);
+        break;
+      case Stage::kParts:
+        sequence_[i]->Process(parts, parts, ctx);
+        break;
+      case Stage::kMerge:
+        static_cast<MergerNode&>(*sequence_[i]).Merge(parts, output, ctx);
+        break;
+      case Stage::kCondition: {
+        // Condition node passes message through without copy.
+        const auto& condition = static_cast<ConditionNode&>(*sequence_[i]);
+        bool hit = condition.Evaluate(*node_input);
+        if (hit && condition.action() == ConditionNode::Action::kExit) {
+          i = sequence_.size() - 1; // Skip the rest nodes, message passed to condition node is the output of dag.
+          continue;
+        }
+        if (condition.forward() == ConditionNode::Forward::kRequest) {
+          node_input = &input;
+        }
+        if (hit) {
+          i = gotos_[i] - 1;
+        }
+        continue;
+      }
     }
     if (ctx.has_err()) {
       return;
     }
+    node_input = &output;
+  }
+  if (node_input != &output) {
+    output.CopyFrom(*node_input);
   }
 }
 
@@ -58,26 +233,346 @@ void SequentialDag::Infer(const ::grps::protos::v1::GrpsMessage& input,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "Infer sequential dag: " << name_);
 #endif
-  for (int i = 0; i < sequence_.size(); ++i) {
-    if (i == 0) {
-      sequence_[i]->Process(input, output, ctx_sp);
-    } else {
-      sequence_[i]->Process(output, output, ctx_sp);
+  std::vector<::grps::protos::v1::GrpsMessage> parts;
+  ModelNode::Tensors tensors;
+  const ::grps::protos::v1::GrpsMessage* node_input = &input;
+  for (size_t i = 0; i < sequence_.size(); ++i) {
+    switch (stages_[i]) {
+      case Stage::kSingle:
+        if (handoffs_[i].tensor_input || handoffs_[i].tensor_output) {
+          RunHandoff(i, *node_input, output, tensors, *ctx_sp);
+        } else {
+          sequence_[i]->Process(*node_input, output, ctx_sp);
+        }
+        break;
+      case Stage::kSplit:
+        static_cast<SplitterNode&>(*sequence_[i]).Split(*node_input, parts, *ctx_sp);
+        break;
+      case Stage::kParts:
+        sequence_[i]->Process(parts, parts, ctx_sp);
+        break;
+      case Stage::kMerge:
+        static_cast<MergerNode&>(*sequence_[i]).Merge(parts, output, *ctx_sp);
+        break;
+      case Stage::kCondition: {
+        // Condition node passes message through without copy.
+        const auto& condition = static_cast<ConditionNode&>(*sequence_[i]);
+        bool hit = condition.Evaluate(*node_input);
+        if (hit && condition.action() == ConditionNode::Action::kExit) {
+          i = sequence_.size() - 1; // Skip the rest nodes, message passed to condition node is the output of dag.
+          continue;
+        }
+        if (condition.forward() == ConditionNode::Forward::kRequest) {
+          node_input = &input;
+        }
+        if (hit) {
+          i = gotos_[i] - 1;
+        }
+        continue;
+      }
     }
     if (ctx_sp->has_err()) {
       return;
     }
+    node_input = &output;
+  }
+  if (node_input != &output) {
+    output.CopyFrom(*node_input);
+  }
+}
+
+void SequentialDag::RunHandoff(size_t idx,
+                               const ::grps::protos::v1::GrpsMessage& input,
+                               ::grps::protos::v1::GrpsMessage& output,
+                               ModelNode::Tensors& tensors,
+                               GrpsContext& ctx) {
+  auto& node = static_cast<ModelNode&>(*sequence_[idx]);
+  ModelNode::Tensors inputs;
+  if (handoffs_[idx].tensor_input) {
+    inputs = std::move(tensors);
+  } else {
+    node.PreProcess(input, inputs, ctx);
+    if (ctx.has_err()) {
+      return;
+    }
+  }
+
+  tensors.clear();
+  node.Infer(inputs, tensors, ctx);
+  if (ctx.has_err() || handoffs_[idx].tensor_output) {
+    return;
   }
+  node.PostProcess(tensors, output, ctx);
+  tensors.clear();
 }
 
 void GraphDag::BuildDag(const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& node_configs,
-                        const std::unordered_map<std::string, Model>& models) {}
+                        const std::unordered_map<std::string, Model>& models,
+                        const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) {
+  LOG4(INFO, "Build graph dag: " << name_);
+  if (node_configs.empty()) {
+    throw InferDagException("Graph dag " + name_ + " has no node.");
+  }
+
+  std::unordered_map<std::string, size_t> indexes;
+  for (size_t i = 0; i < node_configs.size(); ++i) {
+    if (!indexes.emplace(node_configs[i].name, i).second) {
+      LOG4(ERROR, "Duplicated node name: " << node_configs[i].name);
+      throw InferDagException("Duplicated node name: " + node_configs[i].name);
+    }
+  }
+
+  // Build edges.
+  std::vector<GraphNode> nodes(node_configs.size());
+  for (size_t i = 0; i < node_configs.size(); ++i) {
+    if (node_configs[i].type == "splitter" || node_configs[i].type == "merger") {
+      LOG4(ERROR, "Splitter and merger node are only supported by sequential dag, node: " << node_configs[i].name);
+      throw InferDagException("Splitter and merger node are only supported by sequential dag, node: " +
+                              node_configs[i].name);
+    }
+    if (node_configs[i].type == "condition" && node_configs[i].condition.action != "exit") {
+      LOG4(ERROR, "Condition node of graph dag only supports exit action, node: " << node_configs[i].name);
+      throw InferDagException("Condition node of graph dag only supports exit action, node: " +
+                              node_configs[i].name);
+    }
+    nodes[i].node = BuildNode(node_configs[i], models, named_nodes);
+    nodes[i].condition = std::dynamic_pointer_cast<ConditionNode>(nodes[i].node);
+    for (const auto& input : node_configs[i].inputs) {
+      auto iter = indexes.find(input);
+      if (iter == indexes.end()) {
+        LOG4(ERROR, "Input node: " << input << " of node: " << node_configs[i].name << " not found.");
+        throw InferDagException("Input node: " + input + " of node: " + node_configs[i].name + " not found.");
+      }
+      nodes[i].inputs.emplace_back(iter->second);
+      nodes[iter->second].outputs.emplace_back(i);
+    }
+  }
+
+  // Sort nodes in topological order(kahn), and detect cycle.
+  std::vector<size_t> in_degrees(nodes.size());
+  std::queue<size_t> ready;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    in_degrees[i] = nodes[i].inputs.size();
+    if (in_degrees[i] == 0) {
+      ready.push(i);
+    }
+  }
+  std::vector<size_t> order;
+  while (!ready.empty()) {
+    auto idx = ready.front();
+    ready.pop();
+    order.emplace_back(idx);
+    for (auto output : nodes[idx].outputs) {
+      if (--in_degrees[output] == 0) {
+        ready.push(output);
+      }
+    }
+  }
+  if (order.size() != nodes.size()) {
+    LOG4(ERROR, "Graph dag " << name_ << " has cycle.");
+    throw InferDagException("Graph dag " + name_ + " has cycle.");
+  }
+
+  // Re-index nodes in topological order.
+  std::vector<size_t> new_indexes(nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    new_indexes[order[i]] = i;
+  }
+  nodes_.clear();
+  sinks_.clear();
+  for (auto idx : order) {
+    auto node = std::move(nodes[idx]);
+    for (auto& input : node.inputs) {
+      input = new_indexes[input];
+    }
+    for (auto& output : node.outputs) {
+      output = new_indexes[output];
+    }
+    if (node.outputs.empty()) {
+      sinks_.emplace_back(nodes_.size());
+    }
+    nodes_.emplace_back(std::move(node));
+  }
+
+  std::stringstream ss;
+  for (const auto& node : nodes_) {
+    ss << node.node->name() << "(";
+    for (size_t i = 0; i < node.inputs.size(); ++i) {
+      ss << (i == 0 ? "" : ", ") << nodes_[node.inputs[i]].node->name();
+    }
+    ss << ") ";
+  }
+  LOG4(INFO, "Build graph dag successfully, nodes(inputs) in topological order: " << ss.str());
+}
 
 void GraphDag::Infer(const ::grps::protos::v1::GrpsMessage& input,
                      ::grps::protos::v1::GrpsMessage& output,
-                     GrpsContext& ctx) {}
+                     GrpsContext& ctx) {
+#ifdef GRPS_DEBUG
+  LOG4(INFO, "Infer graph dag: " << name_);
+#endif
+  auto state = std::make_shared<RunState>();
+  state->input = &input;
+  state->output = &output;
+  state->ctx = &ctx;
+  Run(state);
+}
 
 void GraphDag::Infer(const ::grps::protos::v1::GrpsMessage& input,
                      ::grps::protos::v1::GrpsMessage& output,
-                     const std::shared_ptr<GrpsContext>& ctx_sp) {}
-} // namespace netease::grps
\ No newline at end of file
+                     const std::shared_ptr<GrpsContext>& ctx_sp) {
+#ifdef GRPS_DEBUG
+  LOG4(INFO, "Infer graph dag: " << name_);
+#endif
+  auto state = std::make_shared<RunState>();
+  state->input = &input;
+  state->output = &output;
+  state->ctx = ctx_sp.get();
+  state->ctx_sp = &ctx_sp;
+  Run(state);
+}
+
+void GraphDag::Run(const std::shared_ptr<RunState>& state) {
+  state->outputs.resize(nodes_.size());
+  state->pending = std::make_unique<std::atomic<int>[]>(nodes_.size());
+  std::vector<size_t> sources;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    state->pending[i] = int(nodes_[i].inputs.size());
+    if (nodes_[i].inputs.empty()) {
+      sources.emplace_back(i);
+    }
+  }
+  state->remaining = nodes_.size();
+
+  for (size_t i = 1; i < sources.size(); ++i) {
+    boost::asio::post(BranchPool(), [this, state, idx = sources[i]] { Execute(state, idx); });
+  }
+  Execute(state, sources[0]);
+
+  {
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait(lock, [&state] { return state->remaining == 0; });
+  }
+
+  auto& ctx = *state->ctx;
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+  if (state->failed) {
+    if (!ctx.has_err()) {
+      ctx.set_err_msg(state->err_msg);
+    }
+    return;
+  }
+  if (state->exited) {
+    return;
+  }
+  if (sinks_.size() > 1) {
+    // Merge outputs of sinks in config order.
+    state->output->Clear();
+    for (auto sink : sinks_) {
+      state->output->MergeFrom(state->outputs[sink]);
+    }
+  }
+}
+
+void GraphDag::Execute(const std::shared_ptr<RunState>& state, size_t idx) {
+  while (true) {
+    if (!state->failed && !state->exited) {
+      ProcessNode(*state, idx);
+    }
+
+    std::vector<size_t> ready;
+    for (auto output : nodes_[idx].outputs) {
+      if (--state->pending[output] == 0) {
+        ready.emplace_back(output);
+      }
+    }
+    for (size_t i = 1; i < ready.size(); ++i) {
+      boost::asio::post(BranchPool(), [this, state, next = ready[i]] { Execute(state, next); });
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(state->mtx);
+      if (--state->remaining == 0) {
+        state->cv.notify_all();
+      }
+    }
+    if (ready.empty()) {
+      return;
+    }
+    idx = ready[0];
+  }
+}
+
+void GraphDag::ProcessNode(RunState& state, size_t idx) {
+  const auto& graph_node = nodes_[idx];
+
+  // Input of node is input of dag, output of its only input node, or merged outputs of its input nodes.
+  const ::grps::protos::v1::GrpsMessage* input = state.input;
+  ::grps::protos::v1::GrpsMessage merged_input;
+  if (graph_node.inputs.size() == 1) {
+    input = &state.outputs[graph_node.inputs[0]];
+  } else if (graph_node.inputs.size() > 1) {
+    for (auto input_idx : graph_node.inputs) {
+      merged_input.MergeFrom(state.outputs[input_idx]);
+    }
+    input = &merged_input;
+  }
+
+  try {
+    if (graph_node.condition) {
+      ProcessCondition(state, idx, *input);
+      return;
+    }
+
+    if (sinks_.size() == 1 && idx == sinks_[0]) {
+      // The only sink runs after all other nodes, so it can use context of request(such as streaming) directly.
+      if (state.ctx_sp != nullptr) {
+        graph_node.node->Process(*input, *state.output, *state.ctx_sp);
+      } else {
+        graph_node.node->Process(*input, *state.output, *state.ctx);
+      }
+      if (state.ctx->has_err()) {
+        state.failed = true;
+      }
+      return;
+    }
+
+    // Nodes running concurrently use their own context, because model node sets converter, inferer and batcher
+    // promise to context.
+    auto node_ctx = GrpsContext::AcquireChild(*state.ctx, input);
+    graph_node.node->Process(*input, state.outputs[idx], node_ctx);
+    if (node_ctx->has_err()) {
+      std::lock_guard<std::mutex> lock(state.mtx);
+      if (!state.failed) {
+        state.err_msg = node_ctx->err_msg();
+        state.failed = true;
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(state.mtx);
+    if (!state.error) {
+      state.error = std::current_exception();
+    }
+    state.failed = true;
+  }
+}
+
+void GraphDag::ProcessCondition(RunState& state, size_t idx, const ::grps::protos::v1::GrpsMessage& input) {
+  const auto& condition = *nodes_[idx].condition;
+  if (condition.Evaluate(input)) {
+    // Exit, nodes not started will be skipped, and input of condition node is the output of dag.
+    std::lock_guard<std::mutex> lock(state.mtx);
+    if (!state.exited) {
+      state.output->CopyFrom(input);
+      state.exited = true;
+    }
+    return;
+  }
+
+  const auto& forward = condition.forward() == ConditionNode::Forward::kRequest ? *state.input : input;
+  auto& output = sinks_.size() == 1 && idx == sinks_[0] ? *state.output : state.outputs[idx];
+  output.CopyFrom(forward);
+}
+} // namespace netease::grps
@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "config/global_config.h"
 #include "context/context.h"
@@ -38,8 +43,16 @@ public:
   explicit InferDag(const std::string& name) : name_(name) {}
   virtual ~InferDag() = default;
 
+  /**
+   * @brief Build dag.
+   * @param node_configs: Node configs.
+   * @param models: Models with `name-version` key.
+   * @param named_nodes: Nodes used directly by model node refers to their name, such as router nodes with model
+   * name(without version) key and lazy model nodes with `name-version` key.
+   */
   virtual void BuildDag(const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& node_configs,
-                        const std::unordered_map<std::string, Model>& models) = 0;
+                        const std::unordered_map<std::string, Model>& models,
+                        const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) = 0;
 
   virtual void Infer(const ::grps::protos::v1::GrpsMessage& input,
                      ::grps::protos::v1::GrpsMessage& output,
@@ -53,6 +66,18 @@ public:
 
 protected:
   std::string name_;
+
+  // Build model node of model(name-version format), or get lazy model node or router node of the name.
+  static std::shared_ptr<Node> BuildModelNode(
+    const std::string& name,
+    const std::string& model_name,
+    const std::unordered_map<std::string, Model>& models,
+    const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes);
+
+  // Build node of node config.
+  static std::shared_ptr<Node> BuildNode(const GlobalConfig::InferenceConfig::NodeConfig& node_config,
+                                         const std::unordered_map<std::string, Model>& models,
+                                         const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes);
 };
 
 // Sequential DAG, which means the models will be executed in sequence.
@@ -62,7 +87,8 @@ public:
   ~SequentialDag() override = default;
 
   void BuildDag(const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& node_configs,
-                const std::unordered_map<std::string, Model>& models) override;
+                const std::unordered_map<std::string, Model>& models,
+                const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) override;
 
   void Infer(const ::grps::protos::v1::GrpsMessage& input,
              ::grps::protos::v1::GrpsMessage& output,
@@ -73,17 +99,39 @@ public:
              const std::shared_ptr<GrpsContext>& ctx_sp) override;
 
 private:
+  // How a node processes in sequence. Nodes between splitter and merger process split sub-requests.
+  enum class Stage { kSingle = 0, kSplit = 1, kParts = 2, kMerge = 3, kCondition = 4 };
+
+  // Tensor hand-off of model node, the converter between two model nodes handing off tensors is skipped.
+  struct Handoff {
+    bool tensor_input = false;  // Take output tensors of previous node.
+    bool tensor_output = false; // Hand output tensors to next node.
+  };
+
   std::vector<std::shared_ptr<Node>> sequence_;
+  std::vector<Stage> stages_;
+  std::vector<Handoff> handoffs_;
+  std::vector<size_t> gotos_; // Index of goto target of condition node, 0 means no goto.
+
+  // Run model node with tensor hand-off. tensors: Output tensors of previous node, and replaced by output tensors of
+  // this node if handed off to next node.
+  void RunHandoff(size_t idx,
+                  const ::grps::protos::v1::GrpsMessage& input,
+                  ::grps::protos::v1::GrpsMessage& output,
+                  ModelNode::Tensors& tensors,
+                  GrpsContext& ctx);
 };
 
-// TODO(zhaochaochao): Graph DAG, which means the models will be executed in graph.
+// Graph DAG, which means the nodes will be executed in topological order of the graph configured by `inputs` of nodes.
+// A node is fired as soon as all its inputs are ready, so independent branches run concurrently on the dag pool.
 class GraphDag : public InferDag {
 public:
-  GraphDag(const std::string& name) : InferDag(name) {}
+  explicit GraphDag(const std::string& name) : InferDag(name) {}
   ~GraphDag() override = default;
 
   void BuildDag(const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& node_configs,
-                const std::unordered_map<std::string, Model>& models) override;
+                const std::unordered_map<std::string, Model>& models,
+                const std::unordered_map<std::string, std::shared_ptr<Node>>& named_nodes) override;
 
   void Infer(const ::grps::protos::v1::GrpsMessage& input,
              ::grps::protos::v1::GrpsMessage& output,
@@ -92,5 +140,41 @@ public:
   void Infer(const ::grps::protos::v1::GrpsMessage& input,
              ::grps::protos::v1::GrpsMessage& output,
              const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  struct GraphNode {
+    std::shared_ptr<Node> node;
+    std::shared_ptr<ConditionNode> condition; // Not null if node is a condition node.
+    std::vector<size_t> inputs;               // Empty means input of dag.
+    std::vector<size_t> outputs; // Downstream nodes.
+  };
+
+  // State of one request running on the graph.
+  struct RunState {
+    const ::grps::protos::v1::GrpsMessage* input = nullptr;
+    ::grps::protos::v1::GrpsMessage* output = nullptr;
+    GrpsContext* ctx = nullptr;
+    const std::shared_ptr<GrpsContext>* ctx_sp = nullptr;
+    std::vector<::grps::protos::v1::GrpsMessage> outputs;
+    std::unique_ptr<std::atomic<int>[]> pending; // Not ready inputs of each node.
+    std::atomic<bool> failed{false};
+    std::atomic<bool> exited{false}; // Ended early by condition node, output is set when exited.
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t remaining = 0; // Nodes not finished, protected by mtx.
+    std::string err_msg;  // Protected by mtx.
+    std::exception_ptr error = nullptr;
+  };
+
+  std::vector<GraphNode> nodes_;
+  // Sink nodes(without downstream), outputs of them are merged as output of dag.
+  std::vector<size_t> sinks_;
+
+  void Run(const std::shared_ptr<RunState>& state);
+  // Run node and its ready downstream nodes. One ready node is run in current thread, and others are posted to pool.
+  void Execute(const std::shared_ptr<RunState>& state, size_t idx);
+  void ProcessNode(RunState& state, size_t idx);
+  // Evaluate condition node, end dag early or pass message to downstream nodes.
+  void ProcessCondition(RunState& state, size_t idx, const ::grps::protos::v1::GrpsMessage& input);
 };
 } // namespace netease::grps
\ No newline at end of file
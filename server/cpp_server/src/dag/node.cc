@@ -7,20 +7,372 @@
 
 #include "node.h"
 
+#include <butil/fast_rand.h>
 #include <butil/time.h>
 
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <numeric>
+
+#include "config/global_config.h"
+#include "constant.h"
 #include "logger/logger.h"
+#include "monitor/monitor.h"
+#include "monitor/trace.h"
 
 namespace netease::grps {
+using ::grps::protos::v1::GenericTensor;
+using ::grps::protos::v1::GrpsMessage;
+
+// Pool running sub-requests split by splitter node. Tasks never wait for each other, so that it never deadlocks.
+// max_concurrency 0 means no limit of server, and one thread is used then.
+static boost::asio::thread_pool& PartsPool() {
+  static boost::asio::thread_pool pool(std::max(GlobalConfig::Instance().server_config().max_concurrency, 1));
+  return pool;
+}
+
+// Run fn(0..n-1) in parallel, fn(0) runs in current thread.
+static void ParallelFor(size_t n, const std::function<void(size_t)>& fn) {
+  std::mutex mtx;
+  std::condition_variable cv;
+  size_t remaining = n - 1;
+  for (size_t i = 1; i < n; ++i) {
+    boost::asio::post(PartsPool(), [&, i] {
+      fn(i);
+      std::lock_guard<std::mutex> lock(mtx);
+      if (--remaining == 0) {
+        cv.notify_one();
+      }
+    });
+  }
+  fn(0);
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [&remaining] { return remaining == 0; });
+}
+
+// ---------------------------- Tensor helpers of splitter and merger. ----------------------------
+
+static size_t RowNum(const GenericTensor& tensor) {
+  if (tensor.shape_size() == 0) {
+    throw Node::NodeException("Tensor " + tensor.name() + " has no dimension.");
+  }
+  return tensor.shape(0);
+}
+
+static size_t RowSize(const GenericTensor& tensor) {
+  size_t size = 1;
+  for (int i = 1; i < tensor.shape_size(); ++i) {
+    size *= tensor.shape(i);
+  }
+  return size;
+}
+
+template <typename T>
+static void AddValue(google::protobuf::RepeatedField<T>* field, T value) {
+  field->Add(value);
+}
+
+static void AddValue(google::protobuf::RepeatedPtrField<std::string>* field, const std::string& value) {
+  *field->Add() = value;
+}
+
+// Append rows of src to flat data of dst, shape of dst is not changed.
+static void AppendRows(const GenericTensor& src, const std::vector<size_t>& rows, GenericTensor& dst) {
+  auto row_size = RowSize(src);
+  auto append = [&rows, row_size](const auto& from, auto* to) {
+    for (auto row : rows) {
+      for (size_t i = row * row_size; i < (row + 1) * row_size; ++i) {
+        AddValue(to, from.Get(int(i)));
+      }
+    }
+  };
+  switch (src.dtype()) {
+    case ::grps::protos::v1::DT_UINT8:
+      append(src.flat_uint8(), dst.mutable_flat_uint8());
+      break;
+    case ::grps::protos::v1::DT_INT8:
+      append(src.flat_int8(), dst.mutable_flat_int8());
+      break;
+    case ::grps::protos::v1::DT_INT16:
+      append(src.flat_int16(), dst.mutable_flat_int16());
+      break;
+    case ::grps::protos::v1::DT_INT32:
+      append(src.flat_int32(), dst.mutable_flat_int32());
+      break;
+    case ::grps::protos::v1::DT_INT64:
+      append(src.flat_int64(), dst.mutable_flat_int64());
+      break;
+    case ::grps::protos::v1::DT_FLOAT16:
+      append(src.flat_float16(), dst.mutable_flat_float16());
+      break;
+    case ::grps::protos::v1::DT_FLOAT32:
+      append(src.flat_float32(), dst.mutable_flat_float32());
+      break;
+    case ::grps::protos::v1::DT_FLOAT64:
+      append(src.flat_float64(), dst.mutable_flat_float64());
+      break;
+    case ::grps::protos::v1::DT_STRING:
+      append(src.flat_string(), dst.mutable_flat_string());
+      break;
+    default:
+      throw Node::NodeException("Unsupported dtype of tensor " + src.name());
+  }
+}
+
+static std::vector<size_t> RowRange(size_t begin, size_t end) {
+  std::vector<size_t> rows(end - begin);
+  std::iota(rows.begin(), rows.end(), begin);
+  return rows;
+}
+
+// Numeric value of flat data of tensor.
+static double ValueAt(const GenericTensor& tensor, size_t idx) {
+  auto i = int(idx);
+  switch (tensor.dtype()) {
+    case ::grps::protos::v1::DT_UINT8:
+      return tensor.flat_uint8(i);
+    case ::grps::protos::v1::DT_INT8:
+      return tensor.flat_int8(i);
+    case ::grps::protos::v1::DT_INT16:
+      return tensor.flat_int16(i);
+    case ::grps::protos::v1::DT_INT32:
+      return tensor.flat_int32(i);
+    case ::grps::protos::v1::DT_INT64:
+      return double(tensor.flat_int64(i));
+    case ::grps::protos::v1::DT_FLOAT16:
+      return tensor.flat_float16(i);
+    case ::grps::protos::v1::DT_FLOAT32:
+      return tensor.flat_float32(i);
+    case ::grps::protos::v1::DT_FLOAT64:
+      return tensor.flat_float64(i);
+    default:
+      throw Node::NodeException("Tensor " + tensor.name() + " is not numeric.");
+  }
+}
+
+// Set numeric flat data of tensor, integers are rounded.
+static void SetValues(GenericTensor& tensor, const std::vector<double>& values) {
+  auto set = [&values](auto* to) {
+    using T = typename std::remove_pointer_t<decltype(to)>::value_type;
+    to->Clear();
+    to->Reserve(int(values.size()));
+    for (auto value : values) {
+      to->Add(std::is_integral_v<T> ? T(std::llround(value)) : T(value));
+    }
+  };
+  switch (tensor.dtype()) {
+    case ::grps::protos::v1::DT_UINT8:
+      set(tensor.mutable_flat_uint8());
+      break;
+    case ::grps::protos::v1::DT_INT8:
+      set(tensor.mutable_flat_int8());
+      break;
+    case ::grps::protos::v1::DT_INT16:
+      set(tensor.mutable_flat_int16());
+      break;
+    case ::grps::protos::v1::DT_INT32:
+      set(tensor.mutable_flat_int32());
+      break;
+    case ::grps::protos::v1::DT_INT64:
+      set(tensor.mutable_flat_int64());
+      break;
+    case ::grps::protos::v1::DT_FLOAT16:
+      set(tensor.mutable_flat_float16());
+      break;
+    case ::grps::protos::v1::DT_FLOAT32:
+      set(tensor.mutable_flat_float32());
+      break;
+    case ::grps::protos::v1::DT_FLOAT64:
+      set(tensor.mutable_flat_float64());
+      break;
+    default:
+      throw Node::NodeException("Tensor " + tensor.name() + " is not numeric.");
+  }
+}
+
+// Concat gtensors of messages along the first dimension.
+static void ConcatTensors(const std::vector<GrpsMessage>& input, GrpsMessage& output) {
+  const auto& first = input[0].gtensors();
+  auto* tensors = output.mutable_gtensors();
+  for (int t = 0; t < first.tensors_size(); ++t) {
+    const auto& first_tensor = first.tensors(t);
+    auto* tensor = tensors->add_tensors();
+    tensor->set_name(first_tensor.name());
+    tensor->set_dtype(first_tensor.dtype());
+    size_t rows = 0;
+    for (const auto& part : input) {
+      if (!part.has_gtensors() || part.gtensors().tensors_size() != first.tensors_size()) {
+        throw Node::NodeException("Tensors number of sub-requests mismatch.");
+      }
+      const auto& part_tensor = part.gtensors().tensors(t);
+      if (part_tensor.dtype() != first_tensor.dtype() || RowSize(part_tensor) != RowSize(first_tensor)) {
+        throw Node::NodeException("Dtype or shape of tensor " + first_tensor.name() + " of sub-requests mismatch.");
+      }
+      AppendRows(part_tensor, RowRange(0, RowNum(part_tensor)), *tensor);
+      rows += RowNum(part_tensor);
+    }
+    tensor->add_shape(rows);
+    for (int d = 1; d < first_tensor.shape_size(); ++d) {
+      tensor->add_shape(first_tensor.shape(d));
+    }
+  }
+}
+
+// Check gtensors of all messages have the same number, dtype and shape as the first message.
+static void CheckSameTensors(const std::vector<GrpsMessage>& input) {
+  const auto& first = input[0].gtensors();
+  for (const auto& message : input) {
+    if (!message.has_gtensors() || message.gtensors().tensors_size() != first.tensors_size()) {
+      throw Node::NodeException("Tensors number of outputs mismatch.");
+    }
+    for (int t = 0; t < first.tensors_size(); ++t) {
+      const auto& tensor = message.gtensors().tensors(t);
+      const auto& first_tensor = first.tensors(t);
+      if (tensor.dtype() != first_tensor.dtype() ||
+          RowNum(tensor) * RowSize(tensor) != RowNum(first_tensor) * RowSize(first_tensor)) {
+        throw Node::NodeException("Dtype or shape of tensor " + first_tensor.name() + " of outputs mismatch.");
+      }
+    }
+  }
+}
+
+// Element-wise weighted sum of gtensors of messages, integers are rounded.
+static void WeightedSumTensors(const std::vector<GrpsMessage>& input,
+                               const std::vector<double>& weights,
+                               GrpsMessage& output) {
+  CheckSameTensors(input);
+  const auto& first = input[0].gtensors();
+  auto* tensors = output.mutable_gtensors();
+  for (int t = 0; t < first.tensors_size(); ++t) {
+    const auto& first_tensor = first.tensors(t);
+    std::vector<double> sums(RowNum(first_tensor) * RowSize(first_tensor), 0);
+    for (size_t m = 0; m < input.size(); ++m) {
+      const auto& tensor = input[m].gtensors().tensors(t);
+      for (size_t i = 0; i < sums.size(); ++i) {
+        sums[i] += weights[m] * ValueAt(tensor, i);
+      }
+    }
+    auto* tensor = tensors->add_tensors();
+    tensor->set_name(first_tensor.name());
+    tensor->set_dtype(first_tensor.dtype());
+    *tensor->mutable_shape() = first_tensor.shape();
+    SetValues(*tensor, sums);
+  }
+}
+
+// Index of the value with the highest total weight, ties go to the first one.
+template <typename T>
+static size_t Majority(const std::vector<T>& values, const std::vector<double>& weights) {
+  size_t best = 0;
+  double best_weight = -1;
+  for (size_t i = 0; i < values.size(); ++i) {
+    double weight = 0;
+    for (size_t j = 0; j < values.size(); ++j) {
+      weight += values[j] == values[i] ? weights[j] : 0;
+    }
+    if (weight > best_weight) {
+      best = i;
+      best_weight = weight;
+    }
+  }
+  return best;
+}
+
+// Element-wise weighted majority of gtensors of messages.
+static void VoteTensors(const std::vector<GrpsMessage>& input,
+                        const std::vector<double>& weights,
+                        GrpsMessage& output) {
+  CheckSameTensors(input);
+  const auto& first = input[0].gtensors();
+  auto* tensors = output.mutable_gtensors();
+  std::vector<double> candidates(input.size());
+  for (int t = 0; t < first.tensors_size(); ++t) {
+    const auto& first_tensor = first.tensors(t);
+    std::vector<double> votes(RowNum(first_tensor) * RowSize(first_tensor));
+    for (size_t i = 0; i < votes.size(); ++i) {
+      for (size_t m = 0; m < input.size(); ++m) {
+        candidates[m] = ValueAt(input[m].gtensors().tensors(t), i);
+      }
+      votes[i] = candidates[Majority(candidates, weights)];
+    }
+    auto* tensor = tensors->add_tensors();
+    tensor->set_name(first_tensor.name());
+    tensor->set_dtype(first_tensor.dtype());
+    *tensor->mutable_shape() = first_tensor.shape();
+    SetValues(*tensor, votes);
+  }
+}
+
+// Pool running members of ensemble node. Members never wait for each other, so that it never deadlocks.
+// max_concurrency 0 means no limit of server, and one thread is used then.
+static boost::asio::thread_pool& EnsemblePool() {
+  static boost::asio::thread_pool pool(std::max(GlobalConfig::Instance().server_config().max_concurrency, 1));
+  return pool;
+}
+
+// Record spans of preprocess, infer and postprocess of sampled request.
+static void TraceStages(Trace* trace,
+                        const std::string& node,
+                        int64_t preprocess_begin,
+                        int64_t preprocess_end,
+                        int64_t infer_end,
+                        int64_t postprocess_end) {
+  if (trace == nullptr) {
+    return;
+  }
+  trace->AddSpan("preprocess", preprocess_begin, preprocess_end, node);
+  trace->AddSpan("infer", preprocess_end, infer_end, node);
+  trace->AddSpan("postprocess", infer_end, postprocess_end, node);
+}
+
+void ModelNode::InferTensors(const Tensors& inputs, Tensors& outputs, GrpsContext& ctx) {
+  auto profiler_path = InferProfiler::Acquire(profile_counter_.get(), model_name_);
+  if (profiler_path.empty()) {
+    model_inferer_->Infer(inputs, outputs, ctx);
+  } else {
+    model_inferer_->InferWithProfiler(profiler_path, inputs, outputs, ctx);
+  }
+}
+
+void ModelNode::InferMessage(const ::grps::protos::v1::GrpsMessage& input,
+                             ::grps::protos::v1::GrpsMessage& output,
+                             GrpsContext& ctx) {
+  auto profiler_path = InferProfiler::Acquire(profile_counter_.get(), model_name_);
+  if (profiler_path.empty()) {
+    model_inferer_->Infer(input, output, ctx);
+  } else {
+    model_inferer_->InferWithProfiler(profiler_path, input, output, ctx);
+  }
+}
+
 void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                         ::grps::protos::v1::GrpsMessage& output,
                         netease::grps::GrpsContext& ctx) {
-  auto begin = butil::gettimeofday_us();
   ctx.set_converter(converter_.get());
   ctx.set_inferer(model_inferer_.get());
 
+  // Serve identical request by cache or in-flight request.
+  ResponseCache::Key cache_key;
+  bool cacheable = (cache_ || single_flight_) && ResponseCache::Cacheable(ctx);
+  std::unique_ptr<SingleFlight::Leader> leader;
+  if (cacheable) {
+    cache_key = ResponseCache::MakeKey(cache_ ? cache_->model_name() : single_flight_->model_name(), input);
+    if (cache_ && cache_->Lookup(cache_key, output)) {
+      return;
+    }
+    if (single_flight_ && single_flight_->Join(cache_key, output, ctx, leader)) {
+      return;
+    }
+  }
+
   if (batcher_) {
     batcher_->Infer(input, output, ctx);
+    if (cacheable && cache_ && !ctx.has_err()) {
+      cache_->Insert(cache_key, output);
+    }
     return;
   }
 
@@ -28,13 +380,14 @@ void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
     std::vector<std::pair<std::string, TensorWrapper>> inp_tensors;
     std::vector<std::pair<std::string, TensorWrapper>> out_tensors;
 
+    auto preprocess_begin = butil::gettimeofday_us();
     converter_->PreProcess(input, inp_tensors, ctx);
     if (ctx.has_err()) {
       return;
     }
     auto preprocess_end = butil::gettimeofday_us();
 
-    model_inferer_->Infer(inp_tensors, out_tensors, ctx);
+    InferTensors(inp_tensors, out_tensors, ctx);
     if (ctx.has_err()) {
       return;
     }
@@ -47,29 +400,60 @@ void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
     }
     auto postprocess_end = butil::gettimeofday_us();
 
-    LOG4(INFO, "Model(" << name_ << "), preprocess latency: " << preprocess_end - begin
+    StageMetrics::Observe(metrics_->preprocess, preprocess_end - preprocess_begin);
+    StageMetrics::Observe(metrics_->infer, infer_end - preprocess_end);
+    StageMetrics::Observe(metrics_->postprocess, postprocess_end - infer_end);
+    TraceStages(ctx.trace(), name_, preprocess_begin, preprocess_end, infer_end, postprocess_end);
+#ifdef GRPS_DEBUG
+    LOG4(INFO, "Model(" << name_ << "), preprocess latency: " << preprocess_end - preprocess_begin
                         << "us, infer latency: " << infer_end - preprocess_end
                         << "us, postprocess latency: " << postprocess_end - infer_end << "us");
+#endif
   } else {
+    auto infer_begin = butil::gettimeofday_us();
     output.Clear();
-    model_inferer_->Infer(input, output, ctx);
+    InferMessage(input, output, ctx);
     if (ctx.has_err()) {
       return;
     }
     auto infer_end = butil::gettimeofday_us();
-    LOG4(INFO, "Model(" << name_ << "), infer latency: " << infer_end - begin << "us");
+    StageMetrics::Observe(metrics_->infer, infer_end - infer_begin);
+    Trace::Record(ctx.trace(), "infer", infer_begin, infer_end, name_);
+#ifdef GRPS_DEBUG
+    LOG4(INFO, "Model(" << name_ << "), infer latency: " << infer_end - infer_begin << "us");
+#endif
+  }
+
+  if (cacheable && cache_) {
+    cache_->Insert(cache_key, output);
   }
 }
 
 void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                         ::grps::protos::v1::GrpsMessage& output,
                         const std::shared_ptr<GrpsContext>& ctx_sp) {
-  auto begin = butil::gettimeofday_us();
   ctx_sp->set_converter(converter_.get());
   ctx_sp->set_inferer(model_inferer_.get());
 
+  // Serve identical request by cache or in-flight request.
+  ResponseCache::Key cache_key;
+  bool cacheable = (cache_ || single_flight_) && ResponseCache::Cacheable(*ctx_sp);
+  std::unique_ptr<SingleFlight::Leader> leader;
+  if (cacheable) {
+    cache_key = ResponseCache::MakeKey(cache_ ? cache_->model_name() : single_flight_->model_name(), input);
+    if (cache_ && cache_->Lookup(cache_key, output)) {
+      return;
+    }
+    if (single_flight_ && single_flight_->Join(cache_key, output, *ctx_sp, leader)) {
+      return;
+    }
+  }
+
   if (batcher_) {
     batcher_->Infer(input, output, ctx_sp);
+    if (cacheable && cache_ && !ctx_sp->has_err()) {
+      cache_->Insert(cache_key, output);
+    }
     return;
   }
 
@@ -77,13 +461,14 @@ void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
     std::vector<std::pair<std::string, TensorWrapper>> inp_tensors;
     std::vector<std::pair<std::string, TensorWrapper>> out_tensors;
 
+    auto preprocess_begin = butil::gettimeofday_us();
     converter_->PreProcess(input, inp_tensors, *ctx_sp);
     if (ctx_sp->has_err()) {
       return;
     }
     auto preprocess_end = butil::gettimeofday_us();
 
-    model_inferer_->Infer(inp_tensors, out_tensors, *ctx_sp);
+    InferTensors(inp_tensors, out_tensors, *ctx_sp);
     if (ctx_sp->has_err()) {
       return;
     }
@@ -96,57 +481,754 @@ void ModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
     }
     auto postprocess_end = butil::gettimeofday_us();
 
-    LOG4(INFO, "Model(" << name_ << "), preprocess latency: " << preprocess_end - begin
+    StageMetrics::Observe(metrics_->preprocess, preprocess_end - preprocess_begin);
+    StageMetrics::Observe(metrics_->infer, infer_end - preprocess_end);
+    StageMetrics::Observe(metrics_->postprocess, postprocess_end - infer_end);
+    TraceStages(ctx_sp->trace(), name_, preprocess_begin, preprocess_end, infer_end, postprocess_end);
+#ifdef GRPS_DEBUG
+    LOG4(INFO, "Model(" << name_ << "), preprocess latency: " << preprocess_end - preprocess_begin
                         << "us, infer latency: " << infer_end - preprocess_end
                         << "us, postprocess latency: " << postprocess_end - infer_end << "us");
+#endif
   } else {
+    auto infer_begin = butil::gettimeofday_us();
     output.Clear();
-    model_inferer_->Infer(input, output, *ctx_sp);
+    InferMessage(input, output, *ctx_sp);
     if (ctx_sp->has_err()) {
       return;
     }
     auto infer_end = butil::gettimeofday_us();
-    LOG4(INFO, "Model(" << name_ << "), infer latency: " << infer_end - begin << "us");
+    StageMetrics::Observe(metrics_->infer, infer_end - infer_begin);
+    Trace::Record(ctx_sp->trace(), "infer", infer_begin, infer_end, name_);
+#ifdef GRPS_DEBUG
+    LOG4(INFO, "Model(" << name_ << "), infer latency: " << infer_end - infer_begin << "us");
+#endif
+  }
+
+  if (cacheable && cache_) {
+    cache_->Insert(cache_key, output);
   }
 }
 
 void ModelNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                         std::vector<::grps::protos::v1::GrpsMessage>& output,
-                        GrpsContext& ctx) {}
+                        GrpsContext& ctx) {
+  ProcessParts(input, output, ctx);
+}
 
 void ModelNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                         std::vector<::grps::protos::v1::GrpsMessage>& output,
-                        const std::shared_ptr<GrpsContext>& ctx_sp) {}
+                        const std::shared_ptr<GrpsContext>& ctx_sp) {
+  ProcessParts(input, output, *ctx_sp);
+}
+
+void ModelNode::PreProcess(const ::grps::protos::v1::GrpsMessage& input, Tensors& tensors, GrpsContext& ctx) {
+  auto begin = butil::gettimeofday_us();
+  ctx.set_converter(converter_.get());
+  ctx.set_inferer(model_inferer_.get());
+  converter_->PreProcess(input, tensors, ctx);
+  auto end = butil::gettimeofday_us();
+  StageMetrics::Observe(metrics_->preprocess, end - begin);
+  Trace::Record(ctx.trace(), "preprocess", begin, end, name_);
+}
+
+void ModelNode::Infer(const Tensors& inputs, Tensors& outputs, GrpsContext& ctx) {
+  auto begin = butil::gettimeofday_us();
+  ctx.set_converter(converter_.get());
+  ctx.set_inferer(model_inferer_.get());
+  InferTensors(inputs, outputs, ctx);
+  auto end = butil::gettimeofday_us();
+  StageMetrics::Observe(metrics_->infer, end - begin);
+  Trace::Record(ctx.trace(), "infer", begin, end, name_);
+#ifdef GRPS_DEBUG
+  LOG4(INFO, "Model(" << name_ << "), infer latency: " << butil::gettimeofday_us() - begin << "us");
+#endif
+}
+
+void ModelNode::PostProcess(const Tensors& tensors, ::grps::protos::v1::GrpsMessage& output, GrpsContext& ctx) {
+  auto begin = butil::gettimeofday_us();
+  ctx.set_converter(converter_.get());
+  ctx.set_inferer(model_inferer_.get());
+  output.Clear();
+  converter_->PostProcess(tensors, output, ctx);
+  auto end = butil::gettimeofday_us();
+  StageMetrics::Observe(metrics_->postprocess, end - begin);
+  Trace::Record(ctx.trace(), "postprocess", begin, end, name_);
+}
+
+void ModelNode::ProcessParts(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                             std::vector<::grps::protos::v1::GrpsMessage>& output,
+                             GrpsContext& ctx) {
+  if (input.empty()) {
+    output.clear();
+    return;
+  }
+
+  // Input may be the same vector as output in sequential dag, so results are written to a new vector.
+  std::vector<GrpsMessage> results(input.size());
+  std::vector<std::shared_ptr<GrpsContext>> part_ctxs(input.size());
+  std::vector<std::exception_ptr> errors(input.size());
+  ParallelFor(input.size(), [&](size_t i) {
+    try {
+      part_ctxs[i] = GrpsContext::AcquireChild(ctx, &input[i]);
+      Process(input[i], results[i], part_ctxs[i]);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  });
+
+  for (size_t i = 0; i < input.size(); ++i) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+    if (part_ctxs[i]->has_err()) {
+      ctx.set_err_msg(part_ctxs[i]->err_msg());
+      return;
+    }
+  }
+  output = std::move(results);
+}
+
+RouterNode::Metrics::Metrics(const std::string& model_name)
+    : latency_avg(MONITOR_REGISTER(std::string(MODEL_LATENCY_AVG) + "{model=" + model_name + "}", AggType::kAvg))
+    , latency_max(MONITOR_REGISTER(std::string(MODEL_LATENCY_MAX) + "{model=" + model_name + "}", AggType::kMax))
+    , fail_rate(MONITOR_REGISTER(std::string(MODEL_FAIL_RATE) + "{model=" + model_name + "}", AggType::kAvg)) {}
+
+void RouterNode::Metrics::Observe(int64_t latency_us, bool failed) const {
+  MONITOR_AVG(latency_avg, float(latency_us) / 1000);
+  MONITOR_MAX(latency_max, float(latency_us) / 1000);
+  MONITOR_AVG(fail_rate, failed ? 100 : 0);
+}
+
+RouterNode::RouterNode(const std::string& name,
+                       std::vector<Target> targets,
+                       Target shadow,
+                       float shadow_ratio,
+                       std::shared_ptr<ShadowPool> shadow_pool)
+    : Node(name)
+    , targets_(std::move(targets))
+    , shadow_(std::move(shadow))
+    , shadow_ratio_(shadow_ratio)
+    , shadow_pool_(std::move(shadow_pool)) {
+  for (const auto& target : targets_) {
+    total_weight_ += target.weight;
+    targets_metrics_.emplace_back(target.model_name);
+  }
+  if (total_weight_ <= 0) {
+    throw NodeException("Router node " + name_ + " should have at least one version with positive weight.");
+  }
+  if (shadow_.node) {
+    if (!shadow_pool_) {
+      throw NodeException("Router node " + name_ + " has shadow version but no shadow pool.");
+    }
+    shadow_metrics_ = std::make_shared<const Metrics>(shadow_.model_name);
+    shadow_drop_metric_ = MONITOR_REGISTER(std::string(SHADOW_DROP_COUNT) + "{model=" + shadow_.model_name + "}",
+                                           AggType::kInc);
+  }
+}
+
+size_t RouterNode::Pick() const {
+  auto point = int(butil::fast_rand_less_than(total_weight_));
+  for (size_t i = 0; i < targets_.size(); ++i) {
+    if (point < targets_[i].weight) {
+      return i;
+    }
+    point -= targets_[i].weight;
+  }
+  return targets_.size() - 1;
+}
+
+void RouterNode::TryShadow(const ::grps::protos::v1::GrpsMessage& input, GrpsContext& ctx) {
+  // Streaming and customized http requests interact with client through context, cannot be mirrored.
+  if (!shadow_.node || butil::fast_rand_double() >= shadow_ratio_ || !ResponseCache::Cacheable(ctx)) {
+    return;
+  }
+
+  auto shadow_input = std::make_shared<::grps::protos::v1::GrpsMessage>(input);
+  // Shadow request outlives the request, so only trace(kept alive) is shared instead of controllers.
+  auto trace = ctx.trace() != nullptr ? ctx.trace()->shared_from_this() : nullptr;
+  bool posted = shadow_pool_->TryPost([node = shadow_.node, metrics = shadow_metrics_, shadow_input, trace]() {
+    auto begin = butil::gettimeofday_us();
+    auto shadow_ctx = GrpsContext::Acquire(shadow_input.get());
+    shadow_ctx->set_trace(trace.get());
+    ::grps::protos::v1::GrpsMessage shadow_output;
+    bool failed = false;
+    try {
+      // Shadow version with batching infers on its batcher workers, which are not low priority.
+      node->Process(*shadow_input, shadow_output, shadow_ctx);
+      failed = shadow_ctx->has_err();
+    } catch (const std::exception& e) {
+      LOG4(WARN, "Shadow request failed: " << e.what());
+      failed = true;
+    }
+    metrics->Observe(butil::gettimeofday_us() - begin, failed);
+  });
+  if (!posted) {
+    MONITOR_INC(shadow_drop_metric_, 1);
+  }
+}
+
+void RouterNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                         ::grps::protos::v1::GrpsMessage& output,
+                         GrpsContext& ctx) {
+  // Input may be the same message as output in sequential dag, so mirror it before primary infer.
+  TryShadow(input, ctx);
+
+  auto idx = Pick();
+  auto begin = butil::gettimeofday_us();
+  try {
+    targets_[idx].node->Process(input, output, ctx);
+  } catch (const std::exception& e) {
+    targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, true);
+    throw;
+  }
+  targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, ctx.has_err());
+}
+
+void RouterNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                         ::grps::protos::v1::GrpsMessage& output,
+                         const std::shared_ptr<GrpsContext>& ctx_sp) {
+  TryShadow(input, *ctx_sp);
+
+  auto idx = Pick();
+  auto begin = butil::gettimeofday_us();
+  try {
+    targets_[idx].node->Process(input, output, ctx_sp);
+  } catch (const std::exception& e) {
+    targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, true);
+    throw;
+  }
+  targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, ctx_sp->has_err());
+}
+
+void RouterNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                         std::vector<::grps::protos::v1::GrpsMessage>& output,
+                         GrpsContext& ctx) {
+  // Sub-requests of one request are routed to the same version, and not mirrored.
+  auto idx = Pick();
+  auto begin = butil::gettimeofday_us();
+  try {
+    targets_[idx].node->Process(input, output, ctx);
+  } catch (const std::exception& e) {
+    targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, true);
+    throw;
+  }
+  targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, ctx.has_err());
+}
+
+void RouterNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                         std::vector<::grps::protos::v1::GrpsMessage>& output,
+                         const std::shared_ptr<GrpsContext>& ctx_sp) {
+  auto idx = Pick();
+  auto begin = butil::gettimeofday_us();
+  try {
+    targets_[idx].node->Process(input, output, ctx_sp);
+  } catch (const std::exception& e) {
+    targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, true);
+    throw;
+  }
+  targets_metrics_[idx].Observe(butil::gettimeofday_us() - begin, ctx_sp->has_err());
+}
+
+void MergerNode::Merge(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                       ::grps::protos::v1::GrpsMessage& output,
+                       GrpsContext& ctx) const {
+  output.Clear();
+  if (input.empty()) {
+    return;
+  }
+
+  if (input[0].has_str_data()) {
+    if (reduce_ != Reduce::kConcat) {
+      throw NodeException("Merger node " + name_ + " only supports concat reduce of str_data.");
+    }
+    std::string text;
+    for (const auto& part : input) {
+      text += part.str_data();
+    }
+    output.set_str_data(std::move(text));
+    return;
+  }
+  if (input[0].has_gmap()) {
+    if (reduce_ != Reduce::kConcat) {
+      throw NodeException("Merger node " + name_ + " only supports concat reduce of gmap.");
+    }
+    for (const auto& part : input) {
+      output.mutable_gmap()->MergeFrom(part.gmap());
+    }
+    return;
+  }
+  if (!input[0].has_gtensors()) {
+    throw NodeException("Merger node " + name_ + " only supports str_data, gmap or gtensors.");
+  }
+
+  if (reduce_ == Reduce::kConcat) {
+    ConcatTensors(input, output);
+  } else if (reduce_ == Reduce::kMean) {
+    WeightedSumTensors(input, std::vector<double>(input.size(), 1.0 / double(input.size())), output);
+  } else {
+    GrpsMessage concat;
+    ConcatTensors(input, concat);
+    const auto& tensors = concat.gtensors().tensors();
+    int score_idx = 0;
+    if (!score_tensor_.empty()) {
+      score_idx = -1;
+      for (int t = 0; t < tensors.size(); ++t) {
+        if (tensors.Get(t).name() == score_tensor_) {
+          score_idx = t;
+        }
+      }
+      if (score_idx < 0) {
+        throw NodeException("Score tensor " + score_tensor_ + " of merger node " + name_ + " not found.");
+      }
+    }
+    if (tensors.empty()) {
+      return;
+    }
+
+    // Keep k rows with the highest score(first value of row of score tensor) of all tensors.
+    const auto& score = tensors.Get(score_idx);
+    auto rows = RowNum(score);
+    auto row_size = RowSize(score);
+    std::vector<double> scores(rows);
+    for (size_t r = 0; r < rows; ++r) {
+      scores[r] = ValueAt(score, r * row_size);
+    }
+    auto selected = RowRange(0, rows);
+    auto k = std::min<size_t>(k_, rows);
+    std::partial_sort(selected.begin(), selected.begin() + long(k), selected.end(),
+                      [&scores](size_t lhs, size_t rhs) { return scores[lhs] > scores[rhs]; });
+    selected.resize(k);
+
+    for (const auto& src : tensors) {
+      if (RowNum(src) != rows) {
+        throw NodeException("Rows of tensor " + src.name() + " mismatch score tensor.");
+      }
+      auto* tensor = output.mutable_gtensors()->add_tensors();
+      tensor->set_name(src.name());
+      tensor->set_dtype(src.dtype());
+      tensor->add_shape(k);
+      for (int d = 1; d < src.shape_size(); ++d) {
+        tensor->add_shape(src.shape(d));
+      }
+      AppendRows(src, selected, *tensor);
+    }
+  }
+}
 
 void MergerNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                          ::grps::protos::v1::GrpsMessage& output,
-                         GrpsContext& ctx) {}
+                         GrpsContext& ctx) {
+  throw NodeException("Merger node " + name_ + " should follow a splitter node.");
+}
 
 void MergerNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                          ::grps::protos::v1::GrpsMessage& output,
-                         const std::shared_ptr<GrpsContext>& ctx_sp) {}
+                         const std::shared_ptr<GrpsContext>& ctx_sp) {
+  throw NodeException("Merger node " + name_ + " should follow a splitter node.");
+}
 
 void MergerNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                          std::vector<::grps::protos::v1::GrpsMessage>& output,
-                         GrpsContext& ctx) {}
+                         GrpsContext& ctx) {
+  GrpsMessage merged;
+  Merge(input, merged, ctx);
+  output.resize(1);
+  output[0] = std::move(merged);
+}
 
 void MergerNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                          std::vector<::grps::protos::v1::GrpsMessage>& output,
-                         const std::shared_ptr<GrpsContext>& ctx_sp) {}
+                         const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+void SplitterNode::Split(const ::grps::protos::v1::GrpsMessage& input,
+                         std::vector<::grps::protos::v1::GrpsMessage>& output,
+                         GrpsContext& ctx) const {
+  output.clear();
+  auto chunk_size = size_t(chunk_size_);
+  if (type_ == Type::kText) {
+    if (!input.has_str_data()) {
+      throw NodeException("Splitter node " + name_ + " requires str_data input.");
+    }
+    const auto& text = input.str_data();
+    size_t begin = 0;
+    do {
+      auto end = std::min(begin + chunk_size, text.size());
+      // Not cut in the middle of utf-8 character(continuation bytes are 10xxxxxx).
+      while (end < text.size() && end > begin && (uint8_t(text[end]) & 0xC0) == 0x80) {
+        --end;
+      }
+      if (end == begin) {
+        // Chunk size is smaller than one character.
+        end = begin + 1;
+        while (end < text.size() && (uint8_t(text[end]) & 0xC0) == 0x80) {
+          ++end;
+        }
+      }
+      output.emplace_back().set_str_data(text.substr(begin, end - begin));
+      begin = end;
+    } while (begin < text.size());
+    return;
+  }
+
+  if (!input.has_gtensors() || input.gtensors().tensors_size() == 0) {
+    throw NodeException("Splitter node " + name_ + " requires gtensors input.");
+  }
+  const auto& tensors = input.gtensors().tensors();
+  auto rows = RowNum(tensors.Get(0));
+  for (const auto& tensor : tensors) {
+    if (RowNum(tensor) != rows) {
+      throw NodeException("Splitter node " + name_ + " requires the same first dimension of all tensors.");
+    }
+  }
+  for (size_t begin = 0; begin < rows; begin += chunk_size) {
+    auto end = std::min(begin + chunk_size, rows);
+    auto row_range = RowRange(begin, end);
+    auto* part_tensors = output.emplace_back().mutable_gtensors();
+    for (const auto& src : tensors) {
+      auto* tensor = part_tensors->add_tensors();
+      tensor->set_name(src.name());
+      tensor->set_dtype(src.dtype());
+      tensor->add_shape(end - begin);
+      for (int d = 1; d < src.shape_size(); ++d) {
+        tensor->add_shape(src.shape(d));
+      }
+      AppendRows(src, row_range, *tensor);
+    }
+  }
+}
 
 void SplitterNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                            ::grps::protos::v1::GrpsMessage& output,
-                           GrpsContext& ctx) {}
+                           GrpsContext& ctx) {
+  throw NodeException("Splitter node " + name_ + " should be followed by a merger node.");
+}
 
 void SplitterNode::Process(const ::grps::protos::v1::GrpsMessage& input,
                            ::grps::protos::v1::GrpsMessage& output,
-                           const std::shared_ptr<GrpsContext>& ctx_sp) {}
+                           const std::shared_ptr<GrpsContext>& ctx_sp) {
+  throw NodeException("Splitter node " + name_ + " should be followed by a merger node.");
+}
 
 void SplitterNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                            std::vector<::grps::protos::v1::GrpsMessage>& output,
-                           GrpsContext& ctx) {}
+                           GrpsContext& ctx) {
+  std::vector<GrpsMessage> parts;
+  for (const auto& message : input) {
+    std::vector<GrpsMessage> message_parts;
+    Split(message, message_parts, ctx);
+    std::move(message_parts.begin(), message_parts.end(), std::back_inserter(parts));
+  }
+  output = std::move(parts);
+}
 
 void SplitterNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                            std::vector<::grps::protos::v1::GrpsMessage>& output,
-                           const std::shared_ptr<GrpsContext>& ctx_sp) {}
+                           const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+ConditionNode::ConditionNode(const std::string& name,
+                             Source source,
+                             std::string key,
+                             Op op,
+                             double value,
+                             Action action,
+                             std::string target,
+                             Forward forward)
+    : Node(name)
+    , source_(source)
+    , key_(std::move(key))
+    , op_(op)
+    , value_(value)
+    , action_(action)
+    , target_(std::move(target))
+    , forward_(forward) {
+  hit_rate_metric_ = MONITOR_REGISTER(std::string(CONDITION_HIT_RATE) + "{node=" + name_ + "}", AggType::kAvg);
+}
+
+double ConditionNode::Extract(const ::grps::protos::v1::GrpsMessage& input) const {
+  if (source_ == Source::kGmap) {
+    const auto& gmap = input.gmap();
+    if (auto iter = gmap.s_f().find(key_); iter != gmap.s_f().end()) {
+      return iter->second;
+    }
+    if (auto iter = gmap.s_d().find(key_); iter != gmap.s_d().end()) {
+      return iter->second;
+    }
+    if (auto iter = gmap.s_i32().find(key_); iter != gmap.s_i32().end()) {
+      return iter->second;
+    }
+    if (auto iter = gmap.s_i64().find(key_); iter != gmap.s_i64().end()) {
+      return double(iter->second);
+    }
+    throw NodeException("Condition node " + name_ + " cannot find numeric gmap value of key " + key_ + ".");
+  }
+
+  for (const auto& tensor : input.gtensors().tensors()) {
+    if (!key_.empty() && tensor.name() != key_) {
+      continue;
+    }
+    size_t size = RowSize(tensor) * RowNum(tensor);
+    if (size == 0) {
+      throw NodeException("Condition node " + name_ + " got empty tensor " + tensor.name() + ".");
+    }
+    double max = ValueAt(tensor, 0);
+    for (size_t i = 1; i < size; ++i) {
+      max = std::max(max, ValueAt(tensor, i));
+    }
+    return max;
+  }
+  throw NodeException("Condition node " + name_ + " cannot find tensor " + key_ + ".");
+}
+
+bool ConditionNode::Evaluate(const ::grps::protos::v1::GrpsMessage& input) const {
+  double value = Extract(input);
+  bool hit = false;
+  switch (op_) {
+    case Op::kGt:
+      hit = value > value_;
+      break;
+    case Op::kGe:
+      hit = value >= value_;
+      break;
+    case Op::kLt:
+      hit = value < value_;
+      break;
+    case Op::kLe:
+      hit = value <= value_;
+      break;
+    case Op::kEq:
+      hit = value == value_;
+      break;
+    case Op::kNe:
+      hit = value != value_;
+      break;
+  }
+  MONITOR_AVG(hit_rate_metric_, hit ? 100 : 0);
+  return hit;
+}
+
+void ConditionNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                            ::grps::protos::v1::GrpsMessage& output,
+                            GrpsContext& ctx) {
+  if (&input != &output) {
+    output.CopyFrom(input);
+  }
+}
+
+void ConditionNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                            ::grps::protos::v1::GrpsMessage& output,
+                            const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+void ConditionNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                            std::vector<::grps::protos::v1::GrpsMessage>& output,
+                            GrpsContext& ctx) {
+  if (&input != &output) {
+    output = input;
+  }
+}
+
+void ConditionNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                            std::vector<::grps::protos::v1::GrpsMessage>& output,
+                            const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+EnsembleNode::EnsembleNode(
+  const std::string& name, std::vector<Member> members, Reduce reduce, int64_t timeout_ms, int min_members)
+    : Node(name)
+    , members_(std::move(members))
+    , reduce_(reduce)
+    , timeout_us_(timeout_ms * 1000)
+    , min_members_(min_members) {
+  if (members_.empty()) {
+    throw NodeException("Ensemble node " + name_ + " has no member.");
+  }
+  for (const auto& member : members_) {
+    total_weight_ += member.weight;
+    drop_metrics_.emplace_back(
+      MONITOR_REGISTER(std::string(ENSEMBLE_DROP_COUNT) + "{model=" + member.model + "}", AggType::kInc));
+  }
+}
+
+void EnsembleNode::RunMember(RunState& state, size_t idx, Node& node) {
+  std::string err_msg;
+  try {
+    auto member_ctx = state.parent != nullptr ? GrpsContext::AcquireChild(*state.parent, state.input)
+                                              : GrpsContext::Acquire(state.input);
+    member_ctx->set_trace(state.trace.get());
+    node.Process(*state.input, state.outputs[idx], member_ctx);
+    if (member_ctx->has_err()) {
+      err_msg = member_ctx->err_msg().empty() ? "failed." : member_ctx->err_msg();
+    }
+  } catch (const std::exception& e) {
+    err_msg = e.what();
+  }
+
+  std::lock_guard<std::mutex> lock(state.mtx);
+  state.err_msgs[idx] = std::move(err_msg);
+  state.done[idx] = true;
+  if (--state.remaining == 0) {
+    state.cv.notify_all();
+  }
+}
+
+void EnsembleNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                           ::grps::protos::v1::GrpsMessage& output,
+                           GrpsContext& ctx) {
+  auto state = std::make_shared<RunState>();
+  if (timeout_us_ > 0) {
+    // Members exceeding timeout still read input after node returns.
+    state->input_holder = std::make_shared<GrpsMessage>(input);
+    state->input = state->input_holder.get();
+  } else {
+    state->input = &input;
+    state->parent = &ctx;
+  }
+  state->trace = ctx.trace() != nullptr ? ctx.trace()->shared_from_this() : nullptr;
+  auto num = members_.size();
+  state->outputs.resize(num);
+  state->err_msgs.resize(num);
+  state->done.assign(num, false);
+  state->remaining = num;
+
+  // Run the first member in current thread when waiting for all members.
+  size_t first = timeout_us_ > 0 ? 0 : 1;
+  for (size_t i = first; i < num; ++i) {
+    boost::asio::post(EnsemblePool(), [state, i, node = members_[i].node] { RunMember(*state, i, *node); });
+  }
+  if (first == 1) {
+    RunMember(*state, 0, *members_[0].node);
+  }
+
+  // Collect outputs of succeeded members, outputs of members not done are still being written and are left alone.
+  std::vector<GrpsMessage> outputs;
+  std::vector<double> weights;
+  std::vector<size_t> dropped;
+  std::string err_msg;
+  {
+    std::unique_lock<std::mutex> lock(state->mtx);
+    auto all_done = [&state] { return state->remaining == 0; };
+    if (timeout_us_ > 0) {
+      state->cv.wait_for(lock, std::chrono::microseconds(timeout_us_), all_done);
+    } else {
+      state->cv.wait(lock, all_done);
+    }
+    for (size_t i = 0; i < num; ++i) {
+      if (state->done[i] && state->err_msgs[i].empty()) {
+        outputs.emplace_back(std::move(state->outputs[i]));
+        weights.emplace_back(members_[i].weight);
+        continue;
+      }
+      dropped.emplace_back(i);
+      if (err_msg.empty()) {
+        err_msg = "member " + members_[i].model + " " + (state->done[i] ? state->err_msgs[i] : "timeout.");
+      }
+    }
+  }
+
+  for (auto idx : dropped) {
+    MONITOR_INC(drop_metrics_[idx], 1);
+  }
+  if (int(outputs.size()) < min_members_) {
+    ctx.set_err_msg("Ensemble node " + name_ + " has only " + std::to_string(outputs.size()) +
+                    " succeeded members, " + err_msg);
+    return;
+  }
+#ifdef GRPS_DEBUG
+  if (!dropped.empty()) {
+    LOG4(INFO, "Ensemble node " << name_ << " dropped " << dropped.size() << " members, " << err_msg);
+  }
+#endif
+  Aggregate(outputs, weights, output);
+}
+
+void EnsembleNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                           ::grps::protos::v1::GrpsMessage& output,
+                           const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+void EnsembleNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                           std::vector<::grps::protos::v1::GrpsMessage>& output,
+                           GrpsContext& ctx) {
+  std::vector<GrpsMessage> results(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    Process(input[i], results[i], ctx);
+    if (ctx.has_err()) {
+      return;
+    }
+  }
+  output = std::move(results);
+}
+
+void EnsembleNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                           std::vector<::grps::protos::v1::GrpsMessage>& output,
+                           const std::shared_ptr<GrpsContext>& ctx_sp) {
+  Process(input, output, *ctx_sp);
+}
+
+void EnsembleNode::Aggregate(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                             const std::vector<double>& weights,
+                             ::grps::protos::v1::GrpsMessage& output) const {
+  output.Clear();
+  if (input[0].has_str_data()) {
+    if (reduce_ == Reduce::kConcat) {
+      std::string text;
+      for (const auto& message : input) {
+        text += message.str_data();
+      }
+      output.set_str_data(std::move(text));
+    } else if (reduce_ == Reduce::kVote) {
+      std::vector<std::string> candidates;
+      for (const auto& message : input) {
+        candidates.emplace_back(message.str_data());
+      }
+      output.set_str_data(std::move(candidates[Majority(candidates, weights)]));
+    } else {
+      throw NodeException("Ensemble node " + name_ + " only supports concat or vote reduce of str_data.");
+    }
+    return;
+  }
+  if (input[0].has_gmap()) {
+    if (reduce_ != Reduce::kConcat) {
+      throw NodeException("Ensemble node " + name_ + " only supports concat reduce of gmap.");
+    }
+    for (const auto& message : input) {
+      output.mutable_gmap()->MergeFrom(message.gmap());
+    }
+    return;
+  }
+  if (!input[0].has_gtensors()) {
+    throw NodeException("Ensemble node " + name_ + " only supports str_data, gmap or gtensors.");
+  }
+
+  switch (reduce_) {
+    case Reduce::kMean:
+      WeightedSumTensors(input, std::vector<double>(input.size(), 1.0 / double(input.size())), output);
+      break;
+    case Reduce::kWeightedSum: {
+      // Redistribute weights of dropped members, so that degraded result keeps the same scale.
+      double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+      double scale = sum > 0 ? total_weight_ / sum : 0;
+      std::vector<double> scaled;
+      for (auto weight : weights) {
+        scaled.emplace_back(weight * scale);
+      }
+      WeightedSumTensors(input, scaled, output);
+      break;
+    }
+    case Reduce::kVote:
+      VoteTensors(input, weights, output);
+      break;
+    case Reduce::kConcat:
+      ConcatTensors(input, output);
+      break;
+  }
+}
 } // namespace netease::grps
@@ -7,14 +7,22 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "batching/batcher.h"
+#include "cache/response_cache.h"
+#include "cache/single_flight.h"
 #include "context/context.h"
 #include "converter/converter.h"
+#include "dag/shadow_pool.h"
 #include "grps.pb.h"
+#include "model_infer/infer_profiler.h"
 #include "model_infer/inferer.h"
+#include "monitor/monitor.h"
+#include "monitor/stage_metrics.h"
 
 namespace netease::grps {
 class Node {
@@ -62,17 +70,55 @@ protected:
 // Model node, which means the node is a model.
 class ModelNode : public Node {
 public:
+  using Tensors = std::vector<std::pair<std::string, TensorWrapper>>;
+
   explicit ModelNode(const std::string& name)
-      : Node(name), model_inferer_(nullptr), converter_(nullptr), batcher_(nullptr) {}
+      : Node(name)
+      , model_inferer_(nullptr)
+      , converter_(nullptr)
+      , batcher_(nullptr)
+      , cache_(nullptr)
+      , single_flight_(nullptr) {}
 
+  /**
+   * @brief Model node constructor.
+   * @param name: Node name.
+   * @param model_name: Model name with `name-version` format, used as metrics label.
+   */
   ModelNode(const std::string& name,
+            const std::string& model_name,
             const std::shared_ptr<ModelInferer>& model_inferer,
             const std::shared_ptr<Converter>& converter,
-            const std::shared_ptr<Batcher>& batcher)
-      : Node(name), model_inferer_(model_inferer), converter_(converter), batcher_(batcher) {}
+            const std::shared_ptr<Batcher>& batcher,
+            const std::shared_ptr<ResponseCache>& cache = nullptr,
+            const std::shared_ptr<SingleFlight>& single_flight = nullptr)
+      : Node(name)
+      , model_name_(model_name)
+      , model_inferer_(model_inferer)
+      , converter_(converter)
+      , batcher_(batcher)
+      , cache_(cache)
+      , single_flight_(single_flight) {
+    // Stages of batched requests are recorded by batcher with batch size label.
+    if (!batcher_) {
+      metrics_ = std::make_unique<StageMetrics>("model=" + model_name + ",node=" + name, converter_ != nullptr);
+    }
+    // Batched requests are profiled by batcher.
+    if (!batcher_ && model_inferer_ && model_inferer_->SupportProfiler()) {
+      profile_counter_ = InferProfiler::Instance().Register(model_name);
+    }
+  }
 
   ~ModelNode() override = default;
 
+  // If tensors can be handed off to or from this node directly. Batcher, cache and coalescing work on messages.
+  [[nodiscard]] bool SupportTensorHandoff() const { return converter_ && !batcher_ && !cache_ && !single_flight_; }
+
+  // Steps of tensor hand-off between model nodes in sequential dag, converters between them are skipped.
+  void PreProcess(const ::grps::protos::v1::GrpsMessage& input, Tensors& tensors, GrpsContext& ctx);
+  void Infer(const Tensors& inputs, Tensors& outputs, GrpsContext& ctx);
+  void PostProcess(const Tensors& tensors, ::grps::protos::v1::GrpsMessage& output, GrpsContext& ctx);
+
   void Process(const ::grps::protos::v1::GrpsMessage& input,
                ::grps::protos::v1::GrpsMessage& output,
                GrpsContext& ctx) override;
@@ -90,17 +136,120 @@ public:
                const std::shared_ptr<GrpsContext>& ctx_sp) override;
 
 private:
+  // Process sub-requests in parallel, each with its own context(and through batcher if configured).
+  void ProcessParts(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                    std::vector<::grps::protos::v1::GrpsMessage>& output,
+                    GrpsContext& ctx);
+
+  // Infer by model inferer, with profiler if current request is profiled.
+  void InferTensors(const Tensors& inputs, Tensors& outputs, GrpsContext& ctx);
+  void InferMessage(const ::grps::protos::v1::GrpsMessage& input,
+                    ::grps::protos::v1::GrpsMessage& output,
+                    GrpsContext& ctx);
+
+  std::string model_name_;
   std::shared_ptr<ModelInferer> model_inferer_;
   std::shared_ptr<Converter> converter_;
   std::shared_ptr<Batcher> batcher_;
+  std::shared_ptr<ResponseCache> cache_;
+  std::shared_ptr<SingleFlight> single_flight_;
+  std::unique_ptr<StageMetrics> metrics_; // Null if no inferer or through batcher.
+  std::shared_ptr<InferProfiler::Counter> profile_counter_; // Null if profiler not supported or through batcher.
 };
 
-// TODO(zhaochaochao): Add merger node.
+// Router node, which routes requests to versions of the same model by weight, and mirrors part of requests to a shadow
+// version asynchronously. Results of shadow version are discarded, only its metrics are reported.
+class RouterNode : public Node {
+public:
+  struct Target {
+    std::string model_name; // Model name with `name-version` format.
+    std::shared_ptr<Node> node;
+    int weight = 0;
+  };
+
+  /**
+   * @brief Router node constructor.
+   * @param name: Node name.
+   * @param targets: Versions to route, at least one target should have positive weight.
+   * @param shadow: Shadow version, null node means no shadow.
+   * @param shadow_ratio: Ratio of requests mirrored to shadow version.
+   * @param shadow_pool: Pool to run shadow requests.
+   */
+  RouterNode(const std::string& name,
+             std::vector<Target> targets,
+             Target shadow,
+             float shadow_ratio,
+             std::shared_ptr<ShadowPool> shadow_pool);
+  ~RouterNode() override = default;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  // Metrics names of one version.
+  struct Metrics {
+    MetricsAgg* latency_avg;
+    MetricsAgg* latency_max;
+    MetricsAgg* fail_rate;
+    explicit Metrics(const std::string& model_name);
+    void Observe(int64_t latency_us, bool failed) const;
+  };
+
+  std::vector<Target> targets_;
+  std::vector<Metrics> targets_metrics_;
+  int total_weight_ = 0;
+  Target shadow_;
+  std::shared_ptr<const Metrics> shadow_metrics_; // Shared with pending shadow requests.
+  float shadow_ratio_;
+  std::shared_ptr<ShadowPool> shadow_pool_;
+  MetricsAgg* shadow_drop_metric_ = nullptr;
+
+  // Pick target index by weight.
+  size_t Pick() const;
+  // Mirror input to shadow version if sampled.
+  void TryShadow(const ::grps::protos::v1::GrpsMessage& input, GrpsContext& ctx);
+};
+
+// Merger node, which gathers outputs of sub-requests split by splitter node into one output.
 class MergerNode : public Node {
 public:
-  explicit MergerNode(const std::string& name) : Node(name) {}
+  enum class Reduce {
+    kConcat = 0, // Concat gtensors along the first dimension, or str_data.
+    kMean = 1,   // Element-wise mean of gtensors.
+    kTopK = 2,   // Concat gtensors and keep k rows with the highest score.
+  };
+
+  /**
+   * @brief Merger node constructor.
+   * @param name: Node name.
+   * @param reduce: Reduce of outputs.
+   * @param k: Rows kept by topk.
+   * @param score_tensor: Tensor used as score by topk, its first value of each row is the score. Empty means the
+   * first tensor.
+   */
+  MergerNode(const std::string& name, Reduce reduce, int k = 1, std::string score_tensor = "")
+      : Node(name), reduce_(reduce), k_(k), score_tensor_(std::move(score_tensor)) {}
   ~MergerNode() override = default;
 
+  // Merge outputs of sub-requests.
+  void Merge(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+             ::grps::protos::v1::GrpsMessage& output,
+             GrpsContext& ctx) const;
+
+  // Not supported, merger node should follow a splitter node.
   void Process(const ::grps::protos::v1::GrpsMessage& input,
                ::grps::protos::v1::GrpsMessage& output,
                GrpsContext& ctx) override;
@@ -109,6 +258,7 @@ public:
                ::grps::protos::v1::GrpsMessage& output,
                const std::shared_ptr<GrpsContext>& ctx_sp) override;
 
+  // Merge all input into one output.
   void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                std::vector<::grps::protos::v1::GrpsMessage>& output,
                GrpsContext& ctx) override;
@@ -116,14 +266,38 @@ public:
   void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                std::vector<::grps::protos::v1::GrpsMessage>& output,
                const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  Reduce reduce_;
+  int k_;
+  std::string score_tensor_;
 };
 
-// TODO(zhaochaochao): Add splitter node.
+// Splitter node, which fans one request out into sub-requests. Nodes between splitter and merger process sub-requests
+// in parallel.
 class SplitterNode : public Node {
 public:
-  explicit SplitterNode(const std::string& name) : Node(name) {}
+  enum class Type {
+    kTensor = 0, // Split gtensors along the first dimension.
+    kText = 1,   // Split str_data into chunks at utf-8 character boundaries.
+  };
+
+  /**
+   * @brief Splitter node constructor.
+   * @param name: Node name.
+   * @param type: Split type.
+   * @param chunk_size: Rows of tensor or bytes of text in one sub-request.
+   */
+  SplitterNode(const std::string& name, Type type, int chunk_size)
+      : Node(name), type_(type), chunk_size_(chunk_size) {}
   ~SplitterNode() override = default;
 
+  // Split input into sub-requests.
+  void Split(const ::grps::protos::v1::GrpsMessage& input,
+             std::vector<::grps::protos::v1::GrpsMessage>& output,
+             GrpsContext& ctx) const;
+
+  // Not supported, splitter node should be followed by a merger node.
   void Process(const ::grps::protos::v1::GrpsMessage& input,
                ::grps::protos::v1::GrpsMessage& output,
                GrpsContext& ctx) override;
@@ -132,6 +306,7 @@ public:
                ::grps::protos::v1::GrpsMessage& output,
                const std::shared_ptr<GrpsContext>& ctx_sp) override;
 
+  // Split each input and concat sub-requests into output.
   void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                std::vector<::grps::protos::v1::GrpsMessage>& output,
                GrpsContext& ctx) override;
@@ -139,5 +314,168 @@ public:
   void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
                std::vector<::grps::protos::v1::GrpsMessage>& output,
                const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  Type type_;
+  int chunk_size_;
+};
+
+// Condition node, which evaluates a predicate on the output of previous node and passes the message through. Dag ends
+// early or jumps to the target node when the predicate is true.
+class ConditionNode : public Node {
+public:
+  enum class Source {
+    kGmap = 0,      // Numeric value of gmap (s_f, s_d, s_i32 or s_i64) with the key.
+    kTensorMax = 1, // Max value of tensor with the key as name, empty key means the first tensor.
+  };
+  enum class Op { kGt = 0, kGe = 1, kLt = 2, kLe = 3, kEq = 4, kNe = 5 };
+  enum class Action {
+    kExit = 0, // End dag, output of previous node will be the output of dag.
+    kGoto = 1, // Jump to the target node.
+  };
+  enum class Forward {
+    kOutput = 0,  // Forward output of previous node to next node.
+    kRequest = 1, // Forward request of dag to next node.
+  };
+
+  /**
+   * @brief Condition node constructor.
+   * @param name: Node name.
+   * @param source: Source of the value compared.
+   * @param key: Gmap key or tensor name.
+   * @param op: Compare operator.
+   * @param value: Threshold compared with.
+   * @param action: Action when the predicate is true.
+   * @param target: Target node of goto.
+   * @param forward: Message forwarded to next node when the dag goes on.
+   */
+  ConditionNode(const std::string& name,
+                Source source,
+                std::string key,
+                Op op,
+                double value,
+                Action action,
+                std::string target,
+                Forward forward);
+  ~ConditionNode() override = default;
+
+  // Evaluate predicate on input and record hit rate.
+  bool Evaluate(const ::grps::protos::v1::GrpsMessage& input) const;
+
+  [[nodiscard]] Action action() const { return action_; }
+  [[nodiscard]] const std::string& target() const { return target_; }
+  [[nodiscard]] Forward forward() const { return forward_; }
+
+  // Pass input through.
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  Source source_;
+  std::string key_;
+  Op op_;
+  double value_;
+  Action action_;
+  std::string target_;
+  Forward forward_;
+
+  // Metrics handles.
+  MetricsAgg* hit_rate_metric_;
+
+  [[nodiscard]] double Extract(const ::grps::protos::v1::GrpsMessage& input) const;
+};
+
+// Ensemble node, which runs the same input on member models concurrently (each through its own batcher) and
+// aggregates their outputs. Members exceeding timeout or failed are dropped, and a degraded result of the succeeded
+// members is returned.
+class EnsembleNode : public Node {
+public:
+  enum class Reduce {
+    kMean = 0,        // Element-wise mean of gtensors.
+    kWeightedSum = 1, // Element-wise weighted sum of gtensors, weights of dropped members are redistributed.
+    kVote = 2,        // Element-wise weighted majority of gtensors, or weighted majority of str_data.
+    kConcat = 3,      // Concat gtensors along the first dimension, str_data or gmap in order of members.
+  };
+
+  struct Member {
+    std::string model;
+    std::shared_ptr<Node> node;
+    double weight = 1;
+  };
+
+  /**
+   * @brief Ensemble node constructor.
+   * @param name: Node name.
+   * @param members: Member models.
+   * @param reduce: Reduce of outputs of members.
+   * @param timeout_ms: Timeout of each member, 0 means no timeout.
+   * @param min_members: Minimum succeeded members, otherwise the request fails.
+   */
+  EnsembleNode(const std::string& name,
+               std::vector<Member> members,
+               Reduce reduce,
+               int64_t timeout_ms,
+               int min_members);
+  ~EnsembleNode() override = default;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+  // Process each input one by one.
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+private:
+  // State of one request shared with members, members exceeding timeout may still be running after node returns.
+  struct RunState {
+    std::shared_ptr<const ::grps::protos::v1::GrpsMessage> input_holder; // Copy of input when timeout is set.
+    const ::grps::protos::v1::GrpsMessage* input = nullptr;
+    // Context of request, set only without timeout since members never outlive the request then.
+    const GrpsContext* parent = nullptr;
+    std::shared_ptr<Trace> trace; // Trace of request kept alive for members exceeding timeout.
+    std::vector<::grps::protos::v1::GrpsMessage> outputs;
+    std::vector<std::string> err_msgs;
+    std::vector<bool> done; // Protected by mtx.
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t remaining = 0; // Protected by mtx.
+  };
+
+  std::vector<Member> members_;
+  Reduce reduce_;
+  int64_t timeout_us_;
+  int min_members_;
+  double total_weight_ = 0;
+
+  // Metrics handles.
+  std::vector<MetricsAgg*> drop_metrics_;
+
+  static void RunMember(RunState& state, size_t idx, Node& node);
+  void Aggregate(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                 const std::vector<double>& weights,
+                 ::grps::protos::v1::GrpsMessage& output) const;
 };
-} // namespace netease::grps
\ No newline at end of file
+} // namespace netease::grps
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/13
+ * Brief  Low priority thread pool used to run shadow requests.
+ */
+
+#include "shadow_pool.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger/logger.h"
+
+namespace netease::grps {
+ShadowPool::ShadowPool(int thread_num, int max_pending) : max_pending_(max_pending) {
+  for (int i = 0; i < thread_num; ++i) {
+    threads_.emplace_back([this] {
+      // On linux, nice value of a thread can be set by its tid.
+      if (setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), 19) != 0) {
+        LOG4(WARN, "Set shadow thread priority failed, errno: " << errno);
+      }
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this] { return !tasks_.empty() || !running_; });
+          if (!running_) {
+            return;
+          }
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        task();
+      }
+    });
+  }
+  LOG4(INFO, "Shadow pool init, thread_num: " << thread_num << ", max_pending: " << max_pending);
+}
+
+ShadowPool::~ShadowPool() {
+  Stop();
+}
+
+bool ShadowPool::TryPost(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_ || tasks_.size() >= size_t(max_pending_)) {
+      return false;
+    }
+    tasks_.emplace_back(std::move(task));
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void ShadowPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = false;
+    tasks_.clear();
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+} // namespace netease::grps
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/13
+ * Brief  Low priority thread pool used to run shadow requests. Shadow requests are dropped instead of queued when
+ *        the pool is busy, so they never add latency to primary requests.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace netease::grps {
+class ShadowPool {
+public:
+  /**
+   * @brief Shadow pool constructor.
+   * @param thread_num: Thread number, threads run with the lowest scheduling priority(nice 19).
+   * @param max_pending: Max pending tasks, tasks exceeding it will be dropped.
+   */
+  ShadowPool(int thread_num, int max_pending);
+  ~ShadowPool();
+  ShadowPool(const ShadowPool&) = delete;
+  ShadowPool& operator=(const ShadowPool&) = delete;
+  ShadowPool(ShadowPool&&) = delete;
+  ShadowPool& operator=(ShadowPool&&) = delete;
+
+  /**
+   * @brief Post task to pool.
+   * @return False if pool is full or stopped, and task is dropped.
+   */
+  bool TryPost(std::function<void()> task);
+
+  // Stop pool, pending tasks are dropped and running tasks are waited.
+  void Stop();
+
+private:
+  int max_pending_;
+  bool running_ = true;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::vector<std::thread> threads_;
+};
+} // namespace netease::grps
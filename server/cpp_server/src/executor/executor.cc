@@ -7,11 +7,15 @@
 
 #include "executor.h"
 
+#include <butil/time.h>
 #include <google/protobuf/text_format.h>
 
+#include <filesystem>
+
 #include "converter/converter.h"
 #include "logger/logger.h"
 #include "model_infer/inferer.h"
+#include "model_infer/replica_inferer.h"
 #ifdef GRPS_TF_ENABLE
 #include "converter/tf_tensor_converter.h"
 #include "model_infer/tf_inferer.h"
@@ -24,24 +28,75 @@
 #include "converter/trt_tensor_converter.h"
 #include "model_infer/trt_inferer.h"
 #endif
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
 #include "batching/batcher.h"
 #include "config/global_config.h"
+#include "constant.h"
+#include "executor/model_warmup.h"
+#include "monitor/monitor.h"
 
 namespace netease::grps {
+static const char* kInferenceConfPath = "./conf/inference.yml";
+
+static bool SameModelConfig(const GlobalConfig::InferenceConfig::ModelConfig& lhs,
+                            const GlobalConfig::InferenceConfig::ModelConfig& rhs) {
+  return lhs.name == rhs.name && lhs.version == rhs.version && lhs.device == rhs.device &&
+         lhs.inp_device == rhs.inp_device && lhs.inferer_type == rhs.inferer_type &&
+         lhs.inferer_name == rhs.inferer_name && lhs.inferer_path == rhs.inferer_path &&
+         YAML::Dump(lhs.inferer_args) == YAML::Dump(rhs.inferer_args) && lhs.converter_type == rhs.converter_type &&
+         lhs.converter_name == rhs.converter_name && lhs.converter_path == rhs.converter_path &&
+         YAML::Dump(lhs.converter_args) == YAML::Dump(rhs.converter_args) &&
+         lhs.batching.type == rhs.batching.type && lhs.batching.max_batch_size == rhs.batching.max_batch_size &&
+         lhs.batching.batch_timeout_us == rhs.batching.batch_timeout_us && lhs.cache.type == rhs.cache.type &&
+         lhs.cache.max_bytes == rhs.cache.max_bytes && lhs.cache.ttl_ms == rhs.cache.ttl_ms &&
+         lhs.cache.shard_num == rhs.cache.shard_num && lhs.coalescing == rhs.coalescing &&
+         lhs.load_policy == rhs.load_policy && lhs.memory_mib == rhs.memory_mib && lhs.instances == rhs.instances &&
+         lhs.instance_dispatch == rhs.instance_dispatch && lhs.instance_cpus == rhs.instance_cpus;
+}
+
 void Executor::Init() {
   LOG4(INFO, "Init executor.");
   InitOutlier();
-  InitModels();
-  InitDag();
+
+  const auto& server_config = GlobalConfig::Instance().server_config();
+  lazy_manager_ = std::make_shared<LazyModelManager>(server_config._is_set.lazy_load
+                                                       ? server_config.lazy_load.memory_budget_mib
+                                                       : 0);
+
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->config = std::make_shared<GlobalConfig::InferenceConfig>(GlobalConfig::Instance().inference_config());
+  auto names = InitModels(*snapshot, nullptr);
+  InitRouters(*snapshot);
+  InitDag(*snapshot);
+  std::shared_ptr<const Snapshot> const_snapshot = std::move(snapshot);
+  std::atomic_store(&snapshot_, const_snapshot);
+
+  // Warmup in background, so that liveness can be checked while warming up. Readiness flips after warmup succeeds,
+  // failed warmup keeps server not ready like failed warmup of reload fails the reload.
+  warmup_thread_ = std::thread([this, snapshot = std::move(const_snapshot), names = std::move(names)] {
+    try {
+      WarmupModels(*snapshot, names);
+    } catch (const std::exception& e) {
+      LOG4(ERROR, "Warmup models failed, server will not be ready: " << e.what());
+      return;
+    }
+    warmed_up_ = true;
+  });
+
+  if (server_config._is_set.hot_reload && server_config.hot_reload.watch) {
+    StartWatcher();
+  }
 }
 
 void Executor::InitOutlier() {
   // TODO: Add outlier.
 }
 
-void Executor::InitModels() {
+std::vector<std::string> Executor::InitModels(Snapshot& snapshot, const Snapshot* old_snapshot) {
   LOG4(INFO, "Init models.");
-  const auto& inference_config = GlobalConfig::Instance().inference_config();
+  const auto& inference_config = *snapshot.config;
   if (!inference_config._is_set.models) {
     LOG4(ERROR, "No model config.");
     throw ExecutorException("No model config.");
@@ -49,159 +104,408 @@ void Executor::InitModels() {
 
   std::unordered_set<std::string> used_customized_inferers;
   std::unordered_set<std::string> used_customized_converters;
+  if (old_snapshot != nullptr) {
+    // Customized inferers and converters of registry may be serving in old snapshot, always clone new when reloading.
+    for (const auto& [name, model] : old_snapshot->config->models) {
+      if (model.inferer_type == "customized") {
+        used_customized_inferers.insert(model.inferer_name);
+      }
+      if (model.converter_type == "customized") {
+        used_customized_converters.insert(model.converter_name);
+      }
+    }
+  }
+
+  // Iterate models in name order, so that clone decisions and errors are deterministic.
+  std::vector<std::string> names;
   for (const auto& [name, model] : inference_config.models) {
-    if (models_.find(name) != models_.end()) {
-      LOG4(ERROR, "Model " << name << " already exists.");
-      throw ExecutorException("Model " + name + " already exists.");
+    names.emplace_back(name);
+  }
+  std::sort(names.begin(), names.end());
+
+  // Models to load, inferers and converters are created serially, and loaded in parallel.
+  struct LoadTask {
+    std::string name;
+    const GlobalConfig::InferenceConfig::ModelConfig* config;
+    std::shared_ptr<ModelInferer> inferer;
+    std::shared_ptr<Converter> converter;
+    Model model;
+    std::exception_ptr error;
+  };
+  std::vector<LoadTask> tasks;
+  for (const auto& name : names) {
+    const auto& model = inference_config.models.at(name);
+    int64_t mtime = std::max(LastModifiedTime(model.inferer_path), LastModifiedTime(model.converter_path));
+    if (old_snapshot != nullptr) {
+      auto old_iter = old_snapshot->config->models.find(name);
+      if (old_iter != old_snapshot->config->models.end() && SameModelConfig(old_iter->second, model) &&
+          old_snapshot->model_mtimes.at(name) == mtime) {
+        if (model.load_policy == "eager") {
+          snapshot.models[name] = old_snapshot->models.at(name);
+        }
+        snapshot.model_nodes[name] = old_snapshot->model_nodes.at(name);
+        snapshot.model_mtimes[name] = mtime;
+        LOG4(INFO, "Model: " << name << " not changed, reuse it.");
+        continue;
+      }
+    }
+
+    if (model.load_policy == "lazy") {
+      snapshot.model_nodes[name] = CreateLazyModelNode(name, model);
+      snapshot.model_mtimes[name] = mtime;
+      LOG4(INFO, "Model: " << name << " will be loaded lazily on first request.");
+      continue;
+    }
+
+    auto inferer = CreateInferer(model, used_customized_inferers);
+    auto converter = CreateConverter(model, used_customized_converters);
+    tasks.push_back({name, &model, std::move(inferer), std::move(converter), {}, nullptr});
+    snapshot.model_mtimes[name] = mtime;
+  }
+
+  if (!tasks.empty()) {
+    auto begin_us = butil::gettimeofday_us();
+    size_t concurrency = std::min<size_t>(tasks.size(), std::max(1u, std::thread::hardware_concurrency()));
+    LOG4(INFO, "Load " << tasks.size() << " models with concurrency: " << concurrency);
+    boost::asio::thread_pool load_tp(concurrency);
+    for (auto& task : tasks) {
+      boost::asio::post(load_tp, [&task] {
+        try {
+          task.model = InitModel(task.name, *task.config, task.inferer, task.converter);
+        } catch (...) {
+          task.error = std::current_exception();
+        }
+      });
+    }
+    load_tp.join();
+
+    // Rethrow the first error in name order. Models loaded successfully are released with tasks.
+    for (const auto& task : tasks) {
+      if (task.error) {
+        LOG4(ERROR, "Load model: " << task.name << " failed.");
+        std::rethrow_exception(task.error);
+      }
+    }
+    LOG4(INFO, "Load " << tasks.size() << " models successfully, cost: " << (butil::gettimeofday_us() - begin_us) / 1000
+                       << " ms.");
+  }
+
+  std::vector<std::string> loaded;
+  for (auto& task : tasks) {
+    const auto& model = task.model;
+    snapshot.model_nodes[task.name] = std::make_shared<ModelNode>(
+      task.name, task.name, model.inferer_, model.converter_, model.batcher_, model.cache_, model.single_flight_);
+    snapshot.models[task.name] = std::move(task.model);
+    loaded.emplace_back(task.name);
+  }
+  return loaded;
+}
+
+void Executor::WarmupModels(const Snapshot& snapshot, const std::vector<std::string>& names) {
+  std::vector<std::string> warmup_names;
+  for (const auto& name : names) {
+    if (snapshot.config->models.at(name).warmup.enabled()) {
+      warmup_names.emplace_back(name);
+    }
+  }
+  if (warmup_names.empty()) {
+    return;
+  }
+
+  size_t concurrency = std::min<size_t>(warmup_names.size(), std::max(1u, std::thread::hardware_concurrency()));
+  LOG4(INFO, "Warmup " << warmup_names.size() << " models with concurrency: " << concurrency);
+  std::vector<std::exception_ptr> errors(warmup_names.size());
+  {
+    boost::asio::thread_pool warmup_tp(concurrency);
+    for (size_t i = 0; i < warmup_names.size(); ++i) {
+      boost::asio::post(warmup_tp, [&snapshot, &warmup_names, &errors, i] {
+        const auto& name = warmup_names[i];
+        try {
+          ModelWarmup::Run(name, snapshot.config->models.at(name).warmup, snapshot.models.at(name));
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+    warmup_tp.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
     }
+  }
+}
 
-    std::shared_ptr<ModelInferer> inferer_ptr = nullptr;
-    std::string inferer_name;
-    if (model.inferer_type == "torch") {
+std::shared_ptr<ModelInferer> Executor::CreateInferer(const GlobalConfig::InferenceConfig::ModelConfig& model,
+                                                     std::unordered_set<std::string>& used_customized_inferers) {
+  std::shared_ptr<ModelInferer> inferer_ptr = nullptr;
+  if (model.inferer_type == "torch") {
 #ifdef GRPS_TORCH_ENABLE
-      inferer_ptr = std::make_shared<TorchModelInferer>();
+    inferer_ptr = std::make_shared<TorchModelInferer>();
 #else
-      throw ExecutorException("Torch model inferer is not supported.");
+    throw ExecutorException("Torch model inferer is not supported.");
 #endif
-      inferer_name = "torch";
-    } else if (model.inferer_type == "tensorflow") {
+  } else if (model.inferer_type == "tensorflow") {
 #ifdef GRPS_TF_ENABLE
-      inferer_ptr = std::make_shared<TfModelInferer>();
+    inferer_ptr = std::make_shared<TfModelInferer>();
 #else
-      throw ExecutorException("Tensorflow model inferer is not supported.");
+    throw ExecutorException("Tensorflow model inferer is not supported.");
 #endif
-      inferer_name = "tensorflow";
-    } else if (model.inferer_type == "tensorrt") {
+  } else if (model.inferer_type == "tensorrt") {
 #ifdef GRPS_TRT_ENABLE
-      inferer_ptr = std::make_shared<TrtModelInferer>();
+    inferer_ptr = std::make_shared<TrtModelInferer>();
 #else
-      throw ExecutorException("TensorRT model inferer is not supported.");
+    throw ExecutorException("TensorRT model inferer is not supported.");
 #endif
-    } else if (model.inferer_type == "customized") {
-      auto customized_inferer = ModelInfererRegistry::Instance().GetInferer(model.inferer_name);
-      if (customized_inferer == nullptr) {
-        LOG4(ERROR, "Not found customized inferer: " << model.inferer_name);
-        throw ExecutorException("Not found customized inferer: " + model.inferer_name);
-      }
-      inferer_name = model.inferer_name;
-      if (used_customized_inferers.find(inferer_name) != used_customized_inferers.end()) {
-        // If customized inferer has been used, clone new.
-        inferer_ptr = std::shared_ptr<ModelInferer>(customized_inferer->Clone());
-      } else {
-        inferer_ptr = customized_inferer;
-        used_customized_inferers.insert(inferer_name);
-      }
+  } else if (model.inferer_type == "customized") {
+    auto customized_inferer = ModelInfererRegistry::Instance().GetInferer(model.inferer_name);
+    if (customized_inferer == nullptr) {
+      LOG4(ERROR, "Not found customized inferer: " << model.inferer_name);
+      throw ExecutorException("Not found customized inferer: " + model.inferer_name);
+    }
+    if (used_customized_inferers.find(model.inferer_name) != used_customized_inferers.end()) {
+      // If customized inferer has been used, clone new.
+      inferer_ptr = std::shared_ptr<ModelInferer>(customized_inferer->Clone());
     } else {
-      LOG4(ERROR, "Not support inferer type: " << model.inferer_type);
-      throw ExecutorException("Not support inferer type: " + model.inferer_type);
+      inferer_ptr = customized_inferer;
+      used_customized_inferers.insert(model.inferer_name);
     }
+  } else {
+    LOG4(ERROR, "Not support inferer type: " << model.inferer_type);
+    throw ExecutorException("Not support inferer type: " + model.inferer_type);
+  }
 
-    std::string device;
-    std::transform(model.device.begin(), model.device.end(), std::back_inserter(device), ::tolower);
-    if (device == "original" && model.inferer_type == "torch") {
-      device += "_" + model.inp_device;
+  if (model.instances > 1 || !model.instance_cpus.empty()) {
+    std::vector<std::shared_ptr<ModelInferer>> replicas{inferer_ptr};
+    for (int i = 1; i < model.instances; ++i) {
+      replicas.emplace_back(inferer_ptr->Clone());
     }
-    std::transform(device.begin(), device.end(), device.begin(), ::tolower);
+    auto dispatch = model.instance_dispatch == "least_loaded" ? ReplicaInferer::Dispatch::kLeastLoaded
+                                                              : ReplicaInferer::Dispatch::kRoundRobin;
+    inferer_ptr = std::make_shared<ReplicaInferer>(std::move(replicas), dispatch, model.instance_cpus);
+    LOG4(INFO, "Create " << model.instances << " replicas of inferer, dispatch: " << model.instance_dispatch
+                         << ", pinned: " << !model.instance_cpus.empty());
+  }
 
-    inferer_ptr->Init(model.inferer_path, device, model.inferer_args);
-    LOG4(INFO, "Init inferer: " << inferer_name << " successfully, path: " << model.inferer_path
-                                << ", device: " << device << ", args: " << model.inferer_args << ".");
-    inferer_ptr->Load();
-    LOG4(INFO, "Load inferer: " << inferer_name << " successfully.");
+  return inferer_ptr;
+}
 
-    std::shared_ptr<Converter> converter_ptr = nullptr;
-    std::string converter_name;
-    if (model.converter_type == "torch") {
+std::shared_ptr<Converter> Executor::CreateConverter(const GlobalConfig::InferenceConfig::ModelConfig& model,
+                                                     std::unordered_set<std::string>& used_customized_converters) {
+  std::shared_ptr<Converter> converter_ptr = nullptr;
+  if (model.converter_type == "torch") {
 #ifdef GRPS_TORCH_ENABLE
-      converter_ptr = std::make_shared<TorchTensorConverter>();
+    converter_ptr = std::make_shared<TorchTensorConverter>();
 #else
-      throw ExecutorException("Torch tensor converter is not supported.");
+    throw ExecutorException("Torch tensor converter is not supported.");
 #endif
-      converter_name = "torch";
-    } else if (model.converter_type == "tensorflow") {
+  } else if (model.converter_type == "tensorflow") {
 #ifdef GRPS_TF_ENABLE
-      converter_ptr = std::make_shared<TfTensorConverter>();
+    converter_ptr = std::make_shared<TfTensorConverter>();
 #else
-      throw ExecutorException("Tensorflow tensor converter is not supported.");
+    throw ExecutorException("Tensorflow tensor converter is not supported.");
 #endif
-      converter_name = "tensorflow";
-    } else if (model.converter_type == "tensorrt") {
+  } else if (model.converter_type == "tensorrt") {
 #ifdef GRPS_TRT_ENABLE
-      converter_ptr = std::make_shared<TrtTensorConverter>();
+    converter_ptr = std::make_shared<TrtTensorConverter>();
 #else
-      throw ExecutorException("TensorRT tensor converter is not supported.");
+    throw ExecutorException("TensorRT tensor converter is not supported.");
 #endif
-    } else if (model.converter_type == "none") {
-      converter_ptr = nullptr;
-      converter_name = "none";
-    } else if (model.converter_type == "customized") {
-      auto customized_converter = ConverterRegistry::Instance().GetConverter(model.converter_name);
-      if (customized_converter == nullptr) {
-        LOG4(ERROR, "Not found customized converter: " << model.converter_name);
-        throw ExecutorException("Not found customized converter: " + model.converter_name);
-      }
-      converter_name = model.converter_name;
-      if (used_customized_converters.find(converter_name) != used_customized_converters.end()) {
-        // If customized converter has been used, clone new.
-        converter_ptr = std::shared_ptr<Converter>(customized_converter->Clone());
-      } else {
-        converter_ptr = customized_converter;
-        used_customized_converters.insert(converter_name);
-      }
+  } else if (model.converter_type == "none") {
+    converter_ptr = nullptr;
+  } else if (model.converter_type == "customized") {
+    auto customized_converter = ConverterRegistry::Instance().GetConverter(model.converter_name);
+    if (customized_converter == nullptr) {
+      LOG4(ERROR, "Not found customized converter: " << model.converter_name);
+      throw ExecutorException("Not found customized converter: " + model.converter_name);
+    }
+    if (used_customized_converters.find(model.converter_name) != used_customized_converters.end()) {
+      // If customized converter has been used, clone new.
+      converter_ptr = std::shared_ptr<Converter>(customized_converter->Clone());
     } else {
-      LOG4(ERROR, "Not support converter type: " << model.converter_type);
-      throw ExecutorException("Not support converter type: " + model.converter_type);
+      converter_ptr = customized_converter;
+      used_customized_converters.insert(model.converter_name);
     }
+  } else {
+    LOG4(ERROR, "Not support converter type: " << model.converter_type);
+    throw ExecutorException("Not support converter type: " + model.converter_type);
+  }
+
+  return converter_ptr;
+}
 
-    if (converter_ptr != nullptr) {
-      converter_ptr->Init(model.converter_path, model.converter_args);
-      LOG4(INFO, "Init converter: " << converter_name << " successfully, path: " << model.converter_path
-                                    << ", args: " << model.converter_args << ".");
+std::shared_ptr<LazyModelNode> Executor::CreateLazyModelNode(const std::string& name,
+                                                            const GlobalConfig::InferenceConfig::ModelConfig& model) {
+  // Rss growth is skewed by concurrent allocations, budget can only be enforced with configured memory.
+  if (lazy_manager_->budget_mib() > 0 && model.memory_mib <= 0) {
+    LOG4(ERROR, "Lazy model: " << name << " must set memory_mib when lazy_load memory_budget_mib is set.");
+    throw ExecutorException("Lazy model: " + name + " must set memory_mib when lazy_load memory_budget_mib is set.");
+  }
+  auto loader = [name, model] {
+    // Customized inferer and converter of registry may be used by other models, always clone new.
+    std::unordered_set<std::string> used_customized_inferers{model.inferer_name};
+    std::unordered_set<std::string> used_customized_converters{model.converter_name};
+    auto inferer = CreateInferer(model, used_customized_inferers);
+    auto converter = CreateConverter(model, used_customized_converters);
+    auto loaded = InitModel(name, model, inferer, converter);
+    if (model.warmup.enabled()) {
+      ModelWarmup::Run(name, model.warmup, loaded);
     }
+    return loaded;
+  };
+  auto node = std::make_shared<LazyModelNode>(name, std::move(loader), model.memory_mib, lazy_manager_);
+  lazy_manager_->Register(node);
+  return node;
+}
 
-    std::shared_ptr<Batcher> batcher_ptr = nullptr;
-    std::string batcher_name;
-    if (model.batching.type == "none") {
-      batcher_name = "none";
-    } else if (model.batching.type == "dynamic") {
-      batcher_ptr = std::make_shared<DynamicBatcher>();
-      batcher_name = "dynamic";
-    } else {
-      LOG4(ERROR, "Not support batching type: " << model.batching.type);
-      throw ExecutorException("Not support batching type: " + model.batching.type);
+Model Executor::InitModel(const std::string& name,
+                          const GlobalConfig::InferenceConfig::ModelConfig& model,
+                          const std::shared_ptr<ModelInferer>& inferer_ptr,
+                          const std::shared_ptr<Converter>& converter_ptr) {
+  auto begin_us = butil::gettimeofday_us();
+  const auto& inferer_name = model.inferer_type == "customized" ? model.inferer_name : model.inferer_type;
+  const auto& converter_name = model.converter_type == "customized" ? model.converter_name : model.converter_type;
+
+  std::string device;
+  std::transform(model.device.begin(), model.device.end(), std::back_inserter(device), ::tolower);
+  if (device == "original" && model.inferer_type == "torch") {
+    device += "_" + model.inp_device;
+  }
+  std::transform(device.begin(), device.end(), device.begin(), ::tolower);
+
+  inferer_ptr->Init(model.inferer_path, device, model.inferer_args);
+  LOG4(INFO, "Init inferer: " << inferer_name << " successfully, path: " << model.inferer_path
+                              << ", device: " << device << ", args: " << model.inferer_args << ".");
+  inferer_ptr->Load();
+  LOG4(INFO, "Load inferer: " << inferer_name << " successfully.");
+
+  if (converter_ptr != nullptr) {
+    converter_ptr->Init(model.converter_path, model.converter_args);
+    LOG4(INFO, "Init converter: " << converter_name << " successfully, path: " << model.converter_path
+                                  << ", args: " << model.converter_args << ".");
+  }
+
+  std::shared_ptr<Batcher> batcher_ptr = nullptr;
+  std::string batcher_name;
+  if (model.batching.type == "none") {
+    batcher_name = "none";
+  } else if (model.batching.type == "dynamic") {
+    batcher_ptr = std::make_shared<DynamicBatcher>();
+    batcher_name = "dynamic";
+  } else {
+    LOG4(ERROR, "Not support batching type: " << model.batching.type);
+    throw ExecutorException("Not support batching type: " + model.batching.type);
+  }
+
+  if (batcher_ptr != nullptr) {
+    batcher_ptr->Init(name, model.batching.max_batch_size, model.batching.batch_timeout_us, converter_ptr.get(),
+                      inferer_ptr.get());
+    batcher_ptr->Start();
+    LOG4(INFO, "Init and start batcher: " << batcher_name
+                                          << " successfully, max_batch_size: " << model.batching.max_batch_size
+                                          << ", batch_timeout_us: " << model.batching.batch_timeout_us);
+  }
+
+  std::shared_ptr<ResponseCache> cache_ptr = nullptr;
+  if (model.cache.type == "lru" || model.cache.type == "tinylfu") {
+    auto policy = model.cache.type == "lru" ? ResponseCache::Policy::kLru : ResponseCache::Policy::kTinyLfu;
+    cache_ptr = std::make_shared<ResponseCache>(name, policy, model.cache.max_bytes, model.cache.ttl_ms,
+                                                model.cache.shard_num);
+    LOG4(INFO, "Init cache: " << model.cache.type << " successfully, max_bytes: " << model.cache.max_bytes
+                              << ", ttl_ms: " << model.cache.ttl_ms << ", shard_num: " << model.cache.shard_num);
+  } else if (model.cache.type != "none") {
+    LOG4(ERROR, "Not support cache type: " << model.cache.type);
+    throw ExecutorException("Not support cache type: " + model.cache.type);
+  }
+
+  std::shared_ptr<SingleFlight> single_flight_ptr = nullptr;
+  if (model.coalescing) {
+    single_flight_ptr = std::make_shared<SingleFlight>(name, model.coalescing_timeout_ms);
+  }
+
+  auto load_ms = float(butil::gettimeofday_us() - begin_us) / 1000;
+  MONITOR_MAX(std::string(MODEL_LOAD_TIME) + "{model=" + name + "}", load_ms);
+  LOG4(INFO, "Init model: " << name << " successfully, inferer: " << inferer_name << ", converter: " << converter_name
+                            << ", batcher: " << batcher_name << ", cache: " << model.cache.type
+                            << ", coalescing: " << model.coalescing << ", version: " << model.version
+                            << ", load cost: " << load_ms << " ms.");
+  return {model.name, model.version, converter_ptr, inferer_ptr, batcher_ptr, cache_ptr, single_flight_ptr};
+}
+
+void Executor::InitRouters(Snapshot& snapshot) {
+  const auto& inference_config = *snapshot.config;
+  if (!inference_config._is_set.routes) {
+    return;
+  }
+
+  LOG4(INFO, "Init routers.");
+  for (const auto& [model, route] : inference_config.routes) {
+    if (snapshot.model_nodes.find(model) != snapshot.model_nodes.end()) {
+      LOG4(ERROR, "Route model name " << model << " conflicts with model.");
+      throw ExecutorException("Route model name " + model + " conflicts with model.");
     }
 
-    if (batcher_ptr != nullptr) {
-      batcher_ptr->Init(name, model.batching.max_batch_size, model.batching.batch_timeout_us, converter_ptr.get(),
-                        inferer_ptr.get());
-      batcher_ptr->Start();
-      LOG4(INFO, "Init and start batcher: " << batcher_name
-                                            << " successfully, max_batch_size: " << model.batching.max_batch_size
-                                            << ", batch_timeout_us: " << model.batching.batch_timeout_us);
+    std::vector<RouterNode::Target> targets;
+    for (const auto& version : route.versions) {
+      auto model_name = model + "-" + version.version;
+      auto iter = snapshot.model_nodes.find(model_name);
+      if (iter == snapshot.model_nodes.end()) {
+        LOG4(ERROR, "Route model not found: " << model_name);
+        throw ExecutorException("Route model not found: " + model_name);
+      }
+      targets.push_back({model_name, iter->second, version.weight});
+    }
+
+    RouterNode::Target shadow;
+    if (!route.shadow.version.empty() && route.shadow.ratio > 0) {
+      shadow.model_name = model + "-" + route.shadow.version;
+      auto iter = snapshot.model_nodes.find(shadow.model_name);
+      if (iter == snapshot.model_nodes.end()) {
+        LOG4(ERROR, "Route shadow model not found: " << shadow.model_name);
+        throw ExecutorException("Route shadow model not found: " + shadow.model_name);
+      }
+      shadow.node = iter->second;
+      if (shadow_pool_ == nullptr) {
+        // Small pool with bounded pending tasks, shadow requests are dropped when busy.
+        const auto& server_config = GlobalConfig::Instance().server_config();
+        shadow_pool_ = std::make_shared<ShadowPool>(std::max(1, server_config.max_concurrency / 4),
+                                                    server_config.max_concurrency * 4);
+      }
     }
 
-    models_[name] = Model(model.name, model.version, converter_ptr, inferer_ptr, batcher_ptr);
-    LOG4(INFO, "Init model: " << name << " successfully, inferer: " << inferer_name << ", converter: " << converter_name
-                              << ", batcher: " << batcher_name << ", version: " << model.version);
+    snapshot.routers[model] =
+      std::make_shared<RouterNode>(model, std::move(targets), std::move(shadow), route.shadow.ratio, shadow_pool_);
+    LOG4(INFO, "Init router: " << model << " successfully, versions: " << route.versions.size()
+                               << ", shadow: " << route.shadow.version << ", shadow ratio: " << route.shadow.ratio);
   }
 }
 
-void Executor::InitDag() {
+void Executor::InitDag(Snapshot& snapshot) {
   LOG4(INFO, "Init dag.");
-  const auto inference_config = GlobalConfig::Instance().inference_config();
+  const auto& inference_config = *snapshot.config;
   if (!inference_config._is_set.dag) {
     LOG4(ERROR, "No dag config.");
     throw ExecutorException("No dag config.");
   }
 
-  const auto dag_config = inference_config.dag;
+  const auto& dag_config = inference_config.dag;
   if (dag_config.type == "sequential") {
-    dag_ = std::make_shared<SequentialDag>(dag_config.name);
-    dag_->BuildDag(dag_config.nodes, models_);
+    snapshot.dag = std::make_shared<SequentialDag>(dag_config.name);
+  } else if (dag_config.type == "graph") {
+    snapshot.dag = std::make_shared<GraphDag>(dag_config.name);
   } else {
     LOG4(ERROR, "Not support dag type: " << dag_config.type);
     throw ExecutorException("Not support dag type: " + dag_config.type);
   }
+
+  // Lazy model nodes are shared with the dag, so that one model is loaded only once.
+  auto named_nodes = snapshot.routers;
+  for (const auto& [name, node] : snapshot.model_nodes) {
+    if (snapshot.models.find(name) == snapshot.models.end()) {
+      named_nodes.emplace(name, node);
+    }
+  }
+  snapshot.dag->BuildDag(dag_config.nodes, snapshot.models, named_nodes);
 }
 
 void Executor::Infer(const ::grps::protos::v1::GrpsMessage& input,
@@ -214,63 +518,17 @@ void Executor::Infer(const ::grps::protos::v1::GrpsMessage& input,
   LOG4(INFO, "Infer input: " << input_str);
 #endif
 
+  // Hold the snapshot during the whole request, so that models will not be unloaded by hot reload.
+  auto snapshot = LoadSnapshot();
   if (model_name.empty()) {
-    dag_->Infer(input, output, ctx);
+    snapshot->dag->Infer(input, output, ctx);
   } else {
-    auto iter = models_.find(model_name);
-    if (iter == models_.end()) {
+    auto* node = FindNode(*snapshot, model_name);
+    if (node == nullptr) {
       LOG4(ERROR, "Not found model: " << model_name);
       throw ExecutorException("Not found model: " + model_name);
     }
-
-    auto& model = iter->second;
-    auto converter = model.converter_;
-    auto inferer = model.inferer_;
-    auto batcher = model.batcher_;
-    ctx.set_converter(converter.get());
-    ctx.set_inferer(inferer.get());
-
-    if (batcher) {
-      batcher->Infer(input, output, ctx);
-      return;
-    }
-
-    auto begin = butil::gettimeofday_us();
-    if (converter) {
-      std::vector<std::pair<std::string, TensorWrapper>> inp_tensors;
-      std::vector<std::pair<std::string, TensorWrapper>> out_tensors;
-
-      converter->PreProcess(input, inp_tensors, ctx);
-      if (ctx.has_err()) {
-        return;
-      }
-      auto preprocess_end = butil::gettimeofday_us();
-
-      inferer->Infer(inp_tensors, out_tensors, ctx);
-      if (ctx.has_err()) {
-        return;
-      }
-      auto infer_end = butil::gettimeofday_us();
-
-      output.Clear();
-      converter->PostProcess(out_tensors, output, ctx);
-      if (ctx.has_err()) {
-        return;
-      }
-      auto postprocess_end = butil::gettimeofday_us();
-
-      LOG4(INFO, "Model(" << model_name << "), preprocess latency: " << preprocess_end - begin
-                          << "us, infer latency: " << infer_end - preprocess_end
-                          << "us, postprocess latency: " << postprocess_end - infer_end << "us");
-    } else {
-      output.Clear();
-      inferer->Infer(input, output, ctx);
-      if (ctx.has_err()) {
-        return;
-      }
-      auto infer_end = butil::gettimeofday_us();
-      LOG4(INFO, "Model(" << model_name << "), infer latency: " << infer_end - begin << "us");
-    }
+    node->Process(input, output, ctx);
   }
 
 #ifdef GRPS_DEBUG
@@ -290,80 +548,202 @@ void Executor::Infer(const ::grps::protos::v1::GrpsMessage& input,
   LOG4(INFO, "Infer input: " << input_str);
 #endif
 
+  auto snapshot = LoadSnapshot();
   if (model_name.empty()) {
-    dag_->Infer(input, output, ctx_sp);
+    snapshot->dag->Infer(input, output, ctx_sp);
   } else {
-    auto iter = models_.find(model_name);
-    if (iter == models_.end()) {
+    auto* node = FindNode(*snapshot, model_name);
+    if (node == nullptr) {
       LOG4(ERROR, "Not found model: " << model_name);
       throw ExecutorException("Not found model: " + model_name);
     }
+    node->Process(input, output, ctx_sp);
+  }
+
+#ifdef GRPS_DEBUG
+  std::string output_str;
+  ::google::protobuf::TextFormat::PrintToString(output, &output_str);
+  LOG4(INFO, "Infer output: " << output_str);
+#endif
+}
 
-    auto& model = iter->second;
-    auto converter = model.converter_;
-    auto inferer = model.inferer_;
-    auto batcher = model.batcher_;
-    ctx_sp->set_converter(converter.get());
-    ctx_sp->set_inferer(inferer.get());
+Node* Executor::FindNode(const Snapshot& snapshot, const std::string& model_name) {
+  auto model_iter = snapshot.model_nodes.find(model_name);
+  if (model_iter != snapshot.model_nodes.end()) {
+    return model_iter->second.get();
+  }
+  auto router_iter = snapshot.routers.find(model_name);
+  if (router_iter != snapshot.routers.end()) {
+    return router_iter->second.get();
+  }
+  return nullptr;
+}
 
-    if (batcher) {
-      batcher->Infer(input, output, ctx_sp);
-      return;
+void Executor::Reload() {
+  std::lock_guard<std::mutex> lock(reload_mtx_);
+  LOG4(INFO, "Reload models.");
+  auto begin_us = butil::gettimeofday_us();
+
+  auto config = std::make_shared<GlobalConfig::InferenceConfig>();
+  bool loaded = false;
+  try {
+    loaded = GlobalConfig::LoadInferenceConf(kInferenceConfPath, *config);
+  } catch (const std::exception& e) {
+    LOG4(ERROR, "Load inference config failed: " << e.what());
+  }
+  if (!loaded) {
+    throw ExecutorException("Load inference config failed, path: " + std::string(kInferenceConfPath));
+  }
+
+  // Load changed models in background while old snapshot keeps serving. If failed, new models will be released and
+  // old snapshot is not affected.
+  auto old_snapshot = LoadSnapshot();
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->config = std::move(config);
+  auto names = InitModels(*snapshot, old_snapshot.get());
+  // Warmup new models before swapping, failed warmup fails the reload.
+  WarmupModels(*snapshot, names);
+  InitRouters(*snapshot);
+  InitDag(*snapshot);
+
+  std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+  LOG4(INFO, "Swap models successfully, cost: " << (butil::gettimeofday_us() - begin_us) / 1000 << " ms.");
+
+  ReleaseSnapshot(std::move(old_snapshot));
+}
+
+void Executor::ReleaseSnapshot(std::shared_ptr<const Snapshot> old_snapshot) {
+  if (old_snapshot == nullptr) {
+    return;
+  }
+
+  auto current_snapshot = LoadSnapshot();
+  for (const auto& [name, model] : old_snapshot->models) {
+    auto iter = current_snapshot->models.find(name);
+    if (iter == current_snapshot->models.end() || iter->second.inferer_ != model.inferer_) {
+      old_snapshot->unloaded_models.emplace_back(name);
+      LOG4(INFO, "Release model: " << name << ", it will be unloaded after in-flight requests finish.");
     }
+  }
+  current_snapshot.reset();
 
-    auto begin = butil::gettimeofday_us();
-    if (converter) {
-      std::vector<std::pair<std::string, TensorWrapper>> inp_tensors;
-      std::vector<std::pair<std::string, TensorWrapper>> out_tensors;
+  // Requests holding old snapshot keep its reference, models not reused are unloaded by the last of them. Batchers of
+  // unloaded models are stopped when released. Pending shadow requests may still hold their model nodes.
+  old_snapshot.reset();
+}
 
-      converter->PreProcess(input, inp_tensors, *ctx_sp);
-      if (ctx_sp->has_err()) {
-        return;
-      }
-      auto preprocess_end = butil::gettimeofday_us();
+Executor::Snapshot::~Snapshot() {
+  for (const auto& name : unloaded_models) {
+    LOG4(INFO, "Unload model: " << name << ", in-flight requests of old models finished.");
+  }
+}
 
-      inferer->Infer(inp_tensors, out_tensors, *ctx_sp);
-      if (ctx_sp->has_err()) {
-        return;
+void Executor::StartWatcher() {
+  watching_ = true;
+  watcher_ = std::thread([this] {
+    const auto interval_s = GlobalConfig::Instance().server_config().hot_reload.watch_interval_s;
+    LOG4(INFO, "Start watching inference config and model files, interval: " << interval_s << " s.");
+    auto last_fingerprint = WatchFingerprint();
+    std::string changed_fingerprint;
+    while (watching_) {
+      {
+        std::unique_lock<std::mutex> lock(watcher_mtx_);
+        watcher_cv_.wait_for(lock, std::chrono::seconds(interval_s), [this] { return !watching_; });
+      }
+      if (!watching_) {
+        break;
       }
-      auto infer_end = butil::gettimeofday_us();
 
-      output.Clear();
-      converter->PostProcess(out_tensors, output, *ctx_sp);
-      if (ctx_sp->has_err()) {
-        return;
+      auto fingerprint = WatchFingerprint();
+      if (fingerprint == last_fingerprint) {
+        changed_fingerprint.clear();
+        continue;
+      }
+      // Files may be still copying, reload only after they keep unchanged for one interval.
+      if (fingerprint != changed_fingerprint) {
+        changed_fingerprint = fingerprint;
+        continue;
       }
-      auto postprocess_end = butil::gettimeofday_us();
 
-      LOG4(INFO, "Model(" << model_name << "), preprocess latency: " << preprocess_end - begin
-                          << "us, infer latency: " << infer_end - preprocess_end
-                          << "us, postprocess latency: " << postprocess_end - infer_end << "us");
-    } else {
-      output.Clear();
-      inferer->Infer(input, output, *ctx_sp);
-      if (ctx_sp->has_err()) {
-        return;
+      LOG4(INFO, "Inference config or model files changed, reload models.");
+      try {
+        Reload();
+      } catch (const std::exception& e) {
+        LOG4(ERROR, "Reload models failed: " << e.what());
       }
-      auto infer_end = butil::gettimeofday_us();
-      LOG4(INFO, "Model(" << model_name << "), infer latency: " << infer_end - begin << "us");
+      // Not retry failed reload until files change again.
+      last_fingerprint = WatchFingerprint();
+      changed_fingerprint.clear();
     }
+  });
+}
+
+void Executor::StopWatcher() {
+  {
+    std::lock_guard<std::mutex> lock(watcher_mtx_);
+    watching_ = false;
+  }
+  watcher_cv_.notify_all();
+  if (watcher_.joinable()) {
+    watcher_.join();
+  }
+}
+
+std::string Executor::WatchFingerprint() {
+  auto snapshot = LoadSnapshot();
+  std::string fingerprint = std::to_string(LastModifiedTime(kInferenceConfPath));
+  if (snapshot == nullptr) {
+    return fingerprint;
+  }
+  std::vector<std::string> paths;
+  for (const auto& [name, model] : snapshot->config->models) {
+    paths.emplace_back(model.inferer_path);
+    paths.emplace_back(model.converter_path);
   }
+  std::sort(paths.begin(), paths.end());
+  for (const auto& path : paths) {
+    fingerprint += "," + std::to_string(LastModifiedTime(path));
+  }
+  return fingerprint;
+}
 
-#ifdef GRPS_DEBUG
-  std::string output_str;
-  ::google::protobuf::TextFormat::PrintToString(output, &output_str);
-  LOG4(INFO, "Infer output: " << output_str);
-#endif
+int64_t Executor::LastModifiedTime(const std::string& path) {
+  auto to_us = [](const std::filesystem::file_time_type& time) {
+    return int64_t(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count());
+  };
+
+  std::error_code ec;
+  if (path.empty() || !std::filesystem::exists(path, ec)) {
+    return 0;
+  }
+  int64_t mtime = to_us(std::filesystem::last_write_time(path, ec));
+  if (std::filesystem::is_directory(path, ec)) {
+    // Such as tensorflow saved model directory.
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+      mtime = std::max(mtime, to_us(std::filesystem::last_write_time(entry.path(), ec)));
+    }
+  }
+  return mtime;
 }
 
 void Executor::Terminate() {
-  for (auto& [name, model] : models_) {
-    if (model.batcher_) {
-      model.batcher_->Stop();
+  StopWatcher();
+  if (warmup_thread_.joinable()) {
+    warmup_thread_.join();
+  }
+  if (shadow_pool_) {
+    shadow_pool_->Stop();
+  }
+
+  auto snapshot = LoadSnapshot();
+  if (snapshot != nullptr) {
+    for (const auto& [name, model] : snapshot->models) {
+      if (model.batcher_) {
+        model.batcher_->Stop();
+      }
     }
   }
 
-  dag_.reset();
-  models_.clear();
+  std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(nullptr));
 }
 } // namespace netease::grps
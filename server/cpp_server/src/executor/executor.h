@@ -7,11 +7,21 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "config/global_config.h"
 #include "context/context.h"
 #include "converter/converter.h"
 #include "dag/dag.h"
+#include "executor/lazy_model.h"
 #include "grps.pb.h"
 #include "model/model.h"
 #include "model_infer/inferer.h"
@@ -46,13 +56,21 @@ public:
 
   void Init();
 
+  /**
+   * @brief Reload models with current inference.yml without downtime. Models whose config or model files changed are
+   * loaded in background, and swapped in atomically together with the new dag. Unchanged models are reused. Old models
+   * are unloaded after their in-flight requests finish.
+   * @throw ExecutorException: If reload failed. Current models keep serving in this case.
+   */
+  void Reload();
+
   /**
    * @brief Infer. Not safe for batching mode. Use Infer(input, output, ctx_sp, model_name) instead.
    * @param input: Input message from client.
    * @param output: Output message to client.
    * @param ctx: Context of current request.
-   * @param model_name: Model name(with `name-version` format) to predict. If not define, will use default model dag
-   * (defined in inference.yml) to predict.
+   * @param model_name: Model name(with `name-version` format, or model name configured in `routing` to route by
+   * weight) to predict. If not define, will use default model dag (defined in inference.yml) to predict.
    * @throw ExecutorException: If infer failed, throw ExecutorException and will be caught by server and return error
    * message to client.
    */
@@ -66,8 +84,8 @@ public:
    * @param input: Input message from client.
    * @param output: Output message to client.
    * @param ctx_sp: Context shared ptr of current request.
-   * @param model_name: Model name(with `name-version` format) to predict. If not define, will use default model dag
-   * (defined in inference.yml) to predict.
+   * @param model_name: Model name(with `name-version` format, or model name configured in `routing` to route by
+   * weight) to predict. If not define, will use default model dag (defined in inference.yml) to predict.
    * @throw ExecutorException: If infer failed, throw ExecutorException and will be caught by server and return error
    * message to client.
    */
@@ -78,14 +96,82 @@ public:
 
   void Terminate();
 
+  // If models have been warmed up successfully after startup. Server reports ready only after warmup succeeds.
+  [[nodiscard]] bool warmed_up() const { return warmed_up_; }
+
 private:
+  // Immutable view of loaded models and dag, swapped atomically(rcu) by hot reload. Every request holds the snapshot it
+  // started with, so models of an old snapshot stay alive until in-flight requests finish.
+  struct Snapshot {
+    std::shared_ptr<const GlobalConfig::InferenceConfig> config = nullptr;
+    // Models loaded eagerly. Lazy models are loaded by their nodes on first request.
+    std::unordered_map<std::string, Model> models = {};
+    // Model nodes(including lazy model nodes) used when predicting with specified model name.
+    std::unordered_map<std::string, std::shared_ptr<Node>> model_nodes = {};
+    // Router nodes used when predicting with model name without version.
+    std::unordered_map<std::string, std::shared_ptr<Node>> routers = {};
+    std::shared_ptr<InferDag> dag = nullptr;
+    // Last modified time of model files, used to detect changed models.
+    std::unordered_map<std::string, int64_t> model_mtimes = {};
+    // Models not reused by the next snapshot, set when replaced by reload and logged when destroyed.
+    mutable std::vector<std::string> unloaded_models = {};
+
+    ~Snapshot();
+  };
+
   Executor() = default;
 
   void InitOutlier();
-  void InitModels();
-  void InitDag();
+  // Build models of snapshot. Models unchanged from old snapshot will be reused. Return names of newly loaded models.
+  std::vector<std::string> InitModels(Snapshot& snapshot, const Snapshot* old_snapshot);
+  // Create inferer and converter. Customized ones of registry are cloned if used already, so it should run serially.
+  static std::shared_ptr<ModelInferer> CreateInferer(const GlobalConfig::InferenceConfig::ModelConfig& model,
+                                                     std::unordered_set<std::string>& used_customized_inferers);
+  static std::shared_ptr<Converter> CreateConverter(const GlobalConfig::InferenceConfig::ModelConfig& model,
+                                                    std::unordered_set<std::string>& used_customized_converters);
+  // Create lazy model node, whose model is created, loaded and warmed up on first request.
+  std::shared_ptr<LazyModelNode> CreateLazyModelNode(const std::string& name,
+                                                     const GlobalConfig::InferenceConfig::ModelConfig& model);
+  // Init and load model, can run in parallel with other models.
+  static Model InitModel(const std::string& name,
+                         const GlobalConfig::InferenceConfig::ModelConfig& model,
+                         const std::shared_ptr<ModelInferer>& inferer_ptr,
+                         const std::shared_ptr<Converter>& converter_ptr);
+  // Warmup models in parallel, rethrow the first error in name order.
+  static void WarmupModels(const Snapshot& snapshot, const std::vector<std::string>& names);
+  void InitRouters(Snapshot& snapshot);
+  void InitDag(Snapshot& snapshot);
+  // Find node to predict with specified model name.
+  static Node* FindNode(const Snapshot& snapshot, const std::string& model_name);
+
+  // Release old snapshot without waiting, its models that are not reused are unloaded when the last in-flight request
+  // holding it finishes.
+  void ReleaseSnapshot(std::shared_ptr<const Snapshot> old_snapshot);
+
+  // Watch inference.yml and model files, reload when changed.
+  void StartWatcher();
+  void StopWatcher();
+  // Fingerprint of inference.yml and model files of current snapshot.
+  std::string WatchFingerprint();
+
+  // Last modified time(us) of file, or latest one of files in directory. 0 if not exists.
+  static int64_t LastModifiedTime(const std::string& path);
+
+  [[nodiscard]] std::shared_ptr<const Snapshot> LoadSnapshot() const { return std::atomic_load(&snapshot_); }
+
+  std::shared_ptr<const Snapshot> snapshot_ = nullptr;
+  std::mutex reload_mtx_;
+  // Shared by all router nodes to run shadow requests, created when shadow is first configured.
+  std::shared_ptr<ShadowPool> shadow_pool_ = nullptr;
+  // Memory accounting of lazy models, shared by snapshots.
+  std::shared_ptr<LazyModelManager> lazy_manager_ = nullptr;
+
+  std::thread warmup_thread_;
+  std::atomic<bool> warmed_up_{false};
 
-  std::unordered_map<std::string, Model> models_ = {};
-  std::shared_ptr<InferDag> dag_ = nullptr;
+  std::thread watcher_;
+  std::atomic<bool> watching_{false};
+  std::mutex watcher_mtx_;
+  std::condition_variable watcher_cv_;
 };
 } // namespace netease::grps
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/19
+ * Brief  Lazy model.
+ */
+
+#include "lazy_model.h"
+
+#include <butil/time.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "constant.h"
+#include "logger/logger.h"
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+// Resident memory of current process.
+static int64_t RssBytes() {
+  std::ifstream statm("/proc/self/statm");
+  int64_t size = 0;
+  int64_t resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+LazyModelNode::LazyModelNode(const std::string& name,
+                             Loader loader,
+                             int64_t memory_mib,
+                             std::shared_ptr<LazyModelManager> manager)
+    : Node(name), loader_(std::move(loader)), memory_mib_(memory_mib), manager_(std::move(manager)) {}
+
+std::shared_ptr<ModelNode> LazyModelNode::Acquire() {
+  while (true) {
+    std::shared_future<void> loading;
+    std::promise<void> promise;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (node_) {
+        ++inflight_;
+        return node_;
+      }
+      if (loading_.valid()) {
+        loading = loading_;
+      } else {
+        loading_ = promise.get_future().share();
+      }
+    }
+
+    if (loading.valid()) {
+      // Wait for the loading request, rethrow its error if failed.
+      loading.get();
+      continue;
+    }
+
+    try {
+      // Memory is always configured with budget, rss growth is only measured for monitoring without budget.
+      manager_->MakeRoom(this, memory_mib_);
+      auto rss_before = RssBytes();
+      auto model = loader_();
+      auto node = std::make_shared<ModelNode>(name_, name_, model.inferer_, model.converter_, model.batcher_,
+                                              model.cache_, model.single_flight_);
+      auto mib = memory_mib_ > 0 ? memory_mib_ : std::max<int64_t>(RssBytes() - rss_before, 0) / MIB;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        model_ = std::move(model);
+        node_ = std::move(node);
+        loaded_mib_ = mib;
+        loading_ = {};
+      }
+      LOG4(INFO, "Lazy load model: " << name_ << " successfully, memory: " << mib << " MiB.");
+      promise.set_value();
+      manager_->MakeRoom(this, 0);
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        loading_ = {};
+      }
+      promise.set_exception(std::current_exception());
+      throw;
+    }
+  }
+}
+
+void LazyModelNode::Release() {
+  last_used_us_ = butil::gettimeofday_us();
+  --inflight_;
+}
+
+int64_t LazyModelNode::TryUnload() {
+  std::shared_ptr<ModelNode> node;
+  Model model;
+  int64_t mib;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!node_ || inflight_ > 0) {
+      return 0;
+    }
+    node = std::move(node_);
+    model = std::move(model_);
+    node_ = nullptr;
+    model_ = Model();
+    mib = loaded_mib_.exchange(0);
+  }
+  // Release model outside the lock.
+  node.reset();
+  model = Model();
+  LOG4(INFO, "Unload lazy model: " << name_ << ", memory: " << mib << " MiB.");
+  return mib;
+}
+
+void LazyModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                            ::grps::protos::v1::GrpsMessage& output,
+                            GrpsContext& ctx) {
+  auto node = Acquire();
+  try {
+    node->Process(input, output, ctx);
+  } catch (...) {
+    Release();
+    throw;
+  }
+  Release();
+}
+
+void LazyModelNode::Process(const ::grps::protos::v1::GrpsMessage& input,
+                            ::grps::protos::v1::GrpsMessage& output,
+                            const std::shared_ptr<GrpsContext>& ctx_sp) {
+  auto node = Acquire();
+  try {
+    node->Process(input, output, ctx_sp);
+  } catch (...) {
+    Release();
+    throw;
+  }
+  Release();
+}
+
+void LazyModelNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                            std::vector<::grps::protos::v1::GrpsMessage>& output,
+                            GrpsContext& ctx) {
+  auto node = Acquire();
+  try {
+    node->Process(input, output, ctx);
+  } catch (...) {
+    Release();
+    throw;
+  }
+  Release();
+}
+
+void LazyModelNode::Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+                            std::vector<::grps::protos::v1::GrpsMessage>& output,
+                            const std::shared_ptr<GrpsContext>& ctx_sp) {
+  auto node = Acquire();
+  try {
+    node->Process(input, output, ctx_sp);
+  } catch (...) {
+    Release();
+    throw;
+  }
+  Release();
+}
+
+void LazyModelManager::Register(const std::shared_ptr<LazyModelNode>& node) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  nodes_.emplace_back(node);
+}
+
+void LazyModelManager::MakeRoom(const LazyModelNode* loading, int64_t need_mib) {
+  while (true) {
+    std::shared_ptr<LazyModelNode> victim;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      int64_t used_mib = 0;
+      for (auto iter = nodes_.begin(); iter != nodes_.end();) {
+        auto node = iter->lock();
+        if (!node) {
+          // Released by hot reload.
+          iter = nodes_.erase(iter);
+          continue;
+        }
+        ++iter;
+        used_mib += node->loaded_mib();
+        if (node.get() != loading && node->loaded_mib() > 0 && node->idle() &&
+            (!victim || node->last_used_us() < victim->last_used_us())) {
+          victim = node;
+        }
+      }
+      MONITOR_MAX(LAZY_MODEL_MEMORY, float(used_mib));
+
+      if (budget_mib_ <= 0 || used_mib + need_mib <= budget_mib_) {
+        return;
+      }
+      if (!victim) {
+        LOG4(WARN, "Lazy models exceed memory budget: " << budget_mib_ << " MiB, used: " << used_mib << " MiB, need: "
+                                                        << need_mib << " MiB, no idle model to unload.");
+        return;
+      }
+    }
+    // Victim may become busy or be unloaded by others meanwhile, memory is recounted in next round anyway.
+    victim->TryUnload();
+  }
+}
+} // namespace netease::grps
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/19
+ * Brief  Lazy model, loaded on first request and unloaded in lru order when lazy models exceed memory budget.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dag/node.h"
+#include "model/model.h"
+
+namespace netease::grps {
+class LazyModelManager;
+
+// Node of lazy model. Concurrent requests arriving when the model is not loaded wait for one loading.
+class LazyModelNode : public Node {
+public:
+  using Loader = std::function<Model()>;
+
+  /**
+   * @brief Lazy model node constructor.
+   * @param name: Model name with `name-version` format.
+   * @param loader: Create, init and load model.
+   * @param memory_mib: Memory of model, 0 means measured by rss growth when loading, which is only allowed without
+   * memory budget.
+   * @param manager: Manager accounting memory of lazy models.
+   */
+  LazyModelNode(const std::string& name, Loader loader, int64_t memory_mib, std::shared_ptr<LazyModelManager> manager);
+  ~LazyModelNode() override = default;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override;
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override;
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override;
+
+  // Unload model if loaded and idle(no in-flight request). Return memory(MiB) released.
+  int64_t TryUnload();
+
+  // Memory(MiB) of loaded model, 0 if not loaded.
+  [[nodiscard]] int64_t loaded_mib() const { return loaded_mib_; }
+  [[nodiscard]] int64_t last_used_us() const { return last_used_us_; }
+  [[nodiscard]] bool idle() const { return inflight_ == 0; }
+
+private:
+  // Get loaded model node and increase in-flight count, load model if not loaded.
+  std::shared_ptr<ModelNode> Acquire();
+  void Release();
+
+  Loader loader_;
+  int64_t memory_mib_;
+  std::shared_ptr<LazyModelManager> manager_;
+
+  std::mutex mtx_;
+  Model model_;
+  std::shared_ptr<ModelNode> node_;
+  std::shared_future<void> loading_; // Valid while loading.
+  std::atomic<int> inflight_{0};
+  std::atomic<int64_t> loaded_mib_{0};
+  std::atomic<int64_t> last_used_us_{0};
+};
+
+// Account memory of lazy models, unload least recently used idle models when exceeding budget.
+class LazyModelManager {
+public:
+  // budget_mib: Memory budget(MiB) of all lazy models, 0 means no limit.
+  explicit LazyModelManager(int64_t budget_mib) : budget_mib_(budget_mib) {}
+
+  void Register(const std::shared_ptr<LazyModelNode>& node);
+
+  // Unload idle models until there is need_mib memory left for the model `loading`. Models are unloaded outside the
+  // lock, so that other loading requests are not blocked.
+  void MakeRoom(const LazyModelNode* loading, int64_t need_mib);
+
+  [[nodiscard]] int64_t budget_mib() const { return budget_mib_; }
+
+private:
+  int64_t budget_mib_;
+  std::mutex mtx_;
+  std::list<std::weak_ptr<LazyModelNode>> nodes_;
+};
+} // namespace netease::grps
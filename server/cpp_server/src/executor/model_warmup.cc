@@ -0,0 +1,178 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/17
+ * Brief  Model warmup.
+ */
+
+#include "model_warmup.h"
+
+#include <butil/fast_rand.h>
+#include <butil/time.h>
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <fstream>
+#include <future>
+#include <memory>
+
+#include "common/pb_utils.h"
+#include "context/context.h"
+#include "dag/node.h"
+#include "logger/logger.h"
+
+namespace netease::grps {
+void ModelWarmup::Run(const std::string& model_name,
+                      const GlobalConfig::InferenceConfig::ModelConfig::WarmupConfig& config,
+                      const Model& model) {
+  if (!config.enabled()) {
+    return;
+  }
+
+  auto begin_us = butil::gettimeofday_us();
+  // Bypass cache and coalescing, warmup responses should not be served to clients.
+  ModelNode node(model_name, model_name, model.inferer_, model.converter_, model.batcher_);
+  auto samples = LoadSamples(config.samples);
+  bool batching = model.batcher_ != nullptr;
+
+  auto infer = [&node, &model_name](const ::grps::protos::v1::GrpsMessage& input) {
+    ::grps::protos::v1::GrpsMessage output;
+    auto ctx = GrpsContext::Acquire(&input);
+    node.Process(input, output, ctx);
+    if (ctx->has_err()) {
+      throw ModelWarmupException("Warmup model " + model_name + " failed: " + ctx->err_msg());
+    }
+  };
+
+  // Senders reused by all batches, so that concurrent requests do not create a thread per request.
+  std::unique_ptr<boost::asio::thread_pool> senders;
+  if (batching) {
+    senders = std::make_unique<boost::asio::thread_pool>(
+      *std::max_element(config.batch_sizes.begin(), config.batch_sizes.end()));
+  }
+
+  int requests = 0;
+  for (int batch_size : config.batch_sizes) {
+    std::vector<::grps::protos::v1::GrpsMessage> inputs = samples;
+    if (inputs.empty()) {
+      inputs.emplace_back(MakeSynthetic(config.synthetic, batching ? 0 : batch_size));
+    }
+
+    for (int i = 0; i < config.iterations; ++i) {
+      for (const auto& input : inputs) {
+        if (!batching) {
+          infer(input);
+          ++requests;
+          continue;
+        }
+        // Send concurrently, so that batcher forms a batch with batch_size.
+        std::vector<std::future<void>> futures;
+        for (int j = 0; j < batch_size; ++j) {
+          auto task = std::make_shared<std::packaged_task<void()>>([&infer, &input] { infer(input); });
+          futures.emplace_back(task->get_future());
+          boost::asio::post(*senders, [task] { (*task)(); });
+        }
+        // Wait all before rethrowing, input is referenced by senders.
+        for (auto& future : futures) {
+          future.wait();
+        }
+        for (auto& future : futures) {
+          future.get();
+        }
+        requests += batch_size;
+      }
+    }
+  }
+
+  LOG4(INFO, "Warmup model: " << model_name << " successfully, requests: " << requests
+                              << ", cost: " << (butil::gettimeofday_us() - begin_us) / 1000 << " ms.");
+}
+
+std::vector<::grps::protos::v1::GrpsMessage> ModelWarmup::LoadSamples(const std::vector<std::string>& paths) {
+  std::vector<::grps::protos::v1::GrpsMessage> samples;
+  for (const auto& path : paths) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      throw ModelWarmupException("Open warmup sample file failed: " + path);
+    }
+    std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string err;
+    samples.emplace_back();
+    Json2pb(json, &samples.back(), &err);
+    if (!err.empty()) {
+      throw ModelWarmupException("Parse warmup sample file: " + path + " failed: " + err);
+    }
+  }
+  return samples;
+}
+
+::grps::protos::v1::GrpsMessage ModelWarmup::MakeSynthetic(
+  const std::vector<GlobalConfig::InferenceConfig::ModelConfig::WarmupConfig::TensorConfig>& tensors,
+  int batch_size) {
+  ::grps::protos::v1::GrpsMessage message;
+  for (const auto& tensor_config : tensors) {
+    auto& tensor = *message.mutable_gtensors()->add_tensors();
+    tensor.set_name(tensor_config.name);
+    ::grps::protos::v1::DataType dtype;
+    if (!::grps::protos::v1::DataType_Parse(tensor_config.dtype, &dtype) ||
+        dtype == ::grps::protos::v1::DataType::DT_INVALID) {
+      throw ModelWarmupException("Invalid warmup tensor dtype: " + tensor_config.dtype);
+    }
+    tensor.set_dtype(dtype);
+
+    size_t size = 1;
+    for (size_t i = 0; i < tensor_config.shape.size(); ++i) {
+      // Batch size 0 means using the first dimension of config.
+      int dim = (i == 0 && batch_size > 0) ? batch_size : tensor_config.shape[i];
+      if (dim <= 0) {
+        throw ModelWarmupException("Invalid warmup tensor shape, tensor: " + tensor_config.name);
+      }
+      tensor.add_shape(dim);
+      size *= dim;
+    }
+
+    // Random floats in [0, 1) and zero integers, which are valid for most models(e.g. zero token ids).
+    switch (dtype) {
+      case ::grps::protos::v1::DataType::DT_UINT8:
+        tensor.mutable_flat_uint8()->Resize(int(size), 0);
+        break;
+      case ::grps::protos::v1::DataType::DT_INT8:
+        tensor.mutable_flat_int8()->Resize(int(size), 0);
+        break;
+      case ::grps::protos::v1::DataType::DT_INT16:
+        tensor.mutable_flat_int16()->Resize(int(size), 0);
+        break;
+      case ::grps::protos::v1::DataType::DT_INT32:
+        tensor.mutable_flat_int32()->Resize(int(size), 0);
+        break;
+      case ::grps::protos::v1::DataType::DT_INT64:
+        tensor.mutable_flat_int64()->Resize(int(size), 0);
+        break;
+      case ::grps::protos::v1::DataType::DT_FLOAT16:
+        for (size_t i = 0; i < size; ++i) {
+          tensor.add_flat_float16(float(butil::fast_rand_double()));
+        }
+        break;
+      case ::grps::protos::v1::DataType::DT_FLOAT32:
+        for (size_t i = 0; i < size; ++i) {
+          tensor.add_flat_float32(float(butil::fast_rand_double()));
+        }
+        break;
+      case ::grps::protos::v1::DataType::DT_FLOAT64:
+        for (size_t i = 0; i < size; ++i) {
+          tensor.add_flat_float64(butil::fast_rand_double());
+        }
+        break;
+      case ::grps::protos::v1::DataType::DT_STRING:
+        for (size_t i = 0; i < size; ++i) {
+          tensor.add_flat_string("grps");
+        }
+        break;
+      default:
+        throw ModelWarmupException("Not support warmup tensor dtype: " + tensor_config.dtype);
+    }
+  }
+  return message;
+}
+} // namespace netease::grps
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/17
+ * Brief  Model warmup, replay sample requests or synthetic inputs before model serving, so that the first requests
+ *        will not pay for jit profiling, allocator growth, graph optimization and etc.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "config/global_config.h"
+#include "grps.pb.h"
+#include "model/model.h"
+
+namespace netease::grps {
+class ModelWarmup {
+public:
+  class ModelWarmupException : public std::exception {
+  public:
+    explicit ModelWarmupException(std::string message) : message_(std::move(message)) {}
+    ~ModelWarmupException() override = default;
+    [[nodiscard]] const char* what() const noexcept override {
+      static std::string err_message;
+      err_message = "[ModelWarmupException] " + message_;
+      return err_message.c_str();
+    }
+
+  private:
+    std::string message_;
+  };
+
+  /**
+   * @brief Warmup model. For each batch size, replay inputs for `iterations` times. If model uses dynamic batching,
+   * `batch_size` requests are sent concurrently so that batcher will form batches with the size. Otherwise, the first
+   * dimension of synthetic inputs is set to `batch_size`.
+   * @param model_name: Model name with `name-version` format.
+   * @param config: Warmup config.
+   * @param model: Model to warmup. Response cache and request coalescing of model are bypassed.
+   * @throw ModelWarmupException: If warmup inputs are invalid or any warmup request failed.
+   */
+  static void Run(const std::string& model_name,
+                  const GlobalConfig::InferenceConfig::ModelConfig::WarmupConfig& config,
+                  const Model& model);
+
+private:
+  static std::vector<::grps::protos::v1::GrpsMessage> LoadSamples(const std::vector<std::string>& paths);
+  static ::grps::protos::v1::GrpsMessage MakeSynthetic(
+    const std::vector<GlobalConfig::InferenceConfig::ModelConfig::WarmupConfig::TensorConfig>& tensors,
+    int batch_size);
+};
+} // namespace netease::grps
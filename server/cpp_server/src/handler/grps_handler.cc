@@ -8,24 +8,54 @@
 #include "grps_handler.h"
 
 #include <brpc/server.h>
+#include <butil/time.h>
 #include <google/protobuf/text_format.h>
 #include <rapidjson/document.h>
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <atomic>
 #include <fstream>
 #include <numeric>
+#include <unordered_map>
 
 #include "common/pb_utils.h"
+#include "common/request_arena.h"
 #include "constant.h"
 #include "context/context.h"
 #include "executor/executor.h"
 #include "logger/logger.h"
 #include "monitor/monitor.h"
+#include "monitor/request_recorder.h"
+#include "monitor/stage_metrics.h"
+#include "monitor/trace.h"
 
 namespace netease::grps {
-static bool online_status = false;
+// Set by offline interface and cleared by online interface, server is ready after warmup unless set offline.
+static std::atomic<bool> offline_status{false};
+
+// Handles of request metrics, registered on first use.
+static MetricsAgg* FailRateMetric() {
+  static auto* handle = MONITOR_REGISTER(REQ_FAIL_RATE, AggType::kAvg);
+  return handle;
+}
+
+[[maybe_unused]] static MetricsAgg* GpuOomMetric() {
+  static auto* handle = MONITOR_REGISTER(GPU_OOM_COUNT, AggType::kInc);
+  return handle;
+}
+
+// Handle of response serialization latency of model, empty model means the dag. Handles are cached per thread.
+static MetricsAgg* SerializationMetric(const std::string& model) {
+  thread_local std::unordered_map<std::string, MetricsAgg*> handles;
+  auto iter = handles.find(model);
+  if (iter == handles.end()) {
+    auto labels = "{model=" + (model.empty() ? std::string("dag") : model) + "}";
+    iter = handles.emplace(model, MONITOR_REGISTER(std::string(SERIALIZATION_AVG) + labels, AggType::kAvg)).first;
+  }
+  return iter->second;
+}
 
 static inline void SetStatus(::grps::protos::v1::GrpsMessage* response,
                              int code,
@@ -43,18 +73,18 @@ void GrpsRpcHandler::Predict(::brpc::Controller* controller,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "Predict");
 #endif
+  RequestRecorder::Instance().Sample(*request, request->model());
 
   try {
-    std::shared_ptr<GrpsContext> ctx_sp =
-      std::make_shared<GrpsContext>(request, nullptr, nullptr, nullptr, controller, nullptr);
+    std::shared_ptr<GrpsContext> ctx_sp = GrpsContext::Acquire(request, nullptr, nullptr, nullptr, controller, nullptr);
     auto& ctx = *ctx_sp;
     Executor::Instance().Infer(*request, *response, ctx_sp, request->model());
     if (ctx.has_err()) {
       SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, ctx.err_msg(), ::grps::protos::v1::Status::FAILURE);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       LOG4(ERROR, "Predict failed: " << ctx.err_msg());
     } else {
-      MONITOR_AVG(REQ_FAIL_RATE, 0);
+      MONITOR_AVG(FailRateMetric(), 0);
       SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
     }
   } catch (const std::exception& e) {
@@ -62,10 +92,10 @@ void GrpsRpcHandler::Predict(::brpc::Controller* controller,
     std::string err_msg = e.what();
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
   }
 }
@@ -76,18 +106,18 @@ void GrpsRpcHandler::Predict(::grpc::ServerContext* grpc_ctx,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "Predict");
 #endif
+  RequestRecorder::Instance().Sample(*request, request->model());
 
   try {
-    std::shared_ptr<GrpsContext> ctx_sp =
-      std::make_shared<GrpsContext>(request, nullptr, nullptr, nullptr, nullptr, grpc_ctx);
+    std::shared_ptr<GrpsContext> ctx_sp = GrpsContext::Acquire(request, nullptr, nullptr, nullptr, nullptr, grpc_ctx);
     auto& ctx = *ctx_sp;
     Executor::Instance().Infer(*request, *response, ctx_sp, request->model());
     if (ctx.has_err()) {
       SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, ctx.err_msg(), ::grps::protos::v1::Status::FAILURE);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       LOG4(ERROR, "Predict failed: " << ctx.err_msg());
     } else {
-      MONITOR_AVG(REQ_FAIL_RATE, 0);
+      MONITOR_AVG(FailRateMetric(), 0);
       SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
     }
   } catch (const std::exception& e) {
@@ -95,10 +125,10 @@ void GrpsRpcHandler::Predict(::grpc::ServerContext* grpc_ctx,
     std::string err_msg = e.what();
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
   }
 }
@@ -109,18 +139,19 @@ void GrpsRpcHandler::PredictStreaming(::grpc::ServerContext* grpc_ctx,
 #ifdef GRPS_DEBUG
   LOG4(INFO, "PredictStreaming");
 #endif
+  RequestRecorder::Instance().Sample(*request, request->model());
 
   ::grps::protos::v1::GrpsMessage response;
   try {
-    auto ctx_sp = std::make_shared<GrpsContext>(request, writer, nullptr, nullptr, nullptr, grpc_ctx);
+    auto ctx_sp = GrpsContext::Acquire(request, writer, nullptr, nullptr, nullptr, grpc_ctx);
     Executor::Instance().Infer(*request, response, ctx_sp, request->model());
     if (ctx_sp->has_err()) {
       SetStatus(&response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, ctx_sp->err_msg(),
                 ::grps::protos::v1::Status::FAILURE);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       LOG4(ERROR, "Predict failed: " << ctx_sp->err_msg());
     } else {
-      MONITOR_AVG(REQ_FAIL_RATE, 0);
+      MONITOR_AVG(FailRateMetric(), 0);
       return;
     }
   } catch (const std::exception& e) {
@@ -128,10 +159,10 @@ void GrpsRpcHandler::PredictStreaming(::grpc::ServerContext* grpc_ctx,
     std::string err_msg = e.what();
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     SetStatus(&response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
   }
   writer->Write(response);
@@ -140,14 +171,14 @@ void GrpsRpcHandler::PredictStreaming(::grpc::ServerContext* grpc_ctx,
 void GrpsRpcHandler::Online(::brpc::Controller* controller,
                             const ::grps::protos::v1::GrpsMessage* request,
                             ::grps::protos::v1::GrpsMessage* response) {
-  online_status = true;
+  offline_status = false;
   SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
 }
 
 void GrpsRpcHandler::Offline(::brpc::Controller* controller,
                              const ::grps::protos::v1::GrpsMessage* request,
                              ::grps::protos::v1::GrpsMessage* response) {
-  online_status = false;
+  offline_status = true;
   SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
 }
 
@@ -160,7 +191,8 @@ void GrpsRpcHandler::CheckLiveness(::brpc::Controller* controller,
 void GrpsRpcHandler::CheckReadiness(::brpc::Controller* controller,
                                     const ::grps::protos::v1::GrpsMessage* request,
                                     ::grps::protos::v1::GrpsMessage* response) {
-  if (online_status) {
+  // Ready after models warmed up, unless set offline.
+  if (!offline_status && Executor::Instance().warmed_up()) {
     SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
   } else {
     SetStatus(response, brpc::HTTP_STATUS_SERVICE_UNAVAILABLE, "Service Unavailable",
@@ -218,18 +250,19 @@ void GrpsHttpHandler::Predict(::brpc::Controller* cntl,
   LOG4(INFO, "Predict");
 #endif
   const auto& content_type = cntl->http_request().content_type();
+  RequestRecorder::Instance().Sample(*request, request->model());
 
   // Predict.
   try {
-    std::shared_ptr<GrpsContext> ctx_sp = std::make_shared<GrpsContext>(request, nullptr, nullptr, cntl);
+    std::shared_ptr<GrpsContext> ctx_sp = GrpsContext::Acquire(request, nullptr, nullptr, cntl);
     auto& ctx = *ctx_sp;
     Executor::Instance().Infer(*request, *response, ctx_sp, request->model());
     if (ctx.has_err()) {
       SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, ctx.err_msg(), ::grps::protos::v1::Status::FAILURE);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       LOG4(ERROR, "Predict failed: " << ctx.err_msg());
     } else {
-      MONITOR_AVG(REQ_FAIL_RATE, 0);
+      MONITOR_AVG(FailRateMetric(), 0);
       SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
     }
   } catch (const std::exception& e) {
@@ -237,16 +270,22 @@ void GrpsHttpHandler::Predict(::brpc::Controller* cntl,
     std::string err_msg = e.what();
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     SetStatus(response, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
   }
 
   // Set response to http body.
+  auto serialize_begin = butil::gettimeofday_us();
   cntl->http_response().set_content_type("application/json");
   cntl->response_attachment().append(Pb2json(*response));
+  if (response->status().status() == ::grps::protos::v1::Status::SUCCESS) {
+    auto serialize_end = butil::gettimeofday_us();
+    StageMetrics::Observe(SerializationMetric(request->model()), serialize_end - serialize_begin);
+    Trace::Record(Tracer::Current(), "serialize", serialize_begin, serialize_end);
+  }
 }
 
 // Parse shape and record val into flat vector from ndarray by recursive call.
@@ -394,31 +433,32 @@ static void CustomizedPredictHttp(brpc::Controller* cntl,
                                   brpc::ClosureGuard& done_guard,
                                   bool is_streaming,
                                   const std::string& model_name = "") {
-  ::grps::protos::v1::GrpsMessage req;
-  ::grps::protos::v1::GrpsMessage res;
+  RequestArena arena;
+  auto& req = *arena.CreateMessage<::grps::protos::v1::GrpsMessage>();
+  auto& res = *arena.CreateMessage<::grps::protos::v1::GrpsMessage>();
 
   if (is_streaming) {
     cntl->http_response().set_content_type(
       GlobalConfig::Instance().server_config().interface.customized_predict_http.streaming_ctrl.res_content_type);
     auto pa = cntl->CreateProgressiveAttachment();
-    auto ctx_sp = std::make_shared<GrpsContext>(&req, nullptr, &pa, cntl);
+    auto ctx_sp = GrpsContext::Acquire(&req, nullptr, &pa, cntl);
     ctx_sp->set_http_stream_done_guard(&done_guard);
     auto& ctx = *ctx_sp;
     try {
       Executor::Instance().Infer(req, res, ctx_sp, model_name);
       if (ctx.has_err()) {
-        MONITOR_AVG(REQ_FAIL_RATE, 100);
+        MONITOR_AVG(FailRateMetric(), 100);
         LOG4(ERROR, "Predict failed: " << ctx.err_msg());
       } else {
-        MONITOR_AVG(REQ_FAIL_RATE, 0);
+        MONITOR_AVG(FailRateMetric(), 0);
       }
     } catch (const std::exception& e) {
       std::string err_msg(e.what());
       LOG4(ERROR, "Predict failed: " << err_msg);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
 #ifdef GRPS_CUDA_ENABLE
       if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-        MONITOR_INC(GPU_OOM_COUNT, 1);
+        MONITOR_INC(GpuOomMetric(), 1);
       }
 #endif
       pa->Write(err_msg.c_str(), err_msg.size());
@@ -427,22 +467,22 @@ static void CustomizedPredictHttp(brpc::Controller* cntl,
   }
 
   try {
-    std::shared_ptr<GrpsContext> ctx_sp = std::make_shared<GrpsContext>(&req, nullptr, nullptr, cntl);
+    std::shared_ptr<GrpsContext> ctx_sp = GrpsContext::Acquire(&req, nullptr, nullptr, cntl);
     auto& ctx = *ctx_sp;
     Executor::Instance().Infer(req, res, ctx_sp, model_name);
     if (ctx.has_err()) {
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       LOG4(ERROR, "Predict failed: " << ctx.err_msg());
     } else {
-      MONITOR_AVG(REQ_FAIL_RATE, 0);
+      MONITOR_AVG(FailRateMetric(), 0);
     }
   } catch (const std::exception& e) {
     std::string err_msg(e.what());
     LOG4(ERROR, "Predict failed: " << err_msg);
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
     cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
@@ -540,13 +580,13 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
               "Bad Request, err: Streaming and ret ndarray are not supported at the same time.",
               ::grps::protos::v1::Status::FAILURE);
     cntl->response_attachment().append(Pb2json(res));
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     return;
   }
 
-  // Parse true request from http body.
-  auto true_req_ptr = std::make_unique<::grps::protos::v1::GrpsMessage>();
-  auto& true_req = *true_req_ptr;
+  // Parse true request from http body. Request and response messages are owned by request arena.
+  RequestArena arena;
+  auto& true_req = *arena.CreateMessage<::grps::protos::v1::GrpsMessage>();
   if (content_type == "application/json") {
     // Json2pb(cntl->request_attachment().to_string(), &true_req);
     auto body_doc_ptr = std::make_unique<rapidjson::Document>();
@@ -558,7 +598,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
       SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: Parse json failed.",
                 ::grps::protos::v1::Status::FAILURE);
       cntl->response_attachment().append(Pb2json(res));
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       return;
     }
     if (body_doc.HasMember("str_data") || body_doc.HasMember("gtensors") || body_doc.HasMember("gmap")) {
@@ -568,7 +608,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
         ::grps::protos::v1::GrpsMessage res;
         SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: " + err, ::grps::protos::v1::Status::FAILURE);
         cntl->response_attachment().append(Pb2json(res));
-        MONITOR_AVG(REQ_FAIL_RATE, 100);
+        MONITOR_AVG(FailRateMetric(), 100);
         return;
       }
     } else if (body_doc.HasMember("ndarray")) {
@@ -583,7 +623,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
           SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: " + err,
                     ::grps::protos::v1::Status::FAILURE);
           cntl->response_attachment().append(Pb2json(res));
-          MONITOR_AVG(REQ_FAIL_RATE, 100);
+          MONITOR_AVG(FailRateMetric(), 100);
           return;
         }
       } else {
@@ -592,7 +632,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
         SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: NDArray is not number or array.",
                   ::grps::protos::v1::Status::FAILURE);
         cntl->response_attachment().append(Pb2json(res));
-        MONITOR_AVG(REQ_FAIL_RATE, 100);
+        MONITOR_AVG(FailRateMetric(), 100);
         return;
       }
     } else if (body_doc.HasMember("bin_data")) {
@@ -602,7 +642,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
                 "Bad Request, err: bin_data should use application/octet-stream format.",
                 ::grps::protos::v1::Status::FAILURE);
       cntl->response_attachment().append(Pb2json(res));
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       return;
     } else {
       LOG4(ERROR, "Have no legal member in json body.");
@@ -610,7 +650,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
       SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: Have no legal member in json body.",
                 ::grps::protos::v1::Status::FAILURE);
       cntl->response_attachment().append(Pb2json(res));
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
       return;
     }
     // Get model name from json body if exist and override model query arg.
@@ -626,7 +666,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
     SetStatus(&res, brpc::HTTP_STATUS_BAD_REQUEST, "Bad Request, err: Content type is not supported.",
               ::grps::protos::v1::Status::FAILURE);
     cntl->response_attachment().append(Pb2json(res));
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
     return;
   }
 #ifdef GRPS_DEBUG
@@ -634,35 +674,35 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
   ::google::protobuf::TextFormat::PrintToString(true_req, &pb_str);
   LOG4(INFO, "True predict request: " << pb_str);
 #endif
+  RequestRecorder::Instance().Sample(true_req, model);
 
   // Streaming predict.
-  auto true_res_ptr = std::make_unique<::grps::protos::v1::GrpsMessage>();
-  auto& true_res = *true_res_ptr;
+  auto& true_res = *arena.CreateMessage<::grps::protos::v1::GrpsMessage>();
   if (is_streaming) {
     cntl->http_response().set_content_type(
       GlobalConfig::Instance().server_config().interface.customized_predict_http.streaming_ctrl.res_content_type);
     auto pa = cntl->CreateProgressiveAttachment();
     done_guard.reset(nullptr);
-    auto ctx_sp = std::make_shared<GrpsContext>(&true_req, nullptr, &pa, cntl);
+    auto ctx_sp = GrpsContext::Acquire(&true_req, nullptr, &pa, cntl);
     auto& ctx = *ctx_sp;
     try {
       Executor::Instance().Infer(true_req, true_res, ctx_sp, model);
       if (ctx.has_err()) {
         SetStatus(&true_res, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, ctx.err_msg(),
                   ::grps::protos::v1::Status::FAILURE);
-        MONITOR_AVG(REQ_FAIL_RATE, 100);
+        MONITOR_AVG(FailRateMetric(), 100);
         LOG4(ERROR, "Predict failed: " << ctx.err_msg());
       } else {
-        MONITOR_AVG(REQ_FAIL_RATE, 0);
+        MONITOR_AVG(FailRateMetric(), 0);
         return;
       }
     } catch (const std::exception& e) {
       std::string err_msg(e.what());
       LOG4(ERROR, "Predict failed: " << err_msg);
-      MONITOR_AVG(REQ_FAIL_RATE, 100);
+      MONITOR_AVG(FailRateMetric(), 100);
 #ifdef GRPS_CUDA_ENABLE
       if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-        MONITOR_INC(GPU_OOM_COUNT, 1);
+        MONITOR_INC(GpuOomMetric(), 1);
       }
 #endif
       SetStatus(&true_res, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
@@ -674,7 +714,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
   // Predict.
   bool has_err = false;
   try {
-    auto ctx_sp = std::make_shared<GrpsContext>(&true_req, nullptr, nullptr, cntl);
+    auto ctx_sp = GrpsContext::Acquire(&true_req, nullptr, nullptr, cntl);
     auto& ctx = *ctx_sp;
     Executor::Instance().Infer(true_req, true_res, ctx_sp, model);
     if (ctx.has_err()) {
@@ -687,10 +727,10 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
   } catch (const std::exception& e) {
     std::string err_msg(e.what());
     LOG4(ERROR, "Predict failed: " << err_msg);
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
 #ifdef GRPS_CUDA_ENABLE
     if (err_msg.find("CUDA out of memory") != std::string::npos || err_msg.find("OOM") != std::string::npos) {
-      MONITOR_INC(GPU_OOM_COUNT, 1);
+      MONITOR_INC(GpuOomMetric(), 1);
     }
 #endif
     SetStatus(&true_res, brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR, e.what(), ::grps::protos::v1::Status::FAILURE);
@@ -700,6 +740,7 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
   }
 
   // Set response to http body.
+  auto serialize_begin = butil::gettimeofday_us();
   if (ret_ndarray) { // return ndarray format.
     auto res_doc_ptr = std::make_unique<rapidjson::Document>();
     auto& res_doc = *res_doc_ptr;
@@ -765,16 +806,27 @@ void GrpsHttpHandler::PredictByHttp(::brpc::Controller* cntl,
     }
   }
   if (has_err) {
-    MONITOR_AVG(REQ_FAIL_RATE, 100);
+    MONITOR_AVG(FailRateMetric(), 100);
   } else {
-    MONITOR_AVG(REQ_FAIL_RATE, 0);
+    MONITOR_AVG(FailRateMetric(), 0);
+    auto serialize_end = butil::gettimeofday_us();
+    StageMetrics::Observe(SerializationMetric(model), serialize_end - serialize_begin);
+    Trace::Record(Tracer::Current(), "serialize", serialize_begin, serialize_end);
+  }
+
+  auto* trace = Tracer::Current();
+  if (trace != nullptr) {
+    // Send response now, so that writing response is traced.
+    auto respond_begin = butil::gettimeofday_us();
+    done_guard.reset(nullptr);
+    trace->AddSpan("respond", respond_begin, butil::gettimeofday_us());
   }
 }
 
 void GrpsHttpHandler::Online(::brpc::Controller* cntl,
                              const ::grps::protos::v1::GrpsMessage* request,
                              ::grps::protos::v1::GrpsMessage* response) {
-  online_status = true;
+  offline_status = false;
   SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
   cntl->http_response().set_content_type("application/json");
   cntl->response_attachment().append(Pb2json(*response));
@@ -783,7 +835,7 @@ void GrpsHttpHandler::Online(::brpc::Controller* cntl,
 void GrpsHttpHandler::Offline(::brpc::Controller* cntl,
                               const ::grps::protos::v1::GrpsMessage* request,
                               ::grps::protos::v1::GrpsMessage* response) {
-  online_status = false;
+  offline_status = true;
   SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
   cntl->http_response().set_content_type("application/json");
   cntl->response_attachment().append(Pb2json(*response));
@@ -800,7 +852,8 @@ void GrpsHttpHandler::CheckLiveness(::brpc::Controller* cntl,
 void GrpsHttpHandler::CheckReadiness(::brpc::Controller* cntl,
                                      const ::grps::protos::v1::GrpsMessage* request,
                                      ::grps::protos::v1::GrpsMessage* response) {
-  if (online_status) {
+  // Ready after models warmed up, unless set offline.
+  if (!offline_status && Executor::Instance().warmed_up()) {
     SetStatus(response, brpc::HTTP_STATUS_OK, "OK", ::grps::protos::v1::Status::SUCCESS);
   } else {
     SetStatus(response, brpc::HTTP_STATUS_SERVICE_UNAVAILABLE, "Service Unavailable",
@@ -24,6 +24,10 @@
 #include "logger/logger.h"
 #include "mem_manager/gpu_mem_mgr.h"
 #include "monitor/monitor.h"
+#include "monitor/request_recorder.h"
+#include "monitor/trace.h"
+#include "service/admin_service.h"
+#include "service/debug_service.h"
 #include "service/grps_service.h"
 #include "service/js_service.h"
 #include "service/monitor_service.h"
@@ -85,6 +89,22 @@ int main(int argc, char** argv) {
   Monitor::Instance().Init();
   Monitor::Instance().Start();
   LOG4(INFO, "Start monitor success.");
+  if (server_config._is_set.trace) {
+    Tracer::Instance().Init(server_config.trace.sample_rate, server_config.trace.max_traces);
+  }
+  if (server_config._is_set.request_recorder &&
+      !RequestRecorder::Instance().Init(server_config.log.log_dir + "/grps_requests.rec",
+                                        server_config.request_recorder.sample_rate,
+                                        int64_t(server_config.request_recorder.max_file_size_mib) * 1024 * 1024,
+                                        server_config.request_recorder.max_files)) {
+    LOG4(FATAL, "Init request recorder failed.");
+    abort();
+  }
+  if (server_config._is_set.request_recorder && server_config.request_recorder.sample_rate > 0 &&
+      server_config._is_set.customized_predict_http &&
+      server_config.interface.customized_predict_http.customized_body) {
+    LOG4(WARN, "Customized http body cannot be converted to GrpsMessage, http predict requests will not be recorded.");
+  }
 
   // System monitor: cpu & gpu
   try {
@@ -266,7 +286,8 @@ int main(int argc, char** argv) {
         customized_path == "/grps/v1/health/ready" || customized_path == "/grps/v1/metadata/server" ||
         customized_path == "/grps/v1/metadata/model" || customized_path == "/grps/v1/js/jquery_min" ||
         customized_path == "/grps/v1/js/flot_min" || customized_path == "/grps/v1/monitor/series" ||
-        customized_path == "/grps/v1/monitor/metrics" || customized_path == "/") {
+        customized_path == "/grps/v1/monitor/metrics" || customized_path == "/grps/v1/monitor/prometheus" ||
+        customized_path == "/grps/v1/monitor/trace" || customized_path == "/") {
       LOG4(FATAL, "Invalid customized path: " << customized_path << ", cannot use internal path.");
       abort();
     }
@@ -293,6 +314,8 @@ int main(int argc, char** argv) {
   MonitorServiceImpl monitor_service;
   if (server.AddService(&monitor_service, brpc::SERVER_DOESNT_OWN_SERVICE,
                         "/grps/v1/monitor/series => SeriesData,"
+                        "/grps/v1/monitor/prometheus => Prometheus,"
+                        "/grps/v1/monitor/trace => Trace,"
                         "/ => Metrics,"
                         "/grps/v1/monitor/metrics => Metrics") != 0) {
     LOG4(FATAL, "Fail to add monitor http service.");
@@ -300,6 +323,37 @@ int main(int argc, char** argv) {
   }
   LOG4(INFO, "Add monitor http service success, port: " << http_port);
 
+  // Debug server on a separate port with authentication, builtin and admin services are only enabled here.
+  brpc::Server debug_server;
+  std::unique_ptr<TokenAuthenticator> debug_authenticator;
+  DebugServiceImpl debug_service;
+  AdminServiceImpl admin_service;
+  if (server_config._is_set.debug_server) {
+    debug_server.set_version(GRPS_VERSION);
+    debug_authenticator = std::make_unique<TokenAuthenticator>(server_config.debug_server.auth_token);
+    brpc::ServerOptions debug_options;
+    debug_options.auth = debug_authenticator.get();
+    debug_options.has_builtin_services = true;
+    if (debug_server.AddService(&debug_service, brpc::SERVER_DOESNT_OWN_SERVICE,
+                                "/grps/v1/debug/cpu => CpuProfile,"
+                                "/grps/v1/debug/heap => HeapProfile") != 0) {
+      LOG4(FATAL, "Fail to add debug http service.");
+      abort();
+    }
+    if (debug_server.AddService(&admin_service, brpc::SERVER_DOESNT_OWN_SERVICE,
+                                "/grps/v1/admin/reload => ReloadModels,"
+                                "/grps/v1/admin/profile => Profile") != 0) {
+      LOG4(FATAL, "Fail to add admin http service.");
+      abort();
+    }
+    std::string debug_address = server_config.debug_server.host + ":" + std::to_string(server_config.debug_server.port);
+    if (debug_server.Start(debug_address.c_str(), &debug_options) != 0) {
+      LOG4(FATAL, "Fail to start debug server, address: " << debug_address);
+      abort();
+    }
+    LOG4(INFO, "Start debug server success, address: " << debug_address);
+  }
+
   // Start http server.
   std::string server_address = host + ":" + std::to_string(http_port);
   if (server.Start(server_address.c_str(), &options) != 0) {
@@ -309,6 +363,11 @@ int main(int argc, char** argv) {
 
   // Wait until Ctrl-C is pressed, then Stop() and Join() the server.
   server.RunUntilAskedToQuit();
+  if (server_config._is_set.debug_server) {
+    debug_server.Stop(0);
+    debug_server.Join();
+  }
+  RequestRecorder::Instance().Stop();
   Executor::Instance().Terminate();
   MPI_Finalize();
   return 0;
@@ -10,6 +10,8 @@
 #include <utility>
 
 #include "batching/batcher.h"
+#include "cache/response_cache.h"
+#include "cache/single_flight.h"
 #include "converter/converter.h"
 #include "model_infer/inferer.h"
 
@@ -20,16 +22,22 @@ struct Model {
   std::shared_ptr<Converter> converter_;
   std::shared_ptr<ModelInferer> inferer_;
   std::shared_ptr<Batcher> batcher_;
-  Model() : converter_(nullptr), inferer_(nullptr), batcher_(nullptr) {}
+  std::shared_ptr<ResponseCache> cache_;
+  std::shared_ptr<SingleFlight> single_flight_;
+  Model() : converter_(nullptr), inferer_(nullptr), batcher_(nullptr), cache_(nullptr), single_flight_(nullptr) {}
   Model(std::string name,
         std::string version,
         std::shared_ptr<Converter> converter,
         std::shared_ptr<ModelInferer> inferer,
-        std::shared_ptr<Batcher> batcher)
+        std::shared_ptr<Batcher> batcher,
+        std::shared_ptr<ResponseCache> cache = nullptr,
+        std::shared_ptr<SingleFlight> single_flight = nullptr)
       : name_(std::move(name))
       , version_(std::move(version))
       , converter_(std::move(converter))
       , inferer_(std::move(inferer))
-      , batcher_(std::move(batcher)) {}
+      , batcher_(std::move(batcher))
+      , cache_(std::move(cache))
+      , single_flight_(std::move(single_flight)) {}
 };
 } // namespace netease::grps
\ No newline at end of file
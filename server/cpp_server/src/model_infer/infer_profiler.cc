@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/22
+ * Brief  Inference profiler.
+ */
+
+#include "infer_profiler.h"
+
+#include <butil/file_util.h>
+#include <butil/files/file_path.h>
+
+#include <algorithm>
+#include <ctime>
+
+#include "config/global_config.h"
+#include "logger/logger.h"
+
+namespace netease::grps {
+std::shared_ptr<InferProfiler::Counter> InferProfiler::Register(const std::string& model) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto& counter = counters_[model];
+  if (!counter) {
+    counter = std::make_shared<Counter>(0);
+  }
+  return counter;
+}
+
+bool InferProfiler::Arm(const std::string& model, int n) {
+  std::shared_ptr<Counter> counter;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto iter = counters_.find(model);
+    if (iter == counters_.end()) {
+      return false;
+    }
+    counter = iter->second;
+  }
+  counter->store(std::max(n, 0), std::memory_order_relaxed);
+  LOG4(INFO, "Profile next " << n << " requests of model: " << model << ", dir: " << dir());
+  return true;
+}
+
+std::string InferProfiler::dir() const {
+  return GlobalConfig::Instance().server_config().log.log_dir + "/profiler";
+}
+
+std::string InferProfiler::AcquireSlow(Counter& counter, const std::string& model) {
+  int remain = counter.load(std::memory_order_relaxed);
+  while (remain > 0 && !counter.compare_exchange_weak(remain, remain - 1, std::memory_order_relaxed)) {
+  }
+  if (remain <= 0) {
+    return {};
+  }
+
+  auto profiler_dir = dir();
+  butil::File::Error error;
+  if (!butil::CreateDirectoryAndGetError(butil::FilePath(profiler_dir), &error)) {
+    LOG4(ERROR, "Create profiler dir failed, dir: " << profiler_dir << ", error: " << error);
+    return {};
+  }
+
+  time_t now = time(nullptr);
+  struct tm tm_now {};
+  localtime_r(&now, &tm_now);
+  char time_str[32];
+  strftime(time_str, sizeof(time_str), "%Y%m%d-%H%M%S", &tm_now);
+  std::string file_name = model;
+  std::replace(file_name.begin(), file_name.end(), '/', '_');
+  return profiler_dir + "/" + file_name + "-" + time_str + "-" +
+         std::to_string(seq_.fetch_add(1, std::memory_order_relaxed));
+}
+} // namespace netease::grps
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/22
+ * Brief  Inference profiler. Profiling of a model is armed by admin interface for its next n requests, which are
+ *        inferred with `InferWithProfiler` or `BatchInferWithProfiler` of model inferer, and operator-level traces are
+ *        written to `${log_dir}/profiler/` for offline analysis. Other requests are not affected.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace netease::grps {
+class InferProfiler {
+public:
+  using Counter = std::atomic<int>;
+
+  ~InferProfiler() = default;
+  InferProfiler(const InferProfiler&) = delete;
+  InferProfiler& operator=(const InferProfiler&) = delete;
+  InferProfiler(InferProfiler&&) = delete;
+  InferProfiler& operator=(InferProfiler&&) = delete;
+
+  static InferProfiler& Instance() {
+    static InferProfiler instance;
+    return instance;
+  }
+
+  /**
+   * @brief Register model whose inferer supports profiler. Counter of the same model is shared across reloads.
+   * @param model: Model name with `name-version` format.
+   * @return Counter of requests to be profiled of model.
+   */
+  std::shared_ptr<Counter> Register(const std::string& model);
+
+  /**
+   * @brief Profile next n requests of model, 0 means canceling profiling.
+   * @param model: Model name with `name-version` format.
+   * @param n: Number of requests to be profiled.
+   * @return False if model is not registered.
+   */
+  bool Arm(const std::string& model, int n);
+
+  /**
+   * @brief Acquire profiler path of current request.
+   * @param counter: Counter of model, returned by `Register`.
+   * @param model: Model name with `name-version` format.
+   * @return Profiler path(without suffix) of current request, empty if current request is not profiled. Only one atomic
+   * load when not profiling.
+   */
+  static std::string Acquire(Counter* counter, const std::string& model) {
+    if (counter == nullptr || counter->load(std::memory_order_relaxed) <= 0) {
+      return {};
+    }
+    return Instance().AcquireSlow(*counter, model);
+  }
+
+  // Directory of profiler traces.
+  [[nodiscard]] std::string dir() const;
+
+private:
+  std::mutex mtx_;
+  std::unordered_map<std::string, std::shared_ptr<Counter>> counters_;
+  std::atomic<uint64_t> seq_{0};
+
+  InferProfiler() = default;
+
+  std::string AcquireSlow(Counter& counter, const std::string& model);
+};
+} // namespace netease::grps
@@ -85,9 +85,14 @@ public:
   }
 
   /**
-   * Not support now.
+   * @brief If inferer supports profiler. Requests armed by `/grps/v1/admin/profile` are inferred with `*WithProfiler`
+   * instead of `Infer` and `BatchInfer` only if supported.
+   */
+  [[nodiscard]] virtual bool SupportProfiler() const { return false; }
+
+  /**
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix, operator-level traces should be written to it.
    * @param inputs: Input tensor of model.
    * @param outputs: Output tensor of model.
    * @param ctx: Context of current request.
@@ -116,9 +121,8 @@ public:
   }
 
   /**
-   * Not support now.
    * @brief Infer model in batch with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix, operator-level traces should be written to it.
    * @param inputs: Input tensor of model in batch.
    * @param outputs: Output tensor of model in batch.
    * @param ctxs: Contexts of each request in batch.
@@ -150,9 +154,9 @@ public:
   }
 
   /**
-   * Not support now. Used when in `no converter mode`. Input and output are directly GrpsMessage.
+   * Used when in `no converter mode`. Input and output are directly GrpsMessage.
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix, operator-level traces should be written to it.
    * @param input: Input.
    * @param output: Output.
    * @param ctx: Context of current request.
@@ -181,8 +185,8 @@ public:
   }
 
   /**
-   * Not support now. Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
-   * @param profiler_path: Profiler path.
+   * Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
+   * @param profiler_path: Profiler path without suffix, operator-level traces should be written to it.
    * @param inputs: Inputs in batch.
    * @param outputs: Outputs in batch.
    * @param ctxs: Contexts of each request in batch.
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/21
+ * Brief  Replica inferer.
+ */
+
+#include "replica_inferer.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/thread/future.hpp>
+#include <sstream>
+
+#include "logger/logger.h"
+
+namespace netease::grps {
+ReplicaInferer::PinnedWorker::PinnedWorker(const std::vector<int>& cpus) {
+  // One thread per cpu, all of them can run on any cpu of the replica.
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    threads_.emplace_back([this, cpus] {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (auto cpu : cpus) {
+        CPU_SET(cpu, &cpu_set);
+      }
+      int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+      if (ret != 0) {
+        LOG4(WARN, "Set cpu affinity of replica thread failed, ret: " << ret);
+      }
+
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mtx_);
+          cv_.wait(lock, [this] { return !tasks_.empty() || !running_; });
+          if (tasks_.empty()) {
+            return;
+          }
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        task();
+      }
+    });
+  }
+}
+
+ReplicaInferer::PinnedWorker::~PinnedWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ReplicaInferer::PinnedWorker::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tasks_.emplace_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+ReplicaInferer::ReplicaInferer(std::vector<std::shared_ptr<ModelInferer>> replicas,
+                               Dispatch dispatch,
+                               const std::vector<std::string>& replica_cpus)
+    : dispatch_(dispatch), replica_cpus_(replica_cpus) {
+  if (replicas.empty()) {
+    throw InfererException("Replica inferer needs at least one replica.");
+  }
+  if (!replica_cpus.empty() && replica_cpus.size() != replicas.size()) {
+    throw InfererException("Cpu list size should be equal to replica number.");
+  }
+  for (size_t i = 0; i < replicas.size(); ++i) {
+    auto replica = std::make_unique<Replica>();
+    replica->inferer = std::move(replicas[i]);
+    if (!replica_cpus.empty()) {
+      replica->worker = std::make_unique<PinnedWorker>(ParseCpus(replica_cpus[i]));
+    }
+    replicas_.emplace_back(std::move(replica));
+  }
+}
+
+ReplicaInferer::~ReplicaInferer() {
+  // Stop pinned threads before releasing inferers.
+  for (auto& replica : replicas_) {
+    replica->worker.reset();
+  }
+}
+
+ModelInferer* ReplicaInferer::Clone() {
+  std::vector<std::shared_ptr<ModelInferer>> replicas;
+  for (const auto& replica : replicas_) {
+    replicas.emplace_back(replica->inferer->Clone());
+  }
+  return new ReplicaInferer(std::move(replicas), dispatch_, replica_cpus_);
+}
+
+void ReplicaInferer::Init(const std::string& path, const std::string& device, const YAML::Node& args) {
+  ModelInferer::Init(path, device, args);
+  for (auto& replica : replicas_) {
+    replica->inferer->Init(path, device, args);
+  }
+}
+
+void ReplicaInferer::Load() {
+  for (size_t i = 0; i < replicas_.size(); ++i) {
+    auto& replica = *replicas_[i];
+    if (replica.worker) {
+      // Load on pinned threads, so that memory is first touched on numa node of the cpus.
+      boost::promise<void> promise;
+      auto future = promise.get_future();
+      replica.worker->Post([&replica, &promise] {
+        try {
+          replica.inferer->Load();
+          promise.set_value();
+        } catch (...) {
+          promise.set_exception(boost::current_exception());
+        }
+      });
+      future.get();
+    } else {
+      replica.inferer->Load();
+    }
+    LOG4(INFO, "Load replica: " << i << " successfully"
+                                << (replica_cpus_.empty() ? "." : ", cpus: " + replica_cpus_[i] + "."));
+  }
+}
+
+void ReplicaInferer::Infer(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                           std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                           GrpsContext& ctx) {
+  Run([&](ModelInferer& inferer) { inferer.Infer(inputs, outputs, ctx); });
+}
+
+void ReplicaInferer::BatchInfer(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                                std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                                std::vector<GrpsContext*>& ctxs) {
+  Run([&](ModelInferer& inferer) { inferer.BatchInfer(inputs, outputs, ctxs); });
+}
+
+void ReplicaInferer::Infer(const ::grps::protos::v1::GrpsMessage& input,
+                           ::grps::protos::v1::GrpsMessage& output,
+                           GrpsContext& ctx) {
+  Run([&](ModelInferer& inferer) { inferer.Infer(input, output, ctx); });
+}
+
+void ReplicaInferer::BatchInfer(std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
+                                std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
+                                std::vector<GrpsContext*>& ctxs) {
+  Run([&](ModelInferer& inferer) { inferer.BatchInfer(inputs, outputs, ctxs); });
+}
+
+bool ReplicaInferer::SupportProfiler() const {
+  return replicas_.front()->inferer->SupportProfiler();
+}
+
+void ReplicaInferer::InferWithProfiler(const std::string& profiler_path,
+                                       const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                                       std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                                       GrpsContext& ctx) {
+  Run([&](ModelInferer& inferer) { inferer.InferWithProfiler(profiler_path, inputs, outputs, ctx); });
+}
+
+void ReplicaInferer::BatchInferWithProfiler(const std::string& profiler_path,
+                                            const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                                            std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                                            std::vector<GrpsContext*>& ctxs) {
+  Run([&](ModelInferer& inferer) { inferer.BatchInferWithProfiler(profiler_path, inputs, outputs, ctxs); });
+}
+
+void ReplicaInferer::InferWithProfiler(const std::string& profiler_path,
+                                       const ::grps::protos::v1::GrpsMessage& input,
+                                       ::grps::protos::v1::GrpsMessage& output,
+                                       GrpsContext& ctx) {
+  Run([&](ModelInferer& inferer) { inferer.InferWithProfiler(profiler_path, input, output, ctx); });
+}
+
+void ReplicaInferer::BatchInferWithProfiler(const std::string& profiler_path,
+                                            std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
+                                            std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
+                                            std::vector<GrpsContext*>& ctxs) {
+  Run([&](ModelInferer& inferer) { inferer.BatchInferWithProfiler(profiler_path, inputs, outputs, ctxs); });
+}
+
+ReplicaInferer::Replica& ReplicaInferer::Pick() {
+  auto start = next_.fetch_add(1, std::memory_order_relaxed);
+  if (dispatch_ == Dispatch::kRoundRobin) {
+    return *replicas_[start % replicas_.size()];
+  }
+
+  // Least loaded, scan from round robin position so that ties are spread.
+  Replica* picked = nullptr;
+  for (size_t i = 0; i < replicas_.size(); ++i) {
+    auto* replica = replicas_[(start + i) % replicas_.size()].get();
+    if (picked == nullptr || replica->inflight < picked->inflight) {
+      picked = replica;
+    }
+  }
+  return *picked;
+}
+
+void ReplicaInferer::Run(const std::function<void(ModelInferer&)>& fn) {
+  auto& replica = Pick();
+  ++replica.inflight;
+  try {
+    if (replica.worker) {
+      boost::promise<void> promise;
+      auto future = promise.get_future();
+      replica.worker->Post([&replica, &fn, &promise] {
+        try {
+          fn(*replica.inferer);
+          promise.set_value();
+        } catch (...) {
+          promise.set_exception(boost::current_exception());
+        }
+      });
+      future.get();
+    } else {
+      fn(*replica.inferer);
+    }
+  } catch (...) {
+    --replica.inflight;
+    throw;
+  }
+  --replica.inflight;
+}
+
+std::vector<int> ReplicaInferer::ParseCpus(const std::string& cpus) {
+  std::vector<int> result;
+  std::stringstream ss(cpus);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    try {
+      auto pos = item.find('-');
+      if (pos == std::string::npos) {
+        result.emplace_back(std::stoi(item));
+        continue;
+      }
+      int begin = std::stoi(item.substr(0, pos));
+      int end = std::stoi(item.substr(pos + 1));
+      if (begin > end) {
+        throw InfererException("Invalid cpu range: " + item);
+      }
+      for (int cpu = begin; cpu <= end; ++cpu) {
+        result.emplace_back(cpu);
+      }
+    } catch (const std::logic_error&) {
+      throw InfererException("Invalid cpu list: " + cpus);
+    }
+  }
+  for (auto cpu : result) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      throw InfererException("Invalid cpu: " + std::to_string(cpu) + " of cpu list: " + cpus);
+    }
+  }
+  if (result.empty()) {
+    throw InfererException("Empty cpu list.");
+  }
+  return result;
+}
+} // namespace netease::grps
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/21
+ * Brief  Replica inferer, run requests of one model on multiple inferer instances. Requests are dispatched to replicas
+ *        in round robin or least loaded order. Replica pinned to cpus runs requests on its own threads bound to them.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model_infer/inferer.h"
+
+namespace netease::grps {
+class ReplicaInferer : public ModelInferer {
+public:
+  enum class Dispatch { kRoundRobin = 0, kLeastLoaded = 1 };
+
+  /**
+   * @brief Replica inferer constructor.
+   * @param replicas: Inferer instances, created by Clone() of the first one.
+   * @param dispatch: Dispatch policy.
+   * @param replica_cpus: Cpu list(such as `0-15,32`) pinned by each replica, empty means not pinned.
+   */
+  ReplicaInferer(std::vector<std::shared_ptr<ModelInferer>> replicas,
+                 Dispatch dispatch,
+                 const std::vector<std::string>& replica_cpus = {});
+  ~ReplicaInferer() override;
+  ReplicaInferer(const ReplicaInferer&) = delete;
+  ReplicaInferer& operator=(const ReplicaInferer&) = delete;
+  ReplicaInferer(ReplicaInferer&&) = delete;
+  ReplicaInferer& operator=(ReplicaInferer&&) = delete;
+
+  ModelInferer* Clone() override;
+
+  void Init(const std::string& path, const std::string& device, const YAML::Node& args) override;
+
+  void Load() override;
+
+  void Infer(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+             std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+             GrpsContext& ctx) override;
+
+  void BatchInfer(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                  std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                  std::vector<GrpsContext*>& ctxs) override;
+
+  void Infer(const ::grps::protos::v1::GrpsMessage& input,
+             ::grps::protos::v1::GrpsMessage& output,
+             GrpsContext& ctx) override;
+
+  void BatchInfer(std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
+                  std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
+                  std::vector<GrpsContext*>& ctxs) override;
+
+  [[nodiscard]] bool SupportProfiler() const override;
+
+  void InferWithProfiler(const std::string& profiler_path,
+                         const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                         std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                         GrpsContext& ctx) override;
+
+  void BatchInferWithProfiler(const std::string& profiler_path,
+                              const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                              std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                              std::vector<GrpsContext*>& ctxs) override;
+
+  void InferWithProfiler(const std::string& profiler_path,
+                         const ::grps::protos::v1::GrpsMessage& input,
+                         ::grps::protos::v1::GrpsMessage& output,
+                         GrpsContext& ctx) override;
+
+  void BatchInferWithProfiler(const std::string& profiler_path,
+                              std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
+                              std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
+                              std::vector<GrpsContext*>& ctxs) override;
+
+  /**
+   * @brief Parse cpu list, such as `0-15,32`.
+   * @throw InfererException: If cpu list is invalid.
+   */
+  static std::vector<int> ParseCpus(const std::string& cpus);
+
+  [[nodiscard]] size_t replica_num() const { return replicas_.size(); }
+
+private:
+  // Threads bound to cpus of one replica.
+  class PinnedWorker {
+  public:
+    explicit PinnedWorker(const std::vector<int>& cpus);
+    ~PinnedWorker();
+    void Post(std::function<void()> task);
+
+  private:
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool running_ = true;
+  };
+
+  struct Replica {
+    std::shared_ptr<ModelInferer> inferer;
+    std::atomic<int> inflight{0};
+    std::unique_ptr<PinnedWorker> worker; // Null if not pinned.
+  };
+
+  // Run fn on one replica chosen by dispatch policy, on its pinned threads if has.
+  void Run(const std::function<void(ModelInferer&)>& fn);
+  Replica& Pick();
+
+  std::vector<std::unique_ptr<Replica>> replicas_;
+  Dispatch dispatch_;
+  std::vector<std::string> replica_cpus_;
+  std::atomic<size_t> next_{0};
+};
+} // namespace netease::grps
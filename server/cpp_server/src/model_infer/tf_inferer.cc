@@ -12,6 +12,7 @@
 #include <tensorflow/cc/saved_model/signature_constants.h>
 #include <tensorflow/cc/saved_model/tag_constants.h>
 #include <tensorflow/core/framework/tensor.h>
+#include <tensorflow/core/platform/env.h>
 
 #include <regex>
 
@@ -154,6 +155,12 @@ void TfModelInferer::Load() {
 void TfModelInferer::Infer(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
                            std::vector<std::pair<std::string, TensorWrapper>>& outputs,
                            GrpsContext& context) {
+  Run(inputs, outputs, "");
+}
+
+void TfModelInferer::Run(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+                         std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+                         const std::string& profiler_path) {
   std::vector<std::pair<std::string, tensorflow::Tensor>> tf_inputs;
   std::vector<tensorflow::Tensor> tf_outputs;
 
@@ -186,6 +193,9 @@ void TfModelInferer::Infer(const std::vector<std::pair<std::string, TensorWrappe
   try {
     tensorflow::RunMetadata run_metadata;
     auto run_options = tensorflow::RunOptions();
+    if (!profiler_path.empty()) {
+      run_options.set_trace_level(tensorflow::RunOptions::FULL_TRACE);
+    }
     tensorflow::Status status =
       bundle_->session->Run(run_options, tf_inputs, out_tensor_names_, {}, &tf_outputs, &run_metadata);
     if (!status.ok()) {
@@ -193,6 +203,18 @@ void TfModelInferer::Infer(const std::vector<std::pair<std::string, TensorWrappe
       throw InfererException("Failed to infer model, error: " + status.error_message());
     }
 
+    if (!profiler_path.empty()) {
+      // Step stats of each op, can be converted to chrome trace by `tensorflow.python.client.timeline`.
+      auto metadata_path = profiler_path + ".run_metadata.pb";
+      auto write_status = tensorflow::WriteBinaryProto(tensorflow::Env::Default(), metadata_path, run_metadata);
+      if (write_status.ok()) {
+        LOG4(INFO, "Tensorflow profiler trace saved, path: " << metadata_path);
+      } else {
+        LOG4(WARN, "Failed to save tensorflow profiler trace, path: " << metadata_path
+                                                                        << ", error: " << write_status.error_message());
+      }
+    }
+
     if (tf_outputs.size() != out_tensor_names_.size()) {
       LOG4(ERROR, "Failed to infer model, error: output size not match");
       throw InfererException("Failed to infer model, error: output size not match");
@@ -231,14 +253,14 @@ void TfModelInferer::InferWithProfiler(const std::string& profiler_path,
                                        const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
                                        std::vector<std::pair<std::string, TensorWrapper>>& outputs,
                                        GrpsContext& context) {
-  throw InfererException("Not support now.");
+  Run(inputs, outputs, profiler_path);
 }
 
 void TfModelInferer::BatchInferWithProfiler(const std::string& profiler_path,
                                             const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
                                             std::vector<std::pair<std::string, TensorWrapper>>& outputs,
                                             std::vector<GrpsContext*>& ctxs) {
-  throw InfererException("Not support now.");
+  InferWithProfiler(profiler_path, inputs, outputs, *ctxs[0]);
 }
 
 // --------------------------------------- No converter mode [BEGIN] ---------------------------------------
@@ -257,7 +279,11 @@ void TfModelInferer::InferWithProfiler(const std::string& profiler_path,
                                        const ::grps::protos::v1::GrpsMessage& inputs,
                                        ::grps::protos::v1::GrpsMessage& outputs,
                                        GrpsContext& context) {
-  throw InfererException("Not support now.");
+  std::vector<std::pair<std::string, TensorWrapper>> input_tensors;
+  std::vector<std::pair<std::string, TensorWrapper>> output_tensors;
+  tf_converter_.PreProcess(inputs, input_tensors, context);
+  InferWithProfiler(profiler_path, input_tensors, output_tensors, context);
+  tf_converter_.PostProcess(output_tensors, outputs, context);
 }
 
 void TfModelInferer::BatchInfer(std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
@@ -274,7 +300,11 @@ void TfModelInferer::BatchInferWithProfiler(const std::string& profiler_path,
                                             std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
                                             std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
                                             std::vector<netease::grps::GrpsContext*>& ctxs) {
-  throw InfererException("Not support now.");
+  std::vector<std::pair<std::string, TensorWrapper>> input_tensors;
+  std::vector<std::pair<std::string, TensorWrapper>> output_tensors;
+  tf_converter_.BatchPreProcess(inputs, input_tensors, ctxs);
+  BatchInferWithProfiler(profiler_path, input_tensors, output_tensors, ctxs);
+  tf_converter_.BatchPostProcess(output_tensors, outputs, ctxs);
 }
 
 // --------------------------------------- No converter mode [END] ---------------------------------------
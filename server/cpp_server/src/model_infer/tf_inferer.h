@@ -52,10 +52,13 @@ public:
              std::vector<std::pair<std::string, TensorWrapper>>& outputs,
              GrpsContext& ctx) override;
 
+  // Profiled requests are run with full trace of tensorflow session.
+  [[nodiscard]] bool SupportProfiler() const override { return true; }
+
   /**
-   * Not support now.
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix, `RunMetadata` with step stats of full trace is written
+   * to `${profiler_path}.run_metadata.pb`.
    * @param inputs: Input tensor of model.
    * @param outputs: Output tensor of model.
    * @param ctx: Context of current request.
@@ -80,9 +83,8 @@ public:
                   std::vector<GrpsContext*>& ctxs) override;
 
   /**
-   * Not support now.
    * @brief Infer model in batch with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix.
    * @param inputs: Input tensor of model in batch.
    * @param outputs: Output tensor of model in batch.
    * @param ctxs: Contexts of each request in batch.
@@ -110,9 +112,9 @@ public:
              GrpsContext& ctx) override;
 
   /**
-   * Not support now. Used when in `no converter mode`. Input and output are directly GrpsMessage.
+   * Used when in `no converter mode`. Input and output are directly GrpsMessage.
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix.
    * @param input: Input.
    * @param output: Output.
    * @param ctx: Context of current request.
@@ -137,8 +139,8 @@ public:
                   std::vector<GrpsContext*>& ctxs) override;
 
   /**
-   * Not support now. Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
-   * @param profiler_path: Profiler path.
+   * Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
+   * @param profiler_path: Profiler path without suffix.
    * @param inputs: Inputs in batch.
    * @param outputs: Outputs in batch.
    * @param ctxs: Contexts of each request in batch.
@@ -153,6 +155,11 @@ public:
   // --------------------------------------- No converter mode [END] ---------------------------------------
 
 protected:
+  // Session run, with full trace written to `${profiler_path}.run_metadata.pb` if profiler_path is not empty.
+  void Run(const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
+           std::vector<std::pair<std::string, TensorWrapper>>& outputs,
+           const std::string& profiler_path);
+
   std::unordered_map<std::string, std::string> inp_name_to_tensor_name_;
   std::vector<std::string> inp_tensor_names_;
   std::unordered_map<std::string, std::string> tensor_name_to_out_name_;
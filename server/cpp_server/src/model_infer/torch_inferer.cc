@@ -11,8 +11,15 @@
 #include <dlfcn.h>
 #include <torch/csrc/api/include/torch/version.h>
 
+#include <mutex>
 #include <regex>
 
+#if TORCH_VERSION_MAJOR > 1 || (TORCH_VERSION_MAJOR == 1 && TORCH_VERSION_MINOR >= 9)
+#include <torch/csrc/autograd/profiler_kineto.h>
+#else
+#include <torch/csrc/autograd/profiler.h>
+#endif
+
 #include "logger/logger.h"
 
 namespace netease::grps {
@@ -203,14 +210,57 @@ void TorchModelInferer::InferWithProfiler(const std::string& profiler_path,
                                           const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
                                           std::vector<std::pair<std::string, TensorWrapper>>& outputs,
                                           GrpsContext& context) {
-  throw InfererException("Not supported now.");
+  // Profiler state is global, profiled requests are run one by one. Requests not profiled are not blocked.
+  static std::mutex profiler_mtx;
+  std::lock_guard<std::mutex> lock(profiler_mtx);
+  auto trace_path = profiler_path + ".pt.trace.json";
+
+#if TORCH_VERSION_MAJOR > 1 || (TORCH_VERSION_MAJOR == 1 && TORCH_VERSION_MINOR >= 9)
+  namespace profiler = torch::autograd::profiler;
+  profiler::ProfilerConfig config(profiler::ProfilerState::KINETO, true /* report_input_shapes */,
+                                  false /* profile_memory */);
+  std::set<profiler::ActivityType> activities{profiler::ActivityType::CPU};
+  if (inp_dev_.is_cuda()) {
+    activities.insert(profiler::ActivityType::CUDA);
+  }
+  try {
+    profiler::prepareProfiler(config, activities);
+    profiler::enableProfiler(config, activities);
+  } catch (const c10::Error& e) {
+    LOG4(WARN, "Enable torch profiler failed, infer without profiler, error: " << e.what());
+    Infer(inputs, outputs, context);
+    return;
+  }
+
+  try {
+    Infer(inputs, outputs, context);
+  } catch (...) {
+    profiler::disableProfiler();
+    throw;
+  }
+
+  try {
+    auto result = profiler::disableProfiler();
+    result->save(trace_path);
+    LOG4(INFO, "Torch profiler trace saved, path: " << trace_path);
+  } catch (const c10::Error& e) {
+    LOG4(WARN, "Failed to save torch profiler trace, path: " << trace_path << ", error: " << e.what());
+  }
+#else
+  {
+    // Legacy profiler writes chrome trace when destructed.
+    torch::autograd::profiler::RecordProfile guard(trace_path);
+    Infer(inputs, outputs, context);
+  }
+  LOG4(INFO, "Torch profiler trace saved, path: " << trace_path);
+#endif
 }
 
 void TorchModelInferer::BatchInferWithProfiler(const std::string& profiler_path,
                                                const std::vector<std::pair<std::string, TensorWrapper>>& inputs,
                                                std::vector<std::pair<std::string, TensorWrapper>>& outputs,
                                                std::vector<GrpsContext*>& ctxs) {
-  throw InfererException("Not supported now.");
+  InferWithProfiler(profiler_path, inputs, outputs, *ctxs[0]);
 }
 
 // --------------------------------------- No converter mode [BEGIN] ---------------------------------------
@@ -229,7 +279,11 @@ void TorchModelInferer::InferWithProfiler(const std::string& profiler_path,
                                           const ::grps::protos::v1::GrpsMessage& inputs,
                                           ::grps::protos::v1::GrpsMessage& outputs,
                                           GrpsContext& context) {
-  throw InfererException("Not supported now.");
+  std::vector<std::pair<std::string, TensorWrapper>> input_tensors;
+  std::vector<std::pair<std::string, TensorWrapper>> output_tensors;
+  converter_.PreProcess(inputs, input_tensors, context);
+  InferWithProfiler(profiler_path, input_tensors, output_tensors, context);
+  converter_.PostProcess(output_tensors, outputs, context);
 }
 
 void TorchModelInferer::BatchInfer(std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
@@ -246,7 +300,11 @@ void TorchModelInferer::BatchInferWithProfiler(const std::string& profiler_path,
                                                std::vector<const ::grps::protos::v1::GrpsMessage*>& inputs,
                                                std::vector<::grps::protos::v1::GrpsMessage*>& outputs,
                                                std::vector<netease::grps::GrpsContext*>& ctxs) {
-  throw InfererException("Not supported now.");
+  std::vector<std::pair<std::string, TensorWrapper>> input_tensors;
+  std::vector<std::pair<std::string, TensorWrapper>> output_tensors;
+  converter_.BatchPreProcess(inputs, input_tensors, ctxs);
+  BatchInferWithProfiler(profiler_path, input_tensors, output_tensors, ctxs);
+  converter_.BatchPostProcess(output_tensors, outputs, ctxs);
 }
 
 // --------------------------------------- No converter mode [END] ---------------------------------------
@@ -51,10 +51,13 @@ public:
              std::vector<std::pair<std::string, TensorWrapper>>& outputs,
              GrpsContext& ctx) override;
 
+  // Profiled requests are traced by torch(kineto) profiler.
+  [[nodiscard]] bool SupportProfiler() const override { return true; }
+
   /**
-   * Not support now.
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix, chrome trace of torch profiler is written to
+   * `${profiler_path}.pt.trace.json`.
    * @param inputs: Input tensor of model.
    * @param outputs: Output tensor of model.
    * @param ctx: Context of current request.
@@ -79,9 +82,8 @@ public:
                   std::vector<GrpsContext*>& ctxs) override;
 
   /**
-   * Not support now.
    * @brief Infer model in batch with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix.
    * @param inputs: Input tensor of model in batch.
    * @param outputs: Output tensor of model in batch.
    * @param ctxs: Contexts of each request in batch.
@@ -109,9 +111,9 @@ public:
              GrpsContext& ctx) override;
 
   /**
-   * Not support now. Used when in `no converter mode`. Input and output are directly GrpsMessage.
+   * Used when in `no converter mode`. Input and output are directly GrpsMessage.
    * @brief Infer model with profiler.
-   * @param profiler_path: Profiler path.
+   * @param profiler_path: Profiler path without suffix.
    * @param input: Input.
    * @param output: Output.
    * @param ctx: Context of current request.
@@ -136,8 +138,8 @@ public:
                   std::vector<GrpsContext*>& ctxs) override;
 
   /**
-   * Not support now. Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
-   * @param profiler_path: Profiler path.
+   * Used when in `no converter mode`. Inputs and outputs are directly GrpsMessage vector.
+   * @param profiler_path: Profiler path without suffix.
    * @param inputs: Inputs in batch.
    * @param outputs: Outputs in batch.
    * @param ctxs: Contexts of each request in batch.
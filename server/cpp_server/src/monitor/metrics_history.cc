@@ -0,0 +1,258 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/01
+ * Brief  Persistent metrics history.
+ */
+
+#include "metrics_history.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "logger/logger.h"
+
+namespace netease::grps {
+static constexpr char kMagic[8] = "GRPSMH";
+static constexpr uint32_t kVersion = 1;
+static constexpr int kRowNum = 60;                  // Rows of cdf window, one per minute.
+static constexpr int64_t kExpireS = 30 * 24 * 3600; // Slots not updated for 30 days can be reused.
+
+// File layout: header, max_metrics trend slots, max_cdf_metrics cdf slots.
+// Trend slot: SlotHeader, TrendWindows.
+// Cdf slot: SlotHeader, int64_t minutes[60], uint32_t counts[60][bucket_num].
+struct MetricsHistory::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t trend_slot_size;
+  uint32_t max_metrics;
+  uint32_t cdf_slot_size;
+  uint32_t max_cdf_metrics;
+  uint32_t bucket_num;
+};
+
+struct MetricsHistory::SlotHeader {
+  char name[kNameSize];
+  int32_t agg_type;
+  int32_t used;          // Slot has been allocated to name.
+  int32_t attached;      // Slot is attached by current process, cleared when opened.
+  int32_t reserved;
+  int64_t update_time_s; // Wall clock time(s) of last attach or close.
+};
+
+static size_t Align8(size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+// Push data into ring buffer, overwrite the oldest data.
+template <size_t N>
+static void RingPush(std::array<float, N>& ring, uint8_t& head, float data) {
+  ring[head] = data;
+  head = uint8_t((head + 1) % N);
+}
+
+// Slide window to now by pushing 0 for each period elapsed since last push.
+template <size_t N>
+static void Slide(std::array<float, N>& ring, uint8_t& head, int64_t& last_time, int64_t now_s, int64_t period) {
+  int64_t elapsed = std::min(now_s / period - last_time / period, int64_t(N));
+  for (int64_t i = 0; i < elapsed; ++i) {
+    RingPush(ring, head, 0);
+  }
+  last_time = now_s / period * period;
+}
+
+bool MetricsHistory::Open(const std::string& path, int max_metrics, int max_cdf_metrics, int bucket_num) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (base_ != nullptr) {
+    return true;
+  }
+  max_metrics_ = max_metrics;
+  max_cdf_metrics_ = max_cdf_metrics;
+  bucket_num_ = bucket_num;
+  trend_slot_size_ = Align8(sizeof(SlotHeader) + sizeof(TrendWindows));
+  cdf_slot_size_ = Align8(sizeof(SlotHeader) + sizeof(int64_t) * kRowNum + sizeof(uint32_t) * kRowNum * bucket_num);
+  size_ = Align8(sizeof(Header)) + max_metrics_ * trend_slot_size_ + max_cdf_metrics_ * cdf_slot_size_;
+
+  int fd = open(path.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    LOG4(ERROR, "Open metrics history file failed, path: " << path << ", errno: " << errno);
+    return false;
+  }
+
+  Header expected{};
+  memcpy(expected.magic, kMagic, sizeof(kMagic));
+  expected.version = kVersion;
+  expected.trend_slot_size = uint32_t(trend_slot_size_);
+  expected.max_metrics = uint32_t(max_metrics_);
+  expected.cdf_slot_size = uint32_t(cdf_slot_size_);
+  expected.max_cdf_metrics = uint32_t(max_cdf_metrics_);
+  expected.bucket_num = uint32_t(bucket_num_);
+
+  Header header{};
+  struct stat st {};
+  bool matched = fstat(fd, &st) == 0 && size_t(st.st_size) == size_ &&
+                 pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                 memcmp(&header, &expected, sizeof(header)) == 0;
+  if (!matched) {
+    // Layout changed or file broken, history can not be reused.
+    if (st.st_size != 0) {
+      LOG4(WARN, "Metrics history file layout not match, recreate it, path: " << path);
+    }
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, off_t(size_)) != 0 ||
+        pwrite(fd, &expected, sizeof(expected), 0) != ssize_t(sizeof(expected))) {
+      LOG4(ERROR, "Init metrics history file failed, path: " << path << ", errno: " << errno);
+      close(fd);
+      return false;
+    }
+  }
+
+  void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    LOG4(ERROR, "Mmap metrics history file failed, path: " << path << ", errno: " << errno);
+    return false;
+  }
+  base_ = static_cast<char*>(addr);
+  for (int i = 0; i < max_metrics_; ++i) {
+    TrendSlot(i)->attached = 0;
+  }
+  for (int i = 0; i < max_cdf_metrics_; ++i) {
+    CdfSlot(i)->attached = 0;
+  }
+  LOG4(INFO, "Metrics history file opened, path: " << path << ", reused: " << matched << ", size: " << size_);
+  return true;
+}
+
+void MetricsHistory::Close() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (base_ == nullptr) {
+    return;
+  }
+  int64_t now_s = time(nullptr);
+  for (int i = 0; i < max_metrics_; ++i) {
+    if (TrendSlot(i)->attached) {
+      TrendSlot(i)->update_time_s = now_s;
+    }
+  }
+  for (int i = 0; i < max_cdf_metrics_; ++i) {
+    if (CdfSlot(i)->attached) {
+      CdfSlot(i)->update_time_s = now_s;
+    }
+  }
+  msync(base_, size_, MS_SYNC);
+  munmap(base_, size_);
+  base_ = nullptr;
+}
+
+void MetricsHistory::Flush() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (base_ != nullptr) {
+    msync(base_, size_, MS_ASYNC);
+  }
+}
+
+MetricsHistory::SlotHeader* MetricsHistory::TrendSlot(int idx) const {
+  return reinterpret_cast<SlotHeader*>(base_ + Align8(sizeof(Header)) + idx * trend_slot_size_);
+}
+
+MetricsHistory::SlotHeader* MetricsHistory::CdfSlot(int idx) const {
+  return reinterpret_cast<SlotHeader*>(base_ + Align8(sizeof(Header)) + max_metrics_ * trend_slot_size_ +
+                                       idx * cdf_slot_size_);
+}
+
+MetricsHistory::SlotHeader* MetricsHistory::FindSlot(SlotHeader* (MetricsHistory::*slot)(int) const,
+                                                     int slot_num,
+                                                     const std::string& name,
+                                                     int agg_type,
+                                                     int64_t now_s,
+                                                     bool& reset) {
+  if (name.size() >= kNameSize) {
+    LOG4(WARN, "Metrics name is too long to be kept in history, name: " << name);
+    return nullptr;
+  }
+  SlotHeader* free_slot = nullptr;
+  for (int i = 0; i < slot_num; ++i) {
+    auto* header = (this->*slot)(i);
+    if (header->used && strncmp(header->name, name.c_str(), kNameSize) == 0) {
+      if (header->attached) {
+        return nullptr;
+      }
+      reset = header->agg_type != agg_type;
+      header->agg_type = agg_type;
+      header->attached = 1;
+      header->update_time_s = now_s;
+      return header;
+    }
+    if (free_slot == nullptr &&
+        (!header->used || (!header->attached && header->update_time_s + kExpireS < now_s))) {
+      free_slot = header;
+    }
+  }
+  if (free_slot == nullptr) {
+    LOG4(WARN, "Metrics history is full, metrics will not be kept in history, name: " << name);
+    return nullptr;
+  }
+  reset = true;
+  memset(free_slot->name, 0, kNameSize);
+  memcpy(free_slot->name, name.data(), name.size());
+  free_slot->agg_type = agg_type;
+  free_slot->used = 1;
+  free_slot->attached = 1;
+  free_slot->update_time_s = now_s;
+  return free_slot;
+}
+
+TrendWindows* MetricsHistory::AttachTrend(const std::string& name, int agg_type, int64_t now_s) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (base_ == nullptr) {
+    return nullptr;
+  }
+  bool reset = false;
+  auto* header = FindSlot(&MetricsHistory::TrendSlot, max_metrics_, name, agg_type, now_s, reset);
+  if (header == nullptr) {
+    return nullptr;
+  }
+  auto* windows = reinterpret_cast<TrendWindows*>(reinterpret_cast<char*>(header) + sizeof(SlotHeader));
+  if (reset) {
+    *windows = TrendWindows();
+    windows->second_time = now_s;
+    windows->minute_time = now_s / 60 * 60;
+    windows->hour_time = now_s / 3600 * 3600;
+    windows->day_time = now_s / 86400 * 86400;
+    return windows;
+  }
+  Slide(windows->seconds, windows->second_head, windows->second_time, now_s, 1);
+  Slide(windows->minutes, windows->minute_head, windows->minute_time, now_s, 60);
+  Slide(windows->hours, windows->hour_head, windows->hour_time, now_s, 3600);
+  Slide(windows->days, windows->day_head, windows->day_time, now_s, 86400);
+  return windows;
+}
+
+bool MetricsHistory::AttachCdf(const std::string& name, int64_t now_s, CdfWindow& window) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (base_ == nullptr) {
+    return false;
+  }
+  bool reset = false;
+  auto* header = FindSlot(&MetricsHistory::CdfSlot, max_cdf_metrics_, name, -1, now_s, reset);
+  if (header == nullptr) {
+    return false;
+  }
+  window.minutes = reinterpret_cast<int64_t*>(reinterpret_cast<char*>(header) + sizeof(SlotHeader));
+  window.counts = reinterpret_cast<uint32_t*>(window.minutes + kRowNum);
+  int64_t now_minute = now_s / 60;
+  for (int row = 0; row < kRowNum; ++row) {
+    if (reset || window.minutes[row] <= now_minute - kRowNum) {
+      window.minutes[row] = 0;
+      memset(window.counts + row * bucket_num_, 0, sizeof(uint32_t) * bucket_num_);
+    }
+  }
+  return true;
+}
+} // namespace netease::grps
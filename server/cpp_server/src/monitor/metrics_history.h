@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/01
+ * Brief  Persistent metrics history. Trend windows and 1 hour cdf window of metrics are kept in fixed size slots of a
+ *        memory-mapped file, aggregation updates them in place without serialization. When the server restarts, slots
+ *        are attached by metrics name again, and windows are slid by the time elapsed since their last update.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace netease::grps {
+// Trend windows of one metrics, each is a ring buffer whose head is the index of the oldest data, so that sliding a
+// window only overwrites one element and moves its head. Plain data, may live in the history file.
+struct TrendWindows {
+  std::array<float, 60> seconds{}; // Last 60 seconds agg data.
+  std::array<float, 60> minutes{}; // Last 60 minutes agg data, avg of seconds.
+  std::array<float, 24> hours{};   // Last 24 hours agg data, avg of minutes.
+  std::array<float, 30> days{};    // Last 30 days agg data, avg of hours.
+  uint8_t second_head = 0;
+  uint8_t minute_head = 0;
+  uint8_t hour_head = 0;
+  uint8_t day_head = 0;
+  // Wall clock time(s) of last push of each window.
+  int64_t second_time = 0;
+  int64_t minute_time = 0;
+  int64_t hour_time = 0;
+  int64_t day_time = 0;
+};
+
+// 1 hour cdf window of one metrics, sketch counts of last 60 minutes. Minute m is stored in row m % 60.
+struct CdfWindow {
+  int64_t* minutes = nullptr; // Minute(wall clock time / 60) of each row, 60 elements.
+  uint32_t* counts = nullptr; // 60 rows of sketch counts.
+};
+
+class MetricsHistory {
+public:
+  static constexpr int kNameSize = 256;
+
+  MetricsHistory() = default;
+  ~MetricsHistory() { Close(); }
+  MetricsHistory(const MetricsHistory&) = delete;
+  MetricsHistory& operator=(const MetricsHistory&) = delete;
+  MetricsHistory(MetricsHistory&&) = delete;
+  MetricsHistory& operator=(MetricsHistory&&) = delete;
+
+  /**
+   * @brief Open and map history file, the file will be recreated if its layout does not match.
+   * @param path: History file path.
+   * @param max_metrics: Max number of trend metrics(avg, max, min, inc) kept in history.
+   * @param max_cdf_metrics: Max number of cdf metrics kept in history.
+   * @param bucket_num: Bucket number of cdf sketch.
+   * @return If success.
+   */
+  bool Open(const std::string& path, int max_metrics, int max_cdf_metrics, int bucket_num);
+
+  /**
+   * @brief Flush and unmap history file. Windows attached before become invalid.
+   */
+  void Close();
+
+  /**
+   * @brief Flush dirty pages of history file to disk asynchronously.
+   */
+  void Flush();
+
+  [[nodiscard]] bool opened() const { return base_ != nullptr; }
+
+  /**
+   * @brief Attach trend windows of metrics. Windows kept by last run are slid to now, pushing 0 for the periods the
+   * server was down. A new slot is allocated if metrics is not in history, and slots not updated for 30 days can be
+   * reused.
+   * @param name: Metrics name.
+   * @param agg_type: Aggregation type of metrics, slot of the same name with another type is reset.
+   * @param now_s: Wall clock time(s).
+   * @return Trend windows in history file, nullptr if history is not opened or full.
+   */
+  TrendWindows* AttachTrend(const std::string& name, int agg_type, int64_t now_s);
+
+  /**
+   * @brief Attach 1 hour cdf window of metrics. Rows older than 1 hour are cleared.
+   * @param name: Metrics name.
+   * @param now_s: Wall clock time(s).
+   * @param window: Set to the window in history file if success.
+   * @return If success, false if history is not opened or full.
+   */
+  bool AttachCdf(const std::string& name, int64_t now_s, CdfWindow& window);
+
+private:
+  struct Header;
+  struct SlotHeader;
+
+  std::mutex mtx_;
+  char* base_ = nullptr;
+  size_t size_ = 0;
+  size_t trend_slot_size_ = 0;
+  size_t cdf_slot_size_ = 0;
+  int max_metrics_ = 0;
+  int max_cdf_metrics_ = 0;
+  int bucket_num_ = 0;
+
+  [[nodiscard]] SlotHeader* TrendSlot(int idx) const;
+  [[nodiscard]] SlotHeader* CdfSlot(int idx) const;
+  // Find slot of name, or allocate a free or expired one. mtx_ should be held.
+  SlotHeader* FindSlot(SlotHeader* (MetricsHistory::*slot)(int) const,
+                       int slot_num,
+                       const std::string& name,
+                       int agg_type,
+                       int64_t now_s,
+                       bool& reset);
+};
+} // namespace netease::grps
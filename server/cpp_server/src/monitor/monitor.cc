@@ -11,12 +11,18 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
-#include <boost/asio.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <ctime>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <numeric>
 
 #include "config/global_config.h"
@@ -25,41 +31,226 @@
 #define MONITOR_DEBUG 0
 
 namespace netease::grps {
-boost::asio::thread_pool MetricsAgg::pool(1);
+// Threads are spread over shards of metrics in the order they first put data.
+static int ShardIndex(int shard_num) {
+  static std::atomic<int> next_idx{0};
+  thread_local int idx = next_idx.fetch_add(1, std::memory_order_relaxed);
+  return idx % shard_num;
+}
+
+template <typename T>
+static void AtomicAdd(std::atomic<T>& target, T value) {
+  T old = target.load(std::memory_order_relaxed);
+  while (!target.compare_exchange_weak(old, old + value, std::memory_order_relaxed)) {
+  }
+}
+
+template <typename T, typename Compare>
+static void AtomicUpdate(std::atomic<T>& target, T value, Compare compare) {
+  T old = target.load(std::memory_order_relaxed);
+  while (compare(value, old) && !target.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Upper bounds of prometheus histogram buckets: 1, 2.5, 5 of each decade in [0.001, 1000000].
+static const std::vector<double>& HistogramBounds() {
+  static const std::vector<double> bounds = [] {
+    std::vector<double> bounds;
+    for (int exp = -3; exp < 6; ++exp) {
+      for (double base : {1.0, 2.5, 5.0}) {
+        bounds.push_back(base * std::pow(10.0, exp));
+      }
+    }
+    bounds.push_back(1e6);
+    return bounds;
+  }();
+  return bounds;
+}
+
+size_t MetricsAgg::SketchRowSize() {
+  static const size_t row_size = QuantileSketch::BucketNum() + HistogramBounds().size() + 1;
+  return row_size;
+}
+
+// Push data into ring buffer, overwrite the oldest data.
+template <size_t N>
+static void RingPush(std::array<float, N>& ring, uint8_t& head, float data) {
+  ring[head] = data;
+  head = uint8_t((head + 1) % N);
+}
+
+template <size_t N>
+static float RingAvg(const std::array<float, N>& ring) {
+  return float(std::accumulate(ring.begin(), ring.end(), 0.0) / double(N));
+}
+
+// Append data of ring buffer from the oldest to the newest.
+template <size_t N>
+static void RingAppend(const std::array<float, N>& ring, uint8_t head, std::vector<float>& out) {
+  out.insert(out.end(), ring.begin() + head, ring.end());
+  out.insert(out.end(), ring.begin(), ring.begin() + head);
+}
+
 MetricsAgg::MetricsAgg(const std::string& agg_name, AggType agg_type)
     : agg_name_(agg_name)
     , agg_type_(agg_type)
-    , agg_buffer_()
-    , trend_agg_datas_(174, 0.0)
     , cdf_agg_datas_(20, 0)
-    , running_(false) {
-  agg_buffer_mutex_ = std::make_unique<std::mutex>();
-  agg_datas_mutex_ = std::make_unique<std::mutex>();
+    , cdf_1m_agg_datas_(20, 0)
+    , cdf_1h_agg_datas_(20, 0) {
+  if (agg_type_ == AggType::kCdf) {
+    int bucket_num = QuantileSketch::BucketNum();
+    sketch_shards_ = std::make_unique<std::atomic<uint32_t>[]>(kShardNum * SketchRowSize());
+    for (size_t i = 0; i < kShardNum * SketchRowSize(); ++i) {
+      sketch_shards_[i].store(0, std::memory_order_relaxed);
+    }
+    second_sketches_.resize(kMin);
+    local_minutes_.resize(kHour / kMin, 0);
+    local_minute_counts_.resize(size_t(kHour / kMin) * bucket_num, 0);
+    minute_window_.minutes = local_minutes_.data();
+    minute_window_.counts = local_minute_counts_.data();
+    minute_counts_.resize(bucket_num, 0);
+    hour_counts_.resize(bucket_num, 0);
+    histogram_counts_.resize(HistogramBounds().size() + 1, 0); // Last one is +Inf.
+  }
 }
 
-void MetricsAgg::Put(int64_t now, float data) {
-  std::lock_guard<std::mutex> lock(*agg_buffer_mutex_);
-  agg_buffer_.emplace_back(now, data);
+// Percentiles of cdf: 10, 20, ..., 90, 91, 92, ..., 99, 99.9, 99.99.
+static const std::vector<float>& CdfPercentiles() {
+  static const std::vector<float> percentiles = [] {
+    std::vector<float> percentiles;
+    for (int i = 1; i <= 9; ++i) {
+      percentiles.push_back(float(i * 10));
+    }
+    for (int i = 1; i <= 9; ++i) {
+      percentiles.push_back(float(90 + i));
+    }
+    percentiles.push_back(float(99.9));
+    percentiles.push_back(float(99.99));
+    return percentiles;
+  }();
+  return percentiles;
 }
 
-void MetricsAgg::Start() {
-  running_ = true;
-  timer_.async_wait([this](auto&& param) { AggThreadFunc(std::forward<decltype(param)>(param)); });
+const double MetricsAgg::QuantileSketch::kGamma = (1 + kRelativeAccuracy) / (1 - kRelativeAccuracy);
+const double MetricsAgg::QuantileSketch::kLogGamma = std::log(kGamma);
+const int MetricsAgg::QuantileSketch::kMinKey = int(std::ceil(std::log(kMinValue) / kLogGamma));
+const int MetricsAgg::QuantileSketch::kMaxKey = int(std::ceil(std::log(kMaxValue) / kLogGamma));
+
+int MetricsAgg::QuantileSketch::BucketNum() {
+  return kMaxKey - kMinKey + 2;
+}
+
+int MetricsAgg::QuantileSketch::Bucket(float data) {
+  if (!(data >= kMinValue)) { // Also catch nan.
+    return 0;
+  }
+  int key = int(std::ceil(std::log(double(data)) / kLogGamma));
+  return std::min(key, kMaxKey) - kMinKey + 1;
 }
 
-void MetricsAgg::Stop() {
-  running_ = false;
+float MetricsAgg::QuantileSketch::Value(int bucket) {
+  if (bucket == 0) {
+    return 0;
+  }
+  // Middle of bucket with relative error less than kRelativeAccuracy to any data in bucket.
+  return float(2 * std::pow(kGamma, bucket + kMinKey - 1) / (kGamma + 1));
+}
+
+void MetricsAgg::QuantileSketch::Percentiles(const std::vector<uint64_t>& counts,
+                                             const std::vector<float>& percentiles,
+                                             std::vector<float>& values) {
+  uint64_t total = std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+  values.assign(percentiles.size(), 0);
+  if (total == 0) {
+    return;
+  }
+  uint64_t cum = 0;
+  size_t bucket = 0;
+  for (size_t i = 0; i < percentiles.size(); ++i) {
+    auto rank = std::max(uint64_t(1), uint64_t(std::ceil(percentiles[i] / 100.0 * double(total))));
+    while (bucket < counts.size() && cum + counts[bucket] < rank) {
+      cum += counts[bucket++];
+    }
+    values[i] = Value(int(std::min(bucket, counts.size() - 1)));
+  }
+}
+
+void MetricsAgg::Put(float data) {
+  if (agg_type_ == AggType::kCdf) {
+    int shard_idx = ShardIndex(kShardNum);
+    auto* counts = &sketch_shards_[shard_idx * SketchRowSize()];
+    counts[QuantileSketch::Bucket(data)].fetch_add(1, std::memory_order_relaxed);
+    // Prometheus histogram needs exact bucket of data, and sum of data.
+    const auto& bounds = HistogramBounds();
+    auto histogram_idx = std::lower_bound(bounds.begin(), bounds.end(), double(data)) - bounds.begin();
+    counts[QuantileSketch::BucketNum() + histogram_idx].fetch_add(1, std::memory_order_relaxed);
+    AtomicAdd(shards_[shard_idx].sum, double(data));
+    return;
+  }
+
+  auto& shard = shards_[ShardIndex(kShardNum)];
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  switch (agg_type_) {
+    case AggType::kAvg:
+    case AggType::kInc:
+      AtomicAdd(shard.sum, double(data));
+      break;
+    case AggType::kMax:
+      AtomicUpdate(shard.max, data, std::greater<>());
+      break;
+    case AggType::kMin:
+      AtomicUpdate(shard.min, data, std::less<>());
+      break;
+    default:
+      break;
+  }
+}
+
+float MetricsAgg::DrainShards() {
+  int64_t count = 0;
+  double sum = 0;
+  float max = std::numeric_limits<float>::lowest();
+  float min = std::numeric_limits<float>::max();
+  for (auto& shard : shards_) {
+    // Fields are reset one by one, data put concurrently may be split into two seconds, which is fine for monitor.
+    count += shard.count.exchange(0, std::memory_order_relaxed);
+    sum += shard.sum.exchange(0, std::memory_order_relaxed);
+    max = std::max(max, shard.max.exchange(std::numeric_limits<float>::lowest(), std::memory_order_relaxed));
+    min = std::min(min, shard.min.exchange(std::numeric_limits<float>::max(), std::memory_order_relaxed));
+  }
+  if (count == 0) {
+    return 0;
+  }
+  switch (agg_type_) {
+    case AggType::kAvg:
+      return float(sum / double(count));
+    case AggType::kMax:
+      return max;
+    case AggType::kMin:
+      return min;
+    case AggType::kInc:
+      return float(sum);
+    default:
+      return 0;
+  }
 }
 
 std::string MetricsAgg::agg_datas_json() {
   std::vector<float> agg_datas;
   {
-    std::lock_guard<std::mutex> lock(*agg_datas_mutex_);
+    std::lock_guard<std::mutex> lock(agg_datas_mutex_);
     if (agg_type_ == AggType::kCdf) {
       agg_datas = cdf_agg_datas_;
+      agg_datas.insert(agg_datas.end(), cdf_1m_agg_datas_.begin(), cdf_1m_agg_datas_.end());
+      agg_datas.insert(agg_datas.end(), cdf_1h_agg_datas_.begin(), cdf_1h_agg_datas_.end());
     } else if (agg_type_ == AggType::kAvg || agg_type_ == AggType::kMax || agg_type_ == AggType::kMin ||
                agg_type_ == AggType::kInc) {
-      agg_datas = trend_agg_datas_;
+      // Same layout as before: [0:29] days, [30:53] hours, [54:113] minutes, [114:173] seconds.
+      agg_datas.reserve(trend_->days.size() + trend_->hours.size() + trend_->minutes.size() + trend_->seconds.size());
+      RingAppend(trend_->days, trend_->day_head, agg_datas);
+      RingAppend(trend_->hours, trend_->hour_head, agg_datas);
+      RingAppend(trend_->minutes, trend_->minute_head, agg_datas);
+      RingAppend(trend_->seconds, trend_->second_head, agg_datas);
     } else {
       LOG4(ERROR, "AggType not support yet, agg_type: " << int(agg_type_));
       return "";
@@ -72,17 +263,21 @@ std::string MetricsAgg::agg_datas_json() {
     doc.SetObject();
     rapidjson::Document::AllocatorType& allocator = doc.GetAllocator();
     doc.AddMember("label", "cdf", allocator);
-    rapidjson::Value data(rapidjson::kArrayType);
-    for (int i = 0; i < agg_datas.size(); ++i) {
-      rapidjson::Value data_item(rapidjson::kArrayType);
-      if (i < 9)
-        data_item.PushBack((i + 1) * 10, allocator);
-      else
-        data_item.PushBack(90 + (i - 8), allocator);
-      data_item.PushBack(agg_datas[i], allocator);
-      data.PushBack(data_item, allocator);
+    const char* windows[] = {"data", "data_1m", "data_1h"};
+    size_t percentile_num = CdfPercentiles().size();
+    for (size_t w = 0; w < 3; ++w) {
+      rapidjson::Value data(rapidjson::kArrayType);
+      for (int i = 0; i < percentile_num; ++i) {
+        rapidjson::Value data_item(rapidjson::kArrayType);
+        if (i < 9)
+          data_item.PushBack((i + 1) * 10, allocator);
+        else
+          data_item.PushBack(90 + (i - 8), allocator);
+        data_item.PushBack(agg_datas[w * percentile_num + i], allocator);
+        data.PushBack(data_item, allocator);
+      }
+      doc.AddMember(rapidjson::StringRef(windows[w]), data, allocator);
     }
-    doc.AddMember("data", data, allocator);
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
     writer.SetMaxDecimalPlaces(2);
@@ -113,230 +308,331 @@ std::string MetricsAgg::agg_datas_json() {
   }
 }
 
-auto MetricsAgg::AvgFunc(const std::vector<float>::iterator& begin, const std::vector<float>::iterator& end) {
-  if (end - begin == 0) {
-    return float(0.0);
-  }
-  auto sum = std::accumulate(begin, end, 0.0);
-  return float(sum) / float(end - begin);
+// Format number of prometheus sample.
+static std::string PrometheusNumber(double value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.10g", value);
+  return buf;
 }
 
-auto MetricsAgg::AggFunc(const std::vector<float>::iterator& begin, const std::vector<float>::iterator& end) {
-  if (agg_type_ == AggType::kAvg) {
-    return MetricsAgg::AvgFunc(begin, end);
-  } else if (agg_type_ == AggType::kMax) {
-    if (end - begin == 0) {
-      return float(0.0);
+// Prometheus sample line: `name{labels,extra_label} value`.
+static void AppendSample(const std::string& name,
+                         const std::string& labels,
+                         const std::string& extra_label,
+                         const std::string& value,
+                         std::string& out) {
+  out += name;
+  if (!labels.empty() || !extra_label.empty()) {
+    out += '{';
+    out += labels;
+    if (!labels.empty() && !extra_label.empty()) {
+      out += ',';
     }
-    return *std::max_element(begin, end);
-  } else if (agg_type_ == AggType::kMin) {
-    if (end - begin == 0) {
-      return float(0.0);
-    }
-    return *std::min_element(begin, end);
-  } else if (agg_type_ == AggType::kInc) {
-    if (end - begin == 0) {
-      return float(0.0);
-    }
-    auto sum = std::accumulate(begin, end, 0.0);
-    return float(sum);
+    out += extra_label;
+    out += '}';
   }
-  return float(0.0);
+  out += ' ';
+  out += value;
+  out += '\n';
 }
 
-void MetricsAgg::AggThreadFunc(const boost::system::error_code& ec) {
-  if (!running_) return;
-  iter_++;
-  int last_ns = 1;
-  auto cur_time = std::chrono::system_clock::now();
-  auto cur_time_s = std::chrono::duration_cast<std::chrono::seconds>(cur_time.time_since_epoch()).count();
-
-  // Get last ns data from agg_buffer_.
-  std::vector<float> last_ns_data;
-  {
-    std::lock_guard<std::mutex> lock(*agg_buffer_mutex_);
-    while (!agg_buffer_.empty()) {
-      auto data = agg_buffer_.front();
-      if (data.first < cur_time_s - last_ns) {
-        agg_buffer_.pop_front();
-        continue;
+void MetricsAgg::AppendPrometheus(const std::string& name, const std::string& labels, std::string& out) {
+  std::lock_guard<std::mutex> lock(agg_datas_mutex_);
+  switch (agg_type_) {
+    case AggType::kAvg:
+    case AggType::kMax:
+    case AggType::kMin:
+      AppendSample(name, labels, "", PrometheusNumber(last_second_data()), out);
+      break;
+    case AggType::kInc:
+      AppendSample(name, labels, "", PrometheusNumber(total_sum_), out);
+      break;
+    case AggType::kCdf: {
+      const auto& bounds = HistogramBounds();
+      uint64_t cum = 0;
+      for (size_t i = 0; i < bounds.size(); ++i) {
+        cum += histogram_counts_[i];
+        AppendSample(name + "_bucket", labels, "le=\"" + PrometheusNumber(bounds[i]) + "\"", std::to_string(cum), out);
       }
+      AppendSample(name + "_bucket", labels, "le=\"+Inf\"", std::to_string(total_count_), out);
+      AppendSample(name + "_sum", labels, "", PrometheusNumber(total_sum_), out);
+      AppendSample(name + "_count", labels, "", std::to_string(total_count_), out);
       break;
     }
-    for (auto& iterator : agg_buffer_) {
-      if (iterator.first >= cur_time_s) {
-        break;
-      }
-      last_ns_data.push_back(iterator.second);
-    }
-  }
-  if (agg_type_ == AggType::kAvg || agg_type_ == AggType::kInc || agg_type_ == AggType::kMax ||
-      agg_type_ == AggType::kMin) { // trend aggregate.
-    // Trend aggregate data into trend_agg_datas according to the following rules:
-    // 1. Aggregate second data once per second, and shift the second array in trend_agg_datas to the left once.
-    // 2. Aggregate minute data once per minute, and shift the minute array in trend_agg_da to the left once.
-    // 3. Aggregate hourly data once per hour, and shift the hour array in trend_agg_datas to the left once.
-    // 4. Aggregate daily data once per day, and shift the day array in trend_agg_datas to the left once.
-
-    // Aggregate last ns data, shift the second array in trend_agg_datas to the left once.
-    std::lock_guard<std::mutex> lock(*agg_datas_mutex_);
-    float last_ns_data_agg = AggFunc(last_ns_data.begin(), last_ns_data.end());
-    if (agg_type_ == AggType::kInc) last_ns_data_agg /= float(last_ns);
-    // LOG4(INFO, "curr_s: " << cur_time_s << "agg_tye: " << int(agg_type_) << " data: " << last_ns_data_agg);
-    for (int i = 114; i < 173; ++i) {
-      trend_agg_datas_[i] = trend_agg_datas_[i + 1];
-    }
-    trend_agg_datas_[173] = last_ns_data_agg;
-
-    // If reach 1m, aggregate 1m data, shift the minute array in trend_agg_datas to the left once.
-    if (iter_ % ONE_MIN == 0) {
-      float last_1m_data_agg = AvgFunc(trend_agg_datas_.begin() + 114, trend_agg_datas_.begin() + 174);
-      for (int i = 54; i < 113; ++i) {
-        trend_agg_datas_[i] = trend_agg_datas_[i + 1];
+    default:
+      LOG4(ERROR, "AggType not support yet, agg_type: " << int(agg_type_));
+      break;
+  }
+}
+
+void MetricsAgg::AggCdf(int64_t tick) {
+  int bucket_num = QuantileSketch::BucketNum();
+  // Merge shards into sketch of last second.
+  // Histogram counts follow sketch counts, see SketchRowSize.
+  std::vector<uint64_t> second_counts(SketchRowSize(), 0);
+  double second_sum = 0;
+  for (int shard = 0; shard < kShardNum; ++shard) {
+    second_sum += shards_[shard].sum.exchange(0, std::memory_order_relaxed);
+    auto* counts = &sketch_shards_[shard * SketchRowSize()];
+    for (size_t i = 0; i < SketchRowSize(); ++i) {
+      if (counts[i].load(std::memory_order_relaxed) != 0) {
+        second_counts[i] += counts[i].exchange(0, std::memory_order_relaxed);
       }
-      trend_agg_datas_[113] = last_1m_data_agg;
     }
+  }
+  std::vector<uint64_t> second_histogram_counts(second_counts.begin() + bucket_num, second_counts.end());
+  second_counts.resize(bucket_num);
 
-    // If reach 1h, aggregate 1h data, shift the hour array in trend_agg_datas to the left once.
-    if (iter_ % ONE_HOUR == 0) {
-      float last_1h_data_agg = AvgFunc(trend_agg_datas_.begin() + 54, trend_agg_datas_.begin() + 114);
-      for (int i = 30; i < 53; ++i) {
-        trend_agg_datas_[i] = trend_agg_datas_[i + 1];
-      }
-      trend_agg_datas_[53] = last_1h_data_agg;
+  // Slide 1 minute window: replace the oldest second with last second.
+  auto& oldest_second = second_sketches_[tick % second_sketches_.size()];
+  for (const auto& [bucket, count] : oldest_second) {
+    minute_counts_[bucket] -= count;
+  }
+  oldest_second.clear();
+  for (int i = 0; i < bucket_num; ++i) {
+    if (second_counts[i] != 0) {
+      minute_counts_[i] += second_counts[i];
+      oldest_second.emplace_back(uint16_t(i), uint32_t(second_counts[i]));
     }
+  }
 
-    // If reach 1d, aggregate 1d data, shift the day array in trend_agg_datas to the left once.
-    if (iter_ % ONE_DAY == 0) {
-      float last_1d_data_agg = AvgFunc(trend_agg_datas_.begin() + 30, trend_agg_datas_.begin() + 54);
-      for (int i = 0; i < 29; ++i) {
-        trend_agg_datas_[i] = trend_agg_datas_[i + 1];
-      }
-      trend_agg_datas_[29] = last_1d_data_agg;
-      iter_ = 0; // reset iter.
+  // Slide 1 hour window once per minute: replace the oldest minute with last minute.
+  bool minute_reached = tick % kMin == 0;
+  if (minute_reached) {
+    int64_t row = (tick / kMin) % (kHour / kMin);
+    auto* oldest_minute = minute_window_.counts + row * bucket_num;
+    for (int i = 0; i < bucket_num; ++i) {
+      auto count = uint32_t(std::min<uint64_t>(minute_counts_[i], std::numeric_limits<uint32_t>::max()));
+      hour_counts_[i] = hour_counts_[i] - oldest_minute[i] + count;
+      oldest_minute[i] = count;
     }
+    minute_window_.minutes[row] = tick / kMin;
+  }
+
+  std::vector<float> last_1s_datas, last_1m_datas, last_1h_datas;
+  QuantileSketch::Percentiles(second_counts, CdfPercentiles(), last_1s_datas);
+  QuantileSketch::Percentiles(minute_counts_, CdfPercentiles(), last_1m_datas);
+  if (minute_reached) {
+    QuantileSketch::Percentiles(hour_counts_, CdfPercentiles(), last_1h_datas);
+  }
+
+  std::lock_guard<std::mutex> lock(agg_datas_mutex_);
+  for (size_t i = 0; i < histogram_counts_.size(); ++i) {
+    histogram_counts_[i] += second_histogram_counts[i];
+    total_count_ += second_histogram_counts[i];
+  }
+  total_sum_ += second_sum;
+  cdf_agg_datas_.swap(last_1s_datas);
+  cdf_1m_agg_datas_.swap(last_1m_datas);
+  if (minute_reached) {
+    cdf_1h_agg_datas_.swap(last_1h_datas);
+  }
+}
+
+void MetricsAgg::Aggregate(int64_t tick) {
+  if (agg_type_ == AggType::kCdf) {
+    AggCdf(tick);
+    return;
+  }
+
+  // Trend aggregate data according to the following rules:
+  // 1. Aggregate second data once per second, and push it into the second window.
+  // 2. Aggregate minute data once per minute by avg of the second window, and push it into the minute window.
+  // 3. Aggregate hourly data once per hour by avg of the minute window, and push it into the hour window.
+  // 4. Aggregate daily data once per day by avg of the hour window, and push it into the day window.
+  float last_1s_data_agg = DrainShards();
+  std::lock_guard<std::mutex> lock(agg_datas_mutex_);
+  RingPush(trend_->seconds, trend_->second_head, last_1s_data_agg);
+  trend_->second_time = tick;
+  if (agg_type_ == AggType::kInc) {
+    total_sum_ += last_1s_data_agg;
+  }
+  if (tick % kMin == 0) {
+    RingPush(trend_->minutes, trend_->minute_head, RingAvg(trend_->seconds));
+    trend_->minute_time = tick;
+  }
+  if (tick % kHour == 0) {
+    RingPush(trend_->hours, trend_->hour_head, RingAvg(trend_->minutes));
+    trend_->hour_time = tick;
+  }
+  if (tick % kDay == 0) {
+    RingPush(trend_->days, trend_->day_head, RingAvg(trend_->hours));
+    trend_->day_time = tick;
+  }
 
 #if MONITOR_DEBUG
-    std::stringstream ss;
-    ss << "AggThreadFunc: agg_name: " << agg_name_ << ", agg_type: " << int(agg_type_) << ", cur_time_s " << cur_time_s
-       << ", iter_: " << iter_ << ", trend_agg_datas: [";
-    for (float trend_agg_data : trend_agg_datas_) {
-      ss << trend_agg_data << ", ";
-    }
-    ss << "]";
-    LOG4(INFO, ss.str());
+  LOG4(INFO, "Aggregate: agg_name: " << agg_name_ << ", agg_type: " << int(agg_type_) << ", tick: " << tick
+                                     << ", last second data: " << last_1s_data_agg);
 #endif
-  } else if (agg_type_ == AggType::kCdf) { // cdf aggregate.
-    if (!last_ns_data.empty()) {
-      auto begin = last_ns_data.begin();
-      auto end = last_ns_data.end();
-      std::sort(begin, end);
-
-      // compute percentile: 10, 20,, ..., 90, 91, 92, ..., 100, 101
-      std::vector<float> percentiles;
-      for (int i = 1; i <= 9; ++i) {
-        percentiles.push_back(float(i * 10));
-      }
-      for (int i = 1; i <= 9; ++i) {
-        percentiles.push_back(float(90 + i));
-      }
-      percentiles.push_back(float(99.9));
-      percentiles.push_back(float(99.99));
+}
 
-      std::lock_guard<std::mutex> lock(*agg_datas_mutex_);
-      for (int i = 0; i < percentiles.size(); ++i) {
-        int index = int(ceil(percentiles[i] / 100.0 * float(last_ns_data.size()))) - 1;
-        cdf_agg_datas_[i] = (*(begin + index));
-      }
-    } else {
-      // reset to 0
-      std::lock_guard<std::mutex> lock(*agg_datas_mutex_);
-      for (float& cdf_agg_data : cdf_agg_datas_) {
-        cdf_agg_data = 0;
-      }
+void MetricsAgg::AttachHistory(MetricsHistory& history, int64_t now_s) {
+  std::lock_guard<std::mutex> lock(agg_datas_mutex_);
+  if (agg_type_ != AggType::kCdf) {
+    auto* windows = history.AttachTrend(agg_name_, int(agg_type_), now_s);
+    if (windows != nullptr) {
+      trend_ = windows;
     }
+    return;
+  }
 
-#if MONITOR_DEBUG
-    std::stringstream ss;
-    ss << "AggThreadFunc: agg_name: " << agg_name_ << ", agg_type: " << int(agg_type_) << ", cur_time_s " << cur_time_s
-       << ", iter_: " << iter_ << ", cdf_agg_datas: [";
-    for (float cdf_agg_data : cdf_agg_datas_) {
-      ss << cdf_agg_data << ", ";
-    }
-    ss << "]";
-    LOG4(INFO, ss.str());
-#endif
-  } else {
-    LOG4(ERROR, "AggType not support yet, agg_type: " << int(agg_type_));
+  CdfWindow window;
+  if (!history.AttachCdf(agg_name_, now_s, window)) {
     return;
   }
-  timer_.expires_at(timer_.expires_at() + boost::posix_time::seconds(1));
-  timer_.async_wait([this](auto&& param) { AggThreadFunc(std::forward<decltype(param)>(param)); });
+  minute_window_ = window;
+  // Rebuild 1 hour window from minutes kept by last run.
+  int bucket_num = QuantileSketch::BucketNum();
+  std::fill(hour_counts_.begin(), hour_counts_.end(), 0);
+  for (int row = 0; row < kHour / kMin; ++row) {
+    auto* counts = minute_window_.counts + row * bucket_num;
+    for (int i = 0; i < bucket_num; ++i) {
+      hour_counts_[i] += counts[i];
+    }
+  }
+  QuantileSketch::Percentiles(hour_counts_, CdfPercentiles(), cdf_1h_agg_datas_);
 }
 
 void Monitor::Init() {
-  monitor_log_path_ = GlobalConfig::Instance().server_config().log.log_dir + "/grps_monitor.log";
+  const auto& server_config = GlobalConfig::Instance().server_config();
+  std::string rank_suffix;
   if (GlobalConfig::Instance().mpi().world_rank > 0) {
-    monitor_log_path_ += "-rank" + std::to_string(GlobalConfig::Instance().mpi().world_rank);
+    rank_suffix = "-rank" + std::to_string(GlobalConfig::Instance().mpi().world_rank);
   }
-}
-
-void Monitor::PutMetricPiece(const netease::grps::MetricsPiece& metrics_piece) {
-  if (!running_) {
-    LOG4(WARN, "Monitor is not running.");
-    return;
+  monitor_log_path_ = server_config.log.log_dir + "/grps_monitor.log" + rank_suffix;
+
+  if (server_config._is_set.monitor_history && server_config.monitor_history.enable && !history_) {
+    auto history = std::make_unique<MetricsHistory>();
+    auto history_path = server_config.log.log_dir + "/grps_monitor.history" + rank_suffix;
+    if (history->Open(history_path, server_config.monitor_history.max_metrics,
+                      server_config.monitor_history.max_cdf_metrics, MetricsAgg::QuantileSketch::BucketNum())) {
+      boost::lock_guard<boost::shared_mutex> lock(metrics_agg_mutex_);
+      history_ = std::move(history);
+      // Metrics registered before init.
+      for (auto& [name, metrics_agg] : metrics_agg_) {
+        metrics_agg->AttachHistory(*history_, time(nullptr));
+      }
+    } else {
+      LOG4(ERROR, "Open metrics history failed, metrics history is disabled, path: " << history_path);
+    }
   }
+}
 
-#if MONITOR_DEBUG
-  LOG4(INFO, "PutMetricPiece, new metrics piece: " << metrics_piece.ToString());
-#endif
-
+MetricsAgg* Monitor::Register(const std::string& name, AggType agg_type) {
+  MetricsAgg* metrics_agg = nullptr;
   {
     boost::shared_lock<boost::shared_mutex> agg_rlock(metrics_agg_mutex_); // use read lock check firstly.
-    if (metrics_agg_.find(metrics_piece.name) == metrics_agg_.end()) {
-      // use write lock to update.
-      agg_rlock.unlock();
-      boost::lock_guard<boost::shared_mutex> agg_wlock(metrics_agg_mutex_);
-      if (metrics_agg_.find(metrics_piece.name) == metrics_agg_.end()) {
-        metrics_agg_.emplace(metrics_piece.name, MetricsAgg(metrics_piece.name, metrics_piece.agg_type));
-        metrics_agg_[metrics_piece.name].Start();
+    auto iter = metrics_agg_.find(name);
+    if (iter != metrics_agg_.end()) {
+      metrics_agg = iter->second.get();
+    }
+  }
+  if (metrics_agg == nullptr) {
+    // use write lock to update.
+    boost::lock_guard<boost::shared_mutex> agg_wlock(metrics_agg_mutex_);
+    auto& agg = metrics_agg_[name];
+    if (!agg) {
+      agg = std::make_unique<MetricsAgg>(name, agg_type);
+      if (history_) {
+        agg->AttachHistory(*history_, time(nullptr));
       }
     }
+    metrics_agg = agg.get();
   }
 
-  if (metrics_agg_[metrics_piece.name].agg_type() != metrics_piece.agg_type) {
-    LOG4(ERROR, "PutMetricPiece, agg_type not match, new agg_type: "
-                  << int(metrics_piece.agg_type)
-                  << ", old agg_type: " << int(metrics_agg_[metrics_piece.name].agg_type()));
+  if (metrics_agg->agg_type() != agg_type) {
+    LOG4(ERROR, "Register metrics, agg_type not match, name: " << name << ", new agg_type: " << int(agg_type)
+                                                                << ", old agg_type: " << int(metrics_agg->agg_type()));
+    return nullptr;
+  }
+  return metrics_agg;
+}
+
+void Monitor::Put(const std::string& name, AggType agg_type, float value) {
+  if (!running_) {
+    LOG4(WARN, "Monitor is not running.");
+    return;
+  }
+  auto* metrics_agg = Register(name, agg_type);
+  if (metrics_agg != nullptr) {
+    metrics_agg->Put(value);
+  }
+}
+
+void Monitor::Put(MetricsAgg* handle, AggType agg_type, float value) {
+  if (!running_) {
+    LOG4(WARN, "Monitor is not running.");
+    return;
+  }
+  if (handle == nullptr) {
+    return;
+  }
+  if (handle->agg_type() != agg_type) {
+    LOG4(ERROR, "Put metrics, agg_type not match, name: " << handle->agg_name() << ", new agg_type: "
+                                                           << int(agg_type)
+                                                           << ", old agg_type: " << int(handle->agg_type()));
     return;
   }
 
-  metrics_agg_[metrics_piece.name].Put(metrics_piece.now, metrics_piece.value);
+#if MONITOR_DEBUG
+  LOG4(INFO, "Put metrics, name: " << handle->agg_name() << ", value: " << value);
+#endif
+  handle->Put(value);
 }
 
 void Monitor::Start() {
   running_ = true;
+  agg_metrics_thread_ = std::thread(&Monitor::AggMetricsAgg, this);
   dump_metrics_agg_thread_ = std::thread(&Monitor::DumpMetricsAgg, this);
 }
 
 void Monitor::Stop() {
-  running_ = false;
+  {
+    std::lock_guard<std::mutex> lock(agg_metrics_mutex_);
+    running_ = false;
+  }
+  agg_metrics_cv_.notify_all();
+  if (agg_metrics_thread_.joinable()) {
+    agg_metrics_thread_.join();
+  }
   if (dump_metrics_agg_thread_.joinable()) {
     dump_metrics_agg_thread_.join();
   }
-  for (auto& [name, metrics_agg] : metrics_agg_) {
-    metrics_agg.Stop();
+  if (history_) {
+    history_->Flush();
+  }
+}
+
+void Monitor::AggMetricsAgg() {
+  // One tick walks all metrics, so that the cost of timers does not grow with the number of metrics. Tick is the wall
+  // clock time(s) when started and advances with steady clock, so that windows slide at wall clock boundaries and
+  // match history kept by last run.
+  int64_t tick = time(nullptr);
+  auto next_tick_time = std::chrono::steady_clock::now();
+  while (true) {
+    next_tick_time += std::chrono::seconds(1);
+    {
+      std::unique_lock<std::mutex> lock(agg_metrics_mutex_);
+      if (agg_metrics_cv_.wait_until(lock, next_tick_time, [this] { return !running_; })) {
+        return;
+      }
+    }
+    ++tick;
+    boost::shared_lock_guard<boost::shared_mutex> lock(metrics_agg_mutex_);
+    for (auto& [name, metrics_agg] : metrics_agg_) {
+      metrics_agg->Aggregate(tick);
+    }
   }
-  MetricsAgg::pool.join();
 }
 
 std::string Monitor::GetMetricsAggDataJson(const char* name) {
   boost::shared_lock_guard<boost::shared_mutex> lock(metrics_agg_mutex_);
-  if (metrics_agg_.find(name) == metrics_agg_.end()) {
+  auto iter = metrics_agg_.find(name);
+  if (iter == metrics_agg_.end()) {
     // LOG4(WARN, "GetMetricsAggData, metrics name not found, name: " << name);
     return "";
   }
-  return metrics_agg_[name].agg_datas_json();
+  return iter->second->agg_datas_json();
 }
 
 std::vector<std::string> Monitor::GetMetricsNames() {
@@ -349,6 +645,98 @@ std::vector<std::string> Monitor::GetMetricsNames() {
   return names;
 }
 
+// Convert metrics name to prometheus family name and labels, see Monitor::GetPrometheusText.
+static void ToPrometheusName(const std::string& name, std::string& family, std::string& labels) {
+  auto sanitize = [](const std::string& str) {
+    std::string ret;
+    for (char c : str) {
+      if (c == '%') {
+        ret += ret.empty() || ret.back() == '_' ? "percent" : "_percent";
+      } else if (std::isalnum(static_cast<unsigned char>(c)) || c == ':') {
+        ret += c;
+      } else if (!ret.empty() && ret.back() != '_') {
+        ret += '_';
+      }
+    }
+    while (!ret.empty() && ret.back() == '_') {
+      ret.pop_back();
+    }
+    return ret;
+  };
+  auto escape = [](const std::string& str) {
+    std::string ret;
+    for (char c : str) {
+      if (c == '\\' || c == '"') {
+        ret += '\\';
+        ret += c;
+      } else if (c == '\n') {
+        ret += "\\n";
+      } else {
+        ret += c;
+      }
+    }
+    return ret;
+  };
+
+  auto label_begin = name.find('{');
+  family = "grps_" + sanitize(name.substr(0, label_begin));
+  labels.clear();
+  if (label_begin == std::string::npos || name.back() != '}') {
+    return;
+  }
+  std::stringstream ss(name.substr(label_begin + 1, name.size() - label_begin - 2));
+  std::string label;
+  while (std::getline(ss, label, ',')) {
+    auto eq = label.find('=');
+    if (eq == std::string::npos) {
+      continue;
+    }
+    auto key = sanitize(label.substr(0, eq));
+    auto value = label.substr(eq + 1);
+    if (key.empty()) {
+      continue;
+    }
+    if (!labels.empty()) {
+      labels += ',';
+    }
+    auto dash = value.rfind('-');
+    if (key == "model" && dash != std::string::npos) {
+      labels += "model=\"" + escape(value.substr(0, dash)) + "\",version=\"" + escape(value.substr(dash + 1)) + "\"";
+    } else {
+      labels += key + "=\"" + escape(value) + "\"";
+    }
+  }
+}
+
+std::string Monitor::GetPrometheusText() {
+  // Group metrics by family, so that samples of one family with different labels follow the same TYPE line.
+  std::map<std::string, std::vector<std::pair<std::string, MetricsAgg*>>> families;
+  std::string out;
+  boost::shared_lock_guard<boost::shared_mutex> lock(metrics_agg_mutex_);
+  for (auto& [name, metrics_agg] : metrics_agg_) {
+    std::string family, labels;
+    ToPrometheusName(name, family, labels);
+    if (metrics_agg->agg_type() == AggType::kInc) {
+      family += "_total";
+    }
+    families[family].emplace_back(std::move(labels), metrics_agg.get());
+  }
+
+  for (auto& [family, metrics] : families) {
+    auto agg_type = metrics.front().second->agg_type();
+    const char* type = agg_type == AggType::kInc ? "counter" : agg_type == AggType::kCdf ? "histogram" : "gauge";
+    out += "# TYPE " + family + " " + type + "\n";
+    for (auto& [labels, metrics_agg] : metrics) {
+      if (metrics_agg->agg_type() != agg_type) {
+        LOG4(WARN, "Prometheus family has metrics with different agg_type, skip metrics: " << metrics_agg->agg_name());
+        continue;
+      }
+      metrics_agg->AppendPrometheus(family, labels, out);
+    }
+  }
+  return out;
+}
+
 void Monitor::DumpMetricsAgg() {
   auto fd = open(monitor_log_path_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
   if (fd < 0) {
@@ -362,16 +750,21 @@ void Monitor::DumpMetricsAgg() {
     lseek(fd, 0, SEEK_SET);
     std::stringstream ss;
     ss.str("");
-    for (auto& item : metrics_agg_) {
-      if (item.second.agg_type_ == AggType::kCdf) {
-        // Dump 80, 90, 99, 99.9, 99.99 percentiles. Index in cdf_agg_datas_: 7,8,17,18,19
-        ss << item.first << "_80 : " << std::fixed << std::setprecision(2) << item.second.cdf_agg_datas_[7] << "\n"
-           << item.first << "_90 : " << std::fixed << std::setprecision(2) << item.second.cdf_agg_datas_[8] << "\n"
-           << item.first << "_99 : " << std::fixed << std::setprecision(2) << item.second.cdf_agg_datas_[17] << "\n"
-           << item.first << "_999 : " << std::fixed << std::setprecision(2) << item.second.cdf_agg_datas_[18] << "\n"
-           << item.first << "_9999 : " << std::fixed << std::setprecision(2) << item.second.cdf_agg_datas_[19] << "\n";
-      } else {
-        ss << item.first << " : " << std::fixed << std::setprecision(2) << item.second.trend_agg_datas_[173] << "\n";
+    {
+      boost::shared_lock_guard<boost::shared_mutex> agg_lock(metrics_agg_mutex_);
+      for (auto& item : metrics_agg_) {
+        auto& agg = *item.second;
+        std::lock_guard<std::mutex> lock(agg.agg_datas_mutex_);
+        if (agg.agg_type_ == AggType::kCdf) {
+          // Dump 80, 90, 99, 99.9, 99.99 percentiles. Index in cdf_agg_datas_: 7,8,17,18,19
+          ss << item.first << "_80 : " << std::fixed << std::setprecision(2) << agg.cdf_agg_datas_[7] << "\n"
+             << item.first << "_90 : " << std::fixed << std::setprecision(2) << agg.cdf_agg_datas_[8] << "\n"
+             << item.first << "_99 : " << std::fixed << std::setprecision(2) << agg.cdf_agg_datas_[17] << "\n"
+             << item.first << "_999 : " << std::fixed << std::setprecision(2) << agg.cdf_agg_datas_[18] << "\n"
+             << item.first << "_9999 : " << std::fixed << std::setprecision(2) << agg.cdf_agg_datas_[19] << "\n";
+        } else {
+          ss << item.first << " : " << std::fixed << std::setprecision(2) << agg.last_second_data() << "\n";
+        }
       }
     }
     auto content_size = write(fd, ss.str().c_str(), ss.str().size());
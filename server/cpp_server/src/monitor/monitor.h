@@ -16,17 +16,22 @@
  * MONITOR_AVG(name, value);
  * // Monitor metrics with cdf(continuous distribution function) aggregation.
  * MONITOR_CDF(name, value);
+ *
+ * // Register metrics once and get its handle. Handle can be used as name of above macros, which skips the lookup of
+ * // name on the recording path.
+ * auto* handle = MONITOR_REGISTER(name, netease::grps::AggType::kAvg);
+ * MONITOR_AVG(handle, value);
  */
 
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <boost/asio.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread.hpp>
 #include <condition_variable>
-#include <list>
+#include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -34,6 +39,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "metrics_history.h"
+
 // Monitor metrics with increase aggregation.
 #define MONITOR_INC(name, value) netease::grps::Monitor::Instance().Inc(name, value)
 // Monitor metrics with max aggregation.
@@ -44,6 +51,8 @@
 #define MONITOR_AVG(name, value) netease::grps::Monitor::Instance().Avg(name, value)
 // Monitor metrics with cdf(continuous distribution function) aggregation.
 #define MONITOR_CDF(name, value) netease::grps::Monitor::Instance().Cdf(name, value)
+// Register metrics and get its handle.
+#define MONITOR_REGISTER(name, agg_type) netease::grps::Monitor::Instance().Register(name, agg_type)
 
 // Time constants.
 #define ONE_MIN (60)
@@ -76,7 +85,6 @@ enum class AggType { kAvg = 0, kMax = 1, kMin = 2, kInc = 3, kCdf = 4 };
 class MetricsAgg {
 public:
   friend class Monitor;
-  MetricsAgg() = default;
 
   /**
    * Metrics aggregation constructor.
@@ -84,87 +92,132 @@ public:
    * @param agg_type: Aggregation type.
    */
   MetricsAgg(const std::string& agg_name, AggType agg_type);
+  MetricsAgg(const MetricsAgg&) = delete;
+  MetricsAgg& operator=(const MetricsAgg&) = delete;
+  MetricsAgg(MetricsAgg&&) = delete;
+  MetricsAgg& operator=(MetricsAgg&&) = delete;
 
   /**
-   * Put data into aggregation.
-   * @param now: The timestamp of the data.
+   * Put data into aggregation. Data is accumulated in the shard of current thread with a few relaxed atomic operations,
+   * and merged by aggregation once per second.
    * @param data: The data.
    */
-  void Put(int64_t now, float data);
+  void Put(float data);
 
   /**
-   * Start aggregation thread.
+   * Aggregate data put in last second, called by aggregation thread of monitor once per second.
+   * @param tick: Wall clock time(s) of current second, windows of minute, hour and day slide at their boundaries.
    */
-  void Start();
-
-  /**
-   * Stop aggregation thread.
-   */
-  void Stop();
+  void Aggregate(int64_t tick);
 
   /**
    * aggregation datas with json format.
    * trend data format:
    * { "label": "trend", "data": [[0, 0], [1, 0], ... [173, 0]] }
-   * cdf data format:
-   * { "label": "cdf", "data": [[10, 0], [20, 0], ... , [90,0], [91,0], ... [100, 0], [101, 0]] }
+   * cdf data format, percentiles of last 1 second, 1 minute and 1 hour:
+   * { "label": "cdf", "data": [[10, 0], [20, 0], ... , [90,0], [91,0], ... [100, 0], [101, 0]],
+   *   "data_1m": [[10, 0], ... [101, 0]], "data_1h": [[10, 0], ... [101, 0]] }
    */
   std::string agg_datas_json();
 
+  /**
+   * Append samples of aggregation with prometheus text format. avg, max and min are exposed as gauge of last second,
+   * inc as counter of total since start, and cdf as histogram of data since start.
+   * @param name: Metric family name.
+   * @param labels: Labels with `key="value",...` format, may be empty.
+   * @param out: Output text.
+   */
+  void AppendPrometheus(const std::string& name, const std::string& labels, std::string& out);
+
   /* aggregation type */
   [[nodiscard]] AggType agg_type() const { return agg_type_; }
 
+  /* aggregation name */
+  [[nodiscard]] const std::string& agg_name() const { return agg_name_; }
+
 private:
-  std::string agg_name_;
-  AggType agg_type_ = AggType::kAvg;
+  static constexpr int kShardNum = 16;
 
-  // TODO(zhaochaochao): Use lock free queue.
-  std::list<std::pair<int64_t, float>> agg_buffer_; // [0]: timestamp, [1]: data.
-  std::unique_ptr<std::mutex> agg_buffer_mutex_;
+  // Accumulator of data put in current second by threads of one shard. Aligned to cache line to avoid false sharing.
+  struct alignas(64) Shard {
+    std::atomic<int64_t> count{0};
+    std::atomic<double> sum{0};
+    std::atomic<float> max{std::numeric_limits<float>::lowest()};
+    std::atomic<float> min{std::numeric_limits<float>::max()};
+  };
 
-  // trend aggregation data.
-  // [0:29]: represent last 30 days agg data.
-  // [30:53]: represent last 24 hours agg data.
-  // [54:113]: represent last 60 minutes agg data.
-  // [114:173]: represent last 60 seconds agg data.
-  std::vector<float> trend_agg_datas_;
+  std::string agg_name_;
+  AggType agg_type_ = AggType::kAvg;
 
-  // cdf aggregation data.
+  std::array<Shard, kShardNum> shards_;
+
+  // Mergeable quantile sketch of cdf (DDSketch). Data is counted in log-spaced buckets, so that the percentile of data
+  // in [kMinValue, kMaxValue] has relative error less than kRelativeAccuracy. Smaller data (include 0 and negative) is
+  // counted as 0 and bigger data is clamped to kMaxValue.
+  class QuantileSketch {
+  public:
+    static constexpr double kRelativeAccuracy = 0.01;
+    static constexpr double kMinValue = 1e-3;
+    static constexpr double kMaxValue = 1e7;
+    // Sparse sketch with ascending (bucket, count) pairs, used to store sketches of seconds.
+    using Sparse = std::vector<std::pair<uint16_t, uint32_t>>;
+
+    static int BucketNum();
+    static int Bucket(float data);
+    // Representative value of bucket.
+    static float Value(int bucket);
+    // Compute percentiles (ascending) of dense sketch counts.
+    static void Percentiles(const std::vector<uint64_t>& counts,
+                            const std::vector<float>& percentiles,
+                            std::vector<float>& values);
+
+  private:
+    static const double kGamma;
+    static const double kLogGamma;
+    // Bucket i (i > 0) counts data in (gamma^(i + kMinKey - 2), gamma^(i + kMinKey - 1)].
+    static const int kMinKey;
+    static const int kMaxKey;
+  };
+
+  // Counts of cdf data put in current second, kShardNum rows of sketch counts and prometheus histogram counts.
+  std::unique_ptr<std::atomic<uint32_t>[]> sketch_shards_;
+  // Row of cdf counts in one shard: counts of sketch buckets followed by counts of prometheus histogram buckets.
+  static size_t SketchRowSize();
+  // Sketches of last 60 seconds, used as ring buffer.
+  std::vector<QuantileSketch::Sparse> second_sketches_;
+  // Dense sketches of last 60 minutes, point to window in history file if attached, otherwise to local rows.
+  std::vector<int64_t> local_minutes_;
+  std::vector<uint32_t> local_minute_counts_;
+  CdfWindow minute_window_;
+  // Merged sketches of the windows, sum of second_sketches_ and rows of minute_window_.
+  std::vector<uint64_t> minute_counts_;
+  std::vector<uint64_t> hour_counts_;
+
+  // Trend windows, point to windows in history file if attached, otherwise to local_trend_.
+  TrendWindows local_trend_;
+  TrendWindows* trend_ = &local_trend_;
+
+  // cdf aggregation data of last 1 second, 1 minute and 1 hour.
   // [0:19]: represent 10%, 20%, ..., 90%, 91%, ... 100%(99.9%), 101%(99.99%).
   std::vector<float> cdf_agg_datas_;
-
-  std::unique_ptr<std::mutex> agg_datas_mutex_;
-
-  std::unique_ptr<std::thread> agg_thread_;
-  static boost::asio::thread_pool pool;
-  boost::asio::deadline_timer timer_ = boost::asio::deadline_timer(pool.get_executor(), boost::posix_time::seconds(1));
-  int64_t iter_ = 0; // current iter count.
-  bool running_ = false;
-
-  // Aggregation thread function.
-  void AggThreadFunc(const boost::system::error_code& ec);
-  // avg func
-  static auto AvgFunc(const std::vector<float>::iterator& begin, const std::vector<float>::iterator& end);
-  // agg func
-  auto AggFunc(const std::vector<float>::iterator& begin, const std::vector<float>::iterator& end);
-};
-
-// One piece of metrics.
-struct MetricsPiece {
-public:
-  std::string name;
-  int64_t now;
-  float value;
-  AggType agg_type;
-
-  MetricsPiece(const std::string& name, int64_t now, float value, AggType agg_type)
-      : name(name), now(now), value(value), agg_type(agg_type) {}
-
-  [[nodiscard]] std::string ToString() const {
-    std::stringstream ss;
-    ss << "{name: " << name << ", now: " << now << ", value: " << value << ", agg_type: " << int(agg_type) << "}";
-    return ss.str();
-  }
+  std::vector<float> cdf_1m_agg_datas_;
+  std::vector<float> cdf_1h_agg_datas_;
+
+  // Cumulative data since start, exposed by prometheus.
+  double total_sum_ = 0;                   // Sum of data of inc and cdf.
+  uint64_t total_count_ = 0;               // Count of data of cdf.
+  std::vector<uint64_t> histogram_counts_; // Count of cdf data in each bucket of prometheus histogram.
+
+  std::mutex agg_datas_mutex_;
+
+  // Merge and reset shards, return aggregation of data put in last second.
+  float DrainShards();
+  // Merge and reset sketch shards, slide windows of cdf and update percentiles.
+  void AggCdf(int64_t tick);
+  // Attach windows to history, called by monitor when registered.
+  void AttachHistory(MetricsHistory& history, int64_t now_s);
+  // Trend data of last second, agg_datas_mutex_ should be held.
+  [[nodiscard]] float last_second_data() const { return trend_->seconds[(trend_->second_head + 59) % 60]; }
 };
 
 class Monitor {
@@ -180,7 +233,7 @@ public:
     return monitor;
   }
 
-  /* Init monitor. */
+  /* Init monitor. Open metrics history file under log dir if enabled. */
   void Init();
 
   /* Start monitor. */
@@ -191,57 +244,61 @@ public:
 
   /**
    * Add avg metrics piece. Monitor will save the data and aggregate it by avg function in agg_time_unit(1s).
-   * @param key: The name of the metrics.
+   * @param key: The name of the metrics, or the handle returned by Register.
    * @param value: The value of the metrics.
    */
-  void Avg(const std::string& key, float value) {
-    PutMetricPiece(MetricsPiece(key, time(nullptr), value, AggType::kAvg));
-  }
+  void Avg(const std::string& key, float value) { Put(key, AggType::kAvg, value); }
+  void Avg(MetricsAgg* handle, float value) { Put(handle, AggType::kAvg, value); }
 
   /**
    * Add max metrics piece. Monitor will save the data and aggregate it by max function in agg_time_unit(1s).
-   * @param key: The name of the metrics.
+   * @param key: The name of the metrics, or the handle returned by Register.
    * @param value: The value of the metrics.
    */
-  void Max(const std::string& key, float value) {
-    PutMetricPiece(MetricsPiece(key, time(nullptr), value, AggType::kMax));
-  }
+  void Max(const std::string& key, float value) { Put(key, AggType::kMax, value); }
+  void Max(MetricsAgg* handle, float value) { Put(handle, AggType::kMax, value); }
 
   /**
    * Add min metrics piece. Monitor will save the data and aggregate it by min function in agg_time_unit(1s).
-   * @param key: The name of the metrics.
+   * @param key: The name of the metrics, or the handle returned by Register.
    * @param value: The value of the metrics.
    */
-  void Min(const std::string& key, float value) {
-    PutMetricPiece(MetricsPiece(key, time(nullptr), value, AggType::kMin));
-  }
+  void Min(const std::string& key, float value) { Put(key, AggType::kMin, value); }
+  void Min(MetricsAgg* handle, float value) { Put(handle, AggType::kMin, value); }
 
   /**
    * Add inc(increase) metrics piece. Monitor will save the data and aggregate it by increase function in
    * agg_time_unit(1s).
-   * @param key: The name of the metrics.
+   * @param key: The name of the metrics, or the handle returned by Register.
    * @param value: The value of the metrics.
    */
-  void Inc(const std::string& key, float value) {
-    PutMetricPiece(MetricsPiece(key, time(nullptr), value, AggType::kInc));
-  }
+  void Inc(const std::string& key, float value) { Put(key, AggType::kInc, value); }
+  void Inc(MetricsAgg* handle, float value) { Put(handle, AggType::kInc, value); }
 
   /**
    * Add cdf(continuous distribution function) metrics piece. Monitor will save the data and aggregate it by cdf
    * function in agg_time_unit(1s).
-   * @param key: The name of the metrics.
+   * @param key: The name of the metrics, or the handle returned by Register.
    * @param value: The value of the metrics.
    */
-  void Cdf(const std::string& key, float value) {
-    PutMetricPiece(MetricsPiece(key, time(nullptr), value, AggType::kCdf));
-  }
+  void Cdf(const std::string& key, float value) { Put(key, AggType::kCdf, value); }
+  void Cdf(MetricsAgg* handle, float value) { Put(handle, AggType::kCdf, value); }
+
+  /**
+   * Register metrics if not registered, and get its handle. Handle is valid until the monitor is destroyed.
+   * @param name: The name of the metrics.
+   * @param agg_type: Aggregation type.
+   * @return Handle of the metrics, nullptr if the metrics has been registered with another aggregation type.
+   */
+  MetricsAgg* Register(const std::string& name, AggType agg_type);
 
   /**
    * Aggregation datas with json format.
    * trend data format:
    * { "label": "trend", "data": [[0, 0], [1, 0], ... [173, 0]] }
-   * cdf data format:
-   * { "label": "cdf", "data": [[10, 0], [20, 0], ... [90,0], [91,0], ... [100, 0], [101, 0]] }
+   * cdf data format, percentiles of last 1 second, 1 minute and 1 hour:
+   * { "label": "cdf", "data": [[10, 0], [20, 0], ... [90,0], [91,0], ... [100, 0], [101, 0]],
+   *   "data_1m": [[10, 0], ... [101, 0]], "data_1h": [[10, 0], ... [101, 0]] }
    */
   std::string GetMetricsAggDataJson(const char* name);
 
@@ -250,17 +307,36 @@ public:
    */
   std::vector<std::string> GetMetricsNames();
 
+  /**
+   * All metrics with prometheus text format(version 0.0.4). Metrics name is converted to `grps_` prefixed family name,
+   * and the label of metrics name is converted to prometheus labels, `model=name-version` is split into `model` and
+   * `version` labels. E.g. `*model_latency_avg(ms){model=m-1.0.0}` to `grps_model_latency_avg_ms{model="m",
+   * version="1.0.0"}`.
+   */
+  std::string GetPrometheusText();
+
 private:
-  std::unordered_map<std::string, MetricsAgg> metrics_agg_; // TODO(zhaochaochao): Use lock free map.
+  // Persistent history of metrics windows, nullptr if disabled. Declared before metrics, so that it is unmapped after
+  // metrics are destroyed.
+  std::unique_ptr<MetricsHistory> history_;
+  // Metrics aggregations are never removed, so that handles are always valid.
+  std::unordered_map<std::string, std::unique_ptr<MetricsAgg>> metrics_agg_;
   boost::shared_mutex metrics_agg_mutex_;
   std::atomic<bool> running_;
+  std::thread agg_metrics_thread_;
+  std::mutex agg_metrics_mutex_;
+  std::condition_variable agg_metrics_cv_; // Wake up aggregation thread when stopped.
   std::thread dump_metrics_agg_thread_;
   std::string monitor_log_path_;
 
   Monitor() : metrics_agg_(), running_(false) {}
 
-  // Put metrics piece into metrics queue.
-  void PutMetricPiece(const MetricsPiece& metrics_piece);
+  // Put data into metrics of name.
+  void Put(const std::string& name, AggType agg_type, float value);
+  // Put data into metrics of handle.
+  void Put(MetricsAgg* handle, AggType agg_type, float value);
+  // Aggregate all metrics once per second.
+  void AggMetricsAgg();
   // Dump metrics aggregation data into file.
   void DumpMetricsAgg();
 };
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/08/05
+ * Brief  Request recorder.
+ */
+
+#include "request_recorder.h"
+
+#include <butil/time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "logger/logger.h"
+
+namespace netease::grps {
+static constexpr size_t kHeaderSize = sizeof(RequestRecorder::kMagic) + sizeof(uint32_t);
+static constexpr size_t kRecordHeaderSize = sizeof(uint32_t) * 2 + sizeof(int64_t);
+
+static void PutFixed(std::string& buf, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    buf.push_back(char((value >> (8 * i)) & 0xff));
+  }
+}
+
+static uint64_t GetFixed(const char* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value |= uint64_t(uint8_t(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+static std::string Header() {
+  std::string header(RequestRecorder::kMagic, sizeof(RequestRecorder::kMagic));
+  PutFixed(header, RequestRecorder::kVersion, sizeof(uint32_t));
+  return header;
+}
+
+void RequestRecorder::Encode(const Record& record, std::string& buf) {
+  PutFixed(buf, record.model.size(), sizeof(uint32_t));
+  PutFixed(buf, record.message.size(), sizeof(uint32_t));
+  PutFixed(buf, uint64_t(record.arrival_us), sizeof(int64_t));
+  buf.append(record.model);
+  buf.append(record.message);
+}
+
+bool RequestRecorder::Init(const std::string& path,
+                           double sample_rate,
+                           int64_t max_file_size,
+                           int max_files) {
+  Stop();
+
+  path_ = path;
+  max_file_size_ = std::max<int64_t>(max_file_size, 1);
+  max_files_ = std::max(max_files, 1);
+  if (!Rotate()) {
+    return false;
+  }
+
+  sample_rate = std::clamp(sample_rate, 0.0, 1.0);
+  uint64_t threshold = sample_rate >= 1.0
+                         ? std::numeric_limits<uint64_t>::max()
+                         : uint64_t(sample_rate * double(std::numeric_limits<uint64_t>::max()));
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = true;
+  }
+  writer_ = std::thread(&RequestRecorder::WriteLoop, this);
+  threshold_.store(threshold, std::memory_order_relaxed);
+  LOG4(INFO, "Request recorder init, path: " << path_ << ", sample_rate: " << sample_rate
+                                             << ", max_file_size: " << max_file_size_
+                                             << ", max_files: " << max_files_);
+  return true;
+}
+
+void RequestRecorder::Stop() {
+  threshold_.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  if (file_ != nullptr) {
+    fclose(file_);
+    file_ = nullptr;
+    LOG4(INFO, "Request recorder stopped, dropped: " << dropped());
+  }
+}
+
+void RequestRecorder::Add(const ::grps::protos::v1::GrpsMessage& request, const std::string& model) {
+  Record record;
+  record.arrival_us = butil::gettimeofday_us();
+  record.model = model;
+  if (!request.SerializeToString(&record.message)) {
+    LOG4(WARN, "Request recorder serialize request failed, model: " << model);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_ || pending_.size() >= kMaxPending) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pending_.emplace_back(std::move(record));
+  }
+  cv_.notify_one();
+}
+
+void RequestRecorder::WriteLoop() {
+  std::deque<Record> records;
+  std::string buf;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] { return !running_ || !pending_.empty(); });
+      if (pending_.empty()) { // Stopped and all records are written.
+        break;
+      }
+      records.swap(pending_);
+    }
+
+    for (const auto& record : records) {
+      buf.clear();
+      Encode(record, buf);
+      if (file_size_ > int64_t(kHeaderSize) && file_size_ + int64_t(buf.size()) > max_file_size_ && !Rotate()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      if (file_ == nullptr || fwrite(buf.data(), 1, buf.size(), file_) != buf.size()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      file_size_ += int64_t(buf.size());
+    }
+    records.clear();
+    if (file_ != nullptr) {
+      fflush(file_);
+    }
+  }
+}
+
+bool RequestRecorder::Rotate() {
+  if (file_ != nullptr) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  // path.(n-2) -> path.(n-1), ..., path -> path.1, the oldest one is overwritten.
+  for (int i = max_files_ - 1; i >= 1; --i) {
+    auto from = i == 1 ? path_ : path_ + "." + std::to_string(i - 1);
+    auto to = path_ + "." + std::to_string(i);
+    rename(from.c_str(), to.c_str());
+  }
+
+  file_ = fopen(path_.c_str(), "wb");
+  if (file_ == nullptr) {
+    LOG4(ERROR, "Request recorder open file failed, path: " << path_ << ", error: " << strerror(errno));
+    return false;
+  }
+  auto header = Header();
+  if (fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+    LOG4(ERROR, "Request recorder write header failed, path: " << path_);
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  file_size_ = int64_t(header.size());
+  return true;
+}
+
+RequestRecordReader::~RequestRecordReader() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+bool RequestRecordReader::Open(const std::string& path) {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+  file_ = fopen(path.c_str(), "rb");
+  if (file_ == nullptr) {
+    LOG4(ERROR, "Open record file failed, path: " << path << ", error: " << strerror(errno));
+    return false;
+  }
+  char header[kHeaderSize];
+  if (fread(header, 1, kHeaderSize, file_) != kHeaderSize ||
+      memcmp(header, RequestRecorder::kMagic, sizeof(RequestRecorder::kMagic)) != 0) {
+    LOG4(ERROR, "Invalid record file, path: " << path);
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  auto version = uint32_t(GetFixed(header + sizeof(RequestRecorder::kMagic), sizeof(uint32_t)));
+  if (version != RequestRecorder::kVersion) {
+    LOG4(ERROR, "Unsupported record file version: " << version << ", path: " << path);
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool RequestRecordReader::Next(RequestRecorder::Record& record) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  char header[kRecordHeaderSize];
+  if (fread(header, 1, kRecordHeaderSize, file_) != kRecordHeaderSize) {
+    return false;
+  }
+  auto model_len = size_t(GetFixed(header, sizeof(uint32_t)));
+  auto msg_len = size_t(GetFixed(header + sizeof(uint32_t), sizeof(uint32_t)));
+  record.arrival_us = int64_t(GetFixed(header + sizeof(uint32_t) * 2, sizeof(int64_t)));
+  record.model.resize(model_len);
+  record.message.resize(msg_len);
+  if (fread(record.model.data(), 1, model_len, file_) != model_len ||
+      fread(record.message.data(), 1, msg_len, file_) != msg_len) {
+    return false;
+  }
+  return true;
+}
+} // namespace netease::grps
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/08/05
+ * Brief  Request recorder. A sampled subset of predict requests is written with arrival time and model name to a
+ *        rotating binary file by a background thread, which can be replayed by `grps_replay` tool for benchmarking
+ *        with real input distributions.
+ *
+ * File format(integers are little endian):
+ * header: magic(8 bytes, "GRPSREC\0"), version(uint32).
+ * record: model_len(uint32), msg_len(uint32), arrival_us(int64), model(model_len bytes),
+ *         serialized GrpsMessage(msg_len bytes).
+ *
+ * Usage:
+ * RequestRecorder::Instance().Init(path, sample_rate, max_file_size, max_files);
+ * RequestRecorder::Instance().Sample(request, model); // Only one atomic load when disabled.
+ * ...
+ * RequestRecordReader reader;
+ * if (reader.Open(path)) {
+ *   RequestRecorder::Record record;
+ *   while (reader.Next(record)) { ... }
+ * }
+ */
+
+#pragma once
+
+#include <butil/fast_rand.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "grps.pb.h"
+
+namespace netease::grps {
+class RequestRecorder {
+public:
+  static constexpr char kMagic[8] = "GRPSREC";
+  static constexpr uint32_t kVersion = 1;
+  static constexpr size_t kMaxPending = 4096; // Max records waiting for writing, new records are dropped when full.
+
+  struct Record {
+    int64_t arrival_us = 0; // Wall clock time(us) of request arrival.
+    std::string model;      // Model name of request, empty means the default dag.
+    std::string message;    // Serialized GrpsMessage.
+  };
+
+  ~RequestRecorder() { Stop(); }
+  RequestRecorder(const RequestRecorder&) = delete;
+  RequestRecorder& operator=(const RequestRecorder&) = delete;
+  RequestRecorder(RequestRecorder&&) = delete;
+  RequestRecorder& operator=(RequestRecorder&&) = delete;
+
+  static RequestRecorder& Instance() {
+    static RequestRecorder recorder;
+    return recorder;
+  }
+
+  /**
+   * @brief Init recorder and start writing thread. Existing file of path is rotated first.
+   * @param path: Record file path, rotated files are `path.1`, `path.2`, ...
+   * @param sample_rate: Ratio of requests to be recorded in [0, 1], 0 means disabled.
+   * @param max_file_size: Max size(bytes) of one record file.
+   * @param max_files: Max number of record files including the current one, the oldest one is removed when rotated.
+   * @return If success.
+   */
+  bool Init(const std::string& path, double sample_rate, int64_t max_file_size, int max_files);
+
+  /**
+   * @brief Stop sampling, flush pending records and close file.
+   */
+  void Stop();
+
+  /**
+   * @brief Sample request, and record it if sampled. Multi-thread safe.
+   * @param request: Predict request.
+   * @param model: Model name of request.
+   */
+  void Sample(const ::grps::protos::v1::GrpsMessage& request, const std::string& model) {
+    auto threshold = threshold_.load(std::memory_order_relaxed);
+    if (threshold == 0 || butil::fast_rand() > threshold) {
+      return;
+    }
+    Add(request, model);
+  }
+
+  // Number of records dropped since pending queue is full.
+  [[nodiscard]] uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  // Append record to buffer with file format.
+  static void Encode(const Record& record, std::string& buf);
+
+private:
+  // Threshold of 64 bits random number, request is sampled if random number is not greater than it. 0 means disabled.
+  std::atomic<uint64_t> threshold_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::string path_;
+  int64_t max_file_size_ = 0;
+  int max_files_ = 1;
+  FILE* file_ = nullptr;
+  int64_t file_size_ = 0;
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<Record> pending_;
+  bool running_ = false;
+  std::thread writer_;
+
+  RequestRecorder() = default;
+
+  void Add(const ::grps::protos::v1::GrpsMessage& request, const std::string& model);
+  // Write pending records until stopped.
+  void WriteLoop();
+  // Rotate existing files and open a new one. Only called by init or writing thread.
+  bool Rotate();
+};
+
+class RequestRecordReader {
+public:
+  RequestRecordReader() = default;
+  ~RequestRecordReader();
+  RequestRecordReader(const RequestRecordReader&) = delete;
+  RequestRecordReader& operator=(const RequestRecordReader&) = delete;
+
+  /**
+   * @brief Open record file and check its header.
+   * @return If success.
+   */
+  bool Open(const std::string& path);
+
+  /**
+   * @brief Read next record.
+   * @return False if no more complete record, a truncated record at the end of file is ignored.
+   */
+  bool Next(RequestRecorder::Record& record);
+
+private:
+  FILE* file_ = nullptr;
+};
+} // namespace netease::grps
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/08
+ * Brief  Latency metrics of inference stages.
+ */
+
+#include "stage_metrics.h"
+
+#include "constant.h"
+
+namespace netease::grps {
+StageMetrics::StageMetrics(const std::string& labels, bool converter, bool queue_wait) {
+  auto label_suffix = "{" + labels + "}";
+  if (queue_wait) {
+    this->queue_wait = MONITOR_REGISTER(std::string(STAGE_QUEUE_WAIT_AVG) + label_suffix, AggType::kAvg);
+  }
+  if (converter) {
+    preprocess = MONITOR_REGISTER(std::string(STAGE_PREPROCESS_AVG) + label_suffix, AggType::kAvg);
+    postprocess = MONITOR_REGISTER(std::string(STAGE_POSTPROCESS_AVG) + label_suffix, AggType::kAvg);
+  }
+  infer = MONITOR_REGISTER(std::string(STAGE_INFER_AVG) + label_suffix, AggType::kAvg);
+}
+} // namespace netease::grps
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/08
+ * Brief  Latency metrics of inference stages(queue wait, preprocess, infer and postprocess), labeled by model, dag
+ *        node or batch size.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "monitor/monitor.h"
+
+namespace netease::grps {
+struct StageMetrics {
+  /**
+   * @brief Register stage metrics of one label set.
+   * @param labels: Labels with `key=value,...` format, e.g. `model=m-1.0.0,node=n` or `model=m-1.0.0,batch=4`.
+   * @param converter: If register preprocess and postprocess metrics, only models with converter have them.
+   * @param queue_wait: If register queue wait metrics, only requests through batcher wait in queue.
+   */
+  StageMetrics(const std::string& labels, bool converter, bool queue_wait = false);
+
+  // Record latency in us, nullptr metrics is ignored.
+  static void Observe(MetricsAgg* metrics, int64_t latency_us) { MONITOR_AVG(metrics, float(latency_us) / 1000); }
+
+  // Metrics handles.
+  MetricsAgg* queue_wait = nullptr;
+  MetricsAgg* preprocess = nullptr;
+  MetricsAgg* infer = nullptr;
+  MetricsAgg* postprocess = nullptr;
+};
+} // namespace netease::grps
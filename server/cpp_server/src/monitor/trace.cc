@@ -0,0 +1,147 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/15
+ * Brief  Request trace.
+ */
+
+#include "trace.h"
+
+#include <butil/time.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "logger/logger.h"
+
+namespace netease::grps {
+static thread_local Trace* current_trace = nullptr;
+
+static uint64_t ThreadId() {
+  thread_local uint64_t tid = uint64_t(syscall(SYS_gettid));
+  return tid;
+}
+
+// Xorshift random number of current thread, good enough for sampling.
+static uint64_t Random() {
+  thread_local uint64_t state = uint64_t(butil::gettimeofday_us()) ^ (ThreadId() << 32) ^ 0x9e3779b97f4a7c15ULL;
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+void Trace::AddSpan(const char* name, int64_t begin_us, int64_t end_us, const std::string& detail) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  spans_.push_back({name, begin_us, end_us, ThreadId(), detail});
+}
+
+std::vector<Trace::Span> Trace::spans() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return spans_;
+}
+
+Tracer::CurrentScope::CurrentScope(Trace* trace) : prev_(current_trace) {
+  current_trace = trace;
+}
+
+Tracer::CurrentScope::~CurrentScope() {
+  current_trace = prev_;
+}
+
+Trace* Tracer::Current() {
+  return current_trace;
+}
+
+void Tracer::Init(double sample_rate, int max_traces) {
+  sample_rate = std::clamp(sample_rate, 0.0, 1.0);
+  uint64_t threshold = sample_rate >= 1.0
+                         ? std::numeric_limits<uint64_t>::max()
+                         : uint64_t(sample_rate * double(std::numeric_limits<uint64_t>::max()));
+  {
+    std::lock_guard<std::mutex> lock(traces_mtx_);
+    max_traces_ = size_t(std::max(max_traces, 1));
+    while (traces_.size() > max_traces_) {
+      traces_.pop_front();
+    }
+  }
+  threshold_.store(threshold, std::memory_order_relaxed);
+  LOG4(INFO, "Tracer init, sample_rate: " << sample_rate << ", max_traces: " << max_traces);
+}
+
+std::shared_ptr<Trace> Tracer::Sample(const char* entry) {
+  auto threshold = threshold_.load(std::memory_order_relaxed);
+  if (threshold == 0 || Random() > threshold) {
+    return nullptr;
+  }
+  return std::make_shared<Trace>(next_id_.fetch_add(1, std::memory_order_relaxed), entry, butil::gettimeofday_us());
+}
+
+void Tracer::Finish(std::shared_ptr<Trace> trace) {
+  if (!trace) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(traces_mtx_);
+  traces_.emplace_back(std::move(trace));
+  while (traces_.size() > max_traces_) {
+    traces_.pop_front();
+  }
+}
+
+std::string Tracer::ChromeTraceJson(size_t limit) {
+  std::vector<std::shared_ptr<Trace>> traces;
+  {
+    std::lock_guard<std::mutex> lock(traces_mtx_);
+    size_t num = limit == 0 ? traces_.size() : std::min(limit, traces_.size());
+    traces.assign(traces_.end() - num, traces_.end());
+  }
+
+  rapidjson::Document doc;
+  doc.SetObject();
+  auto& allocator = doc.GetAllocator();
+  rapidjson::Value events(rapidjson::kArrayType);
+  for (const auto& trace : traces) {
+    // Name the track of request.
+    rapidjson::Value meta(rapidjson::kObjectType);
+    meta.AddMember("name", "thread_name", allocator);
+    meta.AddMember("ph", "M", allocator);
+    meta.AddMember("pid", 1, allocator);
+    meta.AddMember("tid", trace->id(), allocator);
+    rapidjson::Value meta_args(rapidjson::kObjectType);
+    auto track_name = std::string(trace->entry()) + " #" + std::to_string(trace->id());
+    meta_args.AddMember("name", rapidjson::Value(track_name.c_str(), allocator), allocator);
+    meta.AddMember("args", meta_args, allocator);
+    events.PushBack(meta, allocator);
+
+    for (const auto& span : trace->spans()) {
+      rapidjson::Value event(rapidjson::kObjectType);
+      event.AddMember("name", rapidjson::StringRef(span.name), allocator);
+      event.AddMember("cat", rapidjson::StringRef(trace->entry()), allocator);
+      event.AddMember("ph", "X", allocator);
+      event.AddMember("ts", span.begin_us, allocator);
+      event.AddMember("dur", std::max<int64_t>(span.end_us - span.begin_us, 0), allocator);
+      event.AddMember("pid", 1, allocator);
+      event.AddMember("tid", trace->id(), allocator);
+      rapidjson::Value args(rapidjson::kObjectType);
+      args.AddMember("thread", span.tid, allocator);
+      if (!span.detail.empty()) {
+        args.AddMember("model", rapidjson::Value(span.detail.c_str(), allocator), allocator);
+      }
+      event.AddMember("args", args, allocator);
+      events.PushBack(event, allocator);
+    }
+  }
+  doc.AddMember("traceEvents", events, allocator);
+  doc.AddMember("displayTimeUnit", "ms", allocator);
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  doc.Accept(writer);
+  return buffer.GetString();
+}
+} // namespace netease::grps
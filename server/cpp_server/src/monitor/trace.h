@@ -0,0 +1,136 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/15
+ * Brief  Request trace. A sampled subset of requests records spans of each stage (pool queue, batch queue,
+ *        preprocess, infer, postprocess, serialization and respond), and the latest traces are exported with chrome
+ *        trace format in http://ip:port/grps/v1/monitor/trace, which can be opened by chrome://tracing or perfetto.
+ *
+ * Usage:
+ * auto trace = Tracer::Instance().Sample("predict"); // nullptr if not sampled.
+ * Tracer::CurrentScope scope(trace.get());           // Contexts acquired in scope record spans into trace.
+ * ...
+ * Trace::Record(ctx.trace(), "infer", begin_us, end_us, model_name);
+ * ...
+ * Tracer::Instance().Finish(trace);
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace netease::grps {
+// Spans of one sampled request. Tasks that may outlive the request keep it alive by shared_from_this.
+class Trace : public std::enable_shared_from_this<Trace> {
+public:
+  struct Span {
+    const char* name; // Stage name, should be a string literal.
+    int64_t begin_us;
+    int64_t end_us;
+    uint64_t tid;       // Thread recording the span.
+    std::string detail; // Model or node name, may be empty.
+  };
+
+  Trace(uint64_t id, const char* entry, int64_t begin_us) : id_(id), entry_(entry), begin_us_(begin_us) {}
+  Trace(const Trace&) = delete;
+  Trace& operator=(const Trace&) = delete;
+
+  /**
+   * @brief Record span of current thread. Multi-thread safe.
+   */
+  void AddSpan(const char* name, int64_t begin_us, int64_t end_us, const std::string& detail = "");
+
+  // Record span if trace is not nullptr, so that untraced requests only pay for one branch.
+  static void Record(Trace* trace, const char* name, int64_t begin_us, int64_t end_us, const std::string& detail = "") {
+    if (trace != nullptr) {
+      trace->AddSpan(name, begin_us, end_us, detail);
+    }
+  }
+
+  [[nodiscard]] uint64_t id() const { return id_; }
+  [[nodiscard]] const char* entry() const { return entry_; }
+  [[nodiscard]] int64_t begin_us() const { return begin_us_; }
+  // Copy of spans. Multi-thread safe.
+  [[nodiscard]] std::vector<Span> spans() const;
+
+private:
+  uint64_t id_;
+  const char* entry_;
+  int64_t begin_us_;
+  mutable std::mutex mtx_;
+  std::vector<Span> spans_;
+};
+
+class Tracer {
+public:
+  ~Tracer() = default;
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+  Tracer(Tracer&&) = delete;
+  Tracer& operator=(Tracer&&) = delete;
+
+  static Tracer& Instance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  // Set trace of requests handled by current thread in scope, contexts acquired in scope record spans into it.
+  class CurrentScope {
+  public:
+    explicit CurrentScope(Trace* trace);
+    ~CurrentScope();
+    CurrentScope(const CurrentScope&) = delete;
+    CurrentScope& operator=(const CurrentScope&) = delete;
+
+  private:
+    Trace* prev_;
+  };
+
+  /**
+   * @brief Init tracer.
+   * @param sample_rate: Ratio of requests to be traced in [0, 1], 0 means disabled.
+   * @param max_traces: Max number of latest finished traces kept in memory.
+   */
+  void Init(double sample_rate, int max_traces);
+
+  /**
+   * @brief Sample current request.
+   * @param entry: Entry of request, should be a string literal.
+   * @return Trace of request, nullptr if not sampled. Only one atomic load when disabled.
+   */
+  std::shared_ptr<Trace> Sample(const char* entry);
+
+  /**
+   * @brief Finish trace and keep it for export, the oldest one is dropped when exceeding max traces.
+   */
+  void Finish(std::shared_ptr<Trace> trace);
+
+  /**
+   * @brief Latest finished traces with chrome trace format. Each request is shown as one track, and each span as a
+   * complete event:
+   * { "traceEvents": [{"name": "infer", "ph": "X", "ts": 0, "dur": 10, "pid": 1, "tid": 1, "args": {...}}, ...],
+   *   "displayTimeUnit": "ms" }
+   * @param limit: Max number of traces, 0 means all.
+   */
+  std::string ChromeTraceJson(size_t limit = 0);
+
+  // Trace of current thread, nullptr if current request is not sampled.
+  static Trace* Current();
+
+private:
+  // Threshold of 64 bits random number, request is sampled if random number is less than it. 0 means disabled.
+  std::atomic<uint64_t> threshold_{0};
+  std::atomic<uint64_t> next_id_{1};
+  size_t max_traces_ = 1000;
+  std::mutex traces_mtx_;
+  std::deque<std::shared_ptr<Trace>> traces_;
+
+  Tracer() = default;
+};
+} // namespace netease::grps
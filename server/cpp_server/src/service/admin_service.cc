@@ -0,0 +1,83 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/11
+ * Brief  admin service.
+ */
+
+#include "admin_service.h"
+
+#include <brpc/server.h>
+
+#include "executor/executor.h"
+#include "logger/logger.h"
+#include "model_infer/infer_profiler.h"
+
+namespace netease::grps {
+// Max number of requests profiled by one call, traces are large.
+static constexpr long kMaxProfileRequests = 1000;
+
+void AdminServiceImpl::ReloadModels(::google::protobuf::RpcController* controller,
+                                    const ::grps::protos::v1::EmptyGrpsMessage* request,
+                                    ::grps::protos::v1::EmptyGrpsMessage* response,
+                                    ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_POST) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  cntl->http_response().set_content_type("text/plain");
+  try {
+    Executor::Instance().Reload();
+  } catch (const std::exception& e) {
+    LOG4(ERROR, "Reload models failed: " << e.what());
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    cntl->response_attachment().append(std::string("Reload models failed: ") + e.what());
+    return;
+  }
+  cntl->response_attachment().append("Reload models success.");
+}
+
+void AdminServiceImpl::Profile(::google::protobuf::RpcController* controller,
+                               const ::grps::protos::v1::EmptyGrpsMessage* request,
+                               ::grps::protos::v1::EmptyGrpsMessage* response,
+                               ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_POST) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  cntl->http_response().set_content_type("text/plain");
+  auto* model = cntl->http_request().uri().GetQuery("model"); // Model name with `name-version` format.
+  if (model == nullptr || model->empty()) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_BAD_REQUEST);
+    cntl->response_attachment().append("Param model is required.");
+    return;
+  }
+  long n = 1; // Number of next requests to be profiled, 0 means canceling profiling.
+  auto* n_param = cntl->http_request().uri().GetQuery("n");
+  if (n_param != nullptr && !n_param->empty()) {
+    char* end = nullptr;
+    n = strtol(n_param->c_str(), &end, 10);
+    if (end == nullptr || *end != '\0' || n < 0 || n > kMaxProfileRequests) {
+      cntl->http_response().set_status_code(brpc::HTTP_STATUS_BAD_REQUEST);
+      cntl->response_attachment().append("Param n should be in [0, " + std::to_string(kMaxProfileRequests) + "].");
+      return;
+    }
+  }
+
+  if (!InferProfiler::Instance().Arm(*model, int(n))) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_NOT_FOUND);
+    cntl->response_attachment().append("Model " + *model + " not found or its inferer does not support profiler.");
+    return;
+  }
+  cntl->response_attachment().append("Profile next " + std::to_string(n) + " requests of model " + *model +
+                                     ", traces will be written to " + InferProfiler::Instance().dir() + ".");
+}
+} // namespace netease::grps
@@ -0,0 +1,25 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/11
+ * Brief  admin service.
+ */
+
+#pragma once
+
+#include "grps.brpc.pb.h"
+
+namespace netease::grps {
+class AdminServiceImpl : public ::grps::protos::v1::AdminService {
+public:
+  void ReloadModels(::google::protobuf::RpcController* controller,
+                    const ::grps::protos::v1::EmptyGrpsMessage* request,
+                    ::grps::protos::v1::EmptyGrpsMessage* response,
+                    ::google::protobuf::Closure* done) override;
+
+  void Profile(::google::protobuf::RpcController* controller,
+               const ::grps::protos::v1::EmptyGrpsMessage* request,
+               ::grps::protos::v1::EmptyGrpsMessage* response,
+               ::google::protobuf::Closure* done) override;
+};
+} // namespace netease::grps
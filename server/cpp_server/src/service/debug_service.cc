@@ -0,0 +1,220 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/29
+ * Brief  debug service.
+ */
+
+#include "debug_service.h"
+
+#include <brpc/server.h>
+#include <bthread/bthread.h>
+#include <butil/file_util.h>
+#include <butil/files/file_path.h>
+#include <dlfcn.h>
+
+#include <atomic>
+#include <ctime>
+
+#include "config/global_config.h"
+#include "logger/logger.h"
+
+// Resolved only if jemalloc is linked or preloaded.
+extern "C" int mallctl(const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
+  __attribute__((weak));
+
+namespace netease::grps {
+static constexpr int kDefaultCpuProfileSeconds = 10;
+static constexpr int kMaxCpuProfileSeconds = 300;
+
+int TokenAuthenticator::GenerateCredential(std::string* auth_str) const {
+  *auth_str = credential_;
+  return 0;
+}
+
+int TokenAuthenticator::VerifyCredential(const std::string& auth_str,
+                                         const butil::EndPoint& client_addr,
+                                         brpc::AuthContext* out_ctx) const {
+  // Compare in constant time, so that token can not be guessed by response time.
+  unsigned char diff = auth_str.size() == credential_.size() ? 0 : 1;
+  for (size_t i = 0; i < credential_.size(); ++i) {
+    diff |= (i < auth_str.size() ? auth_str[i] : 0) ^ credential_[i];
+  }
+  if (diff != 0) {
+    LOG4(WARN, "Debug server authentication failed, client: " << butil::endpoint2str(client_addr).c_str());
+    return -1;
+  }
+  return 0;
+}
+
+// Cpu profiler of gperftools. Resolved from current process, or loaded from libprofiler if installed, so that it can
+// be used without relinking server.
+struct GperftoolsProfiler {
+  int (*start)(const char*) = nullptr;
+  void (*stop)() = nullptr;
+};
+
+static const GperftoolsProfiler& Gperftools() {
+  static GperftoolsProfiler profiler = [] {
+    GperftoolsProfiler p;
+    void* handle = RTLD_DEFAULT;
+    if (dlsym(handle, "ProfilerStart") == nullptr) {
+      handle = dlopen("libprofiler.so.0", RTLD_NOW | RTLD_GLOBAL);
+      if (handle == nullptr) {
+        handle = dlopen("libprofiler.so", RTLD_NOW | RTLD_GLOBAL);
+      }
+    }
+    if (handle != nullptr) {
+      p.start = reinterpret_cast<int (*)(const char*)>(dlsym(handle, "ProfilerStart"));
+      p.stop = reinterpret_cast<void (*)()>(dlsym(handle, "ProfilerStop"));
+    }
+    return p;
+  }();
+  return profiler;
+}
+
+// Path of new profile file under `${log_dir}/profiler/`, empty if failed to create dir.
+static std::string ProfilePath(const std::string& type) {
+  auto dir = GlobalConfig::Instance().server_config().log.log_dir + "/profiler";
+  butil::File::Error error;
+  if (!butil::CreateDirectoryAndGetError(butil::FilePath(dir), &error)) {
+    LOG4(ERROR, "Create profiler dir failed, dir: " << dir << ", error: " << error);
+    return {};
+  }
+  time_t now = time(nullptr);
+  struct tm tm_now {};
+  localtime_r(&now, &tm_now);
+  char time_str[32];
+  strftime(time_str, sizeof(time_str), "%Y%m%d-%H%M%S", &tm_now);
+  return dir + "/" + type + "-" + time_str + ".prof";
+}
+
+// Respond profile file, or 500 if failed to read it.
+static void RespondProfile(brpc::Controller* cntl, const std::string& path) {
+  std::string content;
+  if (!butil::ReadFileToString(butil::FilePath(path), &content)) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    cntl->response_attachment().append("Read profile failed, path: " + path);
+    return;
+  }
+  cntl->http_response().set_content_type("application/octet-stream");
+  cntl->http_response().SetHeader("Content-Disposition",
+                                  "attachment; filename=" + butil::FilePath(path).BaseName().value());
+  cntl->response_attachment().append(content);
+}
+
+void DebugServiceImpl::CpuProfile(::google::protobuf::RpcController* controller,
+                                  const ::grps::protos::v1::EmptyGrpsMessage* request,
+                                  ::grps::protos::v1::EmptyGrpsMessage* response,
+                                  ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_GET) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  cntl->http_response().set_content_type("text/plain");
+  long seconds = kDefaultCpuProfileSeconds; // Get "seconds" param from url.
+  auto* seconds_param = cntl->http_request().uri().GetQuery("seconds");
+  if (seconds_param != nullptr && !seconds_param->empty()) {
+    char* end = nullptr;
+    seconds = strtol(seconds_param->c_str(), &end, 10);
+    if (end == nullptr || *end != '\0' || seconds < 1 || seconds > kMaxCpuProfileSeconds) {
+      cntl->http_response().set_status_code(brpc::HTTP_STATUS_BAD_REQUEST);
+      cntl->response_attachment().append("Param seconds should be in [1, " + std::to_string(kMaxCpuProfileSeconds) +
+                                         "].");
+      return;
+    }
+  }
+
+  const auto& profiler = Gperftools();
+  if (profiler.start == nullptr || profiler.stop == nullptr) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_NOT_IMPLEMENTED);
+    cntl->response_attachment().append("Cpu profiler is not available, install gperftools(libprofiler.so).");
+    return;
+  }
+
+  static std::atomic<bool> running{false};
+  if (running.exchange(true)) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_SERVICE_UNAVAILABLE);
+    cntl->response_attachment().append("Another cpu profile is running, try again later.");
+    return;
+  }
+  auto path = ProfilePath("cpu");
+  if (path.empty() || !profiler.start(path.c_str())) {
+    running = false;
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    cntl->response_attachment().append("Start cpu profiler failed.");
+    return;
+  }
+  LOG4(INFO, "Cpu profile started, seconds: " << seconds << ", path: " << path);
+  // Yield worker pthread to other bthreads while sampling.
+  bthread_usleep(uint64_t(seconds) * 1000000);
+  profiler.stop();
+  running = false;
+  LOG4(INFO, "Cpu profile finished, path: " << path);
+
+  RespondProfile(cntl, path);
+}
+
+void DebugServiceImpl::HeapProfile(::google::protobuf::RpcController* controller,
+                                   const ::grps::protos::v1::EmptyGrpsMessage* request,
+                                   ::grps::protos::v1::EmptyGrpsMessage* response,
+                                   ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_GET) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  cntl->http_response().set_content_type("text/plain");
+  if (mallctl == nullptr) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_NOT_IMPLEMENTED);
+    cntl->response_attachment().append("Heap profiler is not available, jemalloc is not loaded.");
+    return;
+  }
+  bool prof = false;
+  size_t len = sizeof(prof);
+  if (mallctl("opt.prof", &prof, &len, nullptr, 0) != 0 || !prof) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_NOT_IMPLEMENTED);
+    cntl->response_attachment().append(
+      "Heap profiler is not enabled, start server with env MALLOC_CONF=prof:true,prof_active:false and jemalloc "
+      "built with --enable-prof.");
+    return;
+  }
+
+  // Switch heap sampling.
+  auto* active_param = cntl->http_request().uri().GetQuery("active");
+  if (active_param != nullptr) {
+    if (*active_param != "true" && *active_param != "false") {
+      cntl->http_response().set_status_code(brpc::HTTP_STATUS_BAD_REQUEST);
+      cntl->response_attachment().append("Param active should be true or false.");
+      return;
+    }
+    bool active = *active_param == "true";
+    if (mallctl("prof.active", nullptr, nullptr, &active, sizeof(active)) != 0) {
+      cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
+      cntl->response_attachment().append("Switch heap profiler failed.");
+      return;
+    }
+    LOG4(INFO, "Heap profiler active: " << active);
+    cntl->response_attachment().append(std::string("Heap profiler active: ") + *active_param + ".");
+    return;
+  }
+
+  auto path = ProfilePath("heap");
+  const char* path_ptr = path.c_str();
+  if (path.empty() || mallctl("prof.dump", nullptr, nullptr, &path_ptr, sizeof(path_ptr)) != 0) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
+    cntl->response_attachment().append("Dump heap profile failed.");
+    return;
+  }
+  LOG4(INFO, "Heap profile dumped, path: " << path);
+
+  RespondProfile(cntl, path);
+}
+} // namespace netease::grps
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/29
+ * Brief  debug service, served by debug listener on a separate port with token authentication. Besides cpu and heap
+ *        profiles below, brpc builtin services(/hotspots/contention, /vars, /flags, /threads...) are also enabled on
+ *        the debug listener, while interface ports keep builtin services disabled.
+ */
+
+#pragma once
+
+#include <brpc/authenticator.h>
+
+#include <string>
+
+#include "grps.brpc.pb.h"
+
+namespace netease::grps {
+// Verify `Authorization: Bearer <token>` header of http requests.
+class TokenAuthenticator : public brpc::Authenticator {
+public:
+  explicit TokenAuthenticator(std::string token) : credential_("Bearer " + std::move(token)) {}
+
+  int GenerateCredential(std::string* auth_str) const override;
+
+  int VerifyCredential(const std::string& auth_str,
+                       const butil::EndPoint& client_addr,
+                       brpc::AuthContext* out_ctx) const override;
+
+private:
+  std::string credential_;
+};
+
+class DebugServiceImpl : public ::grps::protos::v1::DebugService {
+public:
+  // Profile cpu for `seconds`(default 10) by gperftools, and respond raw profile which can be analyzed by pprof.
+  void CpuProfile(::google::protobuf::RpcController* controller,
+                  const ::grps::protos::v1::EmptyGrpsMessage* request,
+                  ::grps::protos::v1::EmptyGrpsMessage* response,
+                  ::google::protobuf::Closure* done) override;
+
+  // Dump heap profile of jemalloc and respond it, which can be analyzed by jeprof. `active=true|false` param switches
+  // heap sampling instead of dumping.
+  void HeapProfile(::google::protobuf::RpcController* controller,
+                   const ::grps::protos::v1::EmptyGrpsMessage* request,
+                   ::grps::protos::v1::EmptyGrpsMessage* response,
+                   ::google::protobuf::Closure* done) override;
+};
+} // namespace netease::grps
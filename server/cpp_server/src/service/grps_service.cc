@@ -17,6 +17,7 @@
 #include "handler/grps_handler.h"
 #include "logger/logger.h"
 #include "monitor/monitor.h"
+#include "monitor/trace.h"
 
 #define BRPC_HANDLER_PROCESS(FuncName)                               \
   {                                                                  \
@@ -38,6 +39,42 @@
 namespace netease::grps {
 std::unique_ptr<::boost::asio::thread_pool> g_predict_threadpool = nullptr;
 
+// Handles of request metrics, registered on first use.
+static MetricsAgg* QpsMetric() {
+  static auto* handle = MONITOR_REGISTER(QPS, AggType::kInc);
+  return handle;
+}
+
+static MetricsAgg* LatencyAvgMetric() {
+  static auto* handle = MONITOR_REGISTER(REQ_LATENCY_AVG, AggType::kAvg);
+  return handle;
+}
+
+static MetricsAgg* LatencyMaxMetric() {
+  static auto* handle = MONITOR_REGISTER(REQ_LATENCY_MAX, AggType::kMax);
+  return handle;
+}
+
+static MetricsAgg* LatencyCdfMetric() {
+  static auto* handle = MONITOR_REGISTER(REQ_LATENCY_CDF, AggType::kCdf);
+  return handle;
+}
+
+// Record time waiting for predict thread pool of sampled request.
+static void TracePoolQueue(Trace* trace, int64_t begin_us) {
+  if (trace != nullptr) {
+    trace->AddSpan("pool_queue", begin_us, butil::gettimeofday_us());
+  }
+}
+
+// Record the whole request and keep the trace for export.
+static void FinishTrace(std::shared_ptr<Trace>& trace, int64_t begin_us) {
+  if (trace) {
+    trace->AddSpan("request", begin_us, butil::gettimeofday_us());
+    Tracer::Instance().Finish(std::move(trace));
+  }
+}
+
 void GrpsBrpcServiceImpl::Predict(::google::protobuf::RpcController* controller,
                                   const ::grps::protos::v1::GrpsMessage* request,
                                   ::grps::protos::v1::GrpsMessage* response,
@@ -45,22 +82,32 @@ void GrpsBrpcServiceImpl::Predict(::google::protobuf::RpcController* controller,
   brpc::ClosureGuard done_guard(done);
 
   auto remote_side = dynamic_cast<brpc::Controller*>(controller)->remote_side();
-  MONITOR_INC(QPS, 1);
+  MONITOR_INC(QpsMetric(), 1);
   auto begin = butil::gettimeofday_us();
 
   boost::promise<void> promise;
   auto future = promise.get_future();
+  auto trace = Tracer::Instance().Sample("brpc_predict");
   boost::asio::post(*g_predict_threadpool, [&]() {
+    TracePoolQueue(trace.get(), begin);
+    Tracer::CurrentScope trace_scope(trace.get());
     BRPC_HANDLER_PROCESS(Predict);
     promise.set_value();
   });
   future.wait();
 
   auto latency = float(butil::gettimeofday_us() - begin) / 1000.0;
-  MONITOR_AVG(REQ_LATENCY_AVG, latency);
-  MONITOR_MAX(REQ_LATENCY_MAX, latency);
-  MONITOR_CDF(REQ_LATENCY_CDF, latency);
+  MONITOR_AVG(LatencyAvgMetric(), latency);
+  MONITOR_MAX(LatencyMaxMetric(), latency);
+  MONITOR_CDF(LatencyCdfMetric(), latency);
   LOG4(INFO, "[Predict] from " << remote_side << ", latency: " << latency << "ms.");
+  if (trace) {
+    // Send response now, so that serializing and writing response is traced.
+    auto respond_begin = butil::gettimeofday_us();
+    done_guard.reset(nullptr);
+    trace->AddSpan("respond", respond_begin, butil::gettimeofday_us());
+    FinishTrace(trace, begin);
+  }
 }
 
 void GrpsBrpcServiceImpl::PredictByHttp(::google::protobuf::RpcController* controller,
@@ -68,7 +115,7 @@ void GrpsBrpcServiceImpl::PredictByHttp(::google::protobuf::RpcController* contr
                                         ::grps::protos::v1::EmptyGrpsMessage* response,
                                         ::google::protobuf::Closure* done) {
   auto remote_side = dynamic_cast<brpc::Controller*>(controller)->remote_side();
-  MONITOR_INC(QPS, 1);
+  MONITOR_INC(QpsMetric(), 1);
   auto begin = butil::gettimeofday_us();
   auto* cntl = dynamic_cast<brpc::Controller*>(controller);
   if (cntl->request_protocol() != brpc::PROTOCOL_HTTP) {
@@ -79,17 +126,21 @@ void GrpsBrpcServiceImpl::PredictByHttp(::google::protobuf::RpcController* contr
 
   boost::promise<void> promise;
   auto future = promise.get_future();
+  auto trace = Tracer::Instance().Sample("http_predict");
   boost::asio::post(*g_predict_threadpool, [&]() {
+    TracePoolQueue(trace.get(), begin);
+    Tracer::CurrentScope trace_scope(trace.get());
     http_handler_.PredictByHttp(cntl, request, response, done);
     promise.set_value();
   });
   future.wait();
 
   auto latency = float(butil::gettimeofday_us() - begin) / 1000.0;
-  MONITOR_AVG(REQ_LATENCY_AVG, latency);
-  MONITOR_MAX(REQ_LATENCY_MAX, latency);
-  MONITOR_CDF(REQ_LATENCY_CDF, latency);
+  MONITOR_AVG(LatencyAvgMetric(), latency);
+  MONITOR_MAX(LatencyMaxMetric(), latency);
+  MONITOR_CDF(LatencyCdfMetric(), latency);
   LOG4(INFO, "[Predict] from " << remote_side << ", latency: " << latency << "ms.");
+  FinishTrace(trace, begin);
 }
 
 void GrpsBrpcServiceImpl::Online(::google::protobuf::RpcController* controller,
@@ -156,22 +207,26 @@ void GrpsBrpcServiceImpl::ModelMetadata(::google::protobuf::RpcController* contr
                                             const ::grps::protos::v1::GrpsMessage* request,
                                             ::grps::protos::v1::GrpsMessage* response) {
   auto remote_side = context->peer();
-  MONITOR_INC(QPS, 1);
+  MONITOR_INC(QpsMetric(), 1);
   auto begin = butil::gettimeofday_us();
 
   boost::promise<void> promise;
   auto future = promise.get_future();
+  auto trace = Tracer::Instance().Sample("grpc_predict");
   boost::asio::post(*g_predict_threadpool, [&]() {
+    TracePoolQueue(trace.get(), begin);
+    Tracer::CurrentScope trace_scope(trace.get());
     rpc_handler_.Predict(context, request, response);
     promise.set_value();
   });
   future.wait();
 
   auto latency = float(butil::gettimeofday_us() - begin) / 1000.0;
-  MONITOR_AVG(REQ_LATENCY_AVG, latency);
-  MONITOR_MAX(REQ_LATENCY_MAX, latency);
-  MONITOR_CDF(REQ_LATENCY_CDF, latency);
+  MONITOR_AVG(LatencyAvgMetric(), latency);
+  MONITOR_MAX(LatencyMaxMetric(), latency);
+  MONITOR_CDF(LatencyCdfMetric(), latency);
   LOG4(INFO, "[Predict] from " << remote_side << ", latency: " << latency << "ms.");
+  FinishTrace(trace, begin);
   return ::grpc::Status::OK;
 }
 
@@ -179,22 +234,26 @@ void GrpsBrpcServiceImpl::ModelMetadata(::google::protobuf::RpcController* contr
                                                      const ::grps::protos::v1::GrpsMessage* request,
                                                      ::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>* writer) {
   auto remote_side = context->peer();
-  MONITOR_INC(QPS, 1);
+  MONITOR_INC(QpsMetric(), 1);
   auto begin = butil::gettimeofday_us();
 
   boost::promise<void> promise;
   auto future = promise.get_future();
+  auto trace = Tracer::Instance().Sample("grpc_predict_streaming");
   boost::asio::post(*g_predict_threadpool, [&]() {
+    TracePoolQueue(trace.get(), begin);
+    Tracer::CurrentScope trace_scope(trace.get());
     rpc_handler_.PredictStreaming(context, request, writer);
     promise.set_value();
   });
   future.wait();
 
   auto latency = float(butil::gettimeofday_us() - begin) / 1000.0;
-  MONITOR_AVG(REQ_LATENCY_AVG, latency);
-  MONITOR_MAX(REQ_LATENCY_MAX, latency);
-  MONITOR_CDF(REQ_LATENCY_CDF, latency);
+  MONITOR_AVG(LatencyAvgMetric(), latency);
+  MONITOR_MAX(LatencyMaxMetric(), latency);
+  MONITOR_CDF(LatencyCdfMetric(), latency);
   LOG4(INFO, "[PredictStreaming] from " << remote_side << ", latency: " << latency << "ms.");
+  FinishTrace(trace, begin);
   return ::grpc::Status::OK;
 }
 
@@ -10,6 +10,7 @@
 #include <brpc/server.h>
 
 #include "monitor/monitor.h"
+#include "monitor/trace.h"
 
 namespace netease::grps {
 void MonitorServiceImpl::Metrics(::google::protobuf::RpcController* controller,
@@ -63,7 +64,8 @@ void MonitorServiceImpl::Metrics(::google::protobuf::RpcController* controller,
       "g,\"\\\\$&\"),[e.data],trendOptions),$(\"#value-\"+r.replace(/[!\"#$%&'()*+,./:;<=>?@[\\\\\\]^`{|}~]/"
       "g,\"\\\\$&\")).html(e.data[e.data.length-1][1]);else "
       "if(\"cdf\"==e.label)lastPlot[r]=$.plot(\"#\"+r.replace(/[!\"#$%&'()*+,./:;<=>?@[\\\\\\]^`{|}~]/"
-      "g,\"\\\\$&\"),[e.data],cdfOptions),$(\"#value-\"+r.replace(/[!\"#$%&'()*+,./:;<=>?@[\\\\\\]^`{|}~]/"
+      "g,\"\\\\$&\"),e.data_1m?[{label:\"1s\",data:e.data},{label:\"1m\",data:e.data_1m},{label:\"1h\","
+      "data:e.data_1h}]:[e.data],cdfOptions),$(\"#value-\"+r.replace(/[!\"#$%&'()*+,./:;<=>?@[\\\\\\]^`{|}~]/"
       "g,\"\\\\$&\")).html(e.data[e.data.length-1][1]);else{lastPlot[r]=$.plot(\"#\"+r.replace(/[!\"#$%&'()*+,./"
       ":;<=>?@[\\\\\\]^`{|}~]/g,\"\\\\$&\"),e,trendOptions);for(var a='\"[',t=0;t<e.length;++t){0!=t&&(a+=\",\");var "
       "l=e[t].data;a+=l[l.length-1][1]}a+=']\"',$(\"#value-\"+r.replace(/[!\"#$%&'()*+,./:;<=>?@[\\\\\\]^`{|}~]/"
@@ -115,4 +117,49 @@ void MonitorServiceImpl::SeriesData(::google::protobuf::RpcController* controlle
   cntl->http_response().set_content_type("application/json");
   cntl->response_attachment().append(Monitor::Instance().GetMetricsAggDataJson(metrics_name->c_str()));
 }
+
+void MonitorServiceImpl::Prometheus(::google::protobuf::RpcController* controller,
+                                    const ::grps::protos::v1::EmptyGrpsMessage* request,
+                                    ::grps::protos::v1::EmptyGrpsMessage* response,
+                                    ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_GET) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  // Set response
+  cntl->http_response().set_content_type("text/plain; version=0.0.4; charset=utf-8");
+  cntl->response_attachment().append(Monitor::Instance().GetPrometheusText());
+}
+
+void MonitorServiceImpl::Trace(::google::protobuf::RpcController* controller,
+                               const ::grps::protos::v1::EmptyGrpsMessage* request,
+                               ::grps::protos::v1::EmptyGrpsMessage* response,
+                               ::google::protobuf::Closure* done) {
+  brpc::ClosureGuard done_guard(done);
+  auto* cntl = (brpc::Controller*)controller;
+
+  if (cntl->http_request().method() != brpc::HTTP_METHOD_GET) {
+    cntl->http_response().set_status_code(brpc::HTTP_STATUS_METHOD_NOT_ALLOWED);
+    return;
+  }
+
+  size_t limit = 0; // Get "limit" param from url, max number of latest traces, 0 means all.
+  auto* limit_param = cntl->http_request().uri().GetQuery("limit");
+  if (limit_param != nullptr && !limit_param->empty()) {
+    char* end = nullptr;
+    limit = strtoul(limit_param->c_str(), &end, 10);
+    if (end == nullptr || *end != '\0') {
+      cntl->http_response().set_status_code(brpc::HTTP_STATUS_BAD_REQUEST);
+      return;
+    }
+  }
+
+  // Set response
+  cntl->http_response().set_content_type("application/json");
+  cntl->response_attachment().append(Tracer::Instance().ChromeTraceJson(limit));
+}
 } // namespace netease::grps
\ No newline at end of file
@@ -21,5 +21,15 @@ public:
                   const ::grps::protos::v1::EmptyGrpsMessage* request,
                   ::grps::protos::v1::EmptyGrpsMessage* response,
                   ::google::protobuf::Closure* done) override;
+
+  void Prometheus(::google::protobuf::RpcController* controller,
+                  const ::grps::protos::v1::EmptyGrpsMessage* request,
+                  ::grps::protos::v1::EmptyGrpsMessage* response,
+                  ::google::protobuf::Closure* done) override;
+
+  void Trace(::google::protobuf::RpcController* controller,
+             const ::grps::protos::v1::EmptyGrpsMessage* request,
+             ::grps::protos::v1::EmptyGrpsMessage* response,
+             ::google::protobuf::Closure* done) override;
 };
 } // namespace netease::grps
\ No newline at end of file
@@ -0,0 +1,500 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/24
+ * Brief  Dag test.
+ */
+
+#include "dag/dag.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "converter/converter.h"
+#include "logger/logger.h"
+#include "model_infer/infer_profiler.h"
+#include "model_infer/inferer.h"
+#include "monitor/monitor.h"
+#include "monitor/trace.h"
+
+using netease::grps::Converter;
+using netease::grps::GlobalConfig;
+using netease::grps::GraphDag;
+using netease::grps::GrpsContext;
+using netease::grps::InferDag;
+using netease::grps::InferProfiler;
+using netease::grps::ModelInferer;
+using netease::grps::ModelNode;
+using netease::grps::Node;
+using netease::grps::SequentialDag;
+using netease::grps::TensorWrapper;
+using netease::grps::Trace;
+using Tensors = std::vector<std::pair<std::string, TensorWrapper>>;
+
+// Node copying input to output with gmap `name: 1` added, after sleeping sleep_ms.
+class TestNode : public Node {
+public:
+  TestNode(const std::string& name, int sleep_ms) : Node(name), sleep_ms_(sleep_ms) {}
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override {
+    int running = ++running_;
+    int max_running = max_running_;
+    while (running > max_running && !max_running_.compare_exchange_weak(max_running, running)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms_));
+    output.CopyFrom(input);
+    (*output.mutable_gmap()->mutable_s_i32())[name_] = 1;
+    if (ctx.trace() != nullptr) {
+      ++traced_;
+    }
+    ++processed_;
+    --running_;
+  }
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override {
+    Process(input, output, *ctx_sp);
+  }
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override {
+    throw NodeException("Not support batch.");
+  }
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override {
+    throw NodeException("Not support batch.");
+  }
+
+  // Max number of nodes running concurrently.
+  static std::atomic<int> max_running_;
+  static std::atomic<int> running_;
+  static std::atomic<int> processed_;
+  // Number of nodes processed with trace of request.
+  static std::atomic<int> traced_;
+
+private:
+  int sleep_ms_;
+};
+
+std::atomic<int> TestNode::max_running_{0};
+std::atomic<int> TestNode::running_{0};
+std::atomic<int> TestNode::processed_{0};
+std::atomic<int> TestNode::traced_{0};
+
+// Node outputting float32 tensor `score` of value after sleeping sleep_ms, or failing.
+class ValueNode : public Node {
+public:
+  ValueNode(const std::string& name, float value, int sleep_ms = 0, bool fail = false)
+      : Node(name), value_(value), sleep_ms_(sleep_ms), fail_(fail) {}
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               GrpsContext& ctx) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms_));
+    if (fail_) {
+      throw NodeException("Value node " + name_ + " failed.");
+    }
+    auto* tensor = output.mutable_gtensors()->add_tensors();
+    tensor->set_name("score");
+    tensor->set_dtype(::grps::protos::v1::DT_FLOAT32);
+    tensor->add_shape(1);
+    tensor->add_flat_float32(value_);
+  }
+
+  void Process(const ::grps::protos::v1::GrpsMessage& input,
+               ::grps::protos::v1::GrpsMessage& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override {
+    Process(input, output, *ctx_sp);
+  }
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               GrpsContext& ctx) override {
+    throw NodeException("Not support batch.");
+  }
+
+  void Process(const std::vector<::grps::protos::v1::GrpsMessage>& input,
+               std::vector<::grps::protos::v1::GrpsMessage>& output,
+               const std::shared_ptr<GrpsContext>& ctx_sp) override {
+    throw NodeException("Not support batch.");
+  }
+
+private:
+  float value_;
+  int sleep_ms_;
+  bool fail_;
+};
+
+// Inferer adding 1 to float32 tensors, or upper-casing str_data in no converter mode.
+class TestInferer : public ModelInferer {
+public:
+  ModelInferer* Clone() override { return new TestInferer(); }
+
+  void Infer(const Tensors& inputs, Tensors& outputs, GrpsContext& ctx) override {
+    for (const auto& [name, input] : inputs) {
+      auto tensor = std::make_shared<::grps::protos::v1::GenericTensor>(*input.generic_tensor);
+      for (auto& value : *tensor->mutable_flat_float32()) {
+        value += 1;
+      }
+      outputs.emplace_back(name, TensorWrapper(tensor));
+    }
+    ++inferred_;
+  }
+
+  void Infer(const ::grps::protos::v1::GrpsMessage& input,
+             ::grps::protos::v1::GrpsMessage& output,
+             GrpsContext& ctx) override {
+    auto text = input.str_data();
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    output.set_str_data(text);
+    ++inferred_;
+  }
+
+  [[nodiscard]] bool SupportProfiler() const override { return true; }
+
+  void InferWithProfiler(const std::string& profiler_path,
+                         const ::grps::protos::v1::GrpsMessage& input,
+                         ::grps::protos::v1::GrpsMessage& output,
+                         GrpsContext& ctx) override {
+    std::lock_guard<std::mutex> lock(mtx_);
+    profiler_paths_.emplace_back(profiler_path);
+    Infer(input, output, ctx);
+  }
+
+  std::atomic<int> inferred_{0};
+  std::mutex mtx_;
+  std::vector<std::string> profiler_paths_;
+};
+
+// Converter passing gtensors through as generic tensors.
+class TestConverter : public Converter {
+public:
+  Converter* Clone() override { return new TestConverter(); }
+
+  void PreProcess(const ::grps::protos::v1::GrpsMessage& input, Tensors& output, GrpsContext& ctx) override {
+    for (const auto& tensor : input.gtensors().tensors()) {
+      output.emplace_back(tensor.name(), TensorWrapper(tensor));
+    }
+    ++preprocessed_;
+  }
+
+  void PostProcess(const Tensors& input, ::grps::protos::v1::GrpsMessage& output, GrpsContext& ctx) override {
+    for (const auto& [name, tensor] : input) {
+      *output.mutable_gtensors()->add_tensors() = *tensor.generic_tensor;
+    }
+    ++postprocessed_;
+  }
+
+  std::atomic<int> preprocessed_{0};
+  std::atomic<int> postprocessed_{0};
+};
+
+static GlobalConfig::InferenceConfig::NodeConfig NodeConfig(const std::string& name,
+                                                            const std::vector<std::string>& inputs) {
+  GlobalConfig::InferenceConfig::NodeConfig config;
+  config.name = name;
+  config.type = "model";
+  config.model = name;
+  config.inputs = inputs;
+  return config;
+}
+
+// Nodes named by node configs of model type, with sleep_ms.
+static std::unordered_map<std::string, std::shared_ptr<Node>> NamedNodes(
+  const std::vector<GlobalConfig::InferenceConfig::NodeConfig>& configs, int sleep_ms) {
+  std::unordered_map<std::string, std::shared_ptr<Node>> named_nodes;
+  for (const auto& config : configs) {
+    if (config.type == "model") {
+      named_nodes[config.name] = std::make_shared<TestNode>(config.name, sleep_ms);
+    }
+  }
+  return named_nodes;
+}
+
+static void ResetCounters() {
+  TestNode::max_running_ = 0;
+  TestNode::running_ = 0;
+  TestNode::processed_ = 0;
+  TestNode::traced_ = 0;
+}
+
+TEST(dag_test, test_cycle) {
+  // a -> b -> c -> a.
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {NodeConfig("a", {"c"}), NodeConfig("b", {"a"}),
+                                                                   NodeConfig("c", {"b"})};
+  GraphDag dag("test_cycle");
+  EXPECT_THROW(dag.BuildDag(configs, {}, NamedNodes(configs, 0)), InferDag::InferDagException);
+
+  // Self loop.
+  configs = {NodeConfig("a", {}), NodeConfig("b", {"a", "b"})};
+  EXPECT_THROW(dag.BuildDag(configs, {}, NamedNodes(configs, 0)), InferDag::InferDagException);
+
+  // Unknown input and duplicated name.
+  configs = {NodeConfig("a", {}), NodeConfig("b", {"x"})};
+  EXPECT_THROW(dag.BuildDag(configs, {}, NamedNodes(configs, 0)), InferDag::InferDagException);
+  configs = {NodeConfig("a", {}), NodeConfig("a", {})};
+  EXPECT_THROW(dag.BuildDag(configs, {}, NamedNodes(configs, 0)), InferDag::InferDagException);
+}
+
+TEST(dag_test, test_parallel_branches) {
+  ResetCounters();
+  // Sink d is listed first, nodes are run in topological order.
+  // a -> b -> d
+  //   -> c ->
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {
+    NodeConfig("d", {"b", "c"}), NodeConfig("a", {}), NodeConfig("b", {"a"}), NodeConfig("c", {"a"})};
+  GraphDag dag("test_parallel_branches");
+  dag.BuildDag(configs, {}, NamedNodes(configs, 100));
+
+  ::grps::protos::v1::GrpsMessage input;
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  auto trace = std::make_shared<Trace>(1, "test", 0);
+  ctx->set_trace(trace.get());
+  auto begin = std::chrono::steady_clock::now();
+  dag.Infer(input, output, ctx);
+  auto cost_ms =
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+  ASSERT_FALSE(ctx->has_err());
+  EXPECT_EQ(TestNode::processed_, 4);
+  // Nodes running on pool threads share trace of request.
+  EXPECT_EQ(TestNode::traced_, 4);
+  // b and c run concurrently, d merges outputs of both branches.
+  EXPECT_EQ(TestNode::max_running_, 2);
+  EXPECT_LT(cost_ms, 390);
+  for (const auto& name : {"a", "b", "c", "d"}) {
+    EXPECT_EQ(output.gmap().s_i32().count(name), 1) << name;
+  }
+
+  // Independent sources run concurrently, outputs of sinks are merged.
+  ResetCounters();
+  configs = {NodeConfig("a", {}), NodeConfig("b", {})};
+  GraphDag sources_dag("test_parallel_sources");
+  sources_dag.BuildDag(configs, {}, NamedNodes(configs, 100));
+  output.Clear();
+  sources_dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err());
+  EXPECT_EQ(TestNode::max_running_, 2);
+  EXPECT_EQ(output.gmap().s_i32().count("a"), 1);
+  EXPECT_EQ(output.gmap().s_i32().count("b"), 1);
+}
+
+TEST(dag_test, test_early_exit) {
+  // a -> cond -> b, cond exits when gmap `score` >= 0.5.
+  auto condition = NodeConfig("cond", {"a"});
+  condition.type = "condition";
+  condition.model.clear();
+  condition.condition.key = "score";
+  condition.condition.op = ">=";
+  condition.condition.value = 0.5;
+  condition.condition.action = "exit";
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {NodeConfig("a", {}), condition,
+                                                                   NodeConfig("b", {"cond"})};
+  GraphDag dag("test_early_exit");
+  dag.BuildDag(configs, {}, NamedNodes(configs, 0));
+
+  // Exit, b is skipped and output of a is the output of dag.
+  ResetCounters();
+  ::grps::protos::v1::GrpsMessage input;
+  (*input.mutable_gmap()->mutable_s_f())["score"] = 0.9;
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err());
+  EXPECT_EQ(TestNode::processed_, 1);
+  EXPECT_EQ(output.gmap().s_i32().count("a"), 1);
+  EXPECT_EQ(output.gmap().s_i32().count("b"), 0);
+
+  // Not exit, b runs.
+  ResetCounters();
+  (*input.mutable_gmap()->mutable_s_f())["score"] = 0.1;
+  output.Clear();
+  ctx = GrpsContext::Acquire(&input);
+  dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err());
+  EXPECT_EQ(TestNode::processed_, 2);
+  EXPECT_EQ(output.gmap().s_i32().count("b"), 1);
+}
+
+TEST(dag_test, test_split_merge) {
+  // Split text into chunks of 4 bytes, upper-case chunks concurrently and concat them, with default max_concurrency.
+  auto splitter = NodeConfig("split", {});
+  splitter.type = "splitter";
+  splitter.model.clear();
+  splitter.split.type = "text";
+  splitter.split.chunk_size = 4;
+  auto merger = NodeConfig("merge", {});
+  merger.type = "merger";
+  merger.model.clear();
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {splitter, NodeConfig("upper", {}), merger};
+  auto inferer = std::make_shared<TestInferer>();
+  SequentialDag dag("test_split_merge");
+  dag.BuildDag(configs, {}, {{"upper", std::make_shared<ModelNode>("upper", "upper", inferer, nullptr, nullptr)}});
+
+  ::grps::protos::v1::GrpsMessage input;
+  input.set_str_data("hello world!");
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err()) << ctx->err_msg();
+  EXPECT_EQ(output.str_data(), "HELLO WORLD!");
+  EXPECT_EQ(inferer->inferred_, 3);
+}
+
+TEST(dag_test, test_tensor_handoff) {
+  // add1 => add2, tensors of add1 are handed off to add2 without converters between them.
+  auto handoff = NodeConfig("add2", {});
+  handoff.tensor_handoff = true;
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {NodeConfig("add1", {}), handoff};
+  auto converter = std::make_shared<TestConverter>();
+  auto inferer = std::make_shared<TestInferer>();
+  std::unordered_map<std::string, std::shared_ptr<Node>> named_nodes = {
+    {"add1", std::make_shared<ModelNode>("add1", "add1", inferer, converter, nullptr)},
+    {"add2", std::make_shared<ModelNode>("add2", "add2", inferer, converter, nullptr)}};
+  SequentialDag dag("test_tensor_handoff");
+  dag.BuildDag(configs, {}, named_nodes);
+
+  ::grps::protos::v1::GrpsMessage input;
+  auto* tensor = input.mutable_gtensors()->add_tensors();
+  tensor->set_name("x");
+  tensor->set_dtype(::grps::protos::v1::DT_FLOAT32);
+  tensor->add_shape(1);
+  tensor->add_flat_float32(1);
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err()) << ctx->err_msg();
+  ASSERT_EQ(output.gtensors().tensors_size(), 1);
+  EXPECT_EQ(output.gtensors().tensors(0).flat_float32(0), 3);
+  EXPECT_EQ(inferer->inferred_, 2);
+  EXPECT_EQ(converter->preprocessed_, 1);
+  EXPECT_EQ(converter->postprocessed_, 1);
+
+  // Node without converter does not support tensor hand-off.
+  named_nodes["add2"] = std::make_shared<ModelNode>("add2", "add2", inferer, nullptr, nullptr);
+  SequentialDag invalid_dag("test_invalid_handoff");
+  EXPECT_THROW(invalid_dag.BuildDag(configs, {}, named_nodes), InferDag::InferDagException);
+}
+
+// Ensemble node config of members with weights.
+static GlobalConfig::InferenceConfig::NodeConfig EnsembleConfig(
+  const std::vector<std::pair<std::string, double>>& members, const std::string& reduce) {
+  auto config = NodeConfig("ensemble", {});
+  config.type = "ensemble";
+  config.model.clear();
+  for (const auto& [model, weight] : members) {
+    config.ensemble.members.push_back({model, weight});
+  }
+  config.ensemble.reduce = reduce;
+  return config;
+}
+
+TEST(dag_test, test_ensemble_weighted_sum) {
+  // Members run concurrently with default max_concurrency, 0.25 * 1 + 0.75 * 5 = 4.
+  std::vector<GlobalConfig::InferenceConfig::NodeConfig> configs = {
+    EnsembleConfig({{"one", 0.25}, {"five", 0.75}}, "weighted_sum")};
+  SequentialDag dag("test_ensemble_weighted_sum");
+  dag.BuildDag(configs, {},
+               {{"one", std::make_shared<ValueNode>("one", 1)}, {"five", std::make_shared<ValueNode>("five", 5)}});
+
+  ::grps::protos::v1::GrpsMessage input;
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  dag.Infer(input, output, ctx);
+  ASSERT_FALSE(ctx->has_err()) << ctx->err_msg();
+  ASSERT_EQ(output.gtensors().tensors_size(), 1);
+  EXPECT_FLOAT_EQ(output.gtensors().tensors(0).flat_float32(0), 4);
+}
+
+TEST(dag_test, test_ensemble_degraded) {
+  // Slow member exceeds timeout and failed member is dropped, result of the succeeded member is returned.
+  auto config = EnsembleConfig({{"fast", 1}, {"slow", 1}, {"failed", 1}}, "mean");
+  config.ensemble.timeout_ms = 100;
+  std::unordered_map<std::string, std::shared_ptr<Node>> named_nodes = {
+    {"fast", std::make_shared<ValueNode>("fast", 1)},
+    {"slow", std::make_shared<ValueNode>("slow", 5, 300)},
+    {"failed", std::make_shared<ValueNode>("failed", 5, 0, true)}};
+  SequentialDag dag("test_ensemble_degraded");
+  dag.BuildDag({config}, {}, named_nodes);
+
+  ::grps::protos::v1::GrpsMessage input;
+  ::grps::protos::v1::GrpsMessage output;
+  auto ctx = GrpsContext::Acquire(&input);
+  auto begin = std::chrono::steady_clock::now();
+  dag.Infer(input, output, ctx);
+  auto cost_ms =
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+  ASSERT_FALSE(ctx->has_err()) << ctx->err_msg();
+  EXPECT_LT(cost_ms, 250);
+  ASSERT_EQ(output.gtensors().tensors_size(), 1);
+  EXPECT_FLOAT_EQ(output.gtensors().tensors(0).flat_float32(0), 1);
+
+  // Fail if succeeded members are less than min_members.
+  config.ensemble.min_members = 2;
+  SequentialDag strict_dag("test_ensemble_strict");
+  strict_dag.BuildDag({config}, {}, named_nodes);
+  ctx = GrpsContext::Acquire(&input);
+  strict_dag.Infer(input, output, ctx);
+  EXPECT_TRUE(ctx->has_err());
+}
+
+TEST(dag_test, test_profiler) {
+  auto inferer = std::make_shared<TestInferer>();
+  ModelNode node("p", "p-1.0.0", inferer, nullptr, nullptr);
+  EXPECT_FALSE(InferProfiler::Instance().Arm("unknown-1.0.0", 1));
+  ASSERT_TRUE(InferProfiler::Instance().Arm("p-1.0.0", 2));
+
+  // Only the next 2 requests are profiled, each with its own profiler path.
+  ::grps::protos::v1::GrpsMessage input;
+  input.set_str_data("a");
+  ::grps::protos::v1::GrpsMessage output;
+  for (int i = 0; i < 3; ++i) {
+    auto ctx = GrpsContext::Acquire(&input);
+    node.Process(input, output, ctx);
+    ASSERT_FALSE(ctx->has_err()) << ctx->err_msg();
+    EXPECT_EQ(output.str_data(), "A");
+  }
+  EXPECT_EQ(inferer->inferred_, 3);
+  ASSERT_EQ(inferer->profiler_paths_.size(), 2);
+  EXPECT_EQ(std::set<std::string>(inferer->profiler_paths_.begin(), inferer->profiler_paths_.end()).size(), 2);
+  for (const auto& path : inferer->profiler_paths_) {
+    EXPECT_EQ(path.find(InferProfiler::Instance().dir() + "/p-1.0.0-"), 0) << path;
+  }
+
+  // Arm 0 cancels profiling.
+  ASSERT_TRUE(InferProfiler::Instance().Arm("p-1.0.0", 2));
+  ASSERT_TRUE(InferProfiler::Instance().Arm("p-1.0.0", 0));
+  auto ctx = GrpsContext::Acquire(&input);
+  node.Process(input, output, ctx);
+  EXPECT_EQ(inferer->profiler_paths_.size(), 2);
+}
+
+int main(int argc, char** argv) {
+  // Init logger.
+  std::string sys_log_path = "./logs/grps_server.log";
+  std::string usr_log_path = "./logs/grps_usr.log";
+  netease::grps::DailyLogger::Instance().Init(sys_log_path, 7, usr_log_path, 7);
+
+  auto& monitor_inst = netease::grps::Monitor::Instance();
+  monitor_inst.Init();
+  monitor_inst.Start();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  auto ret = RUN_ALL_TESTS();
+
+  monitor_inst.Stop();
+  return ret;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/07/29
+ * Brief  Debug service test.
+ */
+
+#include "service/debug_service.h"
+
+#include <gtest/gtest.h>
+
+#include "logger/logger.h"
+
+using netease::grps::TokenAuthenticator;
+
+TEST(debug_service_test, test_token_authenticator) {
+  TokenAuthenticator authenticator("secret");
+  std::string credential;
+  EXPECT_EQ(authenticator.GenerateCredential(&credential), 0);
+  EXPECT_EQ(credential, "Bearer secret");
+
+  butil::EndPoint client_addr;
+  EXPECT_EQ(authenticator.VerifyCredential("Bearer secret", client_addr, nullptr), 0);
+  // Wrong token with the same length.
+  EXPECT_NE(authenticator.VerifyCredential("Bearer secreT", client_addr, nullptr), 0);
+  // Token with different length, including prefix of the right one.
+  EXPECT_NE(authenticator.VerifyCredential("Bearer secret0", client_addr, nullptr), 0);
+  EXPECT_NE(authenticator.VerifyCredential("Bearer secre", client_addr, nullptr), 0);
+  EXPECT_NE(authenticator.VerifyCredential("secret", client_addr, nullptr), 0);
+  // Empty token.
+  EXPECT_NE(authenticator.VerifyCredential("", client_addr, nullptr), 0);
+  EXPECT_NE(authenticator.VerifyCredential("Bearer ", client_addr, nullptr), 0);
+}
+
+int main(int argc, char** argv) {
+  // Init logger.
+  std::string sys_log_path = "./logs/grps_server.log";
+  std::string usr_log_path = "./logs/grps_usr.log";
+  netease::grps::DailyLogger::Instance().Init(sys_log_path, 7, usr_log_path, 7);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,291 @@
+// Replay requests recorded by request recorder(`request_recorder` of server.yml) against grps server, and report
+// throughput and latency cdf.
+// Usage: grps_replay --records=grps_requests.rec.1,grps_requests.rec --server=0.0.0.0:7080 --protocol=http
+#include <brpc/channel.h>
+#include <butil/logging.h>
+#include <butil/strings/string_split.h>
+#include <butil/time.h>
+#include <gflags/gflags.h>
+#include <grpcpp/grpcpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/pb_utils.h"
+#include "grps.brpc.pb.h"
+#include "grps.grpc.pb.h"
+#include "logger/logger.h"
+#include "monitor/request_recorder.h"
+
+DEFINE_string(records, "", "Record files separated by comma, from the oldest to the latest");
+DEFINE_string(server, "0.0.0.0:7080", "IP Address of server");
+DEFINE_string(protocol, "http", "Protocol of server[http|grpc|brpc]");
+DEFINE_double(rate_scale, 1.0, "Scale of original request rate, 0 means as fast as possible");
+DEFINE_int32(concurrency, 64, "Number of concurrent requests");
+DEFINE_int32(timeout_ms, 3000, "RPC timeout in milliseconds");
+DEFINE_string(model, "", "Replay all requests to this model instead of the recorded one");
+
+using netease::grps::RequestRecorder;
+
+// Sends one request with the given protocol, returns if success.
+class Sender {
+public:
+  virtual ~Sender() = default;
+  virtual bool Init() = 0;
+  virtual bool Send(const ::grps::protos::v1::GrpsMessage& request, const std::string& model) = 0;
+};
+
+class BrpcSender : public Sender {
+public:
+  explicit BrpcSender(brpc::ProtocolType protocol) : protocol_(protocol) {}
+
+  bool Init() override {
+    brpc::ChannelOptions options;
+    options.protocol = protocol_;
+    options.timeout_ms = FLAGS_timeout_ms;
+    options.max_retry = 0;
+    if (channel_.Init(FLAGS_server.c_str(), "", &options) != 0) {
+      LOG(ERROR) << "Fail to initialize channel";
+      return false;
+    }
+    return true;
+  }
+
+  bool Send(const ::grps::protos::v1::GrpsMessage& request, const std::string& model) override {
+    brpc::Controller cntl;
+    if (protocol_ == brpc::PROTOCOL_HTTP) {
+      return SendHttp(cntl, request, model);
+    }
+    ::grps::protos::v1::GrpsMessage true_req = request;
+    true_req.set_model(model);
+    ::grps::protos::v1::GrpsMessage response;
+    ::grps::protos::v1::GrpsBrpcService_Stub stub(&channel_);
+    stub.Predict(&cntl, &true_req, &response, nullptr);
+    if (cntl.Failed()) {
+      LOG(WARNING) << "Predict failed, " << cntl.ErrorText();
+      return false;
+    }
+    return response.status().status() == ::grps::protos::v1::Status::SUCCESS;
+  }
+
+private:
+  brpc::ProtocolType protocol_;
+  brpc::Channel channel_;
+
+  // Requests with bin_data are sent as octet-stream, others are sent as json.
+  bool SendHttp(brpc::Controller& cntl, const ::grps::protos::v1::GrpsMessage& request, const std::string& model) {
+    cntl.http_request().uri() = "/grps/v1/infer/predict";
+    if (!model.empty()) {
+      cntl.http_request().uri().SetQuery("model", model);
+    }
+    cntl.http_request().set_method(brpc::HTTP_METHOD_POST);
+    if (request.data_oneof_case() == ::grps::protos::v1::GrpsMessage::kBinData) {
+      cntl.http_request().set_content_type("application/octet-stream");
+      cntl.request_attachment().append(request.bin_data());
+    } else {
+      ::grps::protos::v1::GrpsMessage true_req = request;
+      true_req.clear_model();
+      cntl.http_request().set_content_type("application/json");
+      cntl.request_attachment().append(netease::grps::Pb2json(true_req));
+    }
+    channel_.CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+    if (cntl.Failed()) {
+      LOG(WARNING) << "Predict failed, " << cntl.ErrorText();
+      return false;
+    }
+    return true;
+  }
+};
+
+class GrpcSender : public Sender {
+public:
+  bool Init() override {
+    grpc::ChannelArguments args;
+    args.SetMaxReceiveMessageSize(1024 * 1024 * 1024); // 1G
+    args.SetMaxSendMessageSize(1024 * 1024 * 1024);    // 1G
+    auto channel = grpc::CreateCustomChannel(FLAGS_server, grpc::InsecureChannelCredentials(), args);
+    stub_ = ::grps::protos::v1::GrpsService::NewStub(channel);
+    return stub_ != nullptr;
+  }
+
+  bool Send(const ::grps::protos::v1::GrpsMessage& request, const std::string& model) override {
+    ::grps::protos::v1::GrpsMessage true_req = request;
+    true_req.set_model(model);
+    ::grps::protos::v1::GrpsMessage response;
+    grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(FLAGS_timeout_ms));
+    grpc::Status status = stub_->Predict(&context, true_req, &response);
+    if (!status.ok()) {
+      LOG(WARNING) << "Predict failed, " << status.error_message();
+      return false;
+    }
+    return response.status().status() == ::grps::protos::v1::Status::SUCCESS;
+  }
+
+private:
+  std::unique_ptr<::grps::protos::v1::GrpsService::Stub> stub_;
+};
+
+struct Task {
+  size_t idx;
+  int64_t scheduled_us; // Latency is measured from scheduled time, so that queueing of client is also counted.
+};
+
+int main(int argc, char* argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  netease::grps::DailyLogger::Instance().Init("./logs/grps_replay.log", 1, "./logs/grps_replay_usr.log", 1);
+
+  if (FLAGS_records.empty() || FLAGS_rate_scale < 0 || FLAGS_concurrency < 1) {
+    LOG(ERROR) << "--records must be set, --rate_scale must not be negative and --concurrency must be positive";
+    return -1;
+  }
+
+  // Load records.
+  std::vector<RequestRecorder::Record> records;
+  std::vector<std::string> files;
+  butil::SplitString(FLAGS_records, ',', &files);
+  for (const auto& file : files) {
+    netease::grps::RequestRecordReader reader;
+    if (!reader.Open(file)) {
+      LOG(ERROR) << "Fail to open record file: " << file;
+      return -1;
+    }
+    RequestRecorder::Record record;
+    while (reader.Next(record)) {
+      records.emplace_back(std::move(record));
+    }
+  }
+  if (records.empty()) {
+    LOG(ERROR) << "No record found";
+    return -1;
+  }
+  std::stable_sort(records.begin(), records.end(),
+                   [](const auto& a, const auto& b) { return a.arrival_us < b.arrival_us; });
+  std::vector<::grps::protos::v1::GrpsMessage> requests(records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (!requests[i].ParseFromString(records[i].message)) {
+      LOG(ERROR) << "Fail to parse record " << i;
+      return -1;
+    }
+  }
+  LOG(INFO) << "Loaded " << records.size() << " records, recorded duration: "
+            << double(records.back().arrival_us - records.front().arrival_us) / 1e6 << "s";
+
+  std::unique_ptr<Sender> sender;
+  if (FLAGS_protocol == "http") {
+    sender = std::make_unique<BrpcSender>(brpc::PROTOCOL_HTTP);
+  } else if (FLAGS_protocol == "brpc") {
+    sender = std::make_unique<BrpcSender>(brpc::PROTOCOL_BAIDU_STD);
+  } else if (FLAGS_protocol == "grpc") {
+    sender = std::make_unique<GrpcSender>();
+  } else {
+    LOG(ERROR) << "Unknown protocol: " << FLAGS_protocol;
+    return -1;
+  }
+  if (!sender->Init()) {
+    return -1;
+  }
+
+  // Workers send requests in queue.
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::condition_variable idle_cv;
+  std::deque<Task> queue;
+  bool finished = false;
+  std::vector<int64_t> latencies(records.size(), -1); // -1 means failed.
+  std::vector<std::thread> workers;
+  workers.reserve(FLAGS_concurrency);
+  for (int i = 0; i < FLAGS_concurrency; ++i) {
+    workers.emplace_back([&]() {
+      while (true) {
+        Task task{};
+        {
+          std::unique_lock<std::mutex> lock(mtx);
+          cv.wait(lock, [&]() { return finished || !queue.empty(); });
+          if (queue.empty()) {
+            return;
+          }
+          task = queue.front();
+          queue.pop_front();
+        }
+        idle_cv.notify_one();
+        const auto& model = FLAGS_model.empty() ? records[task.idx].model : FLAGS_model;
+        if (sender->Send(requests[task.idx], model)) {
+          latencies[task.idx] = butil::gettimeofday_us() - task.scheduled_us;
+        }
+      }
+    });
+  }
+
+  // Dispatch requests at their original intervals scaled by rate_scale.
+  int64_t begin_us = butil::gettimeofday_us();
+  for (size_t i = 0; i < records.size(); ++i) {
+    int64_t scheduled_us = begin_us;
+    if (FLAGS_rate_scale > 0) {
+      scheduled_us += int64_t(double(records[i].arrival_us - records.front().arrival_us) / FLAGS_rate_scale);
+      int64_t wait_us = scheduled_us - butil::gettimeofday_us();
+      if (wait_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+      }
+    } else {
+      // As fast as possible, dispatch when a worker is idle.
+      std::unique_lock<std::mutex> lock(mtx);
+      idle_cv.wait(lock, [&]() { return queue.size() < size_t(FLAGS_concurrency); });
+      scheduled_us = butil::gettimeofday_us();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      queue.push_back({i, scheduled_us});
+    }
+    cv.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    finished = true;
+  }
+  cv.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double elapsed_s = double(butil::gettimeofday_us() - begin_us) / 1e6;
+
+  // Report.
+  std::vector<int64_t> success;
+  success.reserve(latencies.size());
+  for (auto latency : latencies) {
+    if (latency >= 0) {
+      success.push_back(latency);
+    }
+  }
+  std::sort(success.begin(), success.end());
+  printf("protocol: %s, rate_scale: %g, concurrency: %d\n", FLAGS_protocol.c_str(), FLAGS_rate_scale,
+         FLAGS_concurrency);
+  printf("total: %zu, success: %zu, fail: %zu, elapsed: %.3fs, qps: %.2f\n", latencies.size(), success.size(),
+         latencies.size() - success.size(), elapsed_s, double(latencies.size()) / elapsed_s);
+  if (success.empty()) {
+    return 0;
+  }
+  double avg_us = 0;
+  for (auto latency : success) {
+    avg_us += double(latency) / double(success.size());
+  }
+  auto percentile = [&](double p) {
+    auto idx = size_t(p * double(success.size()));
+    return double(success[std::min(idx, success.size() - 1)]) / 1e3;
+  };
+  printf("latency(ms): avg: %.3f, p50: %.3f, p90: %.3f, p95: %.3f, p99: %.3f, p999: %.3f, max: %.3f\n", avg_us / 1e3,
+         percentile(0.5), percentile(0.9), percentile(0.95), percentile(0.99), percentile(0.999),
+         double(success.back()) / 1e3);
+  printf("latency cdf:\n%10s %12s\n", "ratio", "latency(ms)");
+  for (double p : {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 0.99, 0.999, 0.9999, 1.0}) {
+    printf("%10g %12.3f\n", p, percentile(p));
+  }
+  return 0;
+}
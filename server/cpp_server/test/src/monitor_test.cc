@@ -8,8 +8,18 @@
 #include "monitor/monitor.h"
 
 #include <gtest/gtest.h>
+#include <rapidjson/document.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+#include "constant.h"
 #include "logger/logger.h"
+#include "monitor/request_recorder.h"
+#include "monitor/stage_metrics.h"
+#include "monitor/trace.h"
 
 int parallel_num = 4;
 
@@ -85,6 +95,287 @@ TEST(monitor_test, test_min) {
   }
 }
 
+// Trend data of the last 60 seconds of metrics.
+static std::vector<float> LastMinuteTrend(const std::string& name) {
+  rapidjson::Document doc;
+  doc.Parse(netease::grps::Monitor::Instance().GetMetricsAggDataJson(name.c_str()).c_str());
+  std::vector<float> trend;
+  const auto& data = doc["data"];
+  for (rapidjson::SizeType i = 114; i < data.Size(); ++i) {
+    trend.push_back(data[i][1].GetFloat());
+  }
+  return trend;
+}
+
+TEST(monitor_test, test_register) {
+  auto* handle = MONITOR_REGISTER("test_register", netease::grps::AggType::kInc);
+  ASSERT_NE(handle, nullptr);
+  EXPECT_EQ(handle, MONITOR_REGISTER("test_register", netease::grps::AggType::kInc));
+  EXPECT_EQ(MONITOR_REGISTER("test_register", netease::grps::AggType::kAvg), nullptr);
+  EXPECT_EQ(handle->agg_name(), "test_register");
+  EXPECT_EQ(handle->agg_type(), netease::grps::AggType::kInc);
+}
+
+TEST(monitor_test, test_handle) {
+  auto* inc = MONITOR_REGISTER("test_handle_inc", netease::grps::AggType::kInc);
+  auto* max = MONITOR_REGISTER("test_handle_max", netease::grps::AggType::kMax);
+  auto* min = MONITOR_REGISTER("test_handle_min", netease::grps::AggType::kMin);
+  auto* avg = MONITOR_REGISTER("test_handle_avg", netease::grps::AggType::kAvg);
+  std::vector<std::thread> threads;
+  int count = 100000;
+  for (int i = 0; i < parallel_num; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < count; j++) {
+        float value = float(j % 100 + 1);
+        MONITOR_INC(inc, 1.0);
+        MONITOR_MAX(max, value);
+        MONITOR_MIN(min, value);
+        MONITOR_AVG(avg, value);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Wait for aggregation of all data.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  auto inc_trend = LastMinuteTrend("test_handle_inc");
+  EXPECT_FLOAT_EQ(std::accumulate(inc_trend.begin(), inc_trend.end(), 0.0f), float(parallel_num * count));
+  auto max_trend = LastMinuteTrend("test_handle_max");
+  EXPECT_FLOAT_EQ(*std::max_element(max_trend.begin(), max_trend.end()), 100);
+  for (auto value : LastMinuteTrend("test_handle_min")) {
+    EXPECT_TRUE(value == 0 || value == 1);
+  }
+  for (auto value : LastMinuteTrend("test_handle_avg")) {
+    EXPECT_TRUE(value == 0 || (value >= 1 && value <= 100));
+  }
+}
+
+TEST(monitor_test, test_register_concurrently) {
+  // Register new metrics while other threads are recording.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < parallel_num; i++) {
+    threads.emplace_back([i]() {
+      for (int j = 0; j < 1000; j++) {
+        MONITOR_INC("test_register_concurrently", 1.0);
+        MONITOR_AVG("test_register_concurrently_" + std::to_string(i) + "_" + std::to_string(j), 1.0);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  auto trend = LastMinuteTrend("test_register_concurrently");
+  EXPECT_FLOAT_EQ(std::accumulate(trend.begin(), trend.end(), 0.0f), float(parallel_num * 1000));
+  EXPECT_GE(netease::grps::Monitor::Instance().GetMetricsNames().size(), size_t(parallel_num * 1000));
+}
+
+TEST(monitor_test, test_stage_metrics) {
+  // Stage metrics of model node, and of batches of size 4 through batcher.
+  netease::grps::StageMetrics node_metrics("model=m-1.0.0,node=n", true);
+  netease::grps::StageMetrics batch_metrics("model=m-1.0.0,batch=4", false, true);
+  EXPECT_EQ(node_metrics.queue_wait, nullptr);
+  EXPECT_EQ(batch_metrics.preprocess, nullptr);
+  EXPECT_EQ(batch_metrics.postprocess, nullptr);
+  // Metrics of the same labels are shared.
+  EXPECT_EQ(netease::grps::StageMetrics("model=m-1.0.0,node=n", true).infer, node_metrics.infer);
+  EXPECT_NE(batch_metrics.infer, node_metrics.infer);
+
+  for (int i = 0; i < 100; i++) {
+    netease::grps::StageMetrics::Observe(node_metrics.preprocess, 1000);
+    netease::grps::StageMetrics::Observe(node_metrics.infer, 2000);
+    netease::grps::StageMetrics::Observe(node_metrics.postprocess, 3000);
+    netease::grps::StageMetrics::Observe(batch_metrics.queue_wait, 4000);
+    netease::grps::StageMetrics::Observe(batch_metrics.infer, 5000);
+    netease::grps::StageMetrics::Observe(batch_metrics.preprocess, 6000); // Ignored.
+  }
+
+  // All labeled metrics are aggregated by the same tick, latency is in ms.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  std::vector<std::pair<std::string, float>> expected = {
+    {std::string(STAGE_PREPROCESS_AVG) + "{model=m-1.0.0,node=n}", 1},
+    {std::string(STAGE_INFER_AVG) + "{model=m-1.0.0,node=n}", 2},
+    {std::string(STAGE_POSTPROCESS_AVG) + "{model=m-1.0.0,node=n}", 3},
+    {std::string(STAGE_QUEUE_WAIT_AVG) + "{model=m-1.0.0,batch=4}", 4},
+    {std::string(STAGE_INFER_AVG) + "{model=m-1.0.0,batch=4}", 5}};
+  for (const auto& [name, value] : expected) {
+    auto trend = LastMinuteTrend(name);
+    EXPECT_FLOAT_EQ(*std::max_element(trend.begin(), trend.end()), value) << name;
+  }
+  auto names = netease::grps::Monitor::Instance().GetMetricsNames();
+  EXPECT_EQ(std::count(names.begin(), names.end(), std::string(STAGE_PREPROCESS_AVG) + "{model=m-1.0.0,batch=4}"), 0);
+}
+
+TEST(monitor_test, test_cdf) {
+  auto* cdf = MONITOR_REGISTER("test_cdf", netease::grps::AggType::kCdf);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < parallel_num; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 1; j <= 10000; j++) {
+        MONITOR_CDF(cdf, float(j));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Percentiles of last minute, each with relative error less than 1% of the exact one.
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  rapidjson::Document doc;
+  doc.Parse(netease::grps::Monitor::Instance().GetMetricsAggDataJson("test_cdf").c_str());
+  const auto& data = doc["data_1m"];
+  ASSERT_EQ(data.Size(), 20);
+  std::vector<float> percentiles = {10, 20, 30, 40, 50, 60, 70, 80, 90, 91,
+                                    92, 93, 94, 95, 96, 97, 98, 99, 99.9, 99.99};
+  for (rapidjson::SizeType i = 0; i < data.Size(); ++i) {
+    float expected = std::ceil(percentiles[i] / 100 * 10000);
+    EXPECT_NEAR(data[i][1].GetFloat(), expected, expected * 0.01 + 0.01) << "percentile: " << percentiles[i];
+  }
+}
+
+TEST(monitor_test, test_prometheus) {
+  auto* inc = MONITOR_REGISTER("*test_prometheus_count{model=m-1.0.0}", netease::grps::AggType::kInc);
+  auto* avg = MONITOR_REGISTER("*test_prometheus_usage(%)", netease::grps::AggType::kAvg);
+  auto* cdf = MONITOR_REGISTER("*test_prometheus_latency(ms){node=n}", netease::grps::AggType::kCdf);
+  for (int i = 1; i <= 100; i++) {
+    MONITOR_INC(inc, 1.0);
+    MONITOR_AVG(avg, 50.0);
+    MONITOR_CDF(cdf, float(i));
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  auto text = netease::grps::Monitor::Instance().GetPrometheusText();
+  EXPECT_NE(text.find("# TYPE grps_test_prometheus_count_total counter\n"
+                      "grps_test_prometheus_count_total{model=\"m\",version=\"1.0.0\"} 100\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("# TYPE grps_test_prometheus_usage_percent gauge\n"), std::string::npos);
+  EXPECT_NE(text.find("# TYPE grps_test_prometheus_latency_ms histogram\n"), std::string::npos);
+  EXPECT_NE(text.find("grps_test_prometheus_latency_ms_bucket{node=\"n\",le=\"10\"} 10\n"), std::string::npos);
+  EXPECT_NE(text.find("grps_test_prometheus_latency_ms_bucket{node=\"n\",le=\"+Inf\"} 100\n"), std::string::npos);
+  EXPECT_NE(text.find("grps_test_prometheus_latency_ms_sum{node=\"n\"} 5050\n"), std::string::npos);
+  EXPECT_NE(text.find("grps_test_prometheus_latency_ms_count{node=\"n\"} 100\n"), std::string::npos);
+}
+
+TEST(monitor_test, test_history) {
+  std::string path = "./logs/test_monitor.history";
+  std::remove(path.c_str());
+  int64_t now_s = 1700000000 / 86400 * 86400 + 30; // 30s after a day boundary.
+  {
+    netease::grps::MetricsHistory history;
+    ASSERT_TRUE(history.Open(path, 4, 1, 8));
+    auto* trend = history.AttachTrend("*test_history", int(netease::grps::AggType::kAvg), now_s);
+    ASSERT_NE(trend, nullptr);
+    EXPECT_EQ(history.AttachTrend("*test_history", int(netease::grps::AggType::kAvg), now_s), nullptr); // Attached.
+    trend->seconds[trend->second_head++] = 1;
+    trend->minutes[trend->minute_head++] = 2;
+    trend->second_time = now_s;
+
+    netease::grps::CdfWindow window;
+    ASSERT_TRUE(history.AttachCdf("*test_history_cdf", now_s, window));
+    window.minutes[now_s / 60 % 60] = now_s / 60;
+    window.counts[(now_s / 60 % 60) * 8 + 3] = 5;
+    EXPECT_FALSE(history.AttachCdf("*test_history_cdf2", now_s, window)); // Full.
+  }
+
+  // Restart 2 minutes later.
+  now_s += 120;
+  netease::grps::MetricsHistory history;
+  ASSERT_TRUE(history.Open(path, 4, 1, 8));
+  auto* trend = history.AttachTrend("*test_history", int(netease::grps::AggType::kAvg), now_s);
+  ASSERT_NE(trend, nullptr);
+  // Seconds window is slid out, minutes window is slid by 2 minutes.
+  EXPECT_EQ(std::accumulate(trend->seconds.begin(), trend->seconds.end(), 0.0f), 0);
+  EXPECT_EQ(trend->minute_head, 3);
+  EXPECT_EQ(trend->minutes[0], 2);
+  EXPECT_EQ(trend->second_time, now_s);
+
+  netease::grps::CdfWindow window;
+  ASSERT_TRUE(history.AttachCdf("*test_history_cdf", now_s, window));
+  EXPECT_EQ(window.counts[((now_s - 120) / 60 % 60) * 8 + 3], 5);
+
+  // Layout changed, history is recreated.
+  history.Close();
+  ASSERT_TRUE(history.Open(path, 4, 1, 16));
+  trend = history.AttachTrend("*test_history", int(netease::grps::AggType::kAvg), now_s);
+  ASSERT_NE(trend, nullptr);
+  EXPECT_EQ(trend->minutes[0], 0);
+}
+
+TEST(monitor_test, test_trace) {
+  auto& tracer = netease::grps::Tracer::Instance();
+  EXPECT_EQ(tracer.Sample("test"), nullptr); // Disabled by default.
+
+  tracer.Init(1.0, 2);
+  for (int i = 0; i < 3; i++) {
+    auto trace = tracer.Sample("test");
+    ASSERT_NE(trace, nullptr);
+    {
+      netease::grps::Tracer::CurrentScope scope(trace.get());
+      EXPECT_EQ(netease::grps::Tracer::Current(), trace.get());
+      netease::grps::Trace::Record(netease::grps::Tracer::Current(), "infer", 100, 300, "m");
+    }
+    EXPECT_EQ(netease::grps::Tracer::Current(), nullptr);
+    tracer.Finish(trace);
+  }
+  tracer.Init(0, 2);
+  EXPECT_EQ(tracer.Sample("test"), nullptr);
+
+  rapidjson::Document doc;
+  doc.Parse(tracer.ChromeTraceJson().c_str());
+  ASSERT_TRUE(doc.IsObject());
+  const auto& events = doc["traceEvents"];
+  ASSERT_EQ(events.Size(), 4); // Latest 2 traces, one track name event and one span each.
+  EXPECT_STREQ(events[1]["name"].GetString(), "infer");
+  EXPECT_STREQ(events[1]["ph"].GetString(), "X");
+  EXPECT_EQ(events[1]["ts"].GetInt64(), 100);
+  EXPECT_EQ(events[1]["dur"].GetInt64(), 200);
+  EXPECT_STREQ(events[1]["args"]["model"].GetString(), "m");
+
+  doc.Parse(tracer.ChromeTraceJson(1).c_str());
+  EXPECT_EQ(doc["traceEvents"].Size(), 2);
+}
+
+TEST(monitor_test, test_request_recorder) {
+  std::string path = "./logs/test_requests.rec";
+  std::remove(path.c_str());
+  std::remove((path + ".1").c_str());
+  auto& recorder = netease::grps::RequestRecorder::Instance();
+  ::grps::protos::v1::GrpsMessage request;
+  request.set_str_data("hello0");
+  recorder.Sample(request, "m"); // Disabled by default.
+
+  // Every file holds 2 records at most.
+  netease::grps::RequestRecorder::Record record{0, "m", request.SerializeAsString()};
+  std::string buf;
+  netease::grps::RequestRecorder::Encode(record, buf);
+  auto max_file_size = int64_t(sizeof(netease::grps::RequestRecorder::kMagic) + sizeof(uint32_t) + buf.size() * 2);
+  ASSERT_TRUE(recorder.Init(path, 1.0, max_file_size, 2));
+  for (int i = 0; i < 5; i++) {
+    request.set_str_data("hello" + std::to_string(i));
+    recorder.Sample(request, "m");
+  }
+  recorder.Stop();
+  EXPECT_EQ(recorder.dropped(), 0);
+
+  // The oldest file is removed by rotation.
+  std::vector<std::string> data;
+  for (const auto& file : {path + ".1", path}) {
+    netease::grps::RequestRecordReader reader;
+    ASSERT_TRUE(reader.Open(file));
+    while (reader.Next(record)) {
+      EXPECT_EQ(record.model, "m");
+      EXPECT_GT(record.arrival_us, 0);
+      ASSERT_TRUE(request.ParseFromString(record.message));
+      data.push_back(request.str_data());
+    }
+  }
+  EXPECT_EQ(data, std::vector<std::string>({"hello2", "hello3", "hello4"}));
+}
+
 int main(int argc, char** argv) {
   if (argc == 2) { // parse parallel_num
     parallel_num = std::stoi(argv[1]);
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/03
+ * Brief  Response cache test.
+ */
+
+#include "cache/response_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "logger/logger.h"
+#include "monitor/monitor.h"
+
+using netease::grps::GrpsContext;
+using netease::grps::ResponseCache;
+
+static ::grps::protos::v1::GrpsMessage Message(const std::string& str_data) {
+  ::grps::protos::v1::GrpsMessage message;
+  message.set_str_data(str_data);
+  return message;
+}
+
+// Bytes taken by one cached response of the given size.
+static size_t EntryBytes(size_t data_size) {
+  ResponseCache cache("test_entry_bytes", ResponseCache::Policy::kLru, 1024 * 1024, 0, 1);
+  cache.Insert(cache.MakeKey(Message("")), Message(std::string(data_size, 'x')));
+  return cache.bytes();
+}
+
+TEST(response_cache_test, test_invalid_args) {
+  EXPECT_THROW(ResponseCache("m", ResponseCache::Policy::kLru, 0, 0, 1), ResponseCache::ResponseCacheException);
+  EXPECT_THROW(ResponseCache("m", ResponseCache::Policy::kLru, 1024, 0, 0), ResponseCache::ResponseCacheException);
+  EXPECT_THROW(ResponseCache("m", ResponseCache::Policy::kLru, 1024, -1, 1), ResponseCache::ResponseCacheException);
+}
+
+TEST(response_cache_test, test_make_key) {
+  auto input = Message("a");
+  EXPECT_TRUE(ResponseCache::MakeKey("m-1", input) == ResponseCache::MakeKey("m-1", Message("a")));
+  EXPECT_FALSE(ResponseCache::MakeKey("m-1", input) == ResponseCache::MakeKey("m-2", input));
+  EXPECT_FALSE(ResponseCache::MakeKey("m-1", input) == ResponseCache::MakeKey("m-1", Message("b")));
+
+  // Map fields are serialized deterministically.
+  ::grps::protos::v1::GrpsMessage map1;
+  ::grps::protos::v1::GrpsMessage map2;
+  for (int i = 0; i < 16; ++i) {
+    (*map1.mutable_gmap()->mutable_s_s())[std::to_string(i)] = "v";
+    (*map2.mutable_gmap()->mutable_s_s())[std::to_string(15 - i)] = "v";
+  }
+  EXPECT_TRUE(ResponseCache::MakeKey("m-1", map1) == ResponseCache::MakeKey("m-1", map2));
+}
+
+TEST(response_cache_test, test_hit_miss) {
+  ResponseCache cache("test_hit_miss", ResponseCache::Policy::kLru, 1024 * 1024, 0, 4);
+  auto key = cache.MakeKey(Message("a"));
+  ::grps::protos::v1::GrpsMessage output;
+  EXPECT_FALSE(cache.Lookup(key, output));
+
+  cache.Insert(key, Message("res_a"));
+  ASSERT_TRUE(cache.Lookup(key, output));
+  EXPECT_EQ(output.str_data(), "res_a");
+  EXPECT_FALSE(cache.Lookup(cache.MakeKey(Message("b")), output));
+
+  // Insert again replaces the old response.
+  cache.Insert(key, Message("res_a2"));
+  ASSERT_TRUE(cache.Lookup(key, output));
+  EXPECT_EQ(output.str_data(), "res_a2");
+  EXPECT_EQ(cache.bytes(), EntryBytes(6));
+}
+
+TEST(response_cache_test, test_ttl) {
+  ResponseCache cache("test_ttl", ResponseCache::Policy::kLru, 1024 * 1024, 20, 1);
+  auto key = cache.MakeKey(Message("a"));
+  cache.Insert(key, Message("res_a"));
+  ::grps::protos::v1::GrpsMessage output;
+  EXPECT_TRUE(cache.Lookup(key, output));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(cache.Lookup(key, output));
+  EXPECT_EQ(cache.bytes(), 0); // Expired entry is removed when looked up.
+}
+
+TEST(response_cache_test, test_lru_eviction) {
+  auto entry_bytes = EntryBytes(1000);
+  ResponseCache cache("test_lru_eviction", ResponseCache::Policy::kLru, entry_bytes * 3, 0, 1);
+  auto key_a = cache.MakeKey(Message("a"));
+  auto key_b = cache.MakeKey(Message("b"));
+  auto key_c = cache.MakeKey(Message("c"));
+  auto key_d = cache.MakeKey(Message("d"));
+  auto res = Message(std::string(1000, 'x'));
+  cache.Insert(key_a, res);
+  cache.Insert(key_b, res);
+  cache.Insert(key_c, res);
+  EXPECT_EQ(cache.bytes(), entry_bytes * 3);
+
+  // a is the most recently used after lookup, so b is evicted.
+  ::grps::protos::v1::GrpsMessage output;
+  ASSERT_TRUE(cache.Lookup(key_a, output));
+  cache.Insert(key_d, res);
+  EXPECT_EQ(cache.bytes(), entry_bytes * 3);
+  EXPECT_TRUE(cache.Lookup(key_a, output));
+  EXPECT_FALSE(cache.Lookup(key_b, output));
+  EXPECT_TRUE(cache.Lookup(key_c, output));
+  EXPECT_TRUE(cache.Lookup(key_d, output));
+
+  // Response bigger than the budget is never cached.
+  auto key_e = cache.MakeKey(Message("e"));
+  cache.Insert(key_e, Message(std::string(entry_bytes * 4, 'x')));
+  EXPECT_FALSE(cache.Lookup(key_e, output));
+  EXPECT_TRUE(cache.Lookup(key_a, output));
+}
+
+TEST(response_cache_test, test_tinylfu_admission) {
+  auto entry_bytes = EntryBytes(1000);
+  ResponseCache cache("test_tinylfu_admission", ResponseCache::Policy::kTinyLfu, entry_bytes * 2, 0, 1);
+  auto key_a = cache.MakeKey(Message("a"));
+  auto key_b = cache.MakeKey(Message("b"));
+  auto key_c = cache.MakeKey(Message("c"));
+  auto res = Message(std::string(1000, 'x'));
+  ::grps::protos::v1::GrpsMessage output;
+
+  // Admitted without eviction when there is room.
+  cache.Insert(key_a, res);
+  cache.Insert(key_b, res);
+  for (int i = 0; i < 4; ++i) {
+    cache.Lookup(key_a, output);
+    cache.Lookup(key_b, output);
+  }
+
+  // One-hit candidate is rejected, hot entries are kept.
+  EXPECT_FALSE(cache.Lookup(key_c, output));
+  cache.Insert(key_c, res);
+  EXPECT_FALSE(cache.Lookup(key_c, output));
+  EXPECT_TRUE(cache.Lookup(key_a, output));
+  EXPECT_TRUE(cache.Lookup(key_b, output));
+
+  // Candidate more frequent than the victim is admitted and evicts the lru one.
+  for (int i = 0; i < 16; ++i) {
+    cache.Lookup(key_c, output);
+  }
+  cache.Insert(key_c, res);
+  EXPECT_TRUE(cache.Lookup(key_c, output));
+  EXPECT_EQ(cache.bytes(), entry_bytes * 2);
+  EXPECT_FALSE(cache.Lookup(key_a, output));
+}
+
+TEST(response_cache_test, test_cacheable) {
+  auto request = Message("a");
+  auto ctx = GrpsContext::Acquire(&request);
+  EXPECT_TRUE(ResponseCache::Cacheable(*ctx));
+
+  // Writer is only compared with nullptr.
+  auto* writer = reinterpret_cast<::grpc::ServerWriter<::grps::protos::v1::GrpsMessage>*>(&request);
+  auto streaming_ctx = GrpsContext::Acquire(&request, writer);
+  EXPECT_FALSE(ResponseCache::Cacheable(*streaming_ctx));
+}
+
+int main(int argc, char** argv) {
+  // Init logger.
+  std::string sys_log_path = "./logs/grps_server.log";
+  std::string usr_log_path = "./logs/grps_usr.log";
+  netease::grps::DailyLogger::Instance().Init(sys_log_path, 7, usr_log_path, 7);
+
+  auto& monitor_inst = netease::grps::Monitor::Instance();
+  monitor_inst.Init();
+  monitor_inst.Start();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  auto ret = RUN_ALL_TESTS();
+
+  monitor_inst.Stop();
+  return ret;
+}
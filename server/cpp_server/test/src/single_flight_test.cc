@@ -0,0 +1,163 @@
+/*
+ * Copyright 2022 netease. All rights reserved.
+ * Author zhaochaochao@corp.netease.com
+ * Date   2024/06/05
+ * Brief  Single flight test.
+ */
+
+#include "cache/single_flight.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "logger/logger.h"
+#include "monitor/monitor.h"
+
+using netease::grps::GrpsContext;
+using netease::grps::ResponseCache;
+using netease::grps::SingleFlight;
+
+static ::grps::protos::v1::GrpsMessage Message(const std::string& str_data) {
+  ::grps::protos::v1::GrpsMessage message;
+  message.set_str_data(str_data);
+  return message;
+}
+
+// Follower joining the in-flight call of input, run in another thread.
+struct Follower {
+  std::thread thread;
+  bool joined = false;
+  ::grps::protos::v1::GrpsMessage output;
+  std::string err_msg;
+
+  Follower(SingleFlight& single_flight, const ::grps::protos::v1::GrpsMessage& input) {
+    thread = std::thread([this, &single_flight, &input]() {
+      auto ctx = GrpsContext::Acquire(&input);
+      std::unique_ptr<SingleFlight::Leader> leader;
+      joined = single_flight.Join(ResponseCache::MakeKey(single_flight.model_name(), input), output, *ctx, leader);
+      EXPECT_EQ(leader, nullptr);
+      err_msg = ctx->err_msg();
+    });
+    // Wait for the follower to join the in-flight call.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+};
+
+TEST(single_flight_test, test_result) {
+  SingleFlight single_flight("test_result");
+  auto input = Message("a");
+  auto key = ResponseCache::MakeKey(single_flight.model_name(), input);
+  auto ctx = GrpsContext::Acquire(&input);
+  ::grps::protos::v1::GrpsMessage output;
+  std::unique_ptr<SingleFlight::Leader> leader;
+  ASSERT_FALSE(single_flight.Join(key, output, *ctx, leader));
+  ASSERT_NE(leader, nullptr);
+
+  Follower follower1(single_flight, input);
+  Follower follower2(single_flight, input);
+  output.set_str_data("res_a");
+  leader.reset(); // Publish.
+  for (auto* follower : {&follower1, &follower2}) {
+    follower->thread.join();
+    EXPECT_TRUE(follower->joined);
+    EXPECT_TRUE(follower->err_msg.empty());
+    EXPECT_EQ(follower->output.str_data(), "res_a");
+  }
+
+  // Finished call is removed, the next request leads a new one.
+  ASSERT_FALSE(single_flight.Join(key, output, *ctx, leader));
+  EXPECT_NE(leader, nullptr);
+}
+
+TEST(single_flight_test, test_error) {
+  SingleFlight single_flight("test_error");
+  auto input = Message("a");
+  auto key = ResponseCache::MakeKey(single_flight.model_name(), input);
+  auto ctx = GrpsContext::Acquire(&input);
+  ::grps::protos::v1::GrpsMessage output;
+  std::unique_ptr<SingleFlight::Leader> leader;
+  ASSERT_FALSE(single_flight.Join(key, output, *ctx, leader));
+
+  Follower follower(single_flight, input);
+  ctx->set_err_msg("infer failed");
+  leader.reset();
+  follower.thread.join();
+  EXPECT_TRUE(follower.joined);
+  EXPECT_EQ(follower.err_msg, "infer failed");
+}
+
+TEST(single_flight_test, test_exception) {
+  SingleFlight single_flight("test_exception");
+  auto input = Message("a");
+  auto key = ResponseCache::MakeKey(single_flight.model_name(), input);
+  auto ctx = GrpsContext::Acquire(&input);
+  ::grps::protos::v1::GrpsMessage output;
+  std::unique_ptr<SingleFlight::Leader> leader;
+  ASSERT_FALSE(single_flight.Join(key, output, *ctx, leader));
+
+  Follower follower(single_flight, input);
+  try {
+    auto guard = std::move(leader);
+    throw std::runtime_error("infer throws");
+  } catch (const std::exception&) {
+  }
+  follower.thread.join();
+  EXPECT_TRUE(follower.joined);
+  EXPECT_NE(follower.err_msg.find("leader request throws exception"), std::string::npos);
+}
+
+TEST(single_flight_test, test_timeout) {
+  SingleFlight single_flight("test_timeout", 100);
+  auto input = Message("a");
+  auto key = ResponseCache::MakeKey(single_flight.model_name(), input);
+  auto ctx = GrpsContext::Acquire(&input);
+  ::grps::protos::v1::GrpsMessage output;
+  std::unique_ptr<SingleFlight::Leader> leader;
+  ASSERT_FALSE(single_flight.Join(key, output, *ctx, leader));
+
+  // Leader is stuck, follower gives up and runs independently.
+  auto begin = std::chrono::steady_clock::now();
+  Follower follower(single_flight, input);
+  follower.thread.join();
+  EXPECT_GE(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(100));
+  EXPECT_FALSE(follower.joined);
+  EXPECT_TRUE(follower.err_msg.empty());
+  leader.reset();
+}
+
+TEST(single_flight_test, test_different_keys) {
+  SingleFlight single_flight("test_different_keys");
+  auto input_a = Message("a");
+  auto input_b = Message("b");
+  auto ctx = GrpsContext::Acquire(&input_a);
+  ::grps::protos::v1::GrpsMessage output_a;
+  ::grps::protos::v1::GrpsMessage output_b;
+  std::unique_ptr<SingleFlight::Leader> leader_a;
+  std::unique_ptr<SingleFlight::Leader> leader_b;
+  EXPECT_FALSE(
+    single_flight.Join(ResponseCache::MakeKey(single_flight.model_name(), input_a), output_a, *ctx, leader_a));
+  EXPECT_FALSE(
+    single_flight.Join(ResponseCache::MakeKey(single_flight.model_name(), input_b), output_b, *ctx, leader_b));
+  EXPECT_NE(leader_a, nullptr);
+  EXPECT_NE(leader_b, nullptr);
+}
+
+int main(int argc, char** argv) {
+  // Init logger.
+  std::string sys_log_path = "./logs/grps_server.log";
+  std::string usr_log_path = "./logs/grps_usr.log";
+  netease::grps::DailyLogger::Instance().Init(sys_log_path, 7, usr_log_path, 7);
+
+  auto& monitor_inst = netease::grps::Monitor::Instance();
+  monitor_inst.Init();
+  monitor_inst.Start();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  auto ret = RUN_ALL_TESTS();
+
+  monitor_inst.Stop();
+  return ret;
+}